@@ -36,6 +36,7 @@
 #include "common/options.h"
 #include "common/utils.h"
 #include "common/directory_iterator.h"
+#include "decode_cache.h"
 #include "noise_generator.h"
 #include "tlb_simulator.h"
 #include "tracer/raw2trace_directory.h"
@@ -54,8 +55,11 @@
 #endif
 #include "reader/ipc_reader.h"
 #include "simulator/cache_simulator_create.h"
+#include "simulator/cache_sweep_create.h"
 #include "simulator/tlb_simulator_create.h"
 #include "tools/basic_counts_create.h"
+#include "tools/columnar_export_create.h"
+#include "tools/fcache_sim_create.h"
 #include "tools/filter/record_filter_create.h"
 #include "tools/func_view_create.h"
 #include "tools/histogram_create.h"
@@ -77,6 +81,24 @@ namespace drmemtrace {
 using ::dynamorio::droption::droption_parser_t;
 using ::dynamorio::droption::DROPTION_SCOPE_ALL;
 
+// Shared by the memref and record versions of the schedule_stats tool.
+// Returns false on a usage error.
+static bool
+get_schedule_stats_knobs(schedule_stats_knobs_t &knobs)
+{
+    knobs.print_every = op_schedule_stats_print_every.get_value();
+    knobs.verbose = op_verbose.get_value();
+    knobs.streaming = op_schedule_stats_streaming.get_value();
+    knobs.json_path = op_schedule_stats_json.get_value();
+    if (!knobs.json_path.empty() && op_interval_microseconds.get_value() == 0 &&
+        op_interval_instr_count.get_value() == 0) {
+        ERRMSG("Usage error: -schedule_stats_json requires -interval_microseconds or "
+               "-interval_instr_count.\n");
+        return false;
+    }
+    return true;
+}
+
 /****************************************************************
  * Specializations for analyzer_multi_tmpl_t<memref_t, reader_t>,
  * aka analyzer_multi_t.
@@ -200,7 +222,21 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         cache_simulator_knobs_t *knobs = get_cache_simulator_knobs();
         return cache_miss_analyzer_create(*knobs, op_miss_count_threshold.get_value(),
                                           op_miss_frac_threshold.get_value(),
-                                          op_confidence_threshold.get_value());
+                                          op_confidence_threshold.get_value(),
+                                          op_miss_max_tracked_pcs.get_value());
+    } else if (tool == CACHE_SWEEP) {
+        cache_sweep_knobs_t knobs;
+        knobs.line_size = op_line_size.get_value();
+        knobs.min_sets = op_sweep_min_sets.get_value();
+        knobs.max_sets = op_sweep_max_sets.get_value();
+        knobs.max_assoc = op_sweep_max_assoc.get_value();
+        knobs.replace_policy = op_replace_policy.get_value();
+        knobs.sample_rate = op_sweep_sample_rate.get_value();
+        knobs.skip_refs = op_skip_refs.get_value();
+        knobs.warmup_refs = op_warmup_refs.get_value();
+        knobs.sim_refs = op_sim_refs.get_value();
+        knobs.verbose = op_verbose.get_value();
+        return cache_sweep_create(knobs);
     } else if (tool == TLB || tool == TLB_LEGACY) {
         tlb_simulator_knobs_t knobs;
         knobs.num_cores = op_num_cores.get_value();
@@ -219,6 +255,9 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         knobs.verbose = op_verbose.get_value();
         knobs.cpu_scheduling = op_cpu_scheduling.get_value();
         knobs.use_physical = op_use_physical.get_value();
+        knobs.checkpoint_in = op_sim_checkpoint_in.get_value();
+        knobs.checkpoint_out = op_sim_checkpoint_out.get_value();
+        knobs.checkpoint_instrs = op_sim_checkpoint_instrs.get_value();
         knobs.v2p_file =
             get_aux_file_path(op_v2p_file.get_value(), DRMEMTRACE_V2P_FILENAME);
         analysis_tool_t *tlb_simulator = tlb_simulator_create(knobs);
@@ -284,15 +323,35 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
     } else if (tool == INVARIANT_CHECKER) {
         return create_invariant_checker();
     } else if (tool == SCHEDULE_STATS) {
-        return schedule_stats_tool_create(op_schedule_stats_print_every.get_value(),
-                                          op_verbose.get_value());
+        schedule_stats_knobs_t knobs;
+        if (!get_schedule_stats_knobs(knobs))
+            return nullptr;
+        return schedule_stats_tool_create(knobs);
+    } else if (tool == COLUMNAR_EXPORT) {
+        if (op_columnar_dir.get_value().empty()) {
+            ERRMSG("Usage error: the " COLUMNAR_EXPORT " tool requires -columnar_dir.\n");
+            return nullptr;
+        }
+        return columnar_export_tool_create(op_columnar_dir.get_value(),
+                                           op_columnar_chunk_rows.get_value(),
+                                           op_verbose.get_value());
+    } else if (tool == FCACHE_SIM) {
+        std::vector<fcache_sim_config_t> configs;
+        std::string error =
+            fcache_sim_parse_configs(op_fcache_sim_configs.get_value(), configs);
+        if (!error.empty()) {
+            ERRMSG("Usage error: invalid -fcache_sim_configs: %s\n", error.c_str());
+            return nullptr;
+        }
+        return fcache_sim_tool_create(configs, op_verbose.get_value());
     } else {
         auto ext_tool = create_external_tool(tool);
         if (ext_tool == nullptr) {
             ERRMSG("Usage error: unsupported analyzer type \"%s\". "
                    "Please choose " CPU_CACHE ", " MISS_ANALYZER ", " TLB ", " HISTOGRAM
                    ", " REUSE_DIST ", " BASIC_COUNTS ", " OPCODE_MIX ", " SYSCALL_MIX
-                   ", " VIEW ", " FUNC_VIEW ", or some external analyzer.\n",
+                   ", " VIEW ", " FUNC_VIEW ", " COLUMNAR_EXPORT ", " CACHE_SWEEP
+                   ", " FCACHE_SIM ", or some external analyzer.\n",
                    tool.c_str());
         }
         return ext_tool;
@@ -355,8 +414,10 @@ record_analyzer_multi_t::create_analysis_tool_from_options(const std::string &to
             op_filter_kernel.get_value(), op_filter_kernel_except_syscalls.get_value(),
             op_verbose.get_value());
     } else if (tool == SCHEDULE_STATS) {
-        return record_schedule_stats_tool_create(
-            op_schedule_stats_print_every.get_value(), op_verbose.get_value());
+        schedule_stats_knobs_t knobs;
+        if (!get_schedule_stats_knobs(knobs))
+            return nullptr;
+        return record_schedule_stats_tool_create(knobs);
     }
     ERRMSG("Usage error: unsupported record analyzer type \"%s\".  Only " RECORD_FILTER
            " and " SCHEDULE_STATS " are supported.\n",
@@ -525,6 +586,12 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::analyzer_multi_tmpl_t()
             }
         }
     }
+    // Any decode caches the tools create attach to the shared cache at init time,
+    // so it must be installed before the tools exist.
+    if (op_shared_decode_cache.get_value()) {
+        shared_decode_cache_.reset(new shared_decode_cache_t());
+        decode_cache_base_t::set_shared_cache(shared_decode_cache_.get());
+    }
     // Create the tools after post-processing so we have the schedule files for
     // test_mode.
     if (!create_analysis_tools()) {
@@ -674,6 +741,10 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::~analyzer_multi_tmpl_t()
     }
 #endif
     destroy_analysis_tools();
+    if (shared_decode_cache_ != nullptr) {
+        decode_cache_base_t::set_shared_cache(nullptr);
+        shared_decode_cache_.reset();
+    }
 }
 
 template <typename RecordType, typename ReaderType>
@@ -889,6 +960,7 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::get_cache_simulator_knobs()
     knobs->LL_assoc = op_LL_assoc.get_value();
     knobs->LL_miss_file = op_LL_miss_file.get_value();
     knobs->model_coherence = op_coherence.get_value();
+    knobs->coherence_directory_entries = op_coherence_directory_entries.get_value();
     knobs->replace_policy = op_replace_policy.get_value();
     knobs->data_prefetcher = op_data_prefetcher.get_value();
     knobs->skip_refs = op_skip_refs.get_value();
@@ -898,6 +970,9 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::get_cache_simulator_knobs()
     knobs->verbose = op_verbose.get_value();
     knobs->cpu_scheduling = op_cpu_scheduling.get_value();
     knobs->use_physical = op_use_physical.get_value();
+    knobs->checkpoint_in = op_sim_checkpoint_in.get_value();
+    knobs->checkpoint_out = op_sim_checkpoint_out.get_value();
+    knobs->checkpoint_instrs = op_sim_checkpoint_instrs.get_value();
     return knobs;
 }
 
@@ -45,6 +45,8 @@
 namespace dynamorio {
 namespace drmemtrace {
 
+class shared_decode_cache_t;
+
 template <typename RecordType, typename ReaderType>
 class analyzer_multi_tmpl_t : public analyzer_tmpl_t<RecordType, ReaderType> {
 public:
@@ -107,6 +109,8 @@ protected:
     std::unique_ptr<archive_istream_t> cpu_schedule_zip_;
     std::unique_ptr<archive_ostream_t> record_schedule_zip_;
     std::unique_ptr<archive_istream_t> replay_schedule_zip_;
+    // Shared by the decode caches of all tools; see -shared_decode_cache.
+    std::unique_ptr<shared_decode_cache_t> shared_decode_cache_;
 
     static const int max_num_tools_ = 8;
 };
@@ -140,6 +140,16 @@ droption_t<std::string> op_alt_module_dir(
     "analysis tools, or in the raw modules file for post-prcoessing of offline "
     "raw trace files.  This directory takes precedence over the recorded path.");
 
+droption_t<bool> op_shared_decode_cache(
+    DROPTION_SCOPE_FRONTEND, "shared_decode_cache", true,
+    "Share decoded instructions among analysis tools",
+    "By default, instruction decode information cached by analysis tools (such as "
+    "opcode_mix, view, and the invariant checker) is kept in a single concurrent cache "
+    "owned by the analyzer and shared across all tools and shards, so that each "
+    "distinct instruction encoding is decoded once per type of cached information "
+    "rather than once per tool per shard.  Set this to false to give each tool and "
+    "shard a private decode cache.");
+
 droption_t<bytesize_t> op_chunk_instr_count(
     DROPTION_SCOPE_FRONTEND, "chunk_instr_count", bytesize_t(10 * 1000 * 1000U),
     // We do not support tiny chunks.  We do not support disabling chunks with a 0
@@ -271,6 +281,37 @@ droption_t<bytesize_t> op_L0D_size(
     "Must be a power of 2 and a multiple of line_size, unless it is set to 0, "
     "which disables data entries from appearing in the trace.");
 
+droption_t<bytesize_t> op_L0_filter_target_bw(
+    DROPTION_SCOPE_CLIENT, "L0_filter_target_bw", 0,
+    "Target trace bytes per second for adaptive L0 filter sizing",
+    "If non-zero and -L0I_filter or -L0D_filter is enabled, the sizes of the "
+    "'zero-level' filter caches are adapted at the end of each phase of "
+    "-L0_filter_adapt_ms milliseconds so that the process-wide rate of trace output "
+    "(in bytes per second, prior to any compression) approaches this target.  Each "
+    "adjustment doubles or halves both filter sizes, starting from -L0I_size and "
+    "-L0D_size, bounded above by -L0_filter_max_size and below by -line_size.  Only "
+    "the sizes are adapted: the filters stay direct-mapped, as the inline lookup "
+    "checks a single line.  A "
+    "filter is emptied when its size changes, and the new size is recorded in the "
+    "trace for each thread with a "
+    "#dynamorio::drmemtrace::TRACE_MARKER_TYPE_L0I_FILTER_SIZE or "
+    "#dynamorio::drmemtrace::TRACE_MARKER_TYPE_L0D_FILTER_SIZE marker so that "
+    "simulators can account for the change.");
+
+droption_t<unsigned int> op_L0_filter_adapt_ms(
+    DROPTION_SCOPE_CLIENT, "L0_filter_adapt_ms", 1000,
+    "Phase length in milliseconds for -L0_filter_target_bw",
+    "Specifies the length in milliseconds of each phase over which the trace output "
+    "rate is measured for -L0_filter_target_bw.  The filter sizes are changed at most "
+    "once per phase.");
+
+droption_t<bytesize_t> op_L0_filter_max_size(
+    DROPTION_SCOPE_CLIENT, "L0_filter_max_size", 1024 * 1024U,
+    "Maximum L0 filter size for -L0_filter_target_bw",
+    "Specifies the maximum size of each 'zero-level' filter cache when its size is "
+    "adapted by -L0_filter_target_bw.  Must be a power of 2 no smaller than -L0I_size "
+    "and -L0D_size.  Each thread allocates filter storage of this size up front.");
+
 droption_t<bool> op_instr_only_trace(
     DROPTION_SCOPE_CLIENT, "instr_only_trace", false,
     "Include only instruction fetch entries in trace",
@@ -281,6 +322,15 @@ droption_t<bool> op_coherence(
     DROPTION_SCOPE_FRONTEND, "coherence", false, "Model coherence for private caches",
     "Writes to cache lines will invalidate other private caches that hold that line.");
 
+droption_t<uint64_t> op_coherence_directory_entries(
+    DROPTION_SCOPE_FRONTEND, "coherence_directory_entries", 0,
+    "Directory entries for -coherence, or 0 for a perfect snoop filter",
+    "By default the snoop filter used by -coherence tracks every line held in the "
+    "snooped caches.  If this is non-zero, it instead models a sparse directory "
+    "with this many entries: tracking a new line when the directory is full evicts "
+    "an existing entry and invalidates that line in every cache sharing it.  The "
+    "number of such evictions is reported in the coherence statistics.");
+
 droption_t<bool> op_use_physical(
     DROPTION_SCOPE_ALL, "use_physical", false, "Use physical addresses if possible",
     "If available, metadata with virtual-to-physical-address translation information "
@@ -488,6 +538,34 @@ droption_t<std::string> op_replace_policy(
     "caches. Supported policies: LRU (Least Recently Used), LFU (Least Frequently Used), "
     "FIFO (First-In-First-Out).");
 
+droption_t<unsigned int> op_sweep_min_sets(
+    DROPTION_SCOPE_FRONTEND, "sweep_min_sets", 64, "Smallest set count for " CACHE_SWEEP,
+    "Specifies the smallest number of sets in the grid of cache geometries simulated "
+    "by the " CACHE_SWEEP " tool.  Each power of 2 from this value up to "
+    "-sweep_max_sets is simulated.  Must be a power of 2.");
+
+droption_t<unsigned int> op_sweep_max_sets(
+    DROPTION_SCOPE_FRONTEND, "sweep_max_sets", 65536,
+    "Largest set count for " CACHE_SWEEP,
+    "Specifies the largest number of sets in the grid of cache geometries simulated "
+    "by the " CACHE_SWEEP " tool.  Must be a power of 2.");
+
+droption_t<unsigned int> op_sweep_max_assoc(
+    DROPTION_SCOPE_FRONTEND, "sweep_max_assoc", 16, 1, 1024,
+    "Largest associativity for " CACHE_SWEEP,
+    "Specifies the largest associativity in the grid of cache geometries simulated by "
+    "the " CACHE_SWEEP " tool.  With the LRU -replace_policy every associativity up "
+    "to this value is computed; with other policies, each power of 2 up to this value "
+    "is simulated.");
+
+droption_t<unsigned int> op_sweep_sample_rate(
+    DROPTION_SCOPE_FRONTEND, "sweep_sample_rate", 64,
+    "Set sampling rate for non-LRU " CACHE_SWEEP,
+    "For the " CACHE_SWEEP " tool with a -replace_policy other than LRU, only one in "
+    "this many sets of each cache is simulated and the resulting counts are scaled up. "
+    "Must be a power of 2.  A value of 1 simulates every set.  LRU results are always "
+    "exact and ignore this option.");
+
 droption_t<std::string> op_data_prefetcher(
     DROPTION_SCOPE_FRONTEND, "data_prefetcher", PREFETCH_POLICY_NEXTLINE,
     "Hardware data prefetcher policy (nextline, none)",
@@ -542,7 +620,8 @@ droption_t<std::string>
             "can be specified, separated by a colon (\":\").",
             "Predefined types: " CPU_CACHE ", " MISS_ANALYZER ", " TLB ", " REUSE_DIST
             ", " REUSE_TIME ", " HISTOGRAM ", " BASIC_COUNTS ", " INVARIANT_CHECKER
-            ", " SCHEDULE_STATS ", or " RECORD_FILTER ". The " RECORD_FILTER
+            ", " SCHEDULE_STATS ", " COLUMNAR_EXPORT ", " CACHE_SWEEP ", " FCACHE_SIM
+            ", or " RECORD_FILTER ". The " RECORD_FILTER
             " tool cannot be combined with the others "
             "as it operates on raw disk records. "
             "To invoke an external tool: specify its name as identified by a "
@@ -750,6 +829,32 @@ droption_t<bytesize_t> op_sim_refs(
     "that works on all tools (but does not work with -warmup_*, -sim_refs, or "
     "-skip_refs).");
 
+droption_t<std::string> op_sim_checkpoint_instrs(
+    DROPTION_SCOPE_FRONTEND, "sim_checkpoint_instrs", "",
+    "Instruction ordinals at which to checkpoint simulator state",
+    "A comma-separated list of instruction ordinals at which the cache and TLB "
+    "simulators write their warm state to a checkpoint file named by "
+    "-sim_checkpoint_out with \".<ordinal>\" appended.  The checkpoint for ordinal N "
+    "holds the state after N instructions, so a later run with -skip_instrs N and "
+    "-sim_checkpoint_in can resume from it without a warmup phase.  The state "
+    "includes every cache or TLB block, the replacement policy metadata, the "
+    "prefetcher state, and any snoop filter; statistics are not included.  With "
+    "multiple inputs, ordinals are those of the serial interleaved stream.");
+
+droption_t<std::string> op_sim_checkpoint_out(
+    DROPTION_SCOPE_FRONTEND, "sim_checkpoint_out", "",
+    "Path prefix for simulator checkpoints",
+    "The path prefix for the checkpoint files requested by -sim_checkpoint_instrs.");
+
+droption_t<std::string> op_sim_checkpoint_in(
+    DROPTION_SCOPE_FRONTEND, "sim_checkpoint_in", "",
+    "Simulator checkpoint to restore",
+    "A checkpoint written by -sim_checkpoint_out to restore into the cache or TLB "
+    "simulator before it processes any records.  The simulated hierarchy must be "
+    "configured identically to the one that wrote the checkpoint.  This is meant to "
+    "be combined with -skip_instrs set to the checkpoint's instruction ordinal, with "
+    "no -warmup_refs or -warmup_fraction.");
+
 droption_t<bytesize_t> op_exit_after_instrs(
     DROPTION_SCOPE_FRONTEND, "exit_after_instrs", 0,
     "Limits analyzers to this many instructions",
@@ -935,6 +1040,14 @@ droption_t<bool> op_record_dynsym_only(
     "Symbol lookup can be expensive for large applications and libraries.  This option "
     " causes the symbol lookup for -record_function and -record_heap to look in the "
     " dynamic symbol table *only*.");
+droption_t<std::string> op_record_symbol_cache_dir(
+    DROPTION_SCOPE_CLIENT, "record_symbol_cache_dir", "",
+    "Directory for a persistent symbol cache for -record_function and -record_heap.",
+    "Looking up -record_function and -record_heap symbols that are not in the dynamic "
+    "symbol table requires reading and demangling each library's full symbol table, "
+    "in every traced process.  This option names an existing directory in which the "
+    "first process to do so saves the result for each library, keyed by its build id, "
+    "so that later processes, including concurrent ones, map it instead.");
 droption_t<bool> op_record_replace_retaddr(
     DROPTION_SCOPE_CLIENT, "record_replace_retaddr", false,
     "Wrap by replacing retaddr for -record_function and -record_heap.",
@@ -981,6 +1094,18 @@ droption_t<double> op_confidence_threshold(
     "results. Confidence in a discovered pattern for a load instruction is calculated "
     "as the fraction of the load's misses with the discovered pattern over all the "
     "load's misses.");
+droption_t<unsigned int> op_miss_max_tracked_pcs(
+    DROPTION_SCOPE_FRONTEND, "miss_max_tracked_pcs", 1 << 16,
+    "For cache miss analysis: maximum number of loads tracked at once.",
+    "Specifies the maximum number of load instructions whose LLC misses are tracked "
+    "at once, which bounds the analyzer's memory use.  Each load keeps a fixed-size "
+    "summary of the strides between its misses rather than the misses themselves.  "
+    "When the limit is reached, the half of the tracked loads with the lowest share "
+    "of the misses since each was first tracked is dropped, so that a load that "
+    "starts missing late in the trace is not dropped merely for having fewer misses "
+    "so far.  A load's share is taken over at least half the limit's worth of "
+    "misses, so newly tracked loads are not favored on one or two misses.  "
+    "0 means no limit.");
 droption_t<bool> op_enable_drstatecmp(
     DROPTION_SCOPE_CLIENT, "enable_drstatecmp", false, "Enable the drstatecmp library.",
     "When true, this option enables the drstatecmp library that performs state "
@@ -1218,6 +1343,50 @@ droption_t<uint64_t>
                                   500000, "A letter is printed every N instrs",
                                   "A letter is printed every N instrs or N waits");
 
+droption_t<bool> op_schedule_stats_streaming(
+    DROPTION_SCOPE_FRONTEND, "schedule_stats_streaming", false,
+    "Bound schedule_stats memory usage",
+    "By default, the " SCHEDULE_STATS " tool keeps every context switch record and "
+    "exact histograms, which can use a large amount of memory for long traces with "
+    "many cores.  When this option is enabled, histograms use log-scaled bins with a "
+    "relative error of at most 1/32, and only a prefix of each core's switch records "
+    "and schedule string is kept for printing.  The counters are unaffected.");
+
+droption_t<std::string> op_schedule_stats_json(
+    DROPTION_SCOPE_FRONTEND, "schedule_stats_json", "",
+    "File for periodic schedule_stats JSON output",
+    "If non-empty, the " SCHEDULE_STATS " tool writes one JSON object per line to "
+    "this file each time a per-core interval snapshot is generated, or for each core "
+    "at each whole-trace interval in serial mode, giving a view of the schedule while "
+    "the analysis is still running.  Requires "
+    "-interval_microseconds or -interval_instr_count.");
+
+droption_t<std::string> op_columnar_dir(
+    DROPTION_SCOPE_FRONTEND, "columnar_dir", "",
+    "Output directory for the " COLUMNAR_EXPORT " tool",
+    "The " COLUMNAR_EXPORT " tool writes one columnar file per shard into this "
+    "directory, which must already exist.");
+
+droption_t<unsigned int> op_columnar_chunk_rows(
+    DROPTION_SCOPE_FRONTEND, "columnar_chunk_rows", 65536, 1, 1U << 24,
+    "Rows per chunk for the " COLUMNAR_EXPORT " tool",
+    "The number of rows in each chunk of a file written by the " COLUMNAR_EXPORT
+    " tool.  Each chunk records the minimum and maximum value of each column, "
+    "allowing scans to skip chunks that cannot match.  Smaller chunks allow "
+    "finer-grained skipping at the cost of more per-chunk overhead.");
+
+droption_t<std::string> op_fcache_sim_configs(
+    DROPTION_SCOPE_FRONTEND, "fcache_sim_configs", "",
+    "Candidate code cache configurations for the " FCACHE_SIM " tool",
+    "A colon-separated list of DynamoRIO code cache configurations, each of which is "
+    "simulated by the " FCACHE_SIM " tool.  Each configuration is a comma-separated "
+    "list of name=value pairs, where each name is one of trace_threshold, "
+    "max_trace_bbs, max_bb_instrs, cache_bb_max, cache_trace_max, cache_bb_unit_init, "
+    "cache_bb_unit_max, cache_trace_unit_init, cache_trace_unit_max, ibl_table_init, "
+    "ibl_table_load, or bb_ibl_targets, and sizes accept a K or M suffix.  For example, "
+    "\"trace_threshold=50:trace_threshold=500,cache_bb_max=1M\".  Unnamed values "
+    "keep DynamoRIO's x86-64 defaults.  An empty list simulates just the defaults.");
+
 droption_t<std::string> op_syscall_template_file(
     DROPTION_SCOPE_FRONTEND, "syscall_template_file", "",
     "Path to the file that contains system call trace templates.",
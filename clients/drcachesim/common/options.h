@@ -53,6 +53,9 @@
 #define INVARIANT_CHECKER "invariant_checker"
 #define SCHEDULE_STATS "schedule_stats"
 #define RECORD_FILTER "record_filter"
+#define COLUMNAR_EXPORT "columnar_export"
+#define CACHE_SWEEP "cache_sweep"
+#define FCACHE_SIM "fcache_sim"
 
 // Constants used by specific tools.
 #define REPLACE_POLICY_NON_SPECIFIED ""
@@ -100,6 +103,7 @@ extern dynamorio::droption::droption_t<std::string> op_indir;
 extern dynamorio::droption::droption_t<std::string> op_multi_indir;
 extern dynamorio::droption::droption_t<std::string> op_module_file;
 extern dynamorio::droption::droption_t<std::string> op_alt_module_dir;
+extern dynamorio::droption::droption_t<bool> op_shared_decode_cache;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_chunk_instr_count;
 extern dynamorio::droption::droption_t<bool> op_instr_encodings;
@@ -118,10 +122,16 @@ extern dynamorio::droption::droption_t<bool> op_L0_filter_deprecated;
 extern dynamorio::droption::droption_t<bool> op_L0I_filter;
 extern dynamorio::droption::droption_t<bool> op_L0D_filter;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_L0D_size;
+extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
+    op_L0_filter_target_bw;
+extern dynamorio::droption::droption_t<unsigned int> op_L0_filter_adapt_ms;
+extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
+    op_L0_filter_max_size;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_L0_filter_until_instrs;
 extern dynamorio::droption::droption_t<bool> op_instr_only_trace;
 extern dynamorio::droption::droption_t<bool> op_coherence;
+extern dynamorio::droption::droption_t<uint64_t> op_coherence_directory_entries;
 extern dynamorio::droption::droption_t<bool> op_use_physical;
 extern dynamorio::droption::droption_t<unsigned int> op_virt2phys_freq;
 extern dynamorio::droption::droption_t<std::string> op_v2p_file;
@@ -148,6 +158,10 @@ extern dynamorio::droption::droption_t<std::string> op_raw_compress;
 extern dynamorio::droption::droption_t<std::string> op_trace_compress;
 extern dynamorio::droption::droption_t<bool> op_online_instr_types;
 extern dynamorio::droption::droption_t<std::string> op_replace_policy;
+extern dynamorio::droption::droption_t<unsigned int> op_sweep_min_sets;
+extern dynamorio::droption::droption_t<unsigned int> op_sweep_max_sets;
+extern dynamorio::droption::droption_t<unsigned int> op_sweep_max_assoc;
+extern dynamorio::droption::droption_t<unsigned int> op_sweep_sample_rate;
 extern dynamorio::droption::droption_t<std::string> op_data_prefetcher;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_page_size;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L1I_entries;
@@ -184,6 +198,9 @@ extern dynamorio::droption::droption_t<uint64_t> op_skip_to_timestamp;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_warmup_refs;
 extern dynamorio::droption::droption_t<double> op_warmup_fraction;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t> op_sim_refs;
+extern dynamorio::droption::droption_t<std::string> op_sim_checkpoint_instrs;
+extern dynamorio::droption::droption_t<std::string> op_sim_checkpoint_out;
+extern dynamorio::droption::droption_t<std::string> op_sim_checkpoint_in;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_exit_after_instrs;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
@@ -202,11 +219,13 @@ extern dynamorio::droption::droption_t<std::string> op_record_function;
 extern dynamorio::droption::droption_t<bool> op_record_heap;
 extern dynamorio::droption::droption_t<std::string> op_record_heap_value;
 extern dynamorio::droption::droption_t<bool> op_record_dynsym_only;
+extern dynamorio::droption::droption_t<std::string> op_record_symbol_cache_dir;
 extern dynamorio::droption::droption_t<bool> op_record_replace_retaddr;
 extern dynamorio::droption::droption_t<std::string> op_record_syscall;
 extern dynamorio::droption::droption_t<unsigned int> op_miss_count_threshold;
 extern dynamorio::droption::droption_t<double> op_miss_frac_threshold;
 extern dynamorio::droption::droption_t<double> op_confidence_threshold;
+extern dynamorio::droption::droption_t<unsigned int> op_miss_max_tracked_pcs;
 extern dynamorio::droption::droption_t<bool> op_enable_drstatecmp;
 #ifdef BUILD_PT_TRACER
 extern dynamorio::droption::droption_t<bool> op_enable_kernel_tracing;
@@ -240,6 +259,11 @@ extern dynamorio::droption::droption_t<double> op_sched_exit_if_fraction_inputs_
 extern dynamorio::droption::droption_t<int> op_sched_random_initial_layout;
 extern dynamorio::droption::droption_t<int> op_sched_max_cores;
 extern dynamorio::droption::droption_t<uint64_t> op_schedule_stats_print_every;
+extern dynamorio::droption::droption_t<bool> op_schedule_stats_streaming;
+extern dynamorio::droption::droption_t<std::string> op_schedule_stats_json;
+extern dynamorio::droption::droption_t<std::string> op_columnar_dir;
+extern dynamorio::droption::droption_t<unsigned int> op_columnar_chunk_rows;
+extern dynamorio::droption::droption_t<std::string> op_fcache_sim_configs;
 extern dynamorio::droption::droption_t<std::string> op_syscall_template_file;
 extern dynamorio::droption::droption_t<uint64_t> op_filter_stop_timestamp;
 extern dynamorio::droption::droption_t<int> op_filter_cache_size;
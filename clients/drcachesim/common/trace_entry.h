@@ -815,6 +815,25 @@ typedef enum {
      */
     TRACE_MARKER_TYPE_SKIPPED_MEMREF,
 
+    /**
+     * Records a change in the size of the 'zero-level' instruction cache filter used
+     * during tracing with -L0I_filter when its size is adapted via
+     * -L0_filter_target_bw.  The marker value holds the new size in bytes.  The
+     * filter is emptied at this point, and all subsequent instruction fetch entries
+     * in this thread until the next such marker are misses in a direct-mapped filter
+     * of this size.
+     */
+    TRACE_MARKER_TYPE_L0I_FILTER_SIZE,
+
+    /**
+     * Records a change in the size of the 'zero-level' data cache filter used during
+     * tracing with -L0D_filter when its size is adapted via -L0_filter_target_bw.
+     * The marker value holds the new size in bytes.  The filter is emptied at this
+     * point, and all subsequent data entries in this thread until the next such
+     * marker are misses in a direct-mapped filter of this size.
+     */
+    TRACE_MARKER_TYPE_L0D_FILTER_SIZE,
+
     // XXX: When adding a new type, if its value is an address, add it to
     // scheduler_impl_tmpl_t<memref_t, reader_t>::record_type_canonicalize_addresses()
     // for auto-canonicalization support.
@@ -440,11 +440,33 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
             if (!parse_param_value_or_fail(p.first, p.second, &knobs.model_coherence)) {
                 return false;
             }
+        } else if (p.first == "coherence_directory_entries") {
+            // Sparse directory size, or 0 for a perfect snoop filter.
+            if (!parse_param_value_or_fail(p.first, p.second,
+                                           &knobs.coherence_directory_entries)) {
+                return false;
+            }
         } else if (p.first == "use_physical") {
             // Whether to use physical addresses
             if (!parse_param_value_or_fail(p.first, p.second, &knobs.use_physical)) {
                 return false;
             }
+        } else if (p.first == "sim_checkpoint_in") {
+            // Checkpoint to restore before simulating.
+            if (!parse_param_value_or_fail(p.first, p.second, &knobs.checkpoint_in)) {
+                return false;
+            }
+        } else if (p.first == "sim_checkpoint_out") {
+            // Path prefix for checkpoints to write.
+            if (!parse_param_value_or_fail(p.first, p.second, &knobs.checkpoint_out)) {
+                return false;
+            }
+        } else if (p.first == "sim_checkpoint_instrs") {
+            // Comma-separated instruction ordinals at which to write checkpoints.
+            if (!parse_param_value_or_fail(p.first, p.second,
+                                           &knobs.checkpoint_instrs)) {
+                return false;
+            }
         } else if (p.second.type == config_param_node_t::MAP) {
             // A cache unit.
             cache_params_t cache;
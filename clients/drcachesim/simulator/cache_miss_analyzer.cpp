@@ -32,9 +32,13 @@
 
 #include "cache_miss_analyzer.h"
 
-#include <iostream>
 #include <stdint.h>
 
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
 namespace dynamorio {
 namespace drmemtrace {
 
@@ -44,21 +48,23 @@ const char *cache_miss_stats_t::kT0 = "t0";
 analysis_tool_t *
 cache_miss_analyzer_create(const cache_simulator_knobs_t &knobs,
                            unsigned int miss_count_threshold, double miss_frac_threshold,
-                           double confidence_threshold)
+                           double confidence_threshold, unsigned int max_tracked_pcs)
 {
     return new cache_miss_analyzer_t(knobs, miss_count_threshold, miss_frac_threshold,
-                                     confidence_threshold);
+                                     confidence_threshold, max_tracked_pcs);
 }
 
 cache_miss_stats_t::cache_miss_stats_t(bool warmup_enabled, unsigned int line_size,
                                        unsigned int miss_count_threshold,
                                        double miss_frac_threshold,
-                                       double confidence_threshold)
+                                       double confidence_threshold,
+                                       unsigned int max_tracked_pcs)
     : cache_stats_t(line_size, "", warmup_enabled, false)
     , kLineSize(line_size)
     , kMissCountThreshold(miss_count_threshold)
     , kMissFracThreshold(miss_frac_threshold)
     , kConfidenceThreshold(confidence_threshold)
+    , kMaxTrackedPcs(max_tracked_pcs)
 {
     // Setting this variable to true ensures that the dump_miss() function below
     // gets called during cache simulation on a cache miss.
@@ -69,48 +75,115 @@ void
 cache_miss_stats_t::reset()
 {
     cache_stats_t::reset();
-    pc_cache_misses_.clear();
+    pc_sketches_.clear();
     total_misses_ = 0;
 }
 
+void
+cache_miss_stats_t::stride_sketch_t::add_miss(addr_t line_addr)
+{
+    if (num_misses > 0) {
+        int stride = static_cast<int>(line_addr - last_line_addr);
+        if (stride != 0)
+            add_stride(stride, 1, 0);
+    }
+    last_line_addr = line_addr;
+    num_misses++;
+}
+
+void
+cache_miss_stats_t::stride_sketch_t::add_stride(int stride, uint64_t count,
+                                                uint64_t error)
+{
+    int min_idx = 0;
+    for (int i = 0; i < num_strides; ++i) {
+        if (strides[i].stride == stride) {
+            strides[i].count += count;
+            strides[i].error += error;
+            return;
+        }
+        if (strides[i].count < strides[min_idx].count)
+            min_idx = i;
+    }
+    if (num_strides < kMaxStrides) {
+        strides[num_strides++] = { stride, count, error };
+        return;
+    }
+    // Replace the least frequent stride, which may have been this one.
+    stride_count_t &victim = strides[min_idx];
+    victim = { stride, victim.count + count, victim.count + error };
+}
+
 void
 cache_miss_stats_t::dump_miss(const memref_t &memref)
 {
-    // If the operation causing the LLC miss is a memory read (load), insert
-    // the miss into the pc_cache_misses_ hash map and update
+    // If the operation causing the LLC miss is a memory read (load), add
+    // the miss to the load's sketch in the pc_sketches_ hash map and update
     // the total_misses_ counter.
     if (memref.data.type != TRACE_TYPE_READ) {
         return;
     }
 
-    // TODO i#6905: Consider incorporating PID information into the pc_cache_misses_ hash
+    // TODO i#6905: Consider incorporating PID information into the pc_sketches_ hash
     // map and adjusting subsequent calculations that depend on this data.
     const addr_t pc = memref.data.pc;
     const addr_t addr = memref.data.addr / kLineSize;
-    pc_cache_misses_[pc].push_back(addr);
+    if (kMaxTrackedPcs > 0 && pc_sketches_.size() >= kMaxTrackedPcs &&
+        pc_sketches_.find(pc) == pc_sketches_.end())
+        prune_tracked_pcs();
+    stride_sketch_t &sketch = pc_sketches_[pc];
+    if (sketch.num_misses == 0)
+        sketch.first_tracked_at = total_misses_;
+    sketch.add_miss(addr);
     total_misses_++;
 }
 
+void
+cache_miss_stats_t::prune_tracked_pcs()
+{
+    // Loads with a small share of the misses are never recommended, so we keep the
+    // loads with the largest share.  Ranking by raw miss counts would keep evicting
+    // a load that starts missing late in the trace, as it could never catch up
+    // with the counts of loads tracked since the start.  Instead each load's share
+    // is taken over the misses since it was first tracked, but over no fewer than
+    // the misses separating two prunes, so that a load just tracked does not
+    // outrank everything on its first miss.  Dropping half at once keeps the cost
+    // of this linear pass amortized over many misses.
+    const uint64_t min_age = std::max(kMaxTrackedPcs / 2, 1u);
+    std::vector<std::pair<double, addr_t>> shares;
+    shares.reserve(pc_sketches_.size());
+    for (const auto &entry : pc_sketches_) {
+        const uint64_t age =
+            std::max(total_misses_ - entry.second.first_tracked_at, min_age);
+        shares.emplace_back(static_cast<double>(entry.second.num_misses) / age,
+                            entry.first);
+    }
+    auto middle = shares.begin() + shares.size() / 2;
+    std::nth_element(shares.begin(), middle, shares.end());
+    for (auto it = shares.begin(); it != middle; ++it)
+        pc_sketches_.erase(it->second);
+}
+
 std::vector<prefetching_recommendation_t *>
 cache_miss_stats_t::generate_recommendations()
 {
-    unsigned int miss_count_threshold =
-        static_cast<unsigned int>(kMissFracThreshold * total_misses_);
+    uint64_t miss_count_threshold =
+        static_cast<uint64_t>(kMissFracThreshold * total_misses_);
     if (miss_count_threshold > kMissCountThreshold) {
         miss_count_threshold = kMissCountThreshold;
     }
 
     // Find loads that should be analyzed and analyze them.
     std::vector<prefetching_recommendation_t *> recommendations;
-    for (auto &pc_cache_misses_it : pc_cache_misses_) {
-        std::vector<addr_t> &cache_misses = pc_cache_misses_it.second;
+    for (auto &pc_sketch : pc_sketches_) {
+        const stride_sketch_t &sketch = pc_sketch.second;
 
-        if (cache_misses.size() >= miss_count_threshold) {
-            const int stride = check_for_constant_stride(cache_misses);
+        if (sketch.num_misses >= miss_count_threshold) {
+            const int stride = check_for_constant_stride(sketch);
             if (stride != 0) {
                 prefetching_recommendation_t *recommendation =
                     new prefetching_recommendation_t;
-                recommendation->pc = pc_cache_misses_it.first;
+                recommendation->pc = pc_sketch.first;
                 recommendation->stride = stride;
                 recommendation->locality = kNTA;
                 recommendations.push_back(recommendation);
@@ -122,32 +195,23 @@ cache_miss_stats_t::generate_recommendations()
 }
 
 int
-cache_miss_stats_t::check_for_constant_stride(
-    const std::vector<addr_t> &cache_misses) const
+cache_miss_stats_t::check_for_constant_stride(const stride_sketch_t &sketch) const
 {
-    std::unordered_map<int, int> stride_counts;
-
-    // Find and count all strides in the misses stream.
-    for (unsigned int i = 1; i < cache_misses.size(); ++i) {
-        int stride = static_cast<int>(cache_misses[i] - cache_misses[i - 1]);
-        if (stride != 0) {
-            stride_counts[stride]++;
-        }
-    }
-
-    // Find the most occurring stride.
-    int max_count = 0;
+    // Find the most occurring stride, counting only the occurrences that are
+    // guaranteed so that an evicted-and-readmitted stride is not overrated.
+    uint64_t max_count = 0;
     int max_count_stride = 0;
-    for (auto &stride_count : stride_counts) {
-        if (stride_count.second > max_count) {
-            max_count = stride_count.second;
-            max_count_stride = stride_count.first;
+    for (int i = 0; i < sketch.num_strides; ++i) {
+        uint64_t count = sketch.strides[i].count - sketch.strides[i].error;
+        if (count > max_count) {
+            max_count = count;
+            max_count_stride = sketch.strides[i].stride;
         }
     }
 
     // Return the most occurring stride if it meets the confidence threshold.
-    stride_counts.clear();
-    if (max_count >= static_cast<int>(kConfidenceThreshold * cache_misses.size())) {
+    if (max_count > 0 &&
+        max_count >= static_cast<uint64_t>(kConfidenceThreshold * sketch.num_misses)) {
         return max_count_stride * kLineSize;
     } else {
         return 0;
@@ -157,7 +221,8 @@ cache_miss_stats_t::check_for_constant_stride(
 cache_miss_analyzer_t::cache_miss_analyzer_t(const cache_simulator_knobs_t &knobs,
                                              unsigned int miss_count_threshold,
                                              double miss_frac_threshold,
-                                             double confidence_threshold)
+                                             double confidence_threshold,
+                                             unsigned int max_tracked_pcs)
     : cache_simulator_t(knobs)
 {
     if (!success_) {
@@ -168,7 +233,8 @@ cache_miss_analyzer_t::cache_miss_analyzer_t(const cache_simulator_knobs_t &knob
     delete llcaches_["LL"]->get_stats();
     ll_stats_ =
         new cache_miss_stats_t(warmup_enabled_, knobs.line_size, miss_count_threshold,
-                               miss_frac_threshold, confidence_threshold);
+                               miss_frac_threshold, confidence_threshold,
+                               max_tracked_pcs);
     llcaches_["LL"]->set_stats(ll_stats_);
 
     if (!knobs.LL_miss_file.empty()) {
@@ -40,6 +40,7 @@
 #define _CACHE_MISS_ANALYZER_H_
 
 #include <cstdint>
+#include <stddef.h>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -70,13 +71,16 @@ public:
     //                        instruction to be eligible for analysis.
     // - confidence_threshold: Confidence threshold to include a discovered
     //                         pattern in the output results.
+    // - max_tracked_pcs: Maximum number of load PCs whose misses are tracked
+    //                    at once, or 0 for no limit.
     // Confidence in a discovered pattern for a load instruction is calculated
     // as the fraction of the load's misses with the discovered pattern over
     // all the load's misses.
     cache_miss_stats_t(bool warmup_enabled = false, unsigned int line_size = 64,
                        unsigned int miss_count_threshold = 50000,
                        double miss_frac_threshold = 0.005,
-                       double confidence_threshold = 0.75);
+                       double confidence_threshold = 0.75,
+                       unsigned int max_tracked_pcs = 1 << 16);
 
     cache_miss_stats_t &
     operator=(const cache_miss_stats_t &)
@@ -90,6 +94,13 @@ public:
     std::vector<prefetching_recommendation_t *>
     generate_recommendations();
 
+    // Returns the number of load PCs whose misses are currently tracked.
+    size_t
+    get_tracked_pcs() const
+    {
+        return pc_sketches_.size();
+    }
+
 protected:
     void
     dump_miss(const memref_t &memref) override;
@@ -113,20 +124,56 @@ private:
     // all the load's misses.
     const double kConfidenceThreshold;
 
-    // A function to analyze cache misses in search of a constant stride.
-    // The function returns a nonzero stride value if it finds one that
-    // satisfies the confidence threshold and returns 0 otherwise.
+    // Maximum number of load PCs tracked in pc_sketches_, or 0 for no limit.
+    const unsigned int kMaxTrackedPcs;
+
+    // Number of distinct strides whose counts are kept per load.
+    static constexpr int kMaxStrides = 8;
+
+    // A fixed-size summary of the miss address stream of one load instruction,
+    // updated as each miss arrives so that we never store the stream itself.
+    // The strides between consecutive misses are counted with the
+    // space-saving algorithm: a stride not yet present replaces the least
+    // frequent one and inherits its count as a possible overestimate, which is
+    // recorded in "error".  Counts are exact as long as a load has at most
+    // kMaxStrides distinct strides, and any stride occurring in more than
+    // 1/kMaxStrides of the misses is always present.
+    struct stride_sketch_t {
+        struct stride_count_t {
+            int stride;
+            uint64_t count;
+            uint64_t error;
+        };
+        void
+        add_miss(addr_t line_addr);
+        void
+        add_stride(int stride, uint64_t count, uint64_t error);
+
+        addr_t last_line_addr = 0;
+        uint64_t num_misses = 0;
+        // The value of total_misses_ when this load was first tracked.
+        uint64_t first_tracked_at = 0;
+        int num_strides = 0;
+        stride_count_t strides[kMaxStrides];
+    };
+
+    // Returns a nonzero stride value in bytes if the sketch holds a stride whose
+    // guaranteed count satisfies the confidence threshold, and 0 otherwise.
     int
-    check_for_constant_stride(const std::vector<addr_t> &cache_misses) const;
+    check_for_constant_stride(const stride_sketch_t &sketch) const;
+
+    // Drops the half of the tracked loads with the lowest share of the misses
+    // since each was first tracked.
+    void
+    prune_tracked_pcs();
 
-    // A hash map storing the data cache line addresses accessed by load
-    // instructions that miss in the LLC.
+    // A hash map storing a sketch of the data cache line addresses accessed by
+    // load instructions that miss in the LLC.
     // Key is the PC of the load instruction.
-    // Value is a vector of data memory cache line addresses.
-    std::unordered_map<addr_t, std::vector<addr_t>> pc_cache_misses_;
+    std::unordered_map<addr_t, stride_sketch_t> pc_sketches_;
 
-    // Total number of LLC misses added to the hash map above.
-    int total_misses_ = 0;
+    // Total number of LLC misses by loads, including those of pruned loads.
+    uint64_t total_misses_ = 0;
 };
 
 class cache_miss_analyzer_t : public cache_simulator_t {
@@ -139,13 +186,16 @@ public:
     //                        instruction to be eligible for analysis.
     // - confidence_threshold: Confidence threshold to include a discovered
     //                         pattern in the output results.
+    // - max_tracked_pcs: Maximum number of load PCs whose misses are tracked
+    //                    at once, or 0 for no limit.
     // Confidence in a discovered pattern for a load instruction is calculated
     // as the fraction of the load's misses with the discovered pattern over
     // all the load's misses.
     cache_miss_analyzer_t(const cache_simulator_knobs_t &knobs,
                           unsigned int miss_count_threshold = 50000,
                           double miss_frac_threshold = 0.005,
-                          double confidence_threshold = 0.75);
+                          double confidence_threshold = 0.75,
+                          unsigned int max_tracked_pcs = 1 << 16);
 
     std::vector<prefetching_recommendation_t *>
     generate_recommendations();
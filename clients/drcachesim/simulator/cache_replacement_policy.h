@@ -33,6 +33,8 @@
 #ifndef _CACHE_REPLACEMENT_POLICY_H_
 #define _CACHE_REPLACEMENT_POLICY_H_
 
+#include <istream>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -63,6 +65,12 @@ enum cache_access_outcome_t { UNKNOWN, HIT, MISS };
  * `caching_device_t`, which is the index of the first way in the set when all ways are
  * stored in a contiguous array. This can be obtained with `compute_set_index()` in
  * caching_device_t.
+ *
+ * The built-in policies keep their per-access methods inline in their headers and
+ * store their per-set metadata in one flat array indexed by
+ * `set_idx * associativity + way`.  caching_device_t recognizes them when the
+ * policy is installed and calls them directly on its hot path; other policies,
+ * including subclasses of the built-in ones, are called through this interface.
  */
 class cache_replacement_policy_t {
 public:
@@ -89,6 +97,24 @@ public:
     /// Returns the name of the replacement policy.
     virtual std::string
     get_name() const = 0;
+    /**
+     * Writes the policy's per-set metadata to a simulator checkpoint.  Returns
+     * false if the policy does not support checkpoints, which is the default.
+     */
+    virtual bool
+    save_state(std::ostream &out) const
+    {
+        return false;
+    }
+    /**
+     * Restores the metadata written by save_state() into a policy constructed
+     * with the same geometry.  Returns false on failure.
+     */
+    virtual bool
+    restore_state(std::istream &in)
+    {
+        return false;
+    }
 
     virtual ~cache_replacement_policy_t() = default;
 
@@ -37,7 +37,9 @@
 
 #include <functional>
 #include <iostream>
+#include <istream>
 #include <map>
+#include <ostream>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -55,6 +57,7 @@
 #include "cache_stats.h"
 #include "caching_device.h"
 #include "caching_device_stats.h"
+#include "checkpoint_io.h"
 #include "create_cache_replacement_policy.h"
 #include "prefetcher.h"
 #include "simulator.h"
@@ -184,11 +187,17 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs,
     }
 
     if (knobs_.model_coherence &&
-        !snoop_filter_->init(snooped_caches_, total_snooped_caches)) {
+        !snoop_filter_->init(snooped_caches_, total_snooped_caches,
+                             knobs_.coherence_directory_entries)) {
         ERRMSG("Usage error: failed to initialize snoop filter.\n");
         success_ = false;
         return;
     }
+
+    error_string_ = init_checkpoints(knobs_.checkpoint_in, knobs_.checkpoint_out,
+                                     knobs_.checkpoint_instrs);
+    if (!error_string_.empty())
+        success_ = false;
 }
 
 cache_simulator_t::cache_simulator_t(std::istream *config_file,
@@ -212,6 +221,12 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file,
     init_knobs(knobs_.num_cores, knobs_.skip_refs, knobs_.warmup_refs,
                knobs_.warmup_fraction, knobs_.sim_refs, knobs_.cpu_scheduling,
                knobs_.use_physical, knobs_.verbose);
+    error_string_ = init_checkpoints(knobs_.checkpoint_in, knobs_.checkpoint_out,
+                                     knobs_.checkpoint_instrs);
+    if (!error_string_.empty()) {
+        success_ = false;
+        return;
+    }
 
     if (knobs_.data_prefetcher != PREFETCH_POLICY_NEXTLINE &&
         knobs_.data_prefetcher != PREFETCH_POLICY_NONE) {
@@ -389,7 +404,9 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file,
             other_caches_[cache_name] = cache;
         }
     }
-    if (knobs_.model_coherence && !snoop_filter_->init(snooped_caches_, snoop_id)) {
+    if (knobs_.model_coherence &&
+        !snoop_filter_->init(snooped_caches_, snoop_id,
+                             knobs_.coherence_directory_entries)) {
         ERRMSG("Usage error: failed to initialize snoop filter.\n");
         success_ = false;
         return;
@@ -749,5 +766,51 @@ cache_simulator_t::get_num_snoop_invalidates(void)
     return (snoop_filter_ == nullptr) ? 0 : snoop_filter_->get_num_invalidates();
 }
 
+int64_t
+cache_simulator_t::get_num_snoop_directory_evictions(void)
+{
+    return (snoop_filter_ == nullptr) ? 0
+                                      : snoop_filter_->get_num_directory_evictions();
+}
+
+std::vector<caching_device_t *>
+cache_simulator_t::get_checkpoint_devices() const
+{
+    std::map<std::string, caching_device_t *> sorted(all_caches_.begin(),
+                                                     all_caches_.end());
+    std::vector<caching_device_t *> devices;
+    for (const auto &name_cache : sorted)
+        devices.push_back(name_cache.second);
+    return devices;
+}
+
+std::string
+cache_simulator_t::save_state(std::ostream &out)
+{
+    std::string error = save_devices(out, get_checkpoint_devices());
+    if (!error.empty())
+        return error;
+    if (!checkpoint_write(out, static_cast<uint8_t>(snoop_filter_ != nullptr)))
+        return "write failed";
+    if (snoop_filter_ != nullptr && !snoop_filter_->save_state(out))
+        return "failed to save the snoop filter";
+    return "";
+}
+
+std::string
+cache_simulator_t::restore_state(std::istream &in)
+{
+    std::string error = restore_devices(in, get_checkpoint_devices());
+    if (!error.empty())
+        return error;
+    uint8_t has_snoop_filter;
+    if (!checkpoint_read(in, has_snoop_filter) ||
+        (has_snoop_filter != 0) != (snoop_filter_ != nullptr))
+        return "the checkpoint's coherence setting differs";
+    if (snoop_filter_ != nullptr && !snoop_filter_->restore_state(in))
+        return "mismatched or corrupt snoop filter state";
+    return "";
+}
+
 } // namespace drmemtrace
 } // namespace dynamorio
@@ -40,8 +40,10 @@
 #include <stdint.h>
 
 #include <istream>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "cache.h"
 #include "cache_simulator_create.h"
@@ -99,6 +101,8 @@ public:
     get_num_snoop_writebacks(void);
     int64_t
     get_num_snoop_invalidates(void);
+    int64_t
+    get_num_snoop_directory_evictions(void);
 
     // Exposed to make it easy to test
     bool
@@ -114,6 +118,14 @@ protected:
     bool
     check_warmed_up();
 
+    std::string
+    save_state(std::ostream &out) override;
+    std::string
+    restore_state(std::istream &in) override;
+    // Returns all caches ordered by name, for a stable checkpoint layout.
+    std::vector<caching_device_t *>
+    get_checkpoint_devices() const;
+
     prefetcher_t *
     get_prefetcher(std::string prefetcher_name);
 
@@ -63,6 +63,7 @@ struct cache_simulator_knobs_t {
         , LL_assoc(16)
         , LL_miss_file("")
         , model_coherence(false)
+        , coherence_directory_entries(0)
         , replace_policy("LRU")
         , data_prefetcher("nextline")
         , skip_refs(0)
@@ -71,6 +72,9 @@ struct cache_simulator_knobs_t {
         , sim_refs(1ULL << 63)
         , cpu_scheduling(false)
         , use_physical(false)
+        , checkpoint_in("")
+        , checkpoint_out("")
+        , checkpoint_instrs("")
         , verbose(0)
     {
     }
@@ -84,6 +88,7 @@ struct cache_simulator_knobs_t {
     unsigned int LL_assoc;
     std::string LL_miss_file;
     bool model_coherence;
+    uint64_t coherence_directory_entries;
     std::string replace_policy;
     std::string data_prefetcher;
     uint64_t skip_refs;
@@ -92,6 +97,9 @@ struct cache_simulator_knobs_t {
     uint64_t sim_refs;
     bool cpu_scheduling;
     bool use_physical;
+    std::string checkpoint_in;
+    std::string checkpoint_out;
+    std::string checkpoint_instrs;
     unsigned int verbose;
 };
 
@@ -106,11 +114,15 @@ cache_simulator_create(const cache_simulator_knobs_t &knobs);
 analysis_tool_t *
 cache_simulator_create(const std::string &config_file);
 
-/** Creates an instance of a cache miss analyzer. */
+/**
+ * Creates an instance of a cache miss analyzer.  At most \p max_tracked_pcs load
+ * instructions have their misses tracked at once, or any number if it is 0.
+ */
 analysis_tool_t *
 cache_miss_analyzer_create(const cache_simulator_knobs_t &knobs,
                            unsigned int miss_count_threshold, double miss_frac_threshold,
-                           double confidence_threshold);
+                           double confidence_threshold,
+                           unsigned int max_tracked_pcs = 1 << 16);
 
 } // namespace drmemtrace
 } // namespace dynamorio
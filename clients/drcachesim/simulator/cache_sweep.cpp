@@ -0,0 +1,338 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "cache_sweep.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "cache.h"
+#include "cache_stats.h"
+#include "cache_sweep_create.h"
+#include "caching_device_stats.h"
+#include "create_cache_replacement_policy.h"
+#include "memref.h"
+#include "options.h"
+#include "simulator.h"
+#include "trace_entry.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+analysis_tool_t *
+cache_sweep_create(const cache_sweep_knobs_t &knobs)
+{
+    return new cache_sweep_t(knobs);
+}
+
+cache_sweep_t::cache_sweep_t(const cache_sweep_knobs_t &knobs)
+    : simulator_t(1, knobs.skip_refs, knobs.warmup_refs, 0.0, knobs.sim_refs, false,
+                  false, knobs.verbose)
+    , knobs_(knobs)
+{
+    if (!success_)
+        return;
+    if (knobs_.line_size < 4 || !IS_POWER_OF_2(knobs_.line_size)) {
+        error_string_ = "Usage error: line_size must be a power of 2 and at least 4";
+        success_ = false;
+        return;
+    }
+    if (!IS_POWER_OF_2(knobs_.min_sets) || !IS_POWER_OF_2(knobs_.max_sets) ||
+        knobs_.min_sets > knobs_.max_sets) {
+        error_string_ = "Usage error: sweep_min_sets and sweep_max_sets must be powers "
+                        "of 2 with sweep_min_sets <= sweep_max_sets";
+        success_ = false;
+        return;
+    }
+    if (knobs_.max_assoc == 0) {
+        error_string_ = "Usage error: sweep_max_assoc must be positive";
+        success_ = false;
+        return;
+    }
+    if (!IS_POWER_OF_2(knobs_.sample_rate)) {
+        error_string_ = "Usage error: sweep_sample_rate must be a power of 2";
+        success_ = false;
+        return;
+    }
+    line_bits_ = compute_log2(knobs_.line_size);
+    lru_mode_ = knobs_.replace_policy == REPLACE_POLICY_LRU;
+    counting_ = knobs_.warmup_refs == 0;
+
+    for (unsigned int sets = knobs_.min_sets; sets <= knobs_.max_sets; sets *= 2) {
+        if (lru_mode_) {
+            lru_stacks_t stacks;
+            stacks.num_sets = sets;
+            stacks.tags.resize(static_cast<size_t>(sets) * knobs_.max_assoc);
+            stacks.depth.resize(sets, 0);
+            stacks.distance_counts.resize(knobs_.max_assoc + 1, 0);
+            lru_stacks_.push_back(std::move(stacks));
+        } else {
+            // Simulating every set of every geometry is what makes a sweep with
+            // separate cache_simulator_t runs expensive.  We instead keep only the
+            // sets whose index is a multiple of the stride.  Because the set index
+            // is the low bits of the tag, those are the lines whose tag is a
+            // multiple of the stride, and dropping those zero bits maps them onto
+            // a cache with stride-times fewer sets but identical per-set behavior.
+            unsigned int stride = std::min(knobs_.sample_rate, sets);
+            for (unsigned int assoc = 1; assoc <= knobs_.max_assoc; assoc *= 2) {
+                sampled_cache_t sampled;
+                sampled.num_sets = sets;
+                sampled.associativity = assoc;
+                sampled.sample_stride = stride;
+                sampled.sample_shift = compute_log2(stride);
+                unsigned int sim_sets = sets / stride;
+                sampled.stats =
+                    std::unique_ptr<cache_stats_t>(new cache_stats_t(knobs_.line_size));
+                sampled.cache = std::unique_ptr<cache_t>(new cache_t(
+                    "sweep " + std::to_string(sets) + "x" + std::to_string(assoc)));
+                auto policy = create_cache_replacement_policy(knobs_.replace_policy,
+                                                              sim_sets, assoc);
+                if (policy == nullptr) {
+                    error_string_ = "Usage error: unknown replace_policy " +
+                        knobs_.replace_policy;
+                    success_ = false;
+                    return;
+                }
+                if (!sampled.cache->init(
+                        assoc, knobs_.line_size,
+                        static_cast<int64_t>(sim_sets) * assoc * knobs_.line_size,
+                        nullptr, sampled.stats.get(), std::move(policy))) {
+                    error_string_ = "Usage error: failed to initialize the " +
+                        std::to_string(sets) + "-set " + std::to_string(assoc) +
+                        "-way cache";
+                    success_ = false;
+                    return;
+                }
+                sampled_caches_.push_back(std::move(sampled));
+            }
+        }
+    }
+}
+
+cache_sweep_t::~cache_sweep_t()
+{
+}
+
+void
+cache_sweep_t::reset_counts()
+{
+    accesses_ = 0;
+    compulsory_misses_ = 0;
+    for (auto &stacks : lru_stacks_)
+        std::fill(stacks.distance_counts.begin(), stacks.distance_counts.end(), 0);
+    for (auto &sampled : sampled_caches_)
+        sampled.stats->reset();
+}
+
+void
+cache_sweep_t::access_lru(lru_stacks_t &stacks, addr_t tag)
+{
+    unsigned int assoc = knobs_.max_assoc;
+    size_t set = static_cast<size_t>(tag & (stacks.num_sets - 1));
+    addr_t *stack = &stacks.tags[set * assoc];
+    unsigned int &depth = stacks.depth[set];
+    unsigned int pos = 0;
+    while (pos < depth && stack[pos] != tag)
+        ++pos;
+    if (pos < depth) {
+        if (counting_)
+            ++stacks.distance_counts[pos];
+    } else {
+        if (counting_)
+            ++stacks.distance_counts[assoc];
+        // The least recently used entry falls off the bottom of a full stack.
+        if (depth < assoc)
+            ++depth;
+        pos = depth - 1;
+    }
+    // Move to the top, shifting the more recently used entries down by one.
+    for (; pos > 0; --pos)
+        stack[pos] = stack[pos - 1];
+    stack[0] = tag;
+}
+
+void
+cache_sweep_t::access_line(addr_t tag, const memref_t &memref)
+{
+    if (lru_mode_) {
+        if (counting_)
+            ++accesses_;
+        if (seen_tags_.insert(tag).second && counting_)
+            ++compulsory_misses_;
+        for (auto &stacks : lru_stacks_)
+            access_lru(stacks, tag);
+        return;
+    }
+    memref_t line_ref = memref;
+    line_ref.data.size = 1;
+    for (auto &sampled : sampled_caches_) {
+        if ((tag & (sampled.sample_stride - 1)) != 0)
+            continue;
+        line_ref.data.addr = (tag >> sampled.sample_shift) << line_bits_;
+        sampled.cache->request(line_ref);
+    }
+}
+
+bool
+cache_sweep_t::process_memref(const memref_t &memref)
+{
+    if (!simulator_t::process_memref(memref))
+        return false;
+    bool is_instr = type_is_instr(memref.instr.type) ||
+        memref.instr.type == TRACE_TYPE_PREFETCH_INSTR;
+    bool is_data = memref.data.type == TRACE_TYPE_READ ||
+        memref.data.type == TRACE_TYPE_WRITE || type_is_prefetch(memref.data.type);
+    if (memref.marker.type != TRACE_TYPE_MARKER) {
+        // Only count non-markers toward *_refs counts.
+        if (knob_skip_refs_ > 0) {
+            --knob_skip_refs_;
+            return true;
+        }
+        if (knob_sim_refs_ == 0)
+            return false; // Early exit.
+        ++refs_;
+        if (!counting_ && refs_ > knob_warmup_refs_) {
+            reset_counts();
+            counting_ = true;
+        }
+        if (counting_)
+            --knob_sim_refs_;
+    }
+    if (!is_instr && !is_data)
+        return true;
+    // Instruction and data fetches go to a single unified cache.
+    addr_t addr = is_instr ? memref.instr.addr : memref.data.addr;
+    size_t size = is_instr ? memref.instr.size : memref.data.size;
+    if (size == 0)
+        size = 1;
+    if (knob_verbose_ >= 3) {
+        std::cerr << "::" << memref.data.pid << "." << memref.data.tid << ":: "
+                  << trace_type_names[memref.data.type] << " " << (void *)addr << " x"
+                  << size << "\n";
+    }
+    addr_t final_tag = (addr + size - 1) >> line_bits_;
+    for (addr_t tag = addr >> line_bits_; tag <= final_tag; ++tag)
+        access_line(tag, memref);
+    return true;
+}
+
+std::vector<cache_sweep_t::config_result_t>
+cache_sweep_t::get_results() const
+{
+    std::vector<config_result_t> results;
+    for (const auto &stacks : lru_stacks_) {
+        // With LRU's inclusion property an access at stack distance d hits in
+        // every associativity above d, so the misses of an A-way cache are the
+        // accesses at distances A and beyond.
+        uint64_t misses = stacks.distance_counts[knobs_.max_assoc];
+        std::vector<uint64_t> misses_for_assoc(knobs_.max_assoc + 1);
+        for (unsigned int assoc = knobs_.max_assoc; assoc >= 1; --assoc) {
+            misses_for_assoc[assoc] = misses;
+            misses += stacks.distance_counts[assoc - 1];
+        }
+        for (unsigned int assoc = 1; assoc <= knobs_.max_assoc; ++assoc) {
+            config_result_t res;
+            res.num_sets = stacks.num_sets;
+            res.associativity = assoc;
+            res.misses = misses_for_assoc[assoc];
+            res.hits = accesses_ - res.misses;
+            res.compulsory_misses = compulsory_misses_;
+            results.push_back(res);
+        }
+    }
+    for (const auto &sampled : sampled_caches_) {
+        config_result_t res;
+        res.num_sets = sampled.num_sets;
+        res.associativity = sampled.associativity;
+        const cache_stats_t &stats = *sampled.stats;
+        res.hits = stats.get_metric(metric_name_t::HITS) * sampled.sample_stride;
+        res.misses = stats.get_metric(metric_name_t::MISSES) * sampled.sample_stride;
+        res.compulsory_misses =
+            stats.get_metric(metric_name_t::COMPULSORY_MISSES) * sampled.sample_stride;
+        results.push_back(res);
+    }
+    return results;
+}
+
+bool
+cache_sweep_t::print_results()
+{
+    std::cerr << "Cache sweep results (" << knobs_.replace_policy;
+    if (lru_mode_)
+        std::cerr << ", exact):\n";
+    else {
+        std::cerr << ", sampling 1 in " << knobs_.sample_rate
+                  << " sets; counts are scaled):\n";
+    }
+    std::cerr.imbue(std::locale("")); // Add commas, at least for my locale
+    std::string prefix = "    ";
+    for (const auto &res : get_results()) {
+        // By default we only print the power-of-2 associativities, plus the largest.
+        if (knob_verbose_ == 0 && !IS_POWER_OF_2(res.associativity) &&
+            res.associativity != knobs_.max_assoc)
+            continue;
+        uint64_t size = static_cast<uint64_t>(res.num_sets) * res.associativity *
+            knobs_.line_size;
+        std::cerr << "  " << res.num_sets << " sets x " << res.associativity
+                  << " ways (" << size << " bytes) stats:\n";
+        std::cerr << prefix << std::setw(18) << std::left << "Hits:" << std::setw(20)
+                  << std::right << res.hits << std::endl;
+        std::cerr << prefix << std::setw(18) << std::left << "Misses:" << std::setw(20)
+                  << std::right << res.misses << std::endl;
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Compulsory misses:" << std::setw(20) << std::right
+                  << res.compulsory_misses << std::endl;
+        if (res.hits + res.misses > 0) {
+            std::cerr << prefix << std::setw(18) << std::left << "Miss rate:"
+                      << std::setw(20) << std::fixed << std::setprecision(2)
+                      << std::right
+                      << ((float)res.misses * 100 / (res.hits + res.misses)) << "%"
+                      << std::endl;
+        }
+    }
+    std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
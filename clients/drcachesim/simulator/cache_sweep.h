@@ -0,0 +1,138 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* cache_sweep: computes the hit and miss counts of a grid of cache geometries
+ * in a single pass over the trace.
+ *
+ * For LRU the counts are exact: LRU obeys the stack inclusion property, so for
+ * a fixed set count the contents of an A-way set are always the A most recently
+ * used lines mapping to that set.  We keep one bounded LRU stack per set for
+ * each set count in the sweep and record the stack distance of every access;
+ * an access hits in every associativity greater than its distance.  This is
+ * Mattson et al.'s stack algorithm, run once per set count.
+ *
+ * Other policies do not have the inclusion property, so we fall back to
+ * simulating one real cache per geometry.  To keep that affordable we only
+ * simulate a sample of the sets of each cache and scale the counts.
+ */
+
+#ifndef _CACHE_SWEEP_H_
+#define _CACHE_SWEEP_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "cache.h"
+#include "cache_stats.h"
+#include "cache_sweep_create.h"
+#include "memref.h"
+#include "simulator.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class cache_sweep_t : public simulator_t {
+public:
+    // The counts for one geometry.  For sampled (non-LRU) runs these are scaled
+    // up from the simulated sets.
+    struct config_result_t {
+        unsigned int num_sets = 0;
+        unsigned int associativity = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t compulsory_misses = 0;
+    };
+
+    explicit cache_sweep_t(const cache_sweep_knobs_t &knobs);
+    virtual ~cache_sweep_t();
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+
+    // Returns every geometry in the sweep, ordered by set count and then by
+    // associativity.  For LRU every associativity up to max_assoc is present;
+    // otherwise only the powers of 2 up to max_assoc are.
+    std::vector<config_result_t>
+    get_results() const;
+
+protected:
+    // The per-set LRU stacks for one set count.  Set s owns the tags in
+    // [s * max_assoc, s * max_assoc + depth[s]), most recently used first.
+    struct lru_stacks_t {
+        unsigned int num_sets = 0;
+        std::vector<addr_t> tags;
+        std::vector<unsigned int> depth;
+        // distance_counts[d] is the number of accesses found at stack depth d;
+        // the final entry counts accesses not found in the bounded stack.
+        std::vector<uint64_t> distance_counts;
+    };
+    // One real cache simulating a sample of the sets of a geometry.
+    struct sampled_cache_t {
+        unsigned int num_sets = 0;
+        unsigned int associativity = 0;
+        // Only lines whose tag is a multiple of sample_stride are simulated.
+        unsigned int sample_stride = 1;
+        int sample_shift = 0;
+        // Declared first so it outlives the cache that points at it.
+        std::unique_ptr<cache_stats_t> stats;
+        std::unique_ptr<cache_t> cache;
+    };
+
+    void
+    access_line(addr_t tag, const memref_t &memref);
+    void
+    access_lru(lru_stacks_t &stacks, addr_t tag);
+    void
+    reset_counts();
+
+    cache_sweep_knobs_t knobs_;
+    bool lru_mode_ = true;
+    int line_bits_ = 0;
+    bool counting_ = true;
+    uint64_t refs_ = 0;
+    uint64_t accesses_ = 0;
+    uint64_t compulsory_misses_ = 0;
+    std::unordered_set<addr_t> seen_tags_;
+    std::vector<lru_stacks_t> lru_stacks_;
+    std::vector<sampled_cache_t> sampled_caches_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHE_SWEEP_H_ */
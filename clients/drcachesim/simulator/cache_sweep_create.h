@@ -0,0 +1,102 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* cache sweep creation */
+
+#ifndef _CACHE_SWEEP_CREATE_H_
+#define _CACHE_SWEEP_CREATE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "analysis_tool.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * @file drmemtrace/cache_sweep_create.h
+ * @brief DrMemtrace single-pass multi-configuration cache simulator creation.
+ */
+
+/**
+ * The options for cache_sweep_create().
+ * The options are currently documented in \ref sec_drcachesim_ops.
+ */
+// The options are currently documented in ../common/options.cpp.
+struct cache_sweep_knobs_t {
+    cache_sweep_knobs_t()
+        : line_size(64)
+        , min_sets(64)
+        , max_sets(65536)
+        , max_assoc(16)
+        , replace_policy("LRU")
+        , sample_rate(64)
+        , skip_refs(0)
+        , warmup_refs(0)
+        , sim_refs(1ULL << 63)
+        , verbose(0)
+    {
+    }
+    unsigned int line_size;
+    /** The smallest set count in the sweep.  Must be a power of 2. */
+    unsigned int min_sets;
+    /** The largest set count in the sweep.  Must be a power of 2. */
+    unsigned int max_sets;
+    /** The largest associativity in the sweep. */
+    unsigned int max_assoc;
+    /**
+     * LRU is computed exactly for every configuration from stack distances.
+     * Other policies are simulated on a sample of the sets.
+     */
+    std::string replace_policy;
+    /** For non-LRU policies, one in this many sets is simulated. */
+    unsigned int sample_rate;
+    uint64_t skip_refs;
+    uint64_t warmup_refs;
+    uint64_t sim_refs;
+    unsigned int verbose;
+};
+
+/**
+ * Creates an instance of a cache simulator that computes the hit and miss
+ * counts of every cache geometry in a grid of set counts and associativities
+ * in a single pass over the trace.
+ */
+analysis_tool_t *
+cache_sweep_create(const cache_sweep_knobs_t &knobs);
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHE_SWEEP_CREATE_H_ */
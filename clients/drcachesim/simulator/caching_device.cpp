@@ -37,9 +37,13 @@
 
 #include <cstdint>
 #include <functional>
+#include <istream>
 #include <limits>
 #include <memory>
+#include <ostream>
 #include <string>
+#include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -47,6 +51,7 @@
 #include "cache_replacement_policy.h"
 #include "caching_device_block.h"
 #include "caching_device_stats.h"
+#include "checkpoint_io.h"
 #include "memref.h"
 #include "prefetcher.h"
 #include "snoop_filter.h"
@@ -134,10 +139,33 @@ caching_device_t::init(int associativity, int64_t block_size, int64_t num_blocks
     children_ = children;
 
     replacement_policy_ = std::move(replacement_policy);
+    update_policy_kind();
 
     return true;
 }
 
+void
+caching_device_t::update_policy_kind()
+{
+    // Subclasses of the built-in policies may override their methods, so we only
+    // call directly into a built-in policy that is exactly that class.
+    cache_replacement_policy_t *policy = replacement_policy_.get();
+    if (policy == nullptr)
+        policy_kind_ = policy_kind_t::OTHER;
+    else if (typeid(*policy) == typeid(policy_lru_t))
+        policy_kind_ = policy_kind_t::LRU;
+    else if (typeid(*policy) == typeid(policy_lfu_t))
+        policy_kind_ = policy_kind_t::LFU;
+    else if (typeid(*policy) == typeid(policy_fifo_t))
+        policy_kind_ = policy_kind_t::FIFO;
+    else if (typeid(*policy) == typeid(policy_bit_plru_t))
+        policy_kind_ = policy_kind_t::BIT_PLRU;
+    else if (typeid(*policy) == typeid(policy_rrip_t))
+        policy_kind_ = policy_kind_t::RRIP;
+    else
+        policy_kind_ = policy_kind_t::OTHER;
+}
+
 std::string
 caching_device_t::get_description() const
 {
@@ -284,14 +312,28 @@ void
 caching_device_t::access_update(int block_idx, int way,
                                 cache_access_outcome_t access_type)
 {
-    replacement_policy_->access_update(compute_set_index(block_idx), way, access_type);
+    int set_idx = compute_set_index(block_idx);
+    with_replacement_policy([&](auto &policy) {
+        using policy_type = std::remove_reference_t<decltype(policy)>;
+        if constexpr (is_builtin_policy_v<policy_type>)
+            policy.policy_type::access_update(set_idx, way, access_type);
+        else
+            policy.access_update(set_idx, way, access_type);
+    });
 }
 
 int
 caching_device_t::replace_which_way(int block_idx)
 {
     int way_to_replace = get_next_way_to_replace(block_idx);
-    replacement_policy_->eviction_update(compute_set_index(block_idx), way_to_replace);
+    int set_idx = compute_set_index(block_idx);
+    with_replacement_policy([&](auto &policy) {
+        using policy_type = std::remove_reference_t<decltype(policy)>;
+        if constexpr (is_builtin_policy_v<policy_type>)
+            policy.policy_type::eviction_update(set_idx, way_to_replace);
+        else
+            policy.eviction_update(set_idx, way_to_replace);
+    });
     return way_to_replace;
 }
 
@@ -302,7 +344,14 @@ caching_device_t::get_next_way_to_replace(const int block_idx) const
         if (get_caching_device_block(block_idx, way).tag_ == TAG_INVALID)
             return way;
     }
-    return replacement_policy_->get_next_way_to_replace(compute_set_index(block_idx));
+    int set_idx = compute_set_index(block_idx);
+    return with_replacement_policy([&](auto &policy) {
+        using policy_type = std::remove_reference_t<decltype(policy)>;
+        if constexpr (is_builtin_policy_v<policy_type>)
+            return policy.policy_type::get_next_way_to_replace(set_idx);
+        else
+            return policy.get_next_way_to_replace(set_idx);
+    });
 }
 
 void
@@ -314,8 +363,14 @@ caching_device_t::invalidate(addr_t tag, invalidation_type_t invalidation_type)
         loaded_blocks_--;
         stats_->invalidate(invalidation_type);
         // Invalidate last_tag_ if it was this tag.
-        replacement_policy_->invalidation_update(
-            compute_set_index(compute_block_idx(tag)), block_way.second);
+        int set_idx = compute_set_index(compute_block_idx(tag));
+        with_replacement_policy([&](auto &policy) {
+            using policy_type = std::remove_reference_t<decltype(policy)>;
+            if constexpr (is_builtin_policy_v<policy_type>)
+                policy.policy_type::invalidation_update(set_idx, block_way.second);
+            else
+                policy.invalidation_update(set_idx, block_way.second);
+        });
         if (last_tag_ == tag) {
             last_tag_ = TAG_INVALID;
         }
@@ -556,5 +611,78 @@ caching_device_t::insert_tag(addr_t tag, bool is_write, int way, int block_idx)
     update_tag(cache_block, way, tag);
 }
 
+bool
+caching_device_t::save_block_state(const caching_device_block_t &block,
+                                   std::ostream &out) const
+{
+    return checkpoint_write(out, block.tag_) && checkpoint_write(out, block.counter_);
+}
+
+bool
+caching_device_t::restore_block_state(caching_device_block_t &block, std::istream &in)
+{
+    return checkpoint_read(in, block.tag_) && checkpoint_read(in, block.counter_);
+}
+
+bool
+caching_device_t::save_state(std::ostream &out) const
+{
+    // The geometry lets restore_state() reject a mismatched hierarchy.
+    if (!checkpoint_write(out, static_cast<int64_t>(associativity_)) ||
+        !checkpoint_write(out, block_size_) || !checkpoint_write(out, num_blocks_) ||
+        !checkpoint_write(out, static_cast<int64_t>(loaded_blocks_)))
+        return false;
+    for (int i = 0; i < num_blocks_; i++) {
+        if (!save_block_state(*blocks_[i], out))
+            return false;
+    }
+    uint64_t num_exclusive_tags = prev_serviced_exclusive_tags_.size();
+    if (!checkpoint_write(out, num_exclusive_tags))
+        return false;
+    for (addr_t tag : prev_serviced_exclusive_tags_) {
+        if (!checkpoint_write(out, tag))
+            return false;
+    }
+    if (!replacement_policy_->save_state(out))
+        return false;
+    return prefetcher_ == nullptr || prefetcher_->save_state(out);
+}
+
+bool
+caching_device_t::restore_state(std::istream &in)
+{
+    int64_t associativity, block_size, num_blocks, loaded_blocks;
+    if (!checkpoint_read(in, associativity) || !checkpoint_read(in, block_size) ||
+        !checkpoint_read(in, num_blocks) || !checkpoint_read(in, loaded_blocks))
+        return false;
+    if (associativity != associativity_ || block_size != block_size_ ||
+        num_blocks != num_blocks_ || loaded_blocks < 0 || loaded_blocks > num_blocks_)
+        return false;
+    loaded_blocks_ = static_cast<int>(loaded_blocks);
+    if (use_tag2block_table_)
+        tag2block.clear();
+    for (int i = 0; i < num_blocks_; i++) {
+        if (!restore_block_state(*blocks_[i], in))
+            return false;
+        if (use_tag2block_table_ && blocks_[i]->tag_ != TAG_INVALID)
+            tag2block[blocks_[i]->tag_] = std::make_pair(blocks_[i], i % associativity_);
+    }
+    uint64_t num_exclusive_tags;
+    if (!checkpoint_read(in, num_exclusive_tags))
+        return false;
+    prev_serviced_exclusive_tags_.clear();
+    for (uint64_t i = 0; i < num_exclusive_tags; i++) {
+        addr_t tag;
+        if (!checkpoint_read(in, tag))
+            return false;
+        prev_serviced_exclusive_tags_.insert(tag);
+    }
+    // The fast path's remembered location may no longer hold its tag.
+    last_tag_ = TAG_INVALID;
+    if (!replacement_policy_->restore_state(in))
+        return false;
+    return prefetcher_ == nullptr || prefetcher_->restore_state(in);
+}
+
 } // namespace drmemtrace
 } // namespace dynamorio
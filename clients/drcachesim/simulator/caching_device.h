@@ -40,8 +40,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -51,6 +54,11 @@
 #include "caching_device_block.h"
 #include "caching_device_stats.h"
 #include "memref.h"
+#include "policy_bit_plru.h"
+#include "policy_fifo.h"
+#include "policy_lfu.h"
+#include "policy_lru.h"
+#include "policy_rrip.h"
 #include "trace_entry.h"
 
 namespace dynamorio {
@@ -207,6 +215,7 @@ public:
     set_replace_policy(std::unique_ptr<cache_replacement_policy_t> replacement_policy)
     {
         replacement_policy_ = std::move(replacement_policy);
+        update_policy_kind();
     }
     virtual const std::string &
     get_name() const
@@ -217,6 +226,15 @@ public:
     virtual std::string
     get_description() const;
 
+    // Writes the warm state of this device (its blocks, replacement policy and
+    // prefetcher) to a simulator checkpoint.  Statistics are not included.
+    virtual bool
+    save_state(std::ostream &out) const;
+    // Restores state written by save_state() from a device with the same
+    // geometry.  Returns false if the geometry differs or the data is bad.
+    virtual bool
+    restore_state(std::istream &in);
+
 protected:
     virtual void
     access_update(int block_idx, int way, cache_access_outcome_t access_type);
@@ -282,6 +300,12 @@ protected:
     virtual void
     init_blocks() = 0;
 
+    // Per-block checkpoint hooks for subclasses whose blocks carry extra fields.
+    virtual bool
+    save_block_state(const caching_device_block_t &block, std::ostream &out) const;
+    virtual bool
+    restore_block_state(caching_device_block_t &block, std::istream &in);
+
     int associativity_;
     int64_t block_size_; // Also known as line length.
     int64_t num_blocks_; // Total number of lines in cache = size / block_size.
@@ -331,6 +355,39 @@ protected:
 
     mutable std::unique_ptr<cache_replacement_policy_t> replacement_policy_;
 
+    // Which built-in policy replacement_policy_ holds, if any.  This is only set
+    // when the policy's dynamic type is exactly the built-in class, so that
+    // with_replacement_policy() can bind calls to its inline methods instead of
+    // making an indirect call per access.  Subclasses of the built-in policies
+    // are OTHER and are called through the virtual interface.
+    enum class policy_kind_t { OTHER, LRU, LFU, FIFO, BIT_PLRU, RRIP };
+    policy_kind_t policy_kind_ = policy_kind_t::OTHER;
+
+    void
+    update_policy_kind();
+    // Invokes func with replacement_policy_ cast to its concrete type.  For a
+    // built-in type func should make qualified calls (see is_builtin_policy_v), which
+    // bind directly to the inline methods: with_replacement_policy() only hands out a
+    // built-in type when it is the policy's exact dynamic type.
+    template <typename Func>
+    inline auto
+    with_replacement_policy(Func func) const
+    {
+        cache_replacement_policy_t *policy = replacement_policy_.get();
+        switch (policy_kind_) {
+        case policy_kind_t::LRU: return func(*static_cast<policy_lru_t *>(policy));
+        case policy_kind_t::LFU: return func(*static_cast<policy_lfu_t *>(policy));
+        case policy_kind_t::FIFO: return func(*static_cast<policy_fifo_t *>(policy));
+        case policy_kind_t::BIT_PLRU:
+            return func(*static_cast<policy_bit_plru_t *>(policy));
+        case policy_kind_t::RRIP: return func(*static_cast<policy_rrip_t *>(policy));
+        default: return func(*policy);
+        }
+    }
+    template <typename Policy>
+    static constexpr bool is_builtin_policy_v =
+        !std::is_same_v<std::remove_const_t<Policy>, cache_replacement_policy_t>;
+
     // For exclusive cache: Tags which previously were serviced in this cache,
     // but moved to a child cache.
     // This container expected to be empty for inclusive cache.
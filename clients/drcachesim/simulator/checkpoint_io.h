@@ -0,0 +1,121 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* checkpoint_io: helpers for reading and writing simulator checkpoints.
+ */
+
+#ifndef _CHECKPOINT_IO_H_
+#define _CHECKPOINT_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Checkpoints are a flat binary stream of fixed-size values in host byte order.
+// They are meant to be restored by the same build on the same platform, so we
+// do not bother with a portable encoding; a version number in the simulator's
+// header rejects files from incompatible layouts.
+
+template <typename T>
+inline bool
+checkpoint_write(std::ostream &out, const T &value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "not a plain value");
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    return out.good();
+}
+
+template <typename T>
+inline bool
+checkpoint_read(std::istream &in, T &value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "not a plain value");
+    in.read(reinterpret_cast<char *>(&value), sizeof(value));
+    return in.good();
+}
+
+inline bool
+checkpoint_write_string(std::ostream &out, const std::string &str)
+{
+    if (!checkpoint_write(out, static_cast<uint64_t>(str.size())))
+        return false;
+    out.write(str.data(), str.size());
+    return out.good();
+}
+
+inline bool
+checkpoint_read_string(std::istream &in, std::string &str)
+{
+    // Guard against allocating a huge buffer for a corrupt length.
+    static constexpr uint64_t MAX_STRING_SIZE = 1 << 20;
+    uint64_t size;
+    if (!checkpoint_read(in, size) || size > MAX_STRING_SIZE)
+        return false;
+    str.resize(static_cast<size_t>(size));
+    in.read(&str[0], size);
+    return in.good();
+}
+
+// Writes per-set replacement metadata stored flat as [num_sets * associativity].
+template <typename T>
+inline bool
+checkpoint_write_array(std::ostream &out, const std::vector<T> &array)
+{
+    if (!array.empty()) {
+        out.write(reinterpret_cast<const char *>(array.data()), array.size() * sizeof(T));
+    }
+    return out.good();
+}
+
+// Reads back what checkpoint_write_array() wrote, into an array that is already
+// sized for the same geometry.
+template <typename T>
+inline bool
+checkpoint_read_array(std::istream &in, std::vector<T> &array)
+{
+    if (!array.empty())
+        in.read(reinterpret_cast<char *>(array.data()), array.size() * sizeof(T));
+    return in.good();
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CHECKPOINT_IO_H_ */
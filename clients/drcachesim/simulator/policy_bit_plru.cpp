@@ -32,80 +32,65 @@
 
 #include "policy_bit_plru.h"
 
+#include <istream>
+#include <ostream>
 #include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "cache_replacement_policy.h"
+#include "checkpoint_io.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
 policy_bit_plru_t::policy_bit_plru_t(int num_sets, int associativity, int seed)
     : cache_replacement_policy_t(num_sets, associativity)
+    , plru_bits_(static_cast<size_t>(num_sets) * associativity, 0)
     , num_ones_(num_sets, 0)
     , gen_(seed == -1 ? std::random_device()() : seed)
 {
-    // Initialize the bit vector for each set.
-    plru_bits_.reserve(num_sets);
-    for (int i = 0; i < num_sets; ++i) {
-        plru_bits_.emplace_back(associativity, false);
-    }
 }
 
-void
-policy_bit_plru_t::access_update(int set_idx, int way, cache_access_outcome_t access_type)
-{
-    // Set the bit for the accessed way.
-    if (!plru_bits_[set_idx][way]) {
-        plru_bits_[set_idx][way] = true;
-        num_ones_[set_idx]++;
-    }
-    if (num_ones_[set_idx] < associativity_) {
-        // Finished.
-        return;
-    }
-    // If all bits are set, reset them.
-    for (int i = 0; i < associativity_; ++i) {
-        plru_bits_[set_idx][i] = false;
-    }
-    num_ones_[set_idx] = 1;
-    plru_bits_[set_idx][way] = true;
-}
-
-void
-policy_bit_plru_t::eviction_update(int set_idx, int way)
+std::string
+policy_bit_plru_t::get_name() const
 {
-    // Nothing to update, when the way is accessed we will update it.
+    return "BIT_PLRU";
 }
 
-void
-policy_bit_plru_t::invalidation_update(int set_idx, int way)
+bool
+policy_bit_plru_t::save_state(std::ostream &out) const
 {
-    // Nothing to update, when the way is accessed we will update it.
+    if (!checkpoint_write_array(out, plru_bits_))
+        return false;
+    // The generator picks among the unset bits, so its state is part of what
+    // the policy will do next.
+    std::ostringstream gen_state;
+    gen_state << gen_;
+    return checkpoint_write_string(out, gen_state.str());
 }
 
-int
-policy_bit_plru_t::get_next_way_to_replace(int set_idx) const
+bool
+policy_bit_plru_t::restore_state(std::istream &in)
 {
-    std::vector<int> unset_bits;
-    for (int i = 0; i < associativity_; ++i) {
-        if (!plru_bits_[set_idx][i]) {
-            unset_bits.push_back(i);
+    if (!checkpoint_read_array(in, plru_bits_))
+        return false;
+    for (int set = 0; set < num_sets_; ++set) {
+        num_ones_[set] = 0;
+        for (int way = 0; way < associativity_; ++way) {
+            uint8_t &bit = plru_bits_[set * associativity_ + way];
+            if (bit > 1)
+                return false;
+            num_ones_[set] += bit;
         }
     }
-
-    if (unset_bits.empty()) {
-        // Should not reach here.
-        return -1;
-    }
-    return unset_bits[gen_() % unset_bits.size()];
-}
-
-std::string
-policy_bit_plru_t::get_name() const
-{
-    return "BIT_PLRU";
+    std::string gen_str;
+    if (!checkpoint_read_string(in, gen_str))
+        return false;
+    std::istringstream gen_state(gen_str);
+    gen_state >> gen_;
+    return !gen_state.fail();
 }
 
 } // namespace drmemtrace
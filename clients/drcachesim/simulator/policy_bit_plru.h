@@ -33,6 +33,9 @@
 #ifndef _BIT_PLRU_H_
 #define _BIT_PLRU_H_
 
+#include <stdint.h>
+
+#include <algorithm>
 #include <random>
 #include <string>
 #include <vector>
@@ -53,22 +56,63 @@ public:
     /// If seed is -1, a random seed will be used.
     policy_bit_plru_t(int num_sets, int associativity, int seed = -1);
     void
-    access_update(int set_idx, int way, cache_access_outcome_t access_type) override;
+    access_update(int set_idx, int way, cache_access_outcome_t access_type) override
+    {
+        uint8_t *bits = &plru_bits_[set_idx * associativity_];
+        // Set the bit for the accessed way.
+        if (!bits[way]) {
+            bits[way] = 1;
+            num_ones_[set_idx]++;
+        }
+        if (num_ones_[set_idx] < associativity_) {
+            // Finished.
+            return;
+        }
+        // If all bits are set, reset them.
+        std::fill(bits, bits + associativity_, 0);
+        num_ones_[set_idx] = 1;
+        bits[way] = 1;
+    }
     void
-    eviction_update(int set_idx, int way) override;
+    eviction_update(int set_idx, int way) override
+    {
+        // Nothing to update, when the way is accessed we will update it.
+    }
     int
-    get_next_way_to_replace(int set_idx) const override;
+    get_next_way_to_replace(int set_idx) const override
+    {
+        int num_unset = associativity_ - num_ones_[set_idx];
+        if (num_unset <= 0) {
+            // Should not reach here.
+            return -1;
+        }
+        // Pick a random unset bit.
+        int pick = static_cast<int>(gen_() % num_unset);
+        const uint8_t *bits = &plru_bits_[set_idx * associativity_];
+        for (int i = 0; i < associativity_; ++i) {
+            if (!bits[i] && pick-- == 0)
+                return i;
+        }
+        return -1;
+    }
     void
-    invalidation_update(int set_idx, int way) override;
+    invalidation_update(int set_idx, int way) override
+    {
+        // Nothing to update, when the way is accessed we will update it.
+    }
     std::string
     get_name() const override;
+    bool
+    save_state(std::ostream &out) const override;
+    bool
+    restore_state(std::istream &in) override;
 
     ~policy_bit_plru_t() override = default;
 
 private:
-    // A bit per way for each line.
-    std::vector<std::vector<bool>> plru_bits_;
-    // The amount of bits set to 1 for each line.
+    // A bit per way for each set, one byte each, stored contiguously by set.
+    std::vector<uint8_t> plru_bits_;
+    // The amount of bits set to 1 for each set.
     std::vector<int> num_ones_;
     mutable std::mt19937 gen_;
 };
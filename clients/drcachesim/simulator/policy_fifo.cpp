@@ -32,59 +32,60 @@
 
 #include "policy_fifo.h"
 
-#include <list>
+#include <algorithm>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <vector>
 
 #include "cache_replacement_policy.h"
+#include "checkpoint_io.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
 policy_fifo_t::policy_fifo_t(int num_sets, int associativity)
     : cache_replacement_policy_t(num_sets, associativity)
+    , queues_(static_cast<size_t>(num_sets) * associativity)
 {
-    // Initialize the FIFO list for each set.
-    queues_.reserve(num_sets);
-    for (int i = 0; i < num_sets; ++i) {
-        queues_.push_back(std::list<int>());
-        for (int j = 0; j < associativity; ++j) {
-            queues_[i].push_back(j);
-        }
-    }
-}
-
-void
-policy_fifo_t::access_update(int set_idx, int way, cache_access_outcome_t access_type)
-{
-    // Nothing to update, FIFO does not change on access.
-}
-
-void
-policy_fifo_t::eviction_update(int set_idx, int way)
-{
-    // Move the evicted way to the back of the queue.
-    auto &fifo_set = queues_[set_idx];
-    fifo_set.remove(way);
-    fifo_set.push_back(way);
+    // Initialize the FIFO queue for each set.
+    for (size_t i = 0; i < queues_.size(); ++i)
+        queues_[i] = static_cast<int>(i % associativity);
 }
 
-void
-policy_fifo_t::invalidation_update(int set_idx, int way)
+std::string
+policy_fifo_t::get_name() const
 {
-    // Nothing to update, FIFO does not change on invalidation.
+    return "FIFO";
 }
 
-int
-policy_fifo_t::get_next_way_to_replace(int set_idx) const
+bool
+policy_fifo_t::save_state(std::ostream &out) const
 {
-    // The next way to replace is at the front of the FIFO list.
-    return queues_[set_idx].front();
+    // Each queue holds every way of its set, oldest first.
+    return checkpoint_write_array(out, queues_);
 }
 
-std::string
-policy_fifo_t::get_name() const
+bool
+policy_fifo_t::restore_state(std::istream &in)
 {
-    return "FIFO";
+    std::vector<int> queues(queues_.size());
+    if (!checkpoint_read_array(in, queues))
+        return false;
+    // eviction_update() relies on each set's queue holding every way exactly once,
+    // so we reject anything else rather than let a corrupt checkpoint in.
+    std::vector<bool> seen(associativity_);
+    for (size_t set_start = 0; set_start < queues.size(); set_start += associativity_) {
+        std::fill(seen.begin(), seen.end(), false);
+        for (int i = 0; i < associativity_; ++i) {
+            int way = queues[set_start + i];
+            if (way < 0 || way >= associativity_ || seen[way])
+                return false;
+            seen[way] = true;
+        }
+    }
+    queues_.swap(queues);
+    return true;
 }
 
 } // namespace drmemtrace
@@ -33,7 +33,6 @@
 #ifndef _FIFO_H_
 #define _FIFO_H_
 
-#include <list>
 #include <string>
 #include <vector>
 
@@ -52,21 +51,45 @@ class policy_fifo_t : public cache_replacement_policy_t {
 public:
     policy_fifo_t(int num_sets, int associativity);
     void
-    access_update(int set_idx, int way, cache_access_outcome_t access_type) override;
+    access_update(int set_idx, int way, cache_access_outcome_t access_type) override
+    {
+        // Nothing to update, FIFO does not change on access.
+    }
     void
-    eviction_update(int set_idx, int way) override;
+    eviction_update(int set_idx, int way) override
+    {
+        // Move the evicted way to the back of the queue.
+        int *queue = &queues_[set_idx * associativity_];
+        int pos = 0;
+        while (queue[pos] != way)
+            ++pos;
+        for (; pos < associativity_ - 1; ++pos)
+            queue[pos] = queue[pos + 1];
+        queue[associativity_ - 1] = way;
+    }
     void
-    invalidation_update(int set_idx, int way) override;
+    invalidation_update(int set_idx, int way) override
+    {
+        // Nothing to update, FIFO does not change on invalidation.
+    }
     int
-    get_next_way_to_replace(int set_idx) const override;
+    get_next_way_to_replace(int set_idx) const override
+    {
+        // The next way to replace is at the front of the FIFO queue.
+        return queues_[set_idx * associativity_];
+    }
     std::string
     get_name() const override;
+    bool
+    save_state(std::ostream &out) const override;
+    bool
+    restore_state(std::istream &in) override;
 
     ~policy_fifo_t() override = default;
 
 private:
-    // FIFO queue for each line.
-    std::vector<std::list<int>> queues_;
+    // FIFO queue of every way for each set, oldest first, stored contiguously by set.
+    std::vector<int> queues_;
 };
 
 } // namespace drmemtrace
@@ -32,60 +32,39 @@
 
 #include "policy_lfu.h"
 
+#include <istream>
+#include <ostream>
 #include <string>
 #include <vector>
 
 #include "cache_replacement_policy.h"
+#include "checkpoint_io.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
 policy_lfu_t::policy_lfu_t(int num_sets, int associativity)
     : cache_replacement_policy_t(num_sets, associativity)
+    , access_counts_(static_cast<size_t>(num_sets) * associativity, 0)
 {
-    access_counts_.reserve(num_sets);
-    for (int i = 0; i < num_sets; ++i) {
-        access_counts_.emplace_back(associativity, 0);
-    }
 }
 
-void
-policy_lfu_t::access_update(int set_idx, int way, cache_access_outcome_t access_type)
-{
-    access_counts_[set_idx][way]++;
-}
-
-void
-policy_lfu_t::eviction_update(int set_idx, int way)
-{
-    access_counts_[set_idx][way] = 0;
-}
-
-void
-policy_lfu_t::invalidation_update(int set_idx, int way)
+std::string
+policy_lfu_t::get_name() const
 {
-    access_counts_[set_idx][way] = 0;
+    return "LFU";
 }
 
-int
-policy_lfu_t::get_next_way_to_replace(int set_idx) const
+bool
+policy_lfu_t::save_state(std::ostream &out) const
 {
-    // Find the way with the minimum frequency counter.
-    int min_freq = access_counts_[set_idx][0];
-    int min_way = 0;
-    for (int i = 1; i < associativity_; ++i) {
-        if (access_counts_[set_idx][i] < min_freq) {
-            min_freq = access_counts_[set_idx][i];
-            min_way = i;
-        }
-    }
-    return min_way;
+    return checkpoint_write_array(out, access_counts_);
 }
 
-std::string
-policy_lfu_t::get_name() const
+bool
+policy_lfu_t::restore_state(std::istream &in)
 {
-    return "LFU";
+    return checkpoint_read_array(in, access_counts_);
 }
 
 } // namespace drmemtrace
@@ -33,6 +33,7 @@
 #ifndef _LFU_H_
 #define _LFU_H_
 
+#include <string>
 #include <vector>
 
 #include "cache_replacement_policy.h"
@@ -49,21 +50,47 @@ class policy_lfu_t : public cache_replacement_policy_t {
 public:
     policy_lfu_t(int num_sets, int associativity);
     void
-    access_update(int set_idx, int way, cache_access_outcome_t access_type) override;
+    access_update(int set_idx, int way, cache_access_outcome_t access_type) override
+    {
+        access_counts_[set_idx * associativity_ + way]++;
+    }
     void
-    eviction_update(int set_idx, int way) override;
+    eviction_update(int set_idx, int way) override
+    {
+        access_counts_[set_idx * associativity_ + way] = 0;
+    }
     void
-    invalidation_update(int set_idx, int way) override;
+    invalidation_update(int set_idx, int way) override
+    {
+        access_counts_[set_idx * associativity_ + way] = 0;
+    }
     int
-    get_next_way_to_replace(int set_idx) const override;
+    get_next_way_to_replace(int set_idx) const override
+    {
+        // Find the way with the minimum frequency counter.
+        const int *counts = &access_counts_[set_idx * associativity_];
+        int min_freq = counts[0];
+        int min_way = 0;
+        for (int i = 1; i < associativity_; ++i) {
+            if (counts[i] < min_freq) {
+                min_freq = counts[i];
+                min_way = i;
+            }
+        }
+        return min_way;
+    }
     std::string
     get_name() const override;
+    bool
+    save_state(std::ostream &out) const override;
+    bool
+    restore_state(std::istream &in) override;
 
     ~policy_lfu_t() override = default;
 
 private:
-    // Frequency counters for each way in each line.
-    std::vector<std::vector<int>> access_counts_;
+    // Frequency counters for each way of each set, stored contiguously by set.
+    std::vector<int> access_counts_;
 };
 
 } // namespace drmemtrace
@@ -33,73 +33,46 @@
 #include "policy_lru.h"
 
 #include <algorithm>
+#include <istream>
+#include <ostream>
 #include <string>
 
 #include "cache_replacement_policy.h"
+#include "checkpoint_io.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
 policy_lru_t::policy_lru_t(int num_sets, int associativity)
     : cache_replacement_policy_t(num_sets, associativity)
+    , lru_counters_(static_cast<size_t>(num_sets) * associativity, 1)
 {
-    // Initialize the LRU list for each set.
-    lru_counters_.reserve(num_sets);
-    for (int i = 0; i < num_sets; ++i) {
-        lru_counters_.emplace_back(associativity, 1);
-    }
 }
 
 void
-policy_lru_t::access_update(int set_idx, int way, cache_access_outcome_t access_type)
-{
-    int count = lru_counters_[set_idx][way];
-    // Optimization: return early if it is a repeated access.
-    if (count == 0)
-        return;
-    // We inc all the counters that are not larger than count for LRU.
-    for (int i = 0; i < associativity_; ++i) {
-        if (i != way && lru_counters_[set_idx][i] <= count)
-            lru_counters_[set_idx][i]++;
-    }
-    // Clear the counter for LRU.
-    lru_counters_[set_idx][way] = 0;
-}
-
-void
-policy_lru_t::eviction_update(int set_idx, int way)
+policy_lru_t::invalidation_update(int set_idx, int way)
 {
-    // Nothing to update, when the way is accessed we will update it -
-    // If the way was evicted, it is already at the end of the list.
+    auto set_begin = lru_counters_.begin() + set_idx * associativity_;
+    int max_counter = *std::max_element(set_begin, set_begin + associativity_);
+    set_begin[way] = max_counter + 1;
 }
 
-void
-policy_lru_t::invalidation_update(int set_idx, int way)
+std::string
+policy_lru_t::get_name() const
 {
-    int max_counter =
-        *std::max_element(lru_counters_[set_idx].begin(), lru_counters_[set_idx].end());
-    lru_counters_[set_idx][way] = max_counter + 1;
+    return "LRU";
 }
 
-int
-policy_lru_t::get_next_way_to_replace(int set_idx) const
+bool
+policy_lru_t::save_state(std::ostream &out) const
 {
-    // We implement LRU by picking the slot with the largest counter value.
-    int max_counter = 0;
-    int max_way = 0;
-    for (int way = 0; way < associativity_; ++way) {
-        if (lru_counters_[set_idx][way] > max_counter) {
-            max_counter = lru_counters_[set_idx][way];
-            max_way = way;
-        }
-    }
-    return max_way;
+    return checkpoint_write_array(out, lru_counters_);
 }
 
-std::string
-policy_lru_t::get_name() const
+bool
+policy_lru_t::restore_state(std::istream &in)
 {
-    return "LRU";
+    return checkpoint_read_array(in, lru_counters_);
 }
 
 } // namespace drmemtrace
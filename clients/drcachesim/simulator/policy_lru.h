@@ -33,7 +33,6 @@
 #ifndef _LRU_H_
 #define _LRU_H_
 
-#include <list>
 #include <string>
 #include <vector>
 
@@ -51,21 +50,56 @@ class policy_lru_t : public cache_replacement_policy_t {
 public:
     policy_lru_t(int num_sets, int associativity);
     void
-    access_update(int set_idx, int way, cache_access_outcome_t access_type) override;
+    access_update(int set_idx, int way, cache_access_outcome_t access_type) override
+    {
+        int *counters = &lru_counters_[set_idx * associativity_];
+        int count = counters[way];
+        // Optimization: return early if it is a repeated access.
+        if (count == 0)
+            return;
+        // We inc all the counters that are not larger than count for LRU.
+        for (int i = 0; i < associativity_; ++i) {
+            if (i != way && counters[i] <= count)
+                counters[i]++;
+        }
+        // Clear the counter for LRU.
+        counters[way] = 0;
+    }
     void
-    eviction_update(int set_idx, int way) override;
+    eviction_update(int set_idx, int way) override
+    {
+        // Nothing to update, when the way is accessed we will update it -
+        // If the way was evicted, it is already at the end of the list.
+    }
     void
     invalidation_update(int set_idx, int way) override;
     int
-    get_next_way_to_replace(int set_idx) const override;
+    get_next_way_to_replace(int set_idx) const override
+    {
+        // We implement LRU by picking the slot with the largest counter value.
+        const int *counters = &lru_counters_[set_idx * associativity_];
+        int max_counter = 0;
+        int max_way = 0;
+        for (int way = 0; way < associativity_; ++way) {
+            if (counters[way] > max_counter) {
+                max_counter = counters[way];
+                max_way = way;
+            }
+        }
+        return max_way;
+    }
     std::string
     get_name() const override;
+    bool
+    save_state(std::ostream &out) const override;
+    bool
+    restore_state(std::istream &in) override;
 
     ~policy_lru_t() override = default;
 
 private:
-    // LRU list for each set.
-    std::vector<std::vector<int>> lru_counters_;
+    // LRU counters for each way of each set, stored contiguously by set.
+    std::vector<int> lru_counters_;
 };
 
 } // namespace drmemtrace
@@ -33,9 +33,12 @@
 #include "policy_rrip.h"
 
 #include <algorithm>
+#include <istream>
+#include <ostream>
 #include <string>
 
 #include "cache_replacement_policy.h"
+#include "checkpoint_io.h"
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -51,11 +54,8 @@ policy_rrip_t::policy_rrip_t(int num_sets, int associativity, size_t rrpv_bits,
 {
     assert(rrpv_long_per_period <= rrpv_period);
 
-    // Initialize the RRPV list for each set with "distant" value.
-    rrpv_.reserve(num_sets);
-    for (int i = 0; i < num_sets; ++i) {
-        rrpv_.emplace_back(associativity, rrpv_distant_);
-    }
+    // Initialize the RRPV for each way of each set with "distant" value.
+    rrpv_.assign(static_cast<size_t>(num_sets) * associativity, rrpv_distant_);
 
     // Initialize sequence of RRPV values for cache misses: "long" vs. "distant"
     rrpv_seed_val_at_miss_.reserve(rrpv_period_);
@@ -73,66 +73,27 @@ policy_rrip_t::policy_rrip_t(int num_sets, int associativity, size_t rrpv_bits,
     at_rrpv_seed_idx_ = 0;
 }
 
-void
-policy_rrip_t::access_update(int set_idx, int way, cache_access_outcome_t access_type)
-{
-    assert((access_type == HIT) || (access_type == MISS));
-    // Cache hit: set counter to 0
-    // Cache miss: set block counter to "long" or "distant" with specified frequency
-    rrpv_[set_idx][way] = (access_type == HIT) ? 0 : increment_n_get_miss_rrpv();
-}
-
-void
-policy_rrip_t::eviction_update(int set_idx, int way)
-{
-    // Following the replacement policy, only cache block with "distant" RRPV can be
-    // replaced. If there are no "distant" block, RRPV for all ways should be incremented
-    // d_rrpv times, Where:
-    //  d_RRPV = RRPV_distant - max_over_set(RRPV), And
-    //  max_over_set(RRPV) = rrpv_[set_idx][way]
-    int d_rrpv = rrpv_distant_ - rrpv_[set_idx][way];
-    if (d_rrpv > 0) {
-        for (int w = 0; w < associativity_; ++w) {
-            assert(rrpv_[set_idx][w] + d_rrpv <= rrpv_distant_);
-            rrpv_[set_idx][w] += d_rrpv;
-        }
-    }
-}
-
-void
-policy_rrip_t::invalidation_update(int set_idx, int way)
+std::string
+policy_rrip_t::get_name() const
 {
-    rrpv_[set_idx][way] = rrpv_distant_;
+    return "RRIP";
 }
 
-int
-policy_rrip_t::get_next_way_to_replace(int set_idx) const
+bool
+policy_rrip_t::save_state(std::ostream &out) const
 {
-    // Following the replacement policy, only cache block with "distant" RRPV can be
-    // replaced. If there are no "distant" block, RRPV for all ways should be incremented
-    // d_RRPV times, Where:
-    //  d_RRPV = RRPV_distant - max_over_set(RRPV)
-    // Here let's find the first block with "distant" or max RRPV
-    // RRPV will be updated in `eviction_update` function.
-    int ret_way = 0;
-    rrpv_t rrpv_max = 0;
-    for (int way = 0; way < associativity_; ++way) {
-        if (rrpv_[set_idx][way] == rrpv_distant_) {
-            // Found "distant" RRPV. No need to continue search
-            return way;
-        }
-        if (rrpv_[set_idx][way] > rrpv_max) {
-            ret_way = way;
-            rrpv_max = rrpv_[set_idx][way];
-        }
-    }
-    return ret_way;
+    return checkpoint_write_array(out, rrpv_) &&
+        checkpoint_write(out, static_cast<uint64_t>(at_rrpv_seed_idx_));
 }
 
-std::string
-policy_rrip_t::get_name() const
+bool
+policy_rrip_t::restore_state(std::istream &in)
 {
-    return "RRIP";
+    uint64_t seed_idx;
+    if (!checkpoint_read_array(in, rrpv_) || !checkpoint_read(in, seed_idx))
+        return false;
+    at_rrpv_seed_idx_ = static_cast<size_t>(seed_idx);
+    return true;
 }
 
 } // namespace drmemtrace
@@ -34,7 +34,6 @@
 #define _RRIP_H_
 
 #include <cassert>
-#include <list>
 #include <string>
 #include <vector>
 
@@ -79,22 +78,74 @@ public:
                   size_t rrpv_period = RRPV_PERIOD_DEFAULT,
                   size_t rrpv_long_per_period = RRPV_LONG_PER_PERIOD_DEFAULT);
     void
-    access_update(int set_idx, int way, cache_access_outcome_t access_type) override;
+    access_update(int set_idx, int way, cache_access_outcome_t access_type) override
+    {
+        assert((access_type == HIT) || (access_type == MISS));
+        // Cache hit: set counter to 0
+        // Cache miss: set block counter to "long" or "distant" with specified frequency
+        rrpv_[set_idx * associativity_ + way] =
+            (access_type == HIT) ? 0 : increment_n_get_miss_rrpv();
+    }
     void
-    eviction_update(int set_idx, int way) override;
+    eviction_update(int set_idx, int way) override
+    {
+        // Following the replacement policy, only cache block with "distant" RRPV can
+        // be replaced. If there are no "distant" block, RRPV for all ways should be
+        // incremented d_rrpv times, Where:
+        //  d_RRPV = RRPV_distant - max_over_set(RRPV), And
+        //  max_over_set(RRPV) = rrpv_[set_idx * associativity_ + way]
+        rrpv_t *rrpv = &rrpv_[set_idx * associativity_];
+        int d_rrpv = rrpv_distant_ - rrpv[way];
+        if (d_rrpv > 0) {
+            for (int w = 0; w < associativity_; ++w) {
+                assert(rrpv[w] + d_rrpv <= rrpv_distant_);
+                rrpv[w] += d_rrpv;
+            }
+        }
+    }
     void
-    invalidation_update(int set_idx, int way) override;
+    invalidation_update(int set_idx, int way) override
+    {
+        rrpv_[set_idx * associativity_ + way] = rrpv_distant_;
+    }
     int
-    get_next_way_to_replace(int set_idx) const override;
+    get_next_way_to_replace(int set_idx) const override
+    {
+        // Following the replacement policy, only cache block with "distant" RRPV can
+        // be replaced. If there are no "distant" block, RRPV for all ways should be
+        // incremented d_RRPV times, Where:
+        //  d_RRPV = RRPV_distant - max_over_set(RRPV)
+        // Here let's find the first block with "distant" or max RRPV
+        // RRPV will be updated in `eviction_update` function.
+        const rrpv_t *rrpv = &rrpv_[set_idx * associativity_];
+        int ret_way = 0;
+        rrpv_t rrpv_max = 0;
+        for (int way = 0; way < associativity_; ++way) {
+            if (rrpv[way] == rrpv_distant_) {
+                // Found "distant" RRPV. No need to continue search
+                return way;
+            }
+            if (rrpv[way] > rrpv_max) {
+                ret_way = way;
+                rrpv_max = rrpv[way];
+            }
+        }
+        return ret_way;
+    }
     std::string
     get_name() const override;
+    bool
+    save_state(std::ostream &out) const override;
+    bool
+    restore_state(std::istream &in) override;
 
     ~policy_rrip_t() override = default;
 
 private:
     typedef unsigned rrpv_t;
 
-    std::vector<std::vector<rrpv_t>> rrpv_;
+    // RRPV for each way of each set, stored contiguously by set.
+    std::vector<rrpv_t> rrpv_;
 
     // How many bits are used for re-reference reuse interval
     // With the value of 1 RRIP cache is equal to NRU (Not Recently Used)
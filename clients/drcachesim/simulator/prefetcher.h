@@ -36,6 +36,9 @@
 #ifndef _PREFETCHER_H_
 #define _PREFETCHER_H_
 
+#include <istream>
+#include <ostream>
+
 #include "caching_device.h"
 #include "memref.h"
 
@@ -55,6 +58,19 @@ public:
     // memref.data.addr is already in the cache or not.
     virtual void
     prefetch(caching_device_t *cache, const memref_t &memref, bool missed);
+    // Saves and restores any prediction state for simulator checkpoints.  The
+    // default next-line prefetcher is stateless; prefetchers that learn from
+    // the access stream should override these.
+    virtual bool
+    save_state(std::ostream &out) const
+    {
+        return true;
+    }
+    virtual bool
+    restore_state(std::istream &in)
+    {
+        return true;
+    }
 
 protected:
     int block_size_;
@@ -35,13 +35,20 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdint.h>
+#include <stdlib.h>
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <istream>
+#include <ostream>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "caching_device.h"
+#include "checkpoint_io.h"
 #include "memref.h"
 #include "options.h"
 #include "utils.h"
@@ -130,6 +137,11 @@ simulator_t::initialize_shard_type(shard_type_t shard_type)
 bool
 simulator_t::process_memref(const memref_t &memref)
 {
+    if ((!checkpoint_in_.empty() && !checkpoint_restored_) ||
+        next_checkpoint_ < checkpoint_instrs_.size()) {
+        if (!handle_checkpoints(memref))
+            return false;
+    }
     if (memref.marker.type != TRACE_TYPE_MARKER) {
         ++non_marker_count_;
         return true;
@@ -351,5 +363,159 @@ simulator_t::print_core(int core) const
     }
 }
 
+// "DRSIMCKP" in little-endian order.
+static constexpr uint64_t CHECKPOINT_MAGIC = 0x504b434d49535244ULL;
+// Bump this on any change to the layout of a checkpoint.
+static constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+std::string
+simulator_t::init_checkpoints(const std::string &checkpoint_in,
+                              const std::string &checkpoint_out,
+                              const std::string &checkpoint_instrs)
+{
+    checkpoint_in_ = checkpoint_in;
+    checkpoint_out_ = checkpoint_out;
+    if (checkpoint_instrs.empty()) {
+        if (!checkpoint_out_.empty())
+            return "Usage error: a checkpoint path requires checkpoint instructions";
+        return "";
+    }
+    if (checkpoint_out_.empty())
+        return "Usage error: checkpoint instructions require a checkpoint path";
+    for (const std::string &ordinal : split_by(checkpoint_instrs, ",")) {
+        char *end;
+        unsigned long long value = strtoull(ordinal.c_str(), &end, 0);
+        if (ordinal.empty() || *end != '\0') {
+            return "Usage error: invalid checkpoint instruction ordinal \"" + ordinal +
+                "\"";
+        }
+        checkpoint_instrs_.push_back(value);
+    }
+    std::sort(checkpoint_instrs_.begin(), checkpoint_instrs_.end());
+    checkpoint_instrs_.erase(
+        std::unique(checkpoint_instrs_.begin(), checkpoint_instrs_.end()),
+        checkpoint_instrs_.end());
+    return "";
+}
+
+bool
+simulator_t::handle_checkpoints(const memref_t &memref)
+{
+    if (!checkpoint_in_.empty() && !checkpoint_restored_) {
+        checkpoint_restored_ = true;
+        std::ifstream fin(checkpoint_in_, std::ios::binary);
+        if (!fin.is_open()) {
+            error_string_ = "Failed to open checkpoint file " + checkpoint_in_;
+            return false;
+        }
+        std::string error = restore_checkpoint(fin);
+        if (!error.empty()) {
+            error_string_ = "Failed to restore " + checkpoint_in_ + ": " + error;
+            return false;
+        }
+        if (knob_verbose_ >= 1)
+            std::cerr << "Restored checkpoint " << checkpoint_in_ << "\n";
+    }
+    if (next_checkpoint_ >= checkpoint_instrs_.size() ||
+        !type_is_instr(memref.instr.type))
+        return true;
+    // A checkpoint at ordinal N holds the state after N instructions, so that it
+    // can be paired with -skip_instrs N.  We thus write it just before simulating
+    // instruction N+1.  The stream's ordinal includes any skipped instructions.
+    uint64_t ordinal = serial_stream_ != nullptr
+        ? serial_stream_->get_instruction_ordinal()
+        : ++checkpoint_instr_count_;
+    while (next_checkpoint_ < checkpoint_instrs_.size() &&
+           ordinal > checkpoint_instrs_[next_checkpoint_]) {
+        uint64_t at_instr = checkpoint_instrs_[next_checkpoint_++];
+        std::string path = checkpoint_out_ + "." + std::to_string(at_instr);
+        std::ofstream fout(path, std::ios::binary);
+        if (!fout.is_open()) {
+            error_string_ = "Failed to create checkpoint file " + path;
+            return false;
+        }
+        std::string error = save_checkpoint(fout);
+        fout.close();
+        if (error.empty() && !fout)
+            error = "write failed";
+        if (!error.empty()) {
+            error_string_ = "Failed to write checkpoint " + path + ": " + error;
+            return false;
+        }
+        if (knob_verbose_ >= 1) {
+            std::cerr << "Wrote checkpoint " << path << " at instruction " << at_instr
+                      << "\n";
+        }
+    }
+    return true;
+}
+
+std::string
+simulator_t::save_checkpoint(std::ostream &out)
+{
+    if (!checkpoint_write(out, CHECKPOINT_MAGIC) ||
+        !checkpoint_write(out, CHECKPOINT_VERSION))
+        return "write failed";
+    return save_state(out);
+}
+
+std::string
+simulator_t::restore_checkpoint(std::istream &in)
+{
+    uint64_t magic;
+    uint32_t version;
+    if (!checkpoint_read(in, magic) || magic != CHECKPOINT_MAGIC)
+        return "not a simulator checkpoint";
+    if (!checkpoint_read(in, version) || version != CHECKPOINT_VERSION)
+        return "unsupported checkpoint version";
+    return restore_state(in);
+}
+
+std::string
+simulator_t::save_state(std::ostream &out)
+{
+    return "checkpoints are not supported by this simulator";
+}
+
+std::string
+simulator_t::restore_state(std::istream &in)
+{
+    return "checkpoints are not supported by this simulator";
+}
+
+std::string
+simulator_t::save_devices(std::ostream &out,
+                          const std::vector<caching_device_t *> &devices)
+{
+    if (!checkpoint_write(out, static_cast<uint64_t>(devices.size())))
+        return "write failed";
+    for (const caching_device_t *device : devices) {
+        if (!checkpoint_write_string(out, device->get_name()))
+            return "write failed";
+        if (!device->save_state(out)) {
+            return "failed to save " + device->get_name() + " (" +
+                device->get_replace_policy() + " may not support checkpoints)";
+        }
+    }
+    return "";
+}
+
+std::string
+simulator_t::restore_devices(std::istream &in,
+                             const std::vector<caching_device_t *> &devices)
+{
+    uint64_t count;
+    if (!checkpoint_read(in, count) || count != devices.size())
+        return "the checkpoint is for a different hierarchy";
+    for (caching_device_t *device : devices) {
+        std::string name;
+        if (!checkpoint_read_string(in, name) || name != device->get_name())
+            return "the checkpoint is for a different hierarchy";
+        if (!device->restore_state(in))
+            return "mismatched or corrupt state for " + name;
+    }
+    return "";
+}
+
 } // namespace drmemtrace
 } // namespace dynamorio
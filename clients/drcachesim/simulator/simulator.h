@@ -41,6 +41,8 @@
 #include <stdint.h>
 
 #include <istream>
+#include <ostream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -82,7 +84,39 @@ public:
     virtual std::string
     create_v2p_from_file(std::istream &v2p_file);
 
+    // Writes the warm state of the simulated hierarchy (cache or TLB blocks,
+    // replacement policy metadata, prefetcher state and any snoop filter) so
+    // that a later run can resume from it instead of re-warming.  Statistics
+    // are not included.  Returns "" on success or an error description.
+    std::string
+    save_checkpoint(std::ostream &out);
+
+    // Restores state written by save_checkpoint() from a simulator with an
+    // identical hierarchy.  Returns "" on success or an error description.
+    std::string
+    restore_checkpoint(std::istream &in);
+
 protected:
+    // Parses the checkpoint knobs shared by our simulators: a checkpoint file to
+    // restore before the first record, and a file path prefix plus a
+    // comma-separated list of instruction ordinals at which to write checkpoints.
+    // Returns "" on success or an error description.
+    std::string
+    init_checkpoints(const std::string &checkpoint_in, const std::string &checkpoint_out,
+                     const std::string &checkpoint_instrs);
+
+    // Subclass hooks for save_checkpoint() and restore_checkpoint().
+    virtual std::string
+    save_state(std::ostream &out);
+    virtual std::string
+    restore_state(std::istream &in);
+
+    // Writes or restores a list of devices, identified by name.
+    std::string
+    save_devices(std::ostream &out, const std::vector<caching_device_t *> &devices);
+    std::string
+    restore_devices(std::istream &in, const std::vector<caching_device_t *> &devices);
+
     // Initialize knobs. Success or failure is indicated by setting/resetting
     // the success variable.
     void
@@ -154,6 +188,18 @@ protected:
     addr_t prior_phys_addr_ = 0;
     // Indicates whether the simulator uses a v2p file for virtual to physical mapping.
     bool use_v2p_file_ = false;
+
+    // For checkpoints.
+    std::string checkpoint_in_;
+    bool checkpoint_restored_ = false;
+    std::string checkpoint_out_;
+    std::vector<uint64_t> checkpoint_instrs_; // Sorted.
+    size_t next_checkpoint_ = 0;
+    uint64_t checkpoint_instr_count_ = 0; // Used without a serial stream.
+
+private:
+    bool
+    handle_checkpoints(const memref_t &memref);
 };
 
 } // namespace drmemtrace
@@ -38,55 +38,194 @@
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <istream>
 #include <locale>
+#include <ostream>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "cache.h"
 #include "caching_device_block.h"
 #include "caching_device_stats.h"
+#include "checkpoint_io.h"
 #include "trace_entry.h"
 
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
 namespace dynamorio {
 namespace drmemtrace {
 
+namespace {
+
+int
+lowest_set_bit(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+} // namespace
+
 snoop_filter_t::snoop_filter_t(void)
 {
 }
 
 bool
-snoop_filter_t::init(cache_t **caches, int num_snooped_caches)
+snoop_filter_t::init(cache_t **caches, int num_snooped_caches, uint64_t max_entries)
 {
     caches_ = caches;
     num_snooped_caches_ = num_snooped_caches;
     num_writes_ = 0;
     num_writebacks_ = 0;
     num_invalidates_ = 0;
+    num_directory_evictions_ = 0;
+    max_entries_ = max_entries;
+    words_per_entry_ = (num_snooped_caches + 63) / 64;
+    if (words_per_entry_ == 0)
+        words_per_entry_ = 1;
 
+    // A perfect filter never tracks more lines than the snooped caches can hold,
+    // so we size the table for that footprint at a load factor of at most 1/2
+    // to avoid rehashing in the common case.
+    uint64_t footprint = max_entries_;
+    if (footprint == 0) {
+        for (int i = 0; i < num_snooped_caches; ++i)
+            footprint += caches[i]->get_num_blocks();
+    }
+    int bits = 4;
+    while ((1ULL << bits) < 2 * footprint)
+        ++bits;
+    resize_table(bits);
     return true;
 }
 
+void
+snoop_filter_t::resize_table(int bits)
+{
+    std::vector<directory_entry_t> old_table;
+    std::vector<uint64_t> old_sharers;
+    old_table.swap(table_);
+    old_sharers.swap(sharers_);
+    table_bits_ = bits;
+    table_.assign(static_cast<size_t>(1) << bits, directory_entry_t());
+    sharers_.assign(table_.size() * words_per_entry_, 0);
+    for (size_t i = 0; i < old_table.size(); ++i) {
+        if (old_table[i].tag == TAG_INVALID)
+            continue;
+        size_t slot = find_slot(old_table[i].tag);
+        table_[slot] = old_table[i];
+        std::copy(old_sharers.begin() + i * words_per_entry_,
+                  old_sharers.begin() + (i + 1) * words_per_entry_, get_sharers(slot));
+    }
+}
+
+size_t
+snoop_filter_t::find_slot(addr_t tag) const
+{
+    size_t mask = table_.size() - 1;
+    size_t slot = hash_slot(tag);
+    while (table_[slot].tag != tag && table_[slot].tag != TAG_INVALID)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+size_t
+snoop_filter_t::find_or_add_slot(addr_t tag)
+{
+    size_t slot = find_slot(tag);
+    if (table_[slot].tag == tag)
+        return slot;
+    if (max_entries_ > 0 && num_entries_ >= max_entries_) {
+        evict_entry(tag);
+        slot = find_slot(tag);
+    } else if (2 * (num_entries_ + 1) > table_.size()) {
+        resize_table(table_bits_ + 1);
+        slot = find_slot(tag);
+    }
+    table_[slot].tag = tag;
+    ++num_entries_;
+    return slot;
+}
+
+// Uses backward-shift deletion so that lookups never need tombstones.
+void
+snoop_filter_t::erase_slot(size_t slot)
+{
+    size_t mask = table_.size() - 1;
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask;
+    while (table_[next].tag != TAG_INVALID) {
+        size_t home = hash_slot(table_[next].tag);
+        // Move the entry into the hole unless its home lies cyclically in
+        // (hole, next], in which case it is already reachable.
+        bool reachable = hole <= next ? (home > hole && home <= next)
+                                      : (home > hole || home <= next);
+        if (!reachable) {
+            table_[hole] = table_[next];
+            std::copy(get_sharers(next), get_sharers(next) + words_per_entry_,
+                      get_sharers(hole));
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    table_[hole] = directory_entry_t();
+    std::fill(get_sharers(hole), get_sharers(hole) + words_per_entry_, 0);
+    --num_entries_;
+}
+
+// Makes room in a full sparse directory.  The victim is the first entry at or
+// after new_tag's home slot, which is pseudo-random and cheap to find.
+void
+snoop_filter_t::evict_entry(addr_t new_tag)
+{
+    size_t mask = table_.size() - 1;
+    size_t slot = hash_slot(new_tag);
+    while (table_[slot].tag == TAG_INVALID)
+        slot = (slot + 1) & mask;
+    directory_entry_t &victim = table_[slot];
+    uint64_t *sharers = get_sharers(slot);
+    for (size_t word = 0; word < words_per_entry_; ++word) {
+        for (uint64_t bits = sharers[word]; bits != 0; bits &= bits - 1) {
+            int id = static_cast<int>(word * 64) + lowest_set_bit(bits);
+            // The directory is inclusive of the snooped caches so losing the
+            // entry back-invalidates the line.
+            caches_[id]->invalidate(victim.tag, INVALIDATION_INCLUSIVE);
+        }
+    }
+    if (victim.dirty)
+        num_writebacks_++;
+    num_directory_evictions_++;
+    erase_slot(slot);
+}
+
 /*  This function should be called for all misses in snooped caches_ as well as
  *  all writes to coherent caches_.
  */
 void
 snoop_filter_t::snoop(addr_t tag, int id, bool is_write)
 {
-    coherence_table_entry_t *coherence_entry = &coherence_table_[tag];
-
-    size_t num_sharers = coherence_entry->sharers.size();
-
     // Check that cache id is valid.
     assert(id >= 0 && id < num_snooped_caches_);
     // Check that tag is valid.
     assert(tag != TAG_INVALID);
+
+    size_t slot = find_or_add_slot(tag);
+    directory_entry_t *coherence_entry = &table_[slot];
+    uint64_t *sharers = get_sharers(slot);
+    bool already_sharer = is_sharer(slot, id);
+
     // Check that any dirty line is only held in one snooped cache.
-    assert(!coherence_entry->dirty || num_sharers == 1);
+    assert(!coherence_entry->dirty || coherence_entry->num_sharers == 1);
 
     // Check if this request causes a writeback.
-    if (coherence_entry->sharers.find(id) == coherence_entry->sharers.end() &&
-        coherence_entry->dirty) {
+    if (!already_sharer && coherence_entry->dirty) {
         num_writebacks_++;
         coherence_entry->dirty = false;
     }
@@ -94,48 +233,129 @@ snoop_filter_t::snoop(addr_t tag, int id, bool is_write)
     if (is_write) {
         num_writes_++;
         coherence_entry->dirty = true;
-        if (num_sharers > 0) {
+        if (coherence_entry->num_sharers > (already_sharer ? 1 : 0)) {
             // Writes will invalidate other caches_.
-            auto it = coherence_entry->sharers.begin();
-            while (it != coherence_entry->sharers.end()) {
-                int i = *it++;
-                if (i == id)
-                    continue;
-                caches_[i]->invalidate(tag, INVALIDATION_COHERENCE);
-                num_invalidates_++;
-                coherence_entry->sharers.erase(i);
+            for (size_t word = 0; word < words_per_entry_; ++word) {
+                uint64_t bits = sharers[word];
+                if (word == static_cast<size_t>(id / 64))
+                    bits &= ~(1ULL << (id % 64));
+                for (; bits != 0; bits &= bits - 1) {
+                    int i = static_cast<int>(word * 64) + lowest_set_bit(bits);
+                    caches_[i]->invalidate(tag, INVALIDATION_COHERENCE);
+                    num_invalidates_++;
+                }
+                sharers[word] &= (word == static_cast<size_t>(id / 64))
+                    ? (1ULL << (id % 64))
+                    : 0;
             }
+            coherence_entry->num_sharers = already_sharer ? 1 : 0;
         }
     }
-    coherence_entry->sharers.insert(id);
+    if (!already_sharer) {
+        sharers[id / 64] |= 1ULL << (id % 64);
+        coherence_entry->num_sharers++;
+    }
 }
 
 /* This function is called whenever a coherent cache evicts a line. */
 void
 snoop_filter_t::snoop_eviction(addr_t tag, int id)
 {
-    coherence_table_entry_t *coherence_entry = &coherence_table_[tag];
-
-    // Check if sharer list is initialized.
-    assert(!coherence_entry->sharers.empty());
     // Check that cache id is valid.
     assert(id >= 0 && id < num_snooped_caches_);
     // Check that tag is valid.
     assert(tag != TAG_INVALID);
+
+    size_t slot = find_slot(tag);
+    if (max_entries_ > 0 && (table_[slot].tag != tag || !is_sharer(slot, id))) {
+        // A sparse directory may already have dropped this line and
+        // back-invalidated it: but a non-inclusive snooped cache's children can
+        // still hold it and later propagate its eviction here.
+        return;
+    }
+    directory_entry_t *coherence_entry = &table_[slot];
+
+    // Check if sharer list is initialized.
+    assert(coherence_entry->tag == tag && coherence_entry->num_sharers > 0);
     // Check that we currently have this cache marked as a sharer.
-    assert(coherence_entry->sharers.find(id) != coherence_entry->sharers.end());
+    assert(is_sharer(slot, id));
 
     if (coherence_entry->dirty) {
         num_writebacks_++;
         coherence_entry->dirty = false;
     }
 
-    coherence_entry->sharers.erase(id);
-    if (coherence_entry->sharers.empty()) {
-        coherence_table_.erase(tag);
+    get_sharers(slot)[id / 64] &= ~(1ULL << (id % 64));
+    coherence_entry->num_sharers--;
+    if (coherence_entry->num_sharers == 0) {
+        erase_slot(slot);
     }
 }
 
+bool
+snoop_filter_t::save_state(std::ostream &out) const
+{
+    // Only occupied slots are written; restore_state() rehashes them.
+    if (!checkpoint_write(out, static_cast<int64_t>(num_snooped_caches_)) ||
+        !checkpoint_write(out, max_entries_) || !checkpoint_write(out, num_entries_))
+        return false;
+    for (size_t slot = 0; slot < table_.size(); ++slot) {
+        const directory_entry_t &entry = table_[slot];
+        if (entry.tag == TAG_INVALID)
+            continue;
+        if (!checkpoint_write(out, entry.tag) ||
+            !checkpoint_write(out, static_cast<int64_t>(entry.num_sharers)) ||
+            !checkpoint_write(out, static_cast<uint8_t>(entry.dirty)))
+            return false;
+        for (size_t word = 0; word < words_per_entry_; ++word) {
+            if (!checkpoint_write(out, sharers_[slot * words_per_entry_ + word]))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool
+snoop_filter_t::restore_state(std::istream &in)
+{
+    int64_t num_snooped_caches;
+    uint64_t max_entries, num_entries;
+    if (!checkpoint_read(in, num_snooped_caches) || !checkpoint_read(in, max_entries) ||
+        !checkpoint_read(in, num_entries))
+        return false;
+    if (num_snooped_caches != num_snooped_caches_ || max_entries != max_entries_ ||
+        (max_entries_ > 0 && num_entries > max_entries_))
+        return false;
+    // Start from an empty table large enough to hold every entry at our usual
+    // load factor.
+    int bits = table_bits_;
+    while ((1ULL << bits) < 2 * num_entries)
+        ++bits;
+    table_.clear();
+    sharers_.clear();
+    resize_table(bits);
+    for (uint64_t i = 0; i < num_entries; ++i) {
+        addr_t tag;
+        int64_t num_sharers;
+        uint8_t dirty;
+        if (!checkpoint_read(in, tag) || !checkpoint_read(in, num_sharers) ||
+            !checkpoint_read(in, dirty) || tag == TAG_INVALID)
+            return false;
+        size_t slot = find_slot(tag);
+        if (table_[slot].tag == tag)
+            return false; // Duplicate.
+        table_[slot].tag = tag;
+        table_[slot].num_sharers = static_cast<int>(num_sharers);
+        table_[slot].dirty = dirty != 0;
+        for (size_t word = 0; word < words_per_entry_; ++word) {
+            if (!checkpoint_read(in, get_sharers(slot)[word]))
+                return false;
+        }
+    }
+    num_entries_ = num_entries;
+    return true;
+}
+
 void
 snoop_filter_t::print_stats(void)
 {
@@ -148,6 +368,11 @@ snoop_filter_t::print_stats(void)
               << std::right << num_invalidates_ << std::endl;
     std::cerr << prefix << std::setw(18) << std::left << "Writebacks:" << std::setw(20)
               << std::right << num_writebacks_ << std::endl;
+    if (max_entries_ > 0) {
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Directory evicts:" << std::setw(20) << std::right
+                  << num_directory_evictions_ << std::endl;
+    }
     std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
 }
 
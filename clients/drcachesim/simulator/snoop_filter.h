@@ -33,37 +33,45 @@
 #ifndef _SNOOP_FILTER_H_
 #define _SNOOP_FILTER_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
-#include <unordered_map>
-#include <unordered_set>
+#include <istream>
+#include <ostream>
 #include <vector>
 
 #include "cache.h"
+#include "caching_device_block.h"
 #include "trace_entry.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
-struct coherence_table_entry_t {
-    std::unordered_set<int> sharers; // IDs of caches sharing this line.
-    bool dirty = false;
-};
-
 class snoop_filter_t {
 public:
     snoop_filter_t(void);
     virtual ~snoop_filter_t()
     {
     }
+    // If max_entries is 0, the filter is perfect and tracks every line held in a
+    // snooped cache.  Otherwise it models a sparse directory with that many
+    // entries: tracking a new line when full evicts an existing entry and
+    // invalidates that line in all of its sharers.
     virtual bool
-    init(cache_t **caches, int num_snooped_caches);
+    init(cache_t **caches, int num_snooped_caches, uint64_t max_entries = 0);
     virtual void
     snoop(addr_t tag, int id, bool is_write);
     virtual void
     snoop_eviction(addr_t tag, int id);
     void
     print_stats(void);
+    // Writes the tracked lines and their sharers to a simulator checkpoint.
+    // The event counters are statistics and are not included.
+    virtual bool
+    save_state(std::ostream &out) const;
+    // Restores state written by save_state() for the same snooped caches.
+    virtual bool
+    restore_state(std::istream &in);
     int64_t
     get_num_snooped_caches(void)
     {
@@ -84,15 +92,64 @@ public:
     {
         return num_invalidates_;
     }
+    int64_t
+    get_num_directory_evictions(void)
+    {
+        return num_directory_evictions_;
+    }
 
 protected:
-    // XXX: This initial coherence implementation uses a perfect snoop filter.
-    std::unordered_map<addr_t, coherence_table_entry_t> coherence_table_;
+    struct directory_entry_t {
+        addr_t tag = TAG_INVALID;
+        int num_sharers = 0;
+        bool dirty = false;
+    };
+
+    size_t
+    hash_slot(addr_t tag) const
+    {
+        // Fibonacci hashing spreads the sequential tags of a working set.
+        return static_cast<size_t>((static_cast<uint64_t>(tag) * 0x9e3779b97f4a7c15ULL) >>
+                                   (64 - table_bits_));
+    }
+    // Returns the slot holding tag, or the empty slot where it belongs.
+    size_t
+    find_slot(addr_t tag) const;
+    // Returns the slot for tag, adding an entry (and making room) if needed.
+    size_t
+    find_or_add_slot(addr_t tag);
+    void
+    erase_slot(size_t slot);
+    void
+    evict_entry(addr_t new_tag);
+    void
+    resize_table(int bits);
+    uint64_t *
+    get_sharers(size_t slot)
+    {
+        return &sharers_[slot * words_per_entry_];
+    }
+    bool
+    is_sharer(size_t slot, int id)
+    {
+        return (get_sharers(slot)[id / 64] & (1ULL << (id % 64))) != 0;
+    }
+
+    // The directory is an open-addressed table with linear probing, holding one
+    // bit per snooped cache for each tracked line.  Sharer bits are kept in a
+    // separate flat array with words_per_entry_ words per slot.
+    std::vector<directory_entry_t> table_;
+    std::vector<uint64_t> sharers_;
+    size_t words_per_entry_ = 1;
+    int table_bits_ = 0;
+    uint64_t num_entries_ = 0;
+    uint64_t max_entries_ = 0;
     cache_t **caches_;
     int num_snooped_caches_;
     int64_t num_writes_;
     int64_t num_writebacks_;
     int64_t num_invalidates_;
+    int64_t num_directory_evictions_ = 0;
 };
 
 } // namespace drmemtrace
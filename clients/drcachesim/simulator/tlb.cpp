@@ -35,8 +35,12 @@
 #include <assert.h>
 #include <stddef.h>
 
+#include <istream>
+#include <ostream>
+
 #include "caching_device.h"
 #include "caching_device_block.h"
+#include "checkpoint_io.h"
 #include "memref.h"
 #include "options.h"
 #include "tlb_entry.h"
@@ -58,6 +62,20 @@ tlb_t::tlb_t(const std::string &name)
 {
 }
 
+bool
+tlb_t::save_block_state(const caching_device_block_t &block, std::ostream &out) const
+{
+    return caching_device_t::save_block_state(block, out) &&
+        checkpoint_write(out, static_cast<const tlb_entry_t &>(block).pid_);
+}
+
+bool
+tlb_t::restore_block_state(caching_device_block_t &block, std::istream &in)
+{
+    return caching_device_t::restore_block_state(block, in) &&
+        checkpoint_read(in, static_cast<tlb_entry_t &>(block).pid_);
+}
+
 void
 tlb_t::request(const memref_t &memref_in)
 {
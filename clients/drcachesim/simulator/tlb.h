@@ -61,6 +61,11 @@ public:
 protected:
     void
     init_blocks() override;
+    bool
+    save_block_state(const caching_device_block_t &block,
+                     std::ostream &out) const override;
+    bool
+    restore_block_state(caching_device_block_t &block, std::istream &in) override;
     // Optimization: remember last pid in addition to last tag
     memref_pid_t last_pid_;
 };
@@ -94,6 +94,12 @@ tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
         dtlbs_[i] = NULL;
         lltlbs_[i] = NULL;
     }
+    error_string_ = init_checkpoints(knobs_.checkpoint_in, knobs_.checkpoint_out,
+                                     knobs_.checkpoint_instrs);
+    if (!error_string_.empty()) {
+        success_ = false;
+        return;
+    }
     for (unsigned int i = 0; i < knobs_.num_cores; i++) {
         std::string core_str = std::to_string(i);
         itlbs_[i] = new tlb_t("itlb " + core_str);
@@ -295,5 +301,29 @@ tlb_simulator_t::print_results()
     return true;
 }
 
+std::vector<caching_device_t *>
+tlb_simulator_t::get_checkpoint_devices() const
+{
+    std::vector<caching_device_t *> devices;
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        devices.push_back(itlbs_[i]);
+        devices.push_back(dtlbs_[i]);
+        devices.push_back(lltlbs_[i]);
+    }
+    return devices;
+}
+
+std::string
+tlb_simulator_t::save_state(std::ostream &out)
+{
+    return save_devices(out, get_checkpoint_devices());
+}
+
+std::string
+tlb_simulator_t::restore_state(std::istream &in)
+{
+    return restore_devices(in, get_checkpoint_devices());
+}
+
 } // namespace drmemtrace
 } // namespace dynamorio
@@ -36,8 +36,11 @@
 #ifndef _TLB_SIMULATOR_H_
 #define _TLB_SIMULATOR_H_
 
+#include <istream>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "cache_replacement_policy.h"
 #include "memref.h"
@@ -61,6 +64,13 @@ public:
     create_v2p_from_file(std::istream &v2p_file) override;
 
 protected:
+    std::string
+    save_state(std::ostream &out) override;
+    std::string
+    restore_state(std::istream &in) override;
+    std::vector<caching_device_t *>
+    get_checkpoint_devices() const;
+
     tlb_simulator_knobs_t knobs_;
 
     // Each CPU core contains a L1 ITLB, L1 DTLB and L2 TLB.
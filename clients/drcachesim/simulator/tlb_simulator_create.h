@@ -68,6 +68,9 @@ struct tlb_simulator_knobs_t {
         , sim_refs(1ULL << 63)
         , cpu_scheduling(false)
         , use_physical(false)
+        , checkpoint_in("")
+        , checkpoint_out("")
+        , checkpoint_instrs("")
         , v2p_file("")
         , verbose(0)
     {
@@ -87,6 +90,9 @@ struct tlb_simulator_knobs_t {
     uint64_t sim_refs;
     bool cpu_scheduling;
     bool use_physical;
+    std::string checkpoint_in;
+    std::string checkpoint_out;
+    std::string checkpoint_instrs;
     std::string v2p_file;
     unsigned int verbose;
 };
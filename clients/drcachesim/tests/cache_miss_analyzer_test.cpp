@@ -209,10 +209,96 @@ two_dominant_strides()
     }
 }
 
+// Exposes dump_miss() so tests can feed LLC misses without a cache simulator.
+class test_miss_stats_t : public cache_miss_stats_t {
+public:
+    test_miss_stats_t(unsigned int max_tracked_pcs)
+        : cache_miss_stats_t(false, 64, 1000, 0.01, 0.75, max_tracked_pcs)
+    {
+    }
+    using cache_miss_stats_t::dump_miss;
+};
+
+// A test with many cold loads and a tracked-load limit.
+bool
+bounded_tracked_pcs()
+{
+    const int kStride = 9;
+    const unsigned int kLineSize = 64;
+    const unsigned int kMaxPcs = 64;
+
+    test_miss_stats_t stats(kMaxPcs);
+    addr_t addr = 0x1000;
+    for (int i = 0; i < 20000; ++i) {
+        stats.dump_miss(generate_mem_ref(addr, 0xAAAA));
+        addr += (kLineSize * kStride);
+        // A different cold load each time.
+        stats.dump_miss(generate_mem_ref(0x900000 + kLineSize * i, 0x10000 + i));
+        if (stats.get_tracked_pcs() > kMaxPcs) {
+            std::cerr << "bounded_tracked_pcs test failed: tracking "
+                      << stats.get_tracked_pcs() << " loads." << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<prefetching_recommendation_t *> recommendations =
+        stats.generate_recommendations();
+    if (recommendations.size() == 1 && recommendations[0]->pc == 0xAAAA &&
+        recommendations[0]->stride == (kStride * kLineSize)) {
+        std::cout << "bounded_tracked_pcs test passed." << std::endl;
+        return true;
+    } else {
+        std::cerr << "bounded_tracked_pcs test failed: " << recommendations.size()
+                  << " recommendations." << std::endl;
+        return false;
+    }
+}
+
+// A test with a load that starts missing only after many others stopped,
+// under a tracked-load limit.
+bool
+late_starting_load()
+{
+    const int kStride = 7;
+    const unsigned int kLineSize = 64;
+    const unsigned int kMaxPcs = 64;
+    const int kOldPcs = 40;
+
+    test_miss_stats_t stats(kMaxPcs);
+    // Loads that miss early on and then go quiet, each with more misses than the
+    // late load gets between two prunes.
+    for (int i = 0; i < 100; ++i) {
+        for (int pc = 0; pc < kOldPcs; ++pc) {
+            stats.dump_miss(
+                generate_mem_ref(0x100000 * (pc + 1) + kLineSize * i, 0x2000 + pc));
+        }
+    }
+    addr_t addr = 0x80000000;
+    for (int i = 0; i < 20000; ++i) {
+        stats.dump_miss(generate_mem_ref(addr, 0xCCCC));
+        addr += (kLineSize * kStride);
+        // A different cold load each time.
+        stats.dump_miss(generate_mem_ref(0x900000 + kLineSize * i, 0x10000 + i));
+    }
+
+    std::vector<prefetching_recommendation_t *> recommendations =
+        stats.generate_recommendations();
+    if (recommendations.size() == 1 && recommendations[0]->pc == 0xCCCC &&
+        recommendations[0]->stride == (kStride * kLineSize)) {
+        std::cout << "late_starting_load test passed." << std::endl;
+        return true;
+    } else {
+        std::cerr << "late_starting_load test failed: " << recommendations.size()
+                  << " recommendations." << std::endl;
+        return false;
+    }
+}
+
 int
 test_main(int argc, const char *argv[])
 {
-    if (no_dominant_stride() && one_dominant_stride() && two_dominant_strides()) {
+    if (no_dominant_stride() && one_dominant_stride() && two_dominant_strides() &&
+        bounded_tracked_pcs() && late_starting_load()) {
         return 0;
     } else {
         std::cerr << "cache_miss_analyzer_test failed" << std::endl;
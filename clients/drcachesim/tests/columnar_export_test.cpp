@@ -0,0 +1,198 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Unit tests for the columnar_export tool and the columnar_file library. */
+
+#include <stdint.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dr_api.h"
+#include "../tools/columnar_export.h"
+#include "../tools/common/columnar_file.h"
+#include "memref_gen.h"
+#include "test_helpers.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+static constexpr memref_tid_t TID_A = 42;
+
+bool
+test_encoding_round_trip(const std::string &dir)
+{
+    // Use a small chunk size so values span several chunks, and a mix of
+    // constant runs, small deltas, and large jumps in both directions.
+    const std::string path = dir + DIRSEP + "round_trip.columnar";
+    std::vector<columnar_row_t> rows;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        columnar_row_t row;
+        row.values[COLUMNAR_PC] = 0x400000 + i * 3;
+        row.values[COLUMNAR_ADDR] = (i % 7 == 0) ? ~0ULL - i : 0x7fff0000 + (i % 13);
+        row.values[COLUMNAR_TYPE] = i % 2;
+        row.values[COLUMNAR_SIZE] = 4;
+        row.values[COLUMNAR_TID] = TID_A;
+        row.values[COLUMNAR_TIMESTAMP] = 100 + i / 100;
+        rows.push_back(row);
+    }
+    {
+        columnar_writer_t writer(path, /*rows_per_chunk=*/128);
+        for (const auto &row : rows)
+            writer.add_row(row);
+        CHECK(writer.close().empty(), "Failed to write columnar file");
+    }
+    columnar_reader_t reader;
+    CHECK(reader.open(path).empty(), "Failed to open columnar file");
+    size_t index = 0;
+    std::vector<uint64_t> values[COLUMNAR_COUNT];
+    while (reader.next_chunk()) {
+        for (int col = 0; col < COLUMNAR_COUNT; ++col) {
+            CHECK(reader.read_column(static_cast<columnar_column_t>(col), values[col]),
+                  "Failed to read column");
+            CHECK(values[col].size() == reader.get_chunk_rows(), "Wrong row count");
+        }
+        for (uint32_t i = 0; i < reader.get_chunk_rows(); ++i, ++index) {
+            for (int col = 0; col < COLUMNAR_COUNT; ++col) {
+                CHECK(values[col][i] == rows[index].values[col], "Value mismatch");
+                const columnar_column_stats_t &stats =
+                    reader.get_chunk_stats(static_cast<columnar_column_t>(col));
+                CHECK(values[col][i] >= stats.min && values[col][i] <= stats.max,
+                      "Value outside chunk stats");
+            }
+        }
+    }
+    CHECK(reader.get_error().empty(), "Unexpected read error");
+    CHECK(index == rows.size(), "Missing rows");
+    std::cerr << "test_encoding_round_trip passed\n";
+    return true;
+}
+
+bool
+test_select()
+{
+    const std::vector<uint64_t> values = { 0, 5, 10, 15, ~0ULL };
+    std::vector<unsigned char> mask(values.size());
+    columnar_select_range(values.data(), values.size(), 5, 10, mask.data());
+    CHECK((mask == std::vector<unsigned char> { 0, 1, 1, 0, 0 }), "Wrong range mask");
+    columnar_and_range(values.data(), values.size(), 10, ~0ULL, mask.data());
+    CHECK((mask == std::vector<unsigned char> { 0, 0, 1, 0, 0 }), "Wrong and mask");
+    std::cerr << "test_select passed\n";
+    return true;
+}
+
+bool
+test_export_and_query(const std::string &dir)
+{
+    static constexpr addr_t PC_LOAD = 0x1000;
+    static constexpr addr_t PC_OTHER = 0x1004;
+    std::vector<memref_t> memrefs = {
+        gen_marker(TID_A, TRACE_MARKER_TYPE_TIMESTAMP, 10),
+        gen_instr(TID_A, PC_LOAD, 4),
+        gen_data(TID_A, /*load=*/true, 0x8000, 8),
+        gen_instr(TID_A, PC_OTHER, 4),
+        gen_marker(TID_A, TRACE_MARKER_TYPE_TIMESTAMP, 20),
+        gen_instr(TID_A, PC_LOAD, 4),
+        gen_data(TID_A, /*load=*/true, 0x8008, 8),
+        gen_instr(TID_A, PC_OTHER, 4),
+        gen_data(TID_A, /*load=*/false, 0x9000, 8),
+        gen_marker(TID_A, TRACE_MARKER_TYPE_TIMESTAMP, 30),
+        gen_instr(TID_A, PC_LOAD, 4),
+        gen_data(TID_A, /*load=*/true, 0x8010, 8),
+        gen_exit(TID_A),
+    };
+    // Data records carry the pc of their instruction.
+    for (size_t i = 1; i < memrefs.size(); ++i) {
+        if (type_is_data(memrefs[i].data.type))
+            memrefs[i].data.pc = memrefs[i - 1].instr.addr;
+    }
+    columnar_export_t tool(dir, /*rows_per_chunk=*/4, /*verbose=*/0);
+    CHECK(!!tool, "Failed to create tool");
+    default_memtrace_stream_t stream;
+    void *shard = tool.parallel_shard_init_stream(0, nullptr, &stream);
+    for (const auto &memref : memrefs)
+        CHECK(tool.parallel_shard_memref(shard, memref), "Failed to export memref");
+    CHECK(tool.parallel_shard_exit(shard), "Failed to close export");
+    const std::string path = tool.get_output_path(0);
+
+    uint64_t count;
+    CHECK(columnar_count(path, {}, count).empty() && count == 9, "Wrong row count");
+    CHECK(columnar_count(path,
+                         { { COLUMNAR_TYPE, TRACE_TYPE_READ, TRACE_TYPE_READ } }, count)
+                  .empty() &&
+              count == 3,
+          "Wrong load count");
+    // Loads by pc from timestamp 20 onward.
+    std::unordered_map<uint64_t, uint64_t> counts;
+    CHECK(columnar_count_by(path, COLUMNAR_PC,
+                            { { COLUMNAR_TYPE, TRACE_TYPE_READ, TRACE_TYPE_READ },
+                              { COLUMNAR_TIMESTAMP, 20, ~0ULL } },
+                            counts)
+              .empty(),
+          "Failed to aggregate");
+    CHECK(counts.size() == 1 && counts[PC_LOAD] == 2, "Wrong per-pc load counts");
+    // A predicate outside every chunk's range matches nothing.
+    CHECK(columnar_count(path, { { COLUMNAR_TIMESTAMP, 1000, 2000 } }, count).empty() &&
+              count == 0,
+          "Expected no rows in an empty time window");
+    std::cerr << "test_export_and_query passed\n";
+    return true;
+}
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <tmp_output_dir>\n";
+        return 1;
+    }
+    const std::string dir = argv[1];
+    if (!test_encoding_round_trip(dir) || !test_select() ||
+        !test_export_and_query(dir))
+        return 1;
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -336,6 +336,132 @@ check_decode_caching(void *drcontext, bool use_module_mapper, bool include_decod
     return "";
 }
 
+std::string
+check_shared_decode_cache(void *drcontext)
+{
+    static constexpr addr_t BASE_ADDR = 0x123450;
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *ret = XINST_CREATE_return(drcontext);
+    instr_t *interrupt = XINST_CREATE_interrupt(drcontext, OPND_CREATE_INT8(10));
+    instr_t *jump = XINST_CREATE_jump(drcontext, opnd_create_instr(nop));
+    instrlist_t *ilist = instrlist_create(drcontext);
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, ret);
+    instrlist_append(ilist, interrupt);
+    instrlist_append(ilist, jump);
+    std::vector<memref_with_IR_t> memref_setup = {
+        { gen_instr(TID_A), nop },
+        { gen_instr(TID_A), ret },
+        { gen_instr(TID_A), interrupt },
+        { gen_instr(TID_A), jump },
+    };
+    std::vector<memref_t> memrefs =
+        add_encodings_to_memrefs(ilist, memref_setup, BASE_ADDR);
+    test_decode_info_t::expect_decoded_instr_ = true;
+
+    shared_decode_cache_t shared_cache;
+    decode_cache_base_t::set_shared_cache(&shared_cache);
+    {
+        // Two users of the same DecodeInfo type, e.g., two shards of one tool.
+        decode_cache_t<test_decode_info_t> cache_a(drcontext,
+                                                   /*include_decoded_instr=*/true,
+                                                   /*persist_decoded_instr=*/false);
+        decode_cache_t<test_decode_info_t> cache_b(drcontext,
+                                                   /*include_decoded_instr=*/true,
+                                                   /*persist_decoded_instr=*/false);
+        // A user that must not share.
+        decode_cache_t<instr_decode_info_t> cache_persist(drcontext,
+                                                          /*include_decoded_instr=*/true,
+                                                          /*persist_decoded_instr=*/true);
+        std::string err = cache_a.init(ENCODING_FILE_TYPE);
+        if (err.empty())
+            err = cache_b.init(ENCODING_FILE_TYPE);
+        if (err.empty())
+            err = cache_persist.init(ENCODING_FILE_TYPE);
+        if (!err.empty())
+            return err;
+
+        // Test: a decode by one user is visible to the other.
+        test_decode_info_t *info_a, *info_b;
+        err = cache_a.add_decode_info(memrefs[0].instr, info_a);
+        if (!err.empty())
+            return err;
+        err = cache_b.add_decode_info(memrefs[0].instr, info_b);
+        if (!err.empty())
+            return err;
+        if (info_a == nullptr || info_a != info_b || !info_b->is_nop_ ||
+            cache_b.get_decode_info(reinterpret_cast<app_pc>(memrefs[0].instr.addr)) !=
+                info_a)
+            return "Expected shared test_decode_info_t for nop";
+        if (shared_cache.size() != 1)
+            return "Expected a single shared entry";
+
+        // Test: errors are shared too.
+        err = cache_a.add_decode_info(memrefs[3].instr, info_a);
+        if (err != FAKE_ERROR)
+            return "Expected error for jump";
+        err = cache_b.add_decode_info(memrefs[3].instr, info_b);
+        if (err != FAKE_ERROR || info_a != info_b || info_b->is_valid())
+            return "Expected shared error decode info for jump";
+
+        // Test: a new encoding at a known pc gets its own entry, while the
+        // prior entry remains intact for users that have not yet seen the change.
+        test_decode_info_t *info_ret;
+        err = cache_a.add_decode_info(memrefs[1].instr, info_ret);
+        if (!err.empty())
+            return err;
+        memrefs[2].instr.addr = memrefs[1].instr.addr;
+        memrefs[2].instr.encoding_is_new = true;
+        err = cache_b.add_decode_info(memrefs[2].instr, info_b);
+        if (!err.empty())
+            return err;
+        if (info_b == info_ret || !info_b->is_interrupt_ || !info_ret->is_ret_)
+            return "Expected a new shared entry for the changed encoding";
+        if (cache_a.get_decode_info(reinterpret_cast<app_pc>(memrefs[1].instr.addr)) !=
+            info_ret)
+            return "Expected the old encoding to remain visible to its user";
+
+        // Test: a persisting user keeps its own instr_t.
+        instr_decode_info_t *persist_info;
+        err = cache_persist.add_decode_info(memrefs[0].instr, persist_info);
+        if (!err.empty())
+            return err;
+        if (persist_info == nullptr || !instr_is_nop(persist_info->get_decoded_instr()))
+            return "Unexpected instr_decode_info_t for nop";
+        if (shared_cache.size() != 4)
+            return "Did not expect the persisting user to add shared entries";
+
+        // Test: clearing one user's view does not affect the other.
+        cache_a.clear_cache();
+        if (cache_a.get_decode_info(reinterpret_cast<app_pc>(memrefs[0].instr.addr)) !=
+                nullptr ||
+            cache_b.get_decode_info(reinterpret_cast<app_pc>(memrefs[0].instr.addr)) ==
+                nullptr)
+            return "Unexpected result after clear_cache()";
+        if (shared_cache.size() != 4)
+            return "Shared entries freed while still in use";
+
+        // Test: the shared entries are freed once the last user clears.
+        cache_b.clear_cache();
+        if (shared_cache.size() != 0)
+            return "Shared entries not freed after the last clear_cache()";
+
+        // Test: a cleared user can still be used, and repopulates the cache.
+        err = cache_a.add_decode_info(memrefs[0].instr, info_a);
+        if (!err.empty())
+            return err;
+        if (info_a == nullptr || !info_a->is_nop_ || shared_cache.size() != 1)
+            return "Unexpected result after reusing a cleared cache";
+    }
+    // Test: destroying the users also frees the shared entries.
+    if (shared_cache.size() != 0)
+        return "Shared entries not freed after the last user was destroyed";
+    decode_cache_base_t::set_shared_cache(nullptr);
+    instrlist_clear_and_destroy(drcontext, ilist);
+    std::cerr << "check_shared_decode_cache passed\n";
+    return "";
+}
+
 std::string
 check_init_error_cases(void *drcontext)
 {
@@ -491,6 +617,11 @@ test_main(int argc, const char *argv[])
         exit(1);
     }
 #endif
+    err = check_shared_decode_cache(drcontext);
+    if (!err.empty()) {
+        std::cerr << err << "\n";
+        exit(1);
+    }
     err = check_init_error_cases(drcontext);
     if (!err.empty()) {
         std::cerr << err << "\n";
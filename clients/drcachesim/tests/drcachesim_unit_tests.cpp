@@ -33,9 +33,11 @@
 // Unit tests for drcachesim
 
 #include <iostream>
+#include <cstdio>
 #include <cstdlib>
 #include <random>
 #include <regex>
+#include <sstream>
 
 #include <assert.h>
 #include "config_reader_unit_test.h"
@@ -44,9 +46,12 @@
 #include "cache_replacement_policy_unit_test.h"
 #include "simulator/cache.h"
 #include "simulator/cache_simulator.h"
+#include "simulator/cache_sweep.h"
+#include "simulator/policy_fifo.h"
 #include "simulator/policy_lfu.h"
 #include "simulator/policy_lru.h"
 #include "simulator/prefetcher.h"
+#include "simulator/snoop_filter.h"
 #include "../common/memref.h"
 #include "../common/utils.h"
 #include "test_helpers.h"
@@ -965,6 +970,84 @@ LLC {
     TEST_EQ(new_llc_hits - llc_hits, (NUM_LOOPS - 1) * MORE_CONFLICTING_ADDRESSES);
 }
 
+// Tests the snoop filter directory with more than 64 sharers, which needs more
+// than one word of sharer bits per line, and in sparse directory mode.
+void
+unit_test_snoop_filter()
+{
+    static constexpr int LINE_SIZE = 64;
+    static constexpr int ASSOC = 4;
+    static constexpr int CACHE_SIZE = LINE_SIZE * ASSOC;
+    static constexpr int NUM_CACHES = 70;
+    static constexpr addr_t ADDR_A = 0x10000;
+    static constexpr addr_t TAG_A = ADDR_A / LINE_SIZE;
+
+    auto make_caches = [&](int count, snoop_filter_t *filter, uint64_t max_entries,
+                           std::vector<std::unique_ptr<cache_t>> &caches,
+                           std::vector<std::unique_ptr<caching_device_stats_t>> &stats,
+                           std::vector<cache_t *> &raw) {
+        for (int i = 0; i < count; ++i) {
+            caches.emplace_back(new cache_t("L1D" + std::to_string(i)));
+            stats.emplace_back(new caching_device_stats_t("", LINE_SIZE));
+            bool initialized = caches.back()->init(
+                ASSOC, LINE_SIZE, CACHE_SIZE, /*parent=*/nullptr, stats.back().get(),
+                std::unique_ptr<policy_lru_t>(
+                    new policy_lru_t(CACHE_SIZE / LINE_SIZE, ASSOC)),
+                /*prefetcher=*/nullptr, cache_inclusion_policy_t::NON_INC_NON_EXC,
+                /*coherent_cache=*/true, i, filter);
+            assert(initialized);
+            raw.push_back(caches.back().get());
+        }
+        bool initialized = filter->init(raw.data(), count, max_entries);
+        assert(initialized);
+    };
+
+    {
+        snoop_filter_t filter;
+        std::vector<std::unique_ptr<cache_t>> caches;
+        std::vector<std::unique_ptr<caching_device_stats_t>> stats;
+        std::vector<cache_t *> raw;
+        make_caches(NUM_CACHES, &filter, /*max_entries=*/0, caches, stats, raw);
+        for (int i = 0; i < NUM_CACHES; ++i)
+            raw[i]->request(make_memref(ADDR_A));
+        // A write from the last cache invalidates every other copy.
+        raw[NUM_CACHES - 1]->request(make_memref(ADDR_A, TRACE_TYPE_WRITE));
+        TEST_EQ(filter.get_num_writes(), 1);
+        TEST_EQ(filter.get_num_invalidates(), NUM_CACHES - 1);
+        for (int i = 0; i < NUM_CACHES - 1; ++i)
+            TEST_EQ(raw[i]->contains_tag(TAG_A), false);
+        TEST_EQ(raw[NUM_CACHES - 1]->contains_tag(TAG_A), true);
+        // A read by another cache writes back the dirty line.
+        raw[0]->request(make_memref(ADDR_A));
+        TEST_EQ(filter.get_num_writebacks(), 1);
+        // Conflicting lines evict A from cache 0 and drop it as a sharer, so
+        // a write by the last cache has nobody left to invalidate.
+        for (int i = 1; i <= ASSOC; ++i)
+            raw[0]->request(make_memref(ADDR_A + i * CACHE_SIZE));
+        raw[NUM_CACHES - 1]->request(make_memref(ADDR_A, TRACE_TYPE_WRITE));
+        TEST_EQ(filter.get_num_invalidates(), NUM_CACHES - 1);
+        TEST_EQ(filter.get_num_directory_evictions(), 0);
+    }
+    {
+        // A 2-entry sparse directory must back-invalidate a line to track a third.
+        snoop_filter_t filter;
+        std::vector<std::unique_ptr<cache_t>> caches;
+        std::vector<std::unique_ptr<caching_device_stats_t>> stats;
+        std::vector<cache_t *> raw;
+        make_caches(2, &filter, /*max_entries=*/2, caches, stats, raw);
+        for (int i = 0; i < 3; ++i)
+            raw[i % 2]->request(make_memref(ADDR_A + i * LINE_SIZE));
+        TEST_EQ(filter.get_num_directory_evictions(), 1);
+        int held = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (raw[i % 2]->contains_tag(TAG_A + i))
+                ++held;
+        }
+        TEST_EQ(held, 2);
+        TEST_EQ(raw[0]->contains_tag(TAG_A + 2), true);
+    }
+}
+
 // Generate a sequence of read accesses to a cache in a 2-D access pattern.
 // Loop A is the outer loop, while loop B is the inner, fastest-changing
 // loop.  The whole 2D access pattern is repeated <loop_count> times.
@@ -1351,6 +1434,291 @@ Core #1 \(traced CPU\(s\): #567800\)
     }
 }
 
+// Runs a reference stream through one simulator, checkpointing it partway, and
+// checks that a second simulator restored from the checkpoint produces the same
+// post-checkpoint results as the first.
+// A subclass of a built-in policy, which caching_device_t must call through its
+// virtual methods rather than directly.
+class counting_lru_t : public policy_lru_t {
+public:
+    using policy_lru_t::policy_lru_t;
+    void
+    access_update(int set_idx, int way, cache_access_outcome_t access_type) override
+    {
+        ++accesses;
+        policy_lru_t::access_update(set_idx, way, access_type);
+    }
+    void
+    invalidation_update(int set_idx, int way) override
+    {
+        invalidations.emplace_back(set_idx, way);
+        policy_lru_t::invalidation_update(set_idx, way);
+    }
+    int accesses = 0;
+    std::vector<std::pair<int, int>> invalidations;
+};
+
+void
+unit_test_builtin_policy_subclass()
+{
+    static constexpr int LINE_SIZE = 64;
+    static constexpr int NUM_SETS = 4;
+    static constexpr int ASSOCIATIVITY = 4;
+    static constexpr int NUM_REFS = 10;
+    cache_t cache;
+    cache_stats_t stats(LINE_SIZE, /*miss_file=*/"", /*warmup_enabled=*/false,
+                        /*is_coherent=*/false);
+    counting_lru_t *policy = new counting_lru_t(NUM_SETS, ASSOCIATIVITY);
+    bool initialized =
+        cache.init(ASSOCIATIVITY, LINE_SIZE, NUM_SETS * ASSOCIATIVITY * LINE_SIZE,
+                   /*parent=*/nullptr, &stats, std::unique_ptr<counting_lru_t>(policy));
+    assert(initialized);
+    for (int i = 0; i < NUM_REFS; ++i)
+        cache.request(make_memref(0x1000 + i * LINE_SIZE));
+    TEST_EQ(policy->accesses, NUM_REFS);
+
+    // A flush tells the policy which set and way it invalidated.
+    memref_t flush = {};
+    flush.flush.type = TRACE_TYPE_DATA_FLUSH;
+    flush.flush.addr = 0x1000 + 6 * LINE_SIZE;
+    flush.flush.size = 1;
+    cache.flush(flush);
+    TEST_EQ(policy->invalidations.size(), 1U);
+    TEST_EQ(policy->invalidations[0].first, 6 % NUM_SETS);
+}
+
+static void
+check_checkpoint_roundtrip(const cache_simulator_knobs_t &knobs)
+{
+    static constexpr int NUM_REFS = 20000;
+    static constexpr int CHECKPOINT_AT = NUM_REFS / 2;
+    std::mt19937 gen(17);
+    std::geometric_distribution<int> line_dist(0.002);
+    std::vector<memref_t> refs;
+    for (int i = 0; i < NUM_REFS; ++i) {
+        memref_t ref = make_memref(0x10000 + line_dist(gen) * knobs.line_size,
+                                   i % 3 == 0 ? TRACE_TYPE_WRITE : TRACE_TYPE_READ);
+        ref.data.tid = MY_TID + i % knobs.num_cores;
+        refs.push_back(ref);
+    }
+    const std::vector<metric_name_t> metrics = { metric_name_t::HITS,
+                                                 metric_name_t::MISSES };
+
+    cache_simulator_t warm(knobs);
+    assert(!!warm);
+    std::stringstream checkpoint;
+    std::vector<int64_t> at_checkpoint;
+    for (int i = 0; i < NUM_REFS; ++i) {
+        if (i == CHECKPOINT_AT) {
+            TEST_EQ(warm.save_checkpoint(checkpoint), "");
+            for (metric_name_t metric : metrics) {
+                at_checkpoint.push_back(
+                    warm.get_cache_metric(metric, 1, 0, cache_split_t::DATA));
+                at_checkpoint.push_back(warm.get_cache_metric(metric, 2));
+            }
+        }
+        bool res = warm.process_memref(refs[i]);
+        assert(res);
+    }
+
+    cache_simulator_t restored(knobs);
+    assert(!!restored);
+    TEST_EQ(restored.restore_checkpoint(checkpoint), "");
+    for (int i = CHECKPOINT_AT; i < NUM_REFS; ++i) {
+        bool res = restored.process_memref(refs[i]);
+        assert(res);
+    }
+    int idx = 0;
+    for (metric_name_t metric : metrics) {
+        TEST_EQ(restored.get_cache_metric(metric, 1, 0, cache_split_t::DATA),
+                warm.get_cache_metric(metric, 1, 0, cache_split_t::DATA) -
+                    at_checkpoint[idx++]);
+        TEST_EQ(restored.get_cache_metric(metric, 2),
+                warm.get_cache_metric(metric, 2) - at_checkpoint[idx++]);
+    }
+    if (knobs.model_coherence) {
+        TEST_EQ(restored.get_num_snoop_writes() > 0, true);
+    }
+}
+
+void
+unit_test_checkpoint()
+{
+    for (const char *policy : { "LRU", "LFU", "FIFO", "BIT_PLRU", "RRIP" }) {
+        cache_simulator_knobs_t knobs = make_test_knobs();
+        knobs.num_cores = 2;
+        knobs.L1D_size = 64 * 64;
+        knobs.L1D_assoc = 4;
+        knobs.LL_size = 512 * 64;
+        knobs.LL_assoc = 8;
+        knobs.replace_policy = policy;
+        knobs.data_prefetcher = "nextline";
+        check_checkpoint_roundtrip(knobs);
+        knobs.model_coherence = true;
+        check_checkpoint_roundtrip(knobs);
+    }
+    {
+        // A checkpoint does not restore into a different hierarchy.
+        cache_simulator_knobs_t knobs = make_test_knobs();
+        cache_simulator_t small(knobs);
+        std::stringstream checkpoint;
+        TEST_EQ(small.save_checkpoint(checkpoint), "");
+        knobs.LL_size *= 2;
+        cache_simulator_t large(knobs);
+        std::string error = large.restore_checkpoint(checkpoint);
+        assert(!error.empty());
+        std::stringstream garbage("not a checkpoint");
+        error = large.restore_checkpoint(garbage);
+        assert(!error.empty());
+    }
+    {
+        // A FIFO queue that is not a permutation of its set's ways is rejected.
+        policy_fifo_t fifo(2, 4);
+        for (const std::vector<int> &queues :
+             { std::vector<int> { 0, 1, 2, 3, 3, 2, 1, 1 },
+               std::vector<int> { 0, 1, 2, 4, 3, 2, 1, 0 },
+               std::vector<int> { 0, 1, 2, -1, 3, 2, 1, 0 } }) {
+            std::stringstream state;
+            state.write(reinterpret_cast<const char *>(queues.data()),
+                        queues.size() * sizeof(int));
+            bool res = fifo.restore_state(state);
+            assert(!res);
+        }
+        std::stringstream state;
+        const std::vector<int> valid = { 3, 2, 1, 0, 1, 3, 0, 2 };
+        state.write(reinterpret_cast<const char *>(valid.data()),
+                    valid.size() * sizeof(int));
+        bool res = fifo.restore_state(state);
+        assert(res);
+        TEST_EQ(fifo.get_next_way_to_replace(0), 3);
+        TEST_EQ(fifo.get_next_way_to_replace(1), 1);
+    }
+    {
+        // Test writing and restoring checkpoint files at instruction ordinals.
+        const std::string prefix = "drcachesim_unit_tests_checkpoint";
+        cache_simulator_knobs_t knobs = make_test_knobs();
+        knobs.checkpoint_out = prefix;
+        knobs.checkpoint_instrs = "3,1";
+        cache_simulator_t sim(knobs);
+        assert(!!sim);
+        for (int i = 0; i < 5; ++i) {
+            memref_t instr = make_memref(0x1000 + i * 4, TRACE_TYPE_INSTR, 4);
+            bool res = sim.process_memref(instr);
+            assert(res);
+            memref_t data = make_memref(0x8000 + i * 64);
+            res = sim.process_memref(data);
+            assert(res);
+        }
+        knobs = make_test_knobs();
+        knobs.checkpoint_in = prefix + ".3";
+        cache_simulator_t restored(knobs);
+        assert(!!restored);
+        // The data line touched before the checkpoint hits; the one after misses.
+        bool res = restored.process_memref(make_memref(0x8000 + 2 * 64));
+        assert(res);
+        res = restored.process_memref(make_memref(0x8000 + 3 * 64));
+        assert(res);
+        TEST_EQ(restored.get_cache_metric(metric_name_t::HITS, 1, 0,
+                                          cache_split_t::DATA),
+                1);
+        TEST_EQ(std::remove((prefix + ".1").c_str()), 0);
+        TEST_EQ(std::remove((prefix + ".3").c_str()), 0);
+
+        knobs.checkpoint_in = prefix + ".missing";
+        cache_simulator_t missing(knobs);
+        res = missing.process_memref(make_memref(0x8000));
+        assert(!res);
+        assert(!missing.get_error_string().empty());
+
+        knobs = make_test_knobs();
+        knobs.checkpoint_instrs = "1,x";
+        knobs.checkpoint_out = prefix;
+        cache_simulator_t bad_list(knobs);
+        assert(!bad_list);
+    }
+}
+
+// Compares every geometry of a single-pass sweep against a separate cache_t
+// simulation of that geometry over the same references.
+static void
+check_cache_sweep_against_caches(const std::string &policy)
+{
+    static constexpr int LINE_SIZE = 64;
+    static constexpr int NUM_REFS = 20000;
+    cache_sweep_knobs_t knobs;
+    knobs.line_size = LINE_SIZE;
+    knobs.min_sets = 4;
+    knobs.max_sets = 32;
+    knobs.max_assoc = 8;
+    knobs.replace_policy = policy;
+    // Simulate every set so the non-LRU results are exact too.
+    knobs.sample_rate = 1;
+    cache_sweep_t sweep(knobs);
+    assert(!!sweep);
+
+    // A skewed distribution with some unaligned multi-line accesses gives a mix
+    // of stack distances.
+    std::mt19937 gen(42);
+    std::geometric_distribution<int> line_dist(0.01);
+    std::uniform_int_distribution<int> offset_dist(0, LINE_SIZE - 1);
+    std::vector<memref_t> refs;
+    for (int i = 0; i < NUM_REFS; ++i) {
+        addr_t addr = 0x10000 + line_dist(gen) * LINE_SIZE + offset_dist(gen);
+        refs.push_back(make_memref(addr, TRACE_TYPE_READ, 8));
+        bool processed = sweep.process_memref(refs.back());
+        assert(processed);
+    }
+
+    std::vector<cache_sweep_t::config_result_t> results = sweep.get_results();
+    int checked = 0;
+    for (const auto &res : results) {
+        cache_t cache;
+        caching_device_stats_t stats(/*miss_file=*/"", LINE_SIZE);
+        std::unique_ptr<cache_replacement_policy_t> replace;
+        if (policy == "FIFO") {
+            replace = std::unique_ptr<policy_fifo_t>(
+                new policy_fifo_t(res.num_sets, res.associativity));
+        } else {
+            replace = std::unique_ptr<policy_lru_t>(
+                new policy_lru_t(res.num_sets, res.associativity));
+        }
+        bool initialized =
+            cache.init(res.associativity, LINE_SIZE,
+                       res.num_sets * res.associativity * LINE_SIZE,
+                       /*parent=*/nullptr, &stats, std::move(replace));
+        assert(initialized);
+        for (const memref_t &ref : refs)
+            cache.request(ref);
+        cache_stats_snapshot_t c_stats = get_cache_stats(stats);
+        TEST_EQ(res.hits, static_cast<uint64_t>(c_stats.hits));
+        TEST_EQ(res.misses, static_cast<uint64_t>(c_stats.misses));
+        TEST_EQ(res.compulsory_misses,
+                static_cast<uint64_t>(
+                    stats.get_metric(metric_name_t::COMPULSORY_MISSES)));
+        ++checked;
+    }
+    // LRU reports every associativity; other policies only the powers of 2.
+    TEST_EQ(checked, policy == "LRU" ? 4 * 8 : 4 * 4);
+}
+
+void
+unit_test_cache_sweep()
+{
+    check_cache_sweep_against_caches("LRU");
+    check_cache_sweep_against_caches("FIFO");
+
+    // Bad geometries are rejected.
+    cache_sweep_knobs_t knobs;
+    knobs.min_sets = 48;
+    cache_sweep_t bad_sets(knobs);
+    assert(!bad_sets);
+    knobs = cache_sweep_knobs_t();
+    knobs.replace_policy = "FIFO";
+    knobs.sample_rate = 3;
+    cache_sweep_t bad_rate(knobs);
+    assert(!bad_rate);
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -1361,6 +1729,7 @@ test_main(int argc, const char *argv[])
     unit_test_exclusive_cache_policy();
     unit_test_exclusive_cache_policy_rand();
     unit_test_cache_accessors();
+    unit_test_builtin_policy_subclass();
     unit_test_get_type_name();
     unit_test_parse_value();
     unit_test_read_parameter_map();
@@ -1386,6 +1755,9 @@ test_main(int argc, const char *argv[])
     unit_test_nextline_prefetcher();
     unit_test_custom_prefetcher();
     unit_test_set_parent();
+    unit_test_snoop_filter();
+    unit_test_cache_sweep();
+    unit_test_checkpoint();
     return 0;
 }
 
@@ -0,0 +1,224 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for the fcache_sim tool. */
+
+#include <stdint.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../tools/fcache_sim.h"
+#include "memref_gen.h"
+#include "test_helpers.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+#define CHECK(cond, msg, ...)             \
+    do {                                  \
+        if (!(cond)) {                    \
+            fprintf(stderr, "%s\n", msg); \
+            return false;                 \
+        }                                 \
+    } while (0)
+
+static constexpr memref_tid_t TID_A = 42;
+
+static void
+run_tool(fcache_sim_t &tool, const std::vector<memref_t> &memrefs)
+{
+    for (const auto &memref : memrefs)
+        tool.process_memref(memref);
+}
+
+bool
+test_parse_configs()
+{
+    std::vector<fcache_sim_config_t> configs;
+    CHECK(fcache_sim_parse_configs("", configs).empty() && configs.size() == 1,
+          "Empty spec should give the defaults");
+    CHECK(configs[0].trace_threshold == 50, "Wrong default threshold");
+    CHECK(fcache_sim_parse_configs(
+              "trace_threshold=0:cache_bb_max=64K,bb_ibl_targets=true,ibl_table_load=70",
+              configs)
+              .empty(),
+          "Failed to parse valid spec");
+    CHECK(configs.size() == 2 && configs[0].trace_threshold == 0 &&
+              configs[1].trace_threshold == 50 && configs[1].cache_bb_max == 64 * 1024 &&
+              configs[1].bb_ibl_targets && configs[1].ibl_table_load == 70,
+          "Wrong parsed values");
+    CHECK(!fcache_sim_parse_configs("no_such_option=1", configs).empty(),
+          "Unknown names should fail");
+    CHECK(!fcache_sim_parse_configs("trace_threshold", configs).empty(),
+          "Missing values should fail");
+    CHECK(!fcache_sim_parse_configs("cache_bb_unit_init=8K,cache_bb_unit_max=4K", configs)
+               .empty(),
+          "Units larger than their maximum should fail");
+    std::cerr << "test_parse_configs passed\n";
+    return true;
+}
+
+bool
+test_loop_trace()
+{
+    // Block A ends in a conditional branch falling through to block B, which
+    // jumps back to A, making A a trace head.
+    std::vector<memref_t> memrefs;
+    constexpr int ITERS = 100;
+    for (int i = 0; i < ITERS; ++i) {
+        memrefs.push_back(gen_instr(TID_A, 0x1000, 4));
+        memrefs.push_back(gen_instr(TID_A, 0x1004, 4));
+        memrefs.push_back(
+            gen_instr_type(TRACE_TYPE_INSTR_UNTAKEN_JUMP, TID_A, 0x1008, 2));
+        memrefs.push_back(gen_instr(TID_A, 0x100a, 4));
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_DIRECT_JUMP, TID_A, 0x100e, 2));
+    }
+    memrefs.push_back(gen_exit(TID_A));
+    std::vector<fcache_sim_config_t> configs;
+    CHECK(fcache_sim_parse_configs("trace_threshold=10:trace_threshold=0", configs)
+              .empty(),
+          "Failed to parse");
+    fcache_sim_t tool(configs, 0);
+    run_tool(tool, memrefs);
+    fcache_sim_t::statistics_t traced = tool.get_statistics(0);
+    CHECK(traced.instrs == ITERS * 5, "Wrong instruction count");
+    CHECK(traced.bb_cache.fragments_built == 2, "Expected two blocks");
+    CHECK(traced.trace_cache.fragments_built == 1, "Expected one trace");
+    CHECK(traced.trace_head_entries == 10, "Expected threshold head entries");
+    // The first two iterations build the blocks, the head is counted 10 times,
+    // and the trace is recorded in iteration 11 and executed from 12 onward.
+    CHECK(traced.trace_instrs == (ITERS - 11) * 5, "Wrong trace coverage");
+    CHECK(traced.dispatch_entries == 12, "Wrong dispatcher entry count");
+    CHECK(traced.ibl_lookups == 0, "Unexpected lookups");
+    fcache_sim_t::statistics_t untraced = tool.get_statistics(1);
+    CHECK(untraced.trace_cache.fragments_built == 0 && untraced.trace_instrs == 0,
+          "Traces should be disabled");
+    CHECK(untraced.dispatch_entries == 2 && untraced.trace_head_entries == 0,
+          "Blocks should be linked after being built");
+    std::cerr << "test_loop_trace passed\n";
+    return true;
+}
+
+bool
+test_indirect_lookups()
+{
+    // Two call sites alternately call a function that returns, so each return
+    // is an indirect branch with one of two targets.
+    std::vector<memref_t> memrefs;
+    constexpr int ITERS = 50;
+    for (int i = 0; i < ITERS; ++i) {
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_DIRECT_CALL, TID_A, 0x1000, 5));
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_RETURN, TID_A, 0x2000, 1));
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_DIRECT_JUMP, TID_A, 0x1005, 2));
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_DIRECT_CALL, TID_A, 0x1100, 5));
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_RETURN, TID_A, 0x2000, 1));
+        memrefs.push_back(gen_instr_type(TRACE_TYPE_INSTR_DIRECT_JUMP, TID_A, 0x1105, 2));
+    }
+    memrefs.push_back(gen_exit(TID_A));
+    std::vector<fcache_sim_config_t> configs;
+    CHECK(fcache_sim_parse_configs("trace_threshold=0:trace_threshold=100000", configs)
+              .empty(),
+          "Failed to parse");
+    fcache_sim_t tool(configs, 0);
+    run_tool(tool, memrefs);
+    // Without traces, blocks are lookup targets and only the first return to
+    // each site misses.
+    fcache_sim_t::statistics_t bbs = tool.get_statistics(0);
+    CHECK(bbs.indirect_branches == 2 * ITERS && bbs.ibl_lookups == 2 * ITERS,
+          "Wrong lookup count");
+    CHECK(bbs.ibl_misses == 2, "Expected only cold misses");
+    // With traces enabled but never built, blocks are not lookup targets.
+    fcache_sim_t::statistics_t no_targets = tool.get_statistics(1);
+    CHECK(no_targets.ibl_misses == no_targets.ibl_lookups,
+          "Expected every lookup to miss");
+    std::cerr << "test_indirect_lookups passed\n";
+    return true;
+}
+
+bool
+test_eviction()
+{
+    // A straight line of blocks executed twice through a cache too small to
+    // hold them all.
+    std::vector<memref_t> memrefs;
+    constexpr int BLOCKS = 100;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < BLOCKS; ++i) {
+            addr_t pc = 0x10000 + i * 16;
+            memrefs.push_back(gen_instr(TID_A, pc, 8));
+            memrefs.push_back(
+                gen_instr_type(TRACE_TYPE_INSTR_DIRECT_JUMP, TID_A, pc + 8, 2));
+        }
+    }
+    memrefs.push_back(gen_exit(TID_A));
+    std::vector<fcache_sim_config_t> configs;
+    CHECK(fcache_sim_parse_configs("trace_threshold=0,cache_bb_max=1K:"
+                                   "trace_threshold=0",
+                                   configs)
+              .empty(),
+          "Failed to parse");
+    fcache_sim_t tool(configs, 0);
+    run_tool(tool, memrefs);
+    fcache_sim_t::statistics_t small = tool.get_statistics(0);
+    CHECK(small.bb_cache.fragments_built == 2 * BLOCKS, "Expected every block rebuilt");
+    CHECK(small.bb_cache.fragments_rebuilt == BLOCKS, "Wrong rebuild count");
+    CHECK(small.bb_cache.footprint_bytes == 1024 && small.bb_cache.units == 1,
+          "Footprint should be capped at the maximum");
+    CHECK(small.bb_cache.peak_used_bytes <= 1024, "Cache overfilled");
+    // Each block is 10 application bytes plus a 23-byte exit stub and a 9-byte
+    // lookup prefix, so 24 fit.
+    CHECK(small.bb_cache.used_bytes == 24 * 42 &&
+              small.bb_cache.evictions == 2 * BLOCKS - 24,
+          "Wrong eviction count");
+    fcache_sim_t::statistics_t large = tool.get_statistics(1);
+    CHECK(large.bb_cache.fragments_built == BLOCKS && large.bb_cache.evictions == 0,
+          "Unlimited cache should not evict");
+    CHECK(large.bb_cache.footprint_bytes == 56 * 1024,
+          "Expected one default-sized unit");
+    std::cerr << "test_eviction passed\n";
+    return true;
+}
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (!test_parse_configs() || !test_loop_trace() || !test_indirect_lookups() ||
+        !test_eviction())
+        return 1;
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
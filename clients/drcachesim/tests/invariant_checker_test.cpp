@@ -90,6 +90,7 @@ public:
             }
         }
         per_shard_t global;
+        check_cross_shard_invariants(&global);
         check_schedule_data(&global);
         return true;
     }
@@ -2696,6 +2697,98 @@ check_timestamps_increase_monotonically(void)
     return true;
 }
 
+bool
+check_cross_shard_invariants()
+{
+    std::cerr << "Testing cross-shard invariants\n";
+    // Correct: threads of one process agree.
+    {
+        std::vector<memref_t> memrefs = {
+            gen_marker(TID_A, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+            gen_marker(TID_A, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_instr(TID_A),
+            gen_exit(TID_A),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_instr(TID_B),
+            gen_exit(TID_B),
+        };
+        if (!run_checker(memrefs, false))
+            return false;
+    }
+    // Correct: threads of different processes may differ.
+    {
+        std::vector<memref_t> memrefs = {
+            gen_marker(TID_A, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+            gen_marker(TID_A, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_instr(TID_A),
+            gen_exit(TID_A),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 128),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_instr(TID_B),
+            gen_exit(TID_B),
+        };
+        for (int i = 4; i < 8; ++i)
+            memrefs[i].data.pid = 2;
+        if (!run_checker(memrefs, false))
+            return false;
+    }
+    // Incorrect: threads of one process disagree.
+    {
+        std::vector<memref_t> memrefs = {
+            gen_marker(TID_A, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+            gen_marker(TID_A, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_instr(TID_A),
+            gen_exit(TID_A),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 128),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_marker(TID_B, TRACE_MARKER_TYPE_TIMESTAMP, 42),
+            gen_instr(TID_B),
+            gen_exit(TID_B),
+        };
+        if (!run_checker(memrefs, true,
+                         { "Inconsistent cache line size among threads of a process",
+                           /*tid=*/TID_B,
+                           /*ref_ordinal=*/0, /*last_timestamp=*/42,
+                           /*instrs_since_last_timestamp=*/0 },
+                         "Failed to catch inconsistent cache line sizes"))
+            return false;
+    }
+    // Incorrect: one thread split across two shards.  run_checker() creates one
+    // shard per thread so we drive the shards directly.
+    {
+        std::vector<memref_t> memrefs = {
+            gen_marker(TID_A, TRACE_MARKER_TYPE_CACHE_LINE_SIZE, 64),
+            gen_marker(TID_A, TRACE_MARKER_TYPE_PAGE_SIZE, 4096),
+            gen_marker(TID_A, TRACE_MARKER_TYPE_TIMESTAMP, 42),
+            gen_instr(TID_A),
+            gen_exit(TID_A),
+        };
+        checker_no_abort_t checker(/*offline=*/true, /*serial=*/false,
+                                   /*serial_schedule_file=*/nullptr);
+        default_memtrace_stream_t stream;
+        checker.initialize_stream(&stream);
+        stream.set_tid(TID_A);
+        for (int shard_index = 0; shard_index < 2; ++shard_index) {
+            stream.set_shard_index(shard_index);
+            void *shard =
+                checker.parallel_shard_init_stream(shard_index, nullptr, &stream);
+            for (const auto &memref : memrefs)
+                checker.parallel_shard_memref(shard, memref);
+            checker.parallel_shard_exit(shard);
+        }
+        checker.print_results();
+        error_info_t expected = { "Thread appears in multiple shards", /*tid=*/TID_A,
+                                  /*ref_ordinal=*/0, /*last_timestamp=*/42,
+                                  /*instrs_since_last_timestamp=*/0 };
+        if (checker.errors_.size() != 1 || checker.errors_[0] != expected) {
+            std::cerr << "Failed to catch a thread in multiple shards\n";
+            return false;
+        }
+    }
+    return true;
+}
+
 bool
 check_read_write_records_match_operands()
 {
@@ -5919,7 +6012,7 @@ test_main(int argc, const char *argv[])
         check_duplicate_syscall_with_same_pc() && check_syscalls() &&
         check_rseq_side_exit_discontinuity() && check_schedule_file() &&
         check_branch_decoration() && check_filter_endpoint() &&
-        check_timestamps_increase_monotonically() &&
+        check_timestamps_increase_monotonically() && check_cross_shard_invariants() &&
         check_read_write_records_match_operands() && check_exit_found() &&
         check_kernel_syscall_trace() && check_has_instructions() &&
         check_kernel_context_switch_trace() &&
@@ -82,6 +82,19 @@ public:
     {
     }
 
+    explicit mock_schedule_stats_t(const schedule_stats_knobs_t &knobs)
+        : schedule_stats_t(knobs)
+    {
+    }
+
+    using schedule_stats_t::snapshot_t;
+
+    void *
+    get_shard_data(int core)
+    {
+        return shard_map_[core];
+    }
+
     uint64_t
     get_current_microseconds() override
     {
@@ -113,6 +126,8 @@ public:
     std::unique_ptr<histogram_interface_t>
     create_histogram(uint64_t bin_size) override
     {
+        if (knob_streaming_)
+            return schedule_stats_t::create_histogram(bin_size);
         if (bin_size == kSwitchBinSize) {
             // Always use 1 for granular results with our tiny test cases.
             bin_size = 1;
@@ -967,14 +982,169 @@ test_core_ratio()
     return true;
 }
 
+static bool
+test_log_histogram()
+{
+    schedule_stats_t::log_histogram_t hist;
+    assert(hist.empty());
+    assert(hist.get_percentile(0.5) == 0);
+    for (int64_t i = 0; i < 1000; ++i)
+        hist.add(i);
+    // Small values are exact.
+    assert(hist.get_percentile(0.) == 0);
+    assert(hist.get_percentile(0.05) == 50);
+    // Larger values are within the relative error bound.
+    uint64_t median = hist.get_percentile(0.5);
+    assert(median <= 500 && median >= 500 - 500 / 32);
+    uint64_t p99 = hist.get_percentile(0.99);
+    assert(p99 <= 990 && p99 >= 990 - 990 / 32);
+    // Large values need only a handful of bins per power of 2.
+    schedule_stats_t::log_histogram_t big;
+    big.add(1ULL << 40);
+    big.add((1ULL << 40) + 1);
+    big.add(-1);
+    assert(big.get_percentile(0.) == 0);
+    assert(big.get_percentile(0.99) == 1ULL << 40);
+    // Merging is a bin-wise sum.
+    big.merge(&hist);
+    assert(big.get_percentile(0.5) == hist.get_percentile(0.5));
+    assert(!big.to_string().empty());
+    return true;
+}
+
+static bool
+test_streaming_snapshots()
+{
+    static constexpr int64_t TID_A = 42;
+    static constexpr int64_t TID_B = 142;
+    static constexpr int64_t TID_C = 242;
+    static constexpr int NUM_ALTERNATING_INSTRS = 5000;
+    std::vector<std::vector<memref_t>> memrefs(2);
+    // Core 0 switches on every instruction: more than streaming mode retains.
+    for (int i = 0; i < NUM_ALTERNATING_INSTRS; ++i)
+        memrefs[0].push_back(gen_instr(i % 2 == 0 ? TID_A : TID_B));
+    memrefs[1] = {
+        gen_instr(TID_C),
+        gen_instr(TID_C),
+        gen_instr(TID_C),
+    };
+    schedule_stats_knobs_t knobs;
+    knobs.print_every = 1;
+    knobs.streaming = true;
+    mock_schedule_stats_t tool(knobs);
+    schedule_stats_t::counters_t result = run_schedule_stats_with_tool(tool, memrefs);
+    assert(result.instrs == NUM_ALTERNATING_INSTRS + 3);
+    assert(result.total_switches == NUM_ALTERNATING_INSTRS - 1);
+    assert(result.instrs_per_switch->get_percentile(0.5) == 1);
+    std::vector<schedule_record_t> record;
+    tool.get_switch_record(0, record);
+    assert(record.size() < static_cast<size_t>(NUM_ALTERNATING_INSTRS - 1));
+
+    // Snapshot each core and combine them into a whole-trace snapshot.
+    using snapshot_t = mock_schedule_stats_t::snapshot_t;
+    std::vector<const analysis_tool_t::interval_state_snapshot_t *> snapshots;
+    for (int core = 0; core < 2; ++core) {
+        snapshots.push_back(
+            tool.generate_shard_interval_snapshot(tool.get_shard_data(core), 1));
+    }
+    auto *combined = dynamic_cast<snapshot_t *>(tool.combine_interval_snapshots(
+        snapshots, /*interval_end_timestamp=*/0));
+    assert(combined->instrs == NUM_ALTERNATING_INSTRS + 3);
+    assert(combined->total_switches == NUM_ALTERNATING_INSTRS - 1);
+    assert(combined->instrs_per_switch->get_percentile(0.5) == 1);
+    assert(tool.print_interval_results({ combined }));
+
+    // A second snapshot with no new activity keeps the cumulative counters
+    // but has an empty interval histogram.
+    auto *second = dynamic_cast<snapshot_t *>(
+        tool.generate_shard_interval_snapshot(tool.get_shard_data(0), 2));
+    assert(second->instrs == NUM_ALTERNATING_INSTRS);
+    assert(second->instrs_per_switch->empty());
+    for (auto *snapshot : snapshots) {
+        tool.release_interval_snapshot(
+            const_cast<analysis_tool_t::interval_state_snapshot_t *>(snapshot));
+    }
+    tool.release_interval_snapshot(combined);
+    tool.release_interval_snapshot(second);
+    return true;
+}
+
+static bool
+test_serial_json(const std::string &dir)
+{
+    static constexpr int64_t TID_A = 42;
+    static constexpr int64_t TID_B = 142;
+    static constexpr int64_t TID_C = 242;
+    std::vector<std::vector<memref_t>> memrefs = {
+        {
+            gen_instr(TID_A),
+            gen_instr(TID_B),
+        },
+        {
+            gen_instr(TID_C),
+            gen_instr(TID_C),
+            gen_instr(TID_C),
+        },
+    };
+    schedule_stats_knobs_t knobs;
+    knobs.print_every = 1;
+    knobs.json_path = dir + "/serial.json";
+    mock_schedule_stats_t tool(knobs);
+    // Interleave the cores on a single serial stream.
+    mock_stream_t stream;
+    assert(tool.initialize_stream(&stream).empty());
+    std::unordered_map<workload_tid_t, mock_input_stream_t,
+                       schedule_stats_t::workload_tid_hash_t>
+        input2stream;
+    for (size_t i = 0; i < memrefs[1].size(); ++i) {
+        for (size_t cpu = 0; cpu < memrefs.size(); ++cpu) {
+            if (i >= memrefs[cpu].size())
+                continue;
+            const memref_t &memref = memrefs[cpu][i];
+            stream.set_tid(memref.instr.tid);
+            stream.set_workload_id(memref.instr.pid);
+            stream.set_output_cpuid(cpu);
+            mock_input_stream_t &input =
+                input2stream[workload_tid_t(memref.instr.pid, memref.instr.tid)];
+            stream.set_input_interface(&input);
+            bool res = tool.process_memref(memref);
+            assert(res);
+            input.add_instruction();
+        }
+    }
+    // The whole-trace snapshot also writes one JSON line per core.
+    using snapshot_t = mock_schedule_stats_t::snapshot_t;
+    auto *snapshot = dynamic_cast<snapshot_t *>(tool.generate_interval_snapshot(1));
+    assert(snapshot->instrs == 5);
+    assert(snapshot->total_switches == 1);
+    tool.release_interval_snapshot(snapshot);
+    std::ifstream json(knobs.json_path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(json, line))
+        lines.push_back(line);
+    assert(lines.size() == 2);
+    assert(lines[0].find("{\"core\":0,\"interval\":1,") == 0);
+    assert(lines[0].find(",\"instrs\":2,\"switches\":1,") != std::string::npos);
+    assert(lines[1].find("{\"core\":1,\"interval\":1,") == 0);
+    assert(lines[1].find(",\"instrs\":3,\"switches\":0,") != std::string::npos);
+    return true;
+}
+
 } // namespace
 
 int
 test_main(int argc, const char *argv[])
 {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <tmp_output_dir>\n";
+        return 1;
+    }
+    const std::string dir = argv[1];
     if (test_basic_stats() && test_basic_stats_with_syscall_trace() && test_idle() &&
         test_cpu_footprint() && test_syscall_latencies() &&
-        test_syscall_latencies_with_kernel_trace() && test_core_ratio()) {
+        test_syscall_latencies_with_kernel_trace() && test_core_ratio() &&
+        test_log_histogram() && test_streaming_snapshots() && test_serial_json(dir)) {
         std::cerr << "schedule_stats_test passed\n";
         return 0;
     }
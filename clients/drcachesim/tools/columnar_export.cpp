@@ -0,0 +1,211 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "columnar_export.h"
+
+#include <stdint.h>
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "analysis_tool.h"
+#include "columnar_export_create.h"
+#include "columnar_file.h"
+#include "memref.h"
+#include "memtrace_stream.h"
+#include "trace_entry.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+const std::string columnar_export_t::TOOL_NAME = "Columnar export tool";
+
+analysis_tool_t *
+columnar_export_tool_create(const std::string &output_dir, uint32_t rows_per_chunk,
+                            unsigned int verbose)
+{
+    return new columnar_export_t(output_dir, rows_per_chunk, verbose);
+}
+
+columnar_export_t::columnar_export_t(const std::string &output_dir,
+                                     uint32_t rows_per_chunk, unsigned int verbose)
+    : output_dir_(output_dir)
+    , rows_per_chunk_(rows_per_chunk)
+    , knob_verbose_(verbose)
+{
+    if (output_dir_.empty()) {
+        success_ = false;
+        error_string_ = "An output directory is required";
+    }
+}
+
+columnar_export_t::~columnar_export_t()
+{
+}
+
+std::string
+columnar_export_t::initialize_stream(memtrace_stream_t *serial_stream)
+{
+    serial_stream_ = serial_stream;
+    return "";
+}
+
+bool
+columnar_export_t::parallel_shard_supported()
+{
+    return true;
+}
+
+std::string
+columnar_export_t::get_output_path(int shard_index) const
+{
+    std::ostringstream name;
+    name << output_dir_ << DIRSEP << "drmemtrace.shard." << std::setfill('0')
+         << std::setw(4) << shard_index << ".columnar";
+    return name.str();
+}
+
+void *
+columnar_export_t::parallel_shard_init_stream(int shard_index, void *worker_data,
+                                              memtrace_stream_t *shard_stream)
+{
+    auto shard = std::unique_ptr<shard_data_t>(new shard_data_t);
+    shard->writer = std::unique_ptr<columnar_writer_t>(
+        new columnar_writer_t(get_output_path(shard_index), rows_per_chunk_));
+    shard->error = shard->writer->get_error();
+    shard_data_t *res = shard.get();
+    std::lock_guard<std::mutex> guard(shard_map_mutex_);
+    shard_map_[shard_index] = std::move(shard);
+    return reinterpret_cast<void *>(res);
+}
+
+bool
+columnar_export_t::parallel_shard_exit(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    std::string err = shard->writer->close();
+    if (!err.empty()) {
+        shard->error = err;
+        return false;
+    }
+    return true;
+}
+
+bool
+columnar_export_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    if (!shard->error.empty())
+        return false;
+    columnar_row_t row;
+    if (type_is_instr(memref.instr.type) ||
+        memref.instr.type == TRACE_TYPE_INSTR_NO_FETCH) {
+        row.values[COLUMNAR_PC] = memref.instr.addr;
+        row.values[COLUMNAR_ADDR] = memref.instr.addr;
+        row.values[COLUMNAR_SIZE] = memref.instr.size;
+    } else if (type_is_data(memref.data.type)) {
+        row.values[COLUMNAR_PC] = memref.data.pc;
+        row.values[COLUMNAR_ADDR] = memref.data.addr;
+        row.values[COLUMNAR_SIZE] = memref.data.size;
+    } else {
+        if (memref.marker.type == TRACE_TYPE_MARKER &&
+            memref.marker.marker_type == TRACE_MARKER_TYPE_TIMESTAMP)
+            shard->last_timestamp = memref.marker.marker_value;
+        return true;
+    }
+    row.values[COLUMNAR_TYPE] = memref.data.type;
+    row.values[COLUMNAR_TID] = static_cast<uint64_t>(memref.data.tid);
+    row.values[COLUMNAR_TIMESTAMP] = shard->last_timestamp;
+    shard->writer->add_row(row);
+    ++shard->rows;
+    shard->error = shard->writer->get_error();
+    return shard->error.empty();
+}
+
+std::string
+columnar_export_t::parallel_shard_error(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    return shard->error;
+}
+
+columnar_export_t::shard_data_t *
+columnar_export_t::get_serial_shard(int shard_index)
+{
+    const auto &lookup = shard_map_.find(shard_index);
+    if (lookup != shard_map_.end())
+        return lookup->second.get();
+    return reinterpret_cast<shard_data_t *>(
+        parallel_shard_init_stream(shard_index, nullptr, serial_stream_));
+}
+
+bool
+columnar_export_t::process_memref(const memref_t &memref)
+{
+    // In serial mode we still write one file per input shard.
+    shard_data_t *shard = get_serial_shard(serial_stream_->get_shard_index());
+    if (!parallel_shard_memref(reinterpret_cast<void *>(shard), memref)) {
+        error_string_ = shard->error;
+        return false;
+    }
+    return true;
+}
+
+bool
+columnar_export_t::print_results()
+{
+    uint64_t total_rows = 0;
+    for (const auto &keyval : shard_map_) {
+        if (serial_stream_ != nullptr && !parallel_shard_exit(keyval.second.get())) {
+            error_string_ = keyval.second->error;
+            return false;
+        }
+        total_rows += keyval.second->rows;
+        if (knob_verbose_ > 0) {
+            std::cerr << "Shard " << keyval.first << ": " << keyval.second->rows
+                      << " rows in " << get_output_path(keyval.first) << "\n";
+        }
+    }
+    std::cerr << TOOL_NAME << " results:\n";
+    std::cerr << std::setw(15) << total_rows << " : total rows\n";
+    std::cerr << std::setw(15) << shard_map_.size() << " : files written to "
+              << output_dir_ << "\n";
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
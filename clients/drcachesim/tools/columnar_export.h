@@ -0,0 +1,103 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef _COLUMNAR_EXPORT_H_
+#define _COLUMNAR_EXPORT_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "analysis_tool.h"
+#include "columnar_file.h"
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class columnar_export_t : public analysis_tool_t {
+public:
+    columnar_export_t(const std::string &output_dir, uint32_t rows_per_chunk,
+                      unsigned int verbose);
+    virtual ~columnar_export_t();
+    std::string
+    initialize_stream(memtrace_stream_t *serial_stream) override;
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_shard_init_stream(int shard_index, void *worker_data,
+                               memtrace_stream_t *shard_stream) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
+    /** Returns the path of the file written for shard \p shard_index. */
+    std::string
+    get_output_path(int shard_index) const;
+
+protected:
+    struct shard_data_t {
+        std::unique_ptr<columnar_writer_t> writer;
+        uint64_t last_timestamp = 0;
+        uint64_t rows = 0;
+        std::string error;
+    };
+
+    shard_data_t *
+    get_serial_shard(int shard_index);
+
+    std::string output_dir_;
+    uint32_t rows_per_chunk_;
+    unsigned int knob_verbose_;
+    memtrace_stream_t *serial_stream_ = nullptr;
+    std::unordered_map<int, std::unique_ptr<shard_data_t>> shard_map_;
+    // This mutex is only needed in parallel_shard_init_stream. In all other accesses
+    // to shard_map_ we are single-threaded.
+    std::mutex shard_map_mutex_;
+
+    static const std::string TOOL_NAME;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _COLUMNAR_EXPORT_H_ */
@@ -0,0 +1,388 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "columnar_file.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+// "DRCOLUMN" in little-endian byte order.
+static constexpr uint64_t COLUMNAR_FILE_MAGIC = 0x4e4d554c4f435244ULL;
+
+struct file_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t num_columns;
+};
+
+struct chunk_header_t {
+    uint32_t num_rows;
+    uint32_t num_columns;
+    columnar_column_stats_t stats[COLUMNAR_COUNT];
+};
+
+void
+append_varint(std::vector<unsigned char> &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+bool
+read_varint(const unsigned char *&pos, const unsigned char *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        unsigned char byte = *pos++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Each value is stored as the zigzag-encoded delta from its predecessor. A zero
+// delta is followed by the count of further zero deltas, so constant stretches
+// take two bytes.
+void
+encode_column(const std::vector<uint64_t> &values, std::vector<unsigned char> &out)
+{
+    out.clear();
+    uint64_t prev = 0;
+    size_t i = 0;
+    while (i < values.size()) {
+        const int64_t delta = static_cast<int64_t>(values[i] - prev);
+        const uint64_t zigzag =
+            (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        append_varint(out, zigzag);
+        prev = values[i];
+        ++i;
+        if (zigzag == 0) {
+            size_t run = 0;
+            while (i < values.size() && values[i] == prev) {
+                ++run;
+                ++i;
+            }
+            append_varint(out, run);
+        }
+    }
+}
+
+bool
+decode_column(const unsigned char *pos, const unsigned char *end, uint32_t count,
+              std::vector<uint64_t> &values)
+{
+    values.resize(count);
+    uint64_t prev = 0;
+    uint32_t i = 0;
+    while (i < count) {
+        uint64_t zigzag;
+        if (!read_varint(pos, end, zigzag))
+            return false;
+        prev += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+        values[i++] = prev;
+        if (zigzag == 0) {
+            uint64_t run;
+            if (!read_varint(pos, end, run) || run > count - i)
+                return false;
+            std::fill(values.begin() + i, values.begin() + i + run, prev);
+            i += static_cast<uint32_t>(run);
+        }
+    }
+    return pos == end;
+}
+
+} // namespace
+
+columnar_writer_t::columnar_writer_t(const std::string &path, uint32_t rows_per_chunk)
+    : out_(path, std::ofstream::binary)
+    , rows_per_chunk_(std::max(rows_per_chunk, 1u))
+{
+    if (!out_) {
+        error_ = "Failed to open " + path;
+        return;
+    }
+    file_header_t header = { COLUMNAR_FILE_MAGIC, COLUMNAR_FILE_VERSION,
+                             COLUMNAR_COUNT };
+    out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int i = 0; i < COLUMNAR_COUNT; ++i)
+        columns_[i].reserve(rows_per_chunk_);
+}
+
+columnar_writer_t::~columnar_writer_t()
+{
+    close();
+}
+
+void
+columnar_writer_t::add_row(const columnar_row_t &row)
+{
+    if (closed_ || !error_.empty())
+        return;
+    for (int i = 0; i < COLUMNAR_COUNT; ++i)
+        columns_[i].push_back(row.values[i]);
+    if (columns_[0].size() >= rows_per_chunk_)
+        flush_chunk();
+}
+
+void
+columnar_writer_t::flush_chunk()
+{
+    if (columns_[0].empty())
+        return;
+    chunk_header_t header;
+    header.num_rows = static_cast<uint32_t>(columns_[0].size());
+    header.num_columns = COLUMNAR_COUNT;
+    for (int i = 0; i < COLUMNAR_COUNT; ++i) {
+        const auto minmax = std::minmax_element(columns_[i].begin(), columns_[i].end());
+        header.stats[i].min = *minmax.first;
+        header.stats[i].max = *minmax.second;
+        encode_column(columns_[i], encoded_[i]);
+        header.stats[i].encoded_size = encoded_[i].size();
+        columns_[i].clear();
+    }
+    out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int i = 0; i < COLUMNAR_COUNT; ++i) {
+        out_.write(reinterpret_cast<const char *>(encoded_[i].data()),
+                   encoded_[i].size());
+    }
+    if (!out_)
+        error_ = "Failed to write chunk";
+}
+
+std::string
+columnar_writer_t::close()
+{
+    if (closed_)
+        return error_;
+    closed_ = true;
+    if (error_.empty())
+        flush_chunk();
+    out_.close();
+    return error_;
+}
+
+std::string
+columnar_reader_t::open(const std::string &path)
+{
+    in_.open(path, std::ifstream::binary);
+    if (!in_)
+        return "Failed to open " + path;
+    file_header_t header;
+    if (!in_.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return "Failed to read header of " + path;
+    if (header.magic != COLUMNAR_FILE_MAGIC)
+        return path + " is not a columnar file";
+    if (header.version > COLUMNAR_FILE_VERSION || header.num_columns != COLUMNAR_COUNT)
+        return "Unsupported columnar file version in " + path;
+    next_chunk_offset_ = sizeof(header);
+    return "";
+}
+
+bool
+columnar_reader_t::next_chunk()
+{
+    chunk_rows_ = 0;
+    if (!error_.empty())
+        return false;
+    in_.clear();
+    in_.seekg(next_chunk_offset_);
+    chunk_header_t header;
+    if (!in_.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        if (in_.gcount() != 0)
+            error_ = "Truncated chunk header";
+        return false;
+    }
+    if (header.num_columns != COLUMNAR_COUNT) {
+        error_ = "Invalid chunk header";
+        return false;
+    }
+    chunk_rows_ = header.num_rows;
+    uint64_t offset = next_chunk_offset_ + sizeof(header);
+    for (int i = 0; i < COLUMNAR_COUNT; ++i) {
+        stats_[i] = header.stats[i];
+        column_offset_[i] = offset;
+        offset += stats_[i].encoded_size;
+    }
+    next_chunk_offset_ = offset;
+    return true;
+}
+
+bool
+columnar_reader_t::read_column(columnar_column_t column, std::vector<uint64_t> &values)
+{
+    if (!error_.empty() || chunk_rows_ == 0)
+        return false;
+    buffer_.resize(stats_[column].encoded_size);
+    in_.clear();
+    in_.seekg(column_offset_[column]);
+    if (!in_.read(reinterpret_cast<char *>(buffer_.data()), buffer_.size())) {
+        error_ = "Truncated column data";
+        return false;
+    }
+    if (!decode_column(buffer_.data(), buffer_.data() + buffer_.size(), chunk_rows_,
+                       values)) {
+        error_ = "Corrupt column data";
+        return false;
+    }
+    return true;
+}
+
+void
+columnar_select_range(const uint64_t *values, size_t count, uint64_t lo, uint64_t hi,
+                      unsigned char *mask)
+{
+    // A single unsigned comparison covers both bounds.
+    const uint64_t width = hi - lo;
+    for (size_t i = 0; i < count; ++i)
+        mask[i] = static_cast<unsigned char>(values[i] - lo <= width);
+}
+
+void
+columnar_and_range(const uint64_t *values, size_t count, uint64_t lo, uint64_t hi,
+                   unsigned char *mask)
+{
+    const uint64_t width = hi - lo;
+    for (size_t i = 0; i < count; ++i)
+        mask[i] &= static_cast<unsigned char>(values[i] - lo <= width);
+}
+
+namespace {
+
+// Shared chunk walk for the aggregations. Calls on_chunk(rows, mask) for each chunk
+// that may match, where mask is nullptr if every row is known to match.
+template <typename OnChunk>
+std::string
+scan_chunks(const std::string &path, const std::vector<columnar_predicate_t> &predicates,
+            OnChunk on_chunk)
+{
+    for (const auto &pred : predicates) {
+        if (pred.column < 0 || pred.column >= COLUMNAR_COUNT || pred.lo > pred.hi)
+            return "Invalid predicate";
+    }
+    columnar_reader_t reader;
+    std::string err = reader.open(path);
+    if (!err.empty())
+        return err;
+    std::vector<uint64_t> values;
+    std::vector<unsigned char> mask;
+    while (reader.next_chunk()) {
+        bool may_match = true;
+        bool all_match = true;
+        for (const auto &pred : predicates) {
+            const columnar_column_stats_t &stats = reader.get_chunk_stats(pred.column);
+            if (!reader.chunk_may_match(pred.column, pred.lo, pred.hi)) {
+                may_match = false;
+                break;
+            }
+            if (stats.min < pred.lo || stats.max > pred.hi)
+                all_match = false;
+        }
+        if (!may_match)
+            continue;
+        if (all_match) {
+            if (!on_chunk(reader, nullptr))
+                break;
+            continue;
+        }
+        const uint32_t rows = reader.get_chunk_rows();
+        mask.assign(rows, 1);
+        for (const auto &pred : predicates) {
+            if (!reader.read_column(pred.column, values))
+                break;
+            columnar_and_range(values.data(), rows, pred.lo, pred.hi, mask.data());
+        }
+        if (!reader.get_error().empty() || !on_chunk(reader, mask.data()))
+            break;
+    }
+    return reader.get_error();
+}
+
+} // namespace
+
+std::string
+columnar_count(const std::string &path,
+               const std::vector<columnar_predicate_t> &predicates, uint64_t &count)
+{
+    count = 0;
+    return scan_chunks(path, predicates,
+                       [&count](columnar_reader_t &reader, const unsigned char *mask) {
+                           const uint32_t rows = reader.get_chunk_rows();
+                           if (mask == nullptr) {
+                               count += rows;
+                               return true;
+                           }
+                           uint64_t matches = 0;
+                           for (uint32_t i = 0; i < rows; ++i)
+                               matches += mask[i];
+                           count += matches;
+                           return true;
+                       });
+}
+
+std::string
+columnar_count_by(const std::string &path, columnar_column_t key_column,
+                  const std::vector<columnar_predicate_t> &predicates,
+                  std::unordered_map<uint64_t, uint64_t> &counts)
+{
+    if (key_column < 0 || key_column >= COLUMNAR_COUNT)
+        return "Invalid key column";
+    std::vector<uint64_t> keys;
+    return scan_chunks(path, predicates,
+                       [&](columnar_reader_t &reader, const unsigned char *mask) {
+                           if (!reader.read_column(key_column, keys))
+                               return false;
+                           const uint32_t rows = reader.get_chunk_rows();
+                           for (uint32_t i = 0; i < rows; ++i) {
+                               if (mask == nullptr || mask[i] != 0)
+                                   ++counts[keys[i]];
+                           }
+                           return true;
+                       });
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
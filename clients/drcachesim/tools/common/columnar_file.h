@@ -0,0 +1,249 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/**
+ * columnar_file.h: Reading and writing of the drmemtrace columnar export format,
+ * along with a small scan and aggregation library for ad-hoc queries.
+ *
+ * A columnar file holds the instruction and data records of one trace shard as
+ * separate columns (#dynamorio::drmemtrace::columnar_column_t), grouped into
+ * chunks of a fixed number of rows. Each chunk header records the minimum and
+ * maximum value of every column in the chunk, so scans can skip whole chunks
+ * whose range cannot satisfy a predicate, and the encoded size of every column,
+ * so a scan reads and decodes only the columns it needs.
+ *
+ * Columns are delta-encoded as zigzag LEB128 varints with runs of repeated
+ * values collapsed, which compresses the mostly-constant tid, type, size, and
+ * timestamp columns to a handful of bytes per run. All values are stored in
+ * the byte order of the writing machine, as with other drmemtrace files.
+ */
+
+#ifndef _COLUMNAR_FILE_H_
+#define _COLUMNAR_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/** The columns of a columnar export file. */
+enum columnar_column_t {
+    /**
+     * The instruction address for instruction records, or the address of the
+     * instruction issuing the access for data records (0 if unknown).
+     */
+    COLUMNAR_PC,
+    /** The instruction address or the data address. */
+    COLUMNAR_ADDR,
+    /** The #dynamorio::drmemtrace::trace_type_t of the record. */
+    COLUMNAR_TYPE,
+    /** The size of the instruction or of the data access. */
+    COLUMNAR_SIZE,
+    /** The thread id. */
+    COLUMNAR_TID,
+    /** The value of the most recent timestamp marker (0 if none yet). */
+    COLUMNAR_TIMESTAMP,
+    /** The number of columns. */
+    COLUMNAR_COUNT,
+};
+
+/** The current version of the columnar file format. */
+static constexpr uint32_t COLUMNAR_FILE_VERSION = 1;
+
+/** A single row of a columnar file. */
+struct columnar_row_t {
+    uint64_t values[COLUMNAR_COUNT];
+};
+
+/** Per-column statistics for one chunk, as stored in the chunk header. */
+struct columnar_column_stats_t {
+    uint64_t min;
+    uint64_t max;
+    uint64_t encoded_size;
+};
+
+/**
+ * Writes a columnar file. Rows are buffered until a full chunk is available.
+ * Errors are sticky and are returned by get_error().
+ */
+class columnar_writer_t {
+public:
+    /** Creates the file at \p path, holding \p rows_per_chunk rows per chunk. */
+    columnar_writer_t(const std::string &path, uint32_t rows_per_chunk);
+    ~columnar_writer_t();
+
+    /** Appends \p row. */
+    void
+    add_row(const columnar_row_t &row);
+
+    /** Writes out any buffered rows and closes the file. */
+    std::string
+    close();
+
+    /** Returns the first error encountered, or the empty string. */
+    std::string
+    get_error() const
+    {
+        return error_;
+    }
+
+private:
+    void
+    flush_chunk();
+
+    std::ofstream out_;
+    uint32_t rows_per_chunk_;
+    std::vector<uint64_t> columns_[COLUMNAR_COUNT];
+    std::vector<unsigned char> encoded_[COLUMNAR_COUNT];
+    std::string error_;
+    bool closed_ = false;
+};
+
+/**
+ * Reads a columnar file one chunk at a time. Only the columns requested via
+ * read_column() are decoded; the others are skipped over on disk.
+ */
+class columnar_reader_t {
+public:
+    columnar_reader_t() = default;
+
+    /** Opens the file at \p path and validates its header. */
+    std::string
+    open(const std::string &path);
+
+    /**
+     * Advances to the next chunk. Returns false at the end of the file or on an
+     * error, which is then available from get_error().
+     */
+    bool
+    next_chunk();
+
+    /** Returns the number of rows in the current chunk. */
+    uint32_t
+    get_chunk_rows() const
+    {
+        return chunk_rows_;
+    }
+
+    /** Returns the statistics of column \p column in the current chunk. */
+    const columnar_column_stats_t &
+    get_chunk_stats(columnar_column_t column) const
+    {
+        return stats_[column];
+    }
+
+    /**
+     * Returns whether the current chunk may contain values of \p column in the
+     * inclusive range [\p lo, \p hi], based on the chunk statistics.
+     */
+    bool
+    chunk_may_match(columnar_column_t column, uint64_t lo, uint64_t hi) const
+    {
+        return stats_[column].max >= lo && stats_[column].min <= hi;
+    }
+
+    /** Decodes column \p column of the current chunk into \p values. */
+    bool
+    read_column(columnar_column_t column, std::vector<uint64_t> &values);
+
+    /** Returns the first error encountered, or the empty string. */
+    std::string
+    get_error() const
+    {
+        return error_;
+    }
+
+private:
+    std::ifstream in_;
+    uint32_t chunk_rows_ = 0;
+    columnar_column_stats_t stats_[COLUMNAR_COUNT] = {};
+    // File offsets of each column's data in the current chunk.
+    uint64_t column_offset_[COLUMNAR_COUNT] = {};
+    uint64_t next_chunk_offset_ = 0;
+    std::vector<unsigned char> buffer_;
+    std::string error_;
+};
+
+/**
+ * Sets \p mask[i] to 1 if \p lo <= \p values[i] <= \p hi and to 0 otherwise, for
+ * \p count elements. The loop is branch-free so the compiler can vectorize it.
+ */
+void
+columnar_select_range(const uint64_t *values, size_t count, uint64_t lo, uint64_t hi,
+                      unsigned char *mask);
+
+/**
+ * Clears \p mask[i] unless \p lo <= \p values[i] <= \p hi, for \p count elements,
+ * to combine predicates on several columns.
+ */
+void
+columnar_and_range(const uint64_t *values, size_t count, uint64_t lo, uint64_t hi,
+                   unsigned char *mask);
+
+/** An inclusive range predicate on one column. */
+struct columnar_predicate_t {
+    columnar_column_t column;
+    uint64_t lo;
+    uint64_t hi;
+};
+
+/**
+ * Returns in \p count the number of rows in the file at \p path which satisfy all of
+ * \p predicates. Chunks are skipped based on their statistics, and only the
+ * predicate columns are decoded. Returns an error string on failure.
+ */
+std::string
+columnar_count(const std::string &path,
+               const std::vector<columnar_predicate_t> &predicates, uint64_t &count);
+
+/**
+ * Adds to \p counts, keyed by the value of \p key_column, the number of rows in
+ * the file at \p path which satisfy all of \p predicates. For example, keying by
+ * #COLUMNAR_PC with a #COLUMNAR_TIMESTAMP range and a #COLUMNAR_TYPE range
+ * selecting loads gives the load count per pc within a time window. Returns an
+ * error string on failure.
+ */
+std::string
+columnar_count_by(const std::string &path, columnar_column_t key_column,
+                  const std::vector<columnar_predicate_t> &predicates,
+                  std::unordered_map<uint64_t, uint64_t> &counts);
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _COLUMNAR_FILE_H_ */
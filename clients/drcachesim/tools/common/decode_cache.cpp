@@ -30,10 +30,15 @@
  * DAMAGE.
  */
 
+#include <assert.h>
+
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <typeindex>
 
 // Needs to be included before trace_entry.h or build_target_arch_type will not
 // be defined by trace_entry.h.
@@ -76,6 +81,133 @@ instr_decode_info_t::~instr_decode_info_t()
     }
 }
 
+shared_decode_cache_t::entry_t::entry_t()
+{
+    for (int i = 0; i < MAX_SLOTS; ++i)
+        slots_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+shared_decode_cache_t::entry_t::~entry_t()
+{
+    for (int i = 0; i < MAX_SLOTS; ++i)
+        delete slots_[i].load(std::memory_order_relaxed);
+}
+
+decode_info_base_t *
+shared_decode_cache_t::entry_t::set_slot_if_unset(int slot, decode_info_base_t *info)
+{
+    decode_info_base_t *expected = nullptr;
+    if (slots_[slot].compare_exchange_strong(expected, info, std::memory_order_acq_rel,
+                                             std::memory_order_acquire))
+        return info;
+    // Another user decoded the same instruction concurrently.
+    delete info;
+    return expected;
+}
+
+size_t
+shared_decode_cache_t::key_hash_t::operator()(const key_t &key) const
+{
+    // FNV-1a over the encoding, mixed with the pc and mode.
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned short i = 0; i < key.size; ++i) {
+        hash ^= key.encoding[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= reinterpret_cast<uint64_t>(key.pc) + 0x9e3779b97f4a7c15ULL + (hash << 6) +
+        (hash >> 2);
+    hash ^= key.mode + (static_cast<uint64_t>(key.type) << 32);
+    return static_cast<size_t>(hash);
+}
+
+int
+shared_decode_cache_t::get_slot_index(std::type_index type, bool include_decoded_instr)
+{
+    std::lock_guard<std::mutex> guard(slot_mutex_);
+    for (size_t i = 0; i < slot_owners_.size(); ++i) {
+        if (slot_owners_[i].first == type &&
+            slot_owners_[i].second == include_decoded_instr)
+            return static_cast<int>(i);
+    }
+    if (slot_owners_.size() >= MAX_SLOTS)
+        return -1;
+    slot_owners_.emplace_back(type, include_decoded_instr);
+    return static_cast<int>(slot_owners_.size() - 1);
+}
+
+shared_decode_cache_t::entry_t *
+shared_decode_cache_t::find_or_add(const key_t &key)
+{
+    // Consecutive instructions usually differ in their low pc bits, which spreads
+    // them across stripes.
+    stripe_t &stripe =
+        stripes_[(reinterpret_cast<uint64_t>(key.pc) ^ key.size) % NUM_STRIPES];
+    {
+        std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+        auto it = stripe.map.find(key);
+        if (it != stripe.map.end())
+            return it->second.get();
+    }
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    auto &entry = stripe.map[key];
+    if (entry == nullptr)
+        entry.reset(new entry_t());
+    return entry.get();
+}
+
+void
+shared_decode_cache_t::add_user()
+{
+    std::lock_guard<std::mutex> guard(users_mutex_);
+    ++num_users_;
+}
+
+void
+shared_decode_cache_t::remove_user()
+{
+    std::lock_guard<std::mutex> guard(users_mutex_);
+    assert(num_users_ > 0);
+    if (--num_users_ > 0)
+        return;
+    // Nobody holds on to an entry anymore. As in decode_cache_t::clear_cache(),
+    // replacing each map releases its memory where clear() might not.
+    for (int i = 0; i < NUM_STRIPES; ++i) {
+        std::unique_lock<std::shared_mutex> lock(stripes_[i].mutex);
+        stripes_[i].map =
+            std::unordered_map<key_t, std::unique_ptr<entry_t>, key_hash_t>();
+    }
+}
+
+size_t
+shared_decode_cache_t::size()
+{
+    size_t total = 0;
+    for (int i = 0; i < NUM_STRIPES; ++i) {
+        std::shared_lock<std::shared_mutex> lock(stripes_[i].mutex);
+        total += stripes_[i].map.size();
+    }
+    return total;
+}
+
+void
+decode_cache_base_t::set_shared_cache(shared_decode_cache_t *cache)
+{
+    shared_cache_ = cache;
+}
+
+uint64_t
+decode_cache_base_t::shared_cache_mode(void *dcontext)
+{
+    // The isa mode may be switched to DR_ISA_REGDEPS and the vector length may be
+    // changed by tools like view, both of which affect decoding.
+    uint64_t mode = static_cast<uint64_t>(dr_get_isa_mode(dcontext));
+    mode |= static_cast<uint64_t>(static_cast<uint32_t>(dr_get_vector_length())) << 16;
+    // Encodings from the module mapper are keyed by pc only.
+    if (use_module_mapper_)
+        mode |= 1ULL << 63;
+    return mode;
+}
+
 decode_cache_base_t::decode_cache_base_t(unsigned int verbosity)
     : verbosity_(verbosity)
 {
@@ -206,6 +338,7 @@ std::unique_ptr<module_mapper_t> decode_cache_base_t::module_mapper_;
 std::string decode_cache_base_t::module_file_path_used_for_init_;
 char *decode_cache_base_t::modfile_bytes_ = nullptr;
 int decode_cache_base_t::module_mapper_use_count_ = 0;
+shared_decode_cache_t *decode_cache_base_t::shared_cache_ = nullptr;
 
 } // namespace drmemtrace
 } // namespace dynamorio
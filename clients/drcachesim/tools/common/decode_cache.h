@@ -47,11 +47,19 @@
 #include "memref.h"
 #include "raw2trace_shared.h"
 
+#include <atomic>
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <typeindex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -164,6 +172,130 @@ private:
     void *dcontext_ = nullptr;
 };
 
+/**
+ * A concurrent decode cache that is shared among all
+ * #dynamorio::drmemtrace::decode_cache_t instances (of any template type) in all
+ * analysis tools and shards, typically owned by the analyzer and installed via
+ * #dynamorio::drmemtrace::decode_cache_base_t::set_shared_cache().
+ *
+ * Entries are keyed by the instruction pc together with its encoding bytes, its
+ * trace record type, and the decoding mode, so a given encoding is decoded only
+ * once per DecodeInfo type regardless of how many tools and shards observe it.
+ * Each entry holds one slot per registered (DecodeInfo type, include_decoded_instr)
+ * pair. The table is split into stripes, each guarded by a reader-writer lock, so
+ * lookups of existing entries never contend on a global lock.
+ *
+ * Each #dynamorio::drmemtrace::decode_cache_t using this cache is counted as a
+ * user from its init() until its clear_cache() or destruction. Entries are kept
+ * while there is any user, and all of them are freed when the last user goes away,
+ * so tools that call clear_cache() in parallel_shard_exit() still release the
+ * memory once every shard is done. The cached DecodeInfo objects must be treated as
+ * read-only once published.
+ */
+class shared_decode_cache_t {
+public:
+    /**
+     * The maximum number of distinct (DecodeInfo type, include_decoded_instr)
+     * pairs that can be registered. Further decode_cache_t instances fall back
+     * to their private caches.
+     */
+    static constexpr int MAX_SLOTS = 16;
+
+    /** Lookup key for a shared entry. */
+    struct key_t {
+        app_pc pc = nullptr;
+        // Combines the isa mode, the vector length, and the encoding source.
+        uint64_t mode = 0;
+        unsigned short type = 0;
+        unsigned short size = 0;
+        unsigned char encoding[MAX_ENCODING_LENGTH] = {};
+
+        bool
+        operator==(const key_t &rhs) const
+        {
+            return pc == rhs.pc && mode == rhs.mode && type == rhs.type &&
+                size == rhs.size && memcmp(encoding, rhs.encoding, size) == 0;
+        }
+    };
+
+    /** A shared entry holding the per-slot DecodeInfo objects. */
+    class entry_t {
+    public:
+        entry_t();
+        ~entry_t();
+        decode_info_base_t *
+        get_slot(int slot) const
+        {
+            return slots_[slot].load(std::memory_order_acquire);
+        }
+        /**
+         * Publishes \p info into \p slot unless another thread already did so.
+         * Takes ownership of \p info; if it loses the race, \p info is deleted.
+         * Returns the published object.
+         */
+        decode_info_base_t *
+        set_slot_if_unset(int slot, decode_info_base_t *info);
+
+    private:
+        std::atomic<decode_info_base_t *> slots_[MAX_SLOTS];
+    };
+
+    shared_decode_cache_t() = default;
+    ~shared_decode_cache_t() = default;
+    shared_decode_cache_t(const shared_decode_cache_t &) = delete;
+    shared_decode_cache_t &
+    operator=(const shared_decode_cache_t &) = delete;
+
+    /**
+     * Returns the slot index to use for the given DecodeInfo \p type and
+     * \p include_decoded_instr setting, or -1 if all slots are taken.
+     */
+    int
+    get_slot_index(std::type_index type, bool include_decoded_instr);
+
+    /**
+     * Returns the entry for \p key, creating an empty one if none exists yet.
+     * The returned pointer remains valid for the lifetime of this object.
+     */
+    entry_t *
+    find_or_add(const key_t &key);
+
+    /**
+     * Registers a user of the entries returned by find_or_add(). Entries remain
+     * valid until the user calls remove_user().
+     */
+    void
+    add_user();
+
+    /**
+     * Unregisters a user added with add_user(). Frees every entry when no users
+     * remain.
+     */
+    void
+    remove_user();
+
+    /** Returns the number of distinct entries. Intended for diagnostics. */
+    size_t
+    size();
+
+private:
+    struct key_hash_t {
+        size_t
+        operator()(const key_t &key) const;
+    };
+    struct stripe_t {
+        std::shared_mutex mutex;
+        std::unordered_map<key_t, std::unique_ptr<entry_t>, key_hash_t> map;
+    };
+    static constexpr int NUM_STRIPES = 64;
+
+    stripe_t stripes_[NUM_STRIPES];
+    std::mutex users_mutex_;
+    int num_users_ = 0;
+    std::mutex slot_mutex_;
+    std::vector<std::pair<std::type_index, bool>> slot_owners_;
+};
+
 /**
  * Base class for #dynamorio::drmemtrace::decode_cache_t.
  *
@@ -180,6 +312,29 @@ protected:
     decode_cache_base_t(unsigned int verbosity);
     virtual ~decode_cache_base_t();
 
+public:
+    /**
+     * Installs \p cache as the #dynamorio::drmemtrace::shared_decode_cache_t used
+     * by all #dynamorio::drmemtrace::decode_cache_t instances that are initialized
+     * afterward, or removes it if \p cache is nullptr. The caller retains ownership
+     * of \p cache and must keep it alive, and must not change the installed cache,
+     * while any #dynamorio::drmemtrace::decode_cache_t that used it still exists.
+     * Instances constructed with \p persist_decoded_instr_ set to true never use the
+     * shared cache, as their decoded #instr_t is owned by a single user.
+     */
+    static void
+    set_shared_cache(shared_decode_cache_t *cache);
+
+protected:
+    static shared_decode_cache_t *shared_cache_;
+
+    /**
+     * Returns the #dynamorio::drmemtrace::shared_decode_cache_t::key_t mode value
+     * for the current decoding state of \p dcontext.
+     */
+    uint64_t
+    shared_cache_mode(void *dcontext);
+
     static std::mutex module_mapper_mutex_;
     static std::unique_ptr<module_mapper_t> module_mapper_;
     static std::string module_file_path_used_for_init_;
@@ -311,6 +466,7 @@ public:
     };
     virtual ~decode_cache_t() override
     {
+        release_shared();
     }
 
     /**
@@ -330,6 +486,12 @@ public:
     DecodeInfo *
     get_decode_info(app_pc pc)
     {
+        if (shared_ != nullptr) {
+            auto it = shared_view_.find(pc);
+            if (it == shared_view_.end())
+                return nullptr;
+            return it->second;
+        }
         auto it = decode_cache_.find(pc);
         if (it == decode_cache_.end()) {
             return nullptr;
@@ -366,6 +528,8 @@ public:
             return "init() must be called first";
         }
         const app_pc trace_pc = reinterpret_cast<app_pc>(memref_instr.addr);
+        if (shared_ != nullptr)
+            return add_shared_decode_info(memref_instr, cached_decode_info);
 
         auto [it_info, inserted] = decode_cache_.try_emplace(trace_pc, DecodeInfo());
         bool already_exists = !inserted;
@@ -403,28 +567,7 @@ public:
             }
         }
 
-        // Optionally decode the instruction.
-        instr_t *instr = nullptr;
-        instr_noalloc_t noalloc;
-        if (include_decoded_instr_) {
-            if (persist_decoded_instr_) {
-                instr = instr_create(dcontext_);
-            } else {
-                instr_noalloc_init(dcontext_, &noalloc);
-                instr = instr_from_noalloc(&noalloc);
-            }
-
-            app_pc next_pc = decode_from_copy(dcontext_, decode_pc, trace_pc, instr);
-            if (next_pc == nullptr || !instr_valid(instr)) {
-                if (persist_decoded_instr_) {
-                    instr_destroy(dcontext_, instr);
-                }
-                cached_decode_info->error_string_ = "decode_from_copy failed";
-                return cached_decode_info->get_error_string();
-            }
-        }
-        it_info->second.set_decode_info(dcontext_, memref_instr, instr, decode_pc);
-        return it_info->second.get_error_string();
+        return decode_and_set(memref_instr, decode_pc, *cached_decode_info);
     }
 
     /**
@@ -513,13 +656,22 @@ public:
             return "Trace does not have embedded encodings, and no module_file_path "
                    "provided";
         }
-        if (module_file_path.empty()) {
-            init_done_ = true;
-            return "";
+        if (!module_file_path.empty()) {
+            std::string err = init_module_mapper(module_file_path, alt_module_dir);
+            if (!err.empty()) {
+                return err;
+            }
         }
-        std::string err = init_module_mapper(module_file_path, alt_module_dir);
-        if (!err.empty()) {
-            return err;
+        // The installed shared cache is used only for DecodeInfo that no other
+        // party may own or modify.
+        if (shared_cache_ != nullptr && !persist_decoded_instr_) {
+            shared_slot_ = shared_cache_->get_slot_index(
+                std::type_index(typeid(DecodeInfo)), include_decoded_instr_);
+            if (shared_slot_ >= 0) {
+                shared_ = shared_cache_;
+                shared_->add_user();
+                shared_user_ = true;
+            }
         }
         init_done_ = true;
         return "";
@@ -534,6 +686,10 @@ public:
      * the decode cache entries in parallel_shard_exit(), since it's very likely that the
      * decode cache is not needed for result computation.
      *
+     * With a #dynamorio::drmemtrace::shared_decode_cache_t, this gives up this
+     * object's use of the shared entries, which are freed once no other
+     * #dynamorio::drmemtrace::decode_cache_t uses them.
+     *
      * This does not affect the state of any initialized module mapper, which is still
      * cleaned up during destruction.
      */
@@ -543,10 +699,114 @@ public:
         // Just a clear() does not release all memory held by the unordered_map. So we
         // need to fully replace it with a new one.
         decode_cache_ = std::unordered_map<app_pc, DecodeInfo>();
+        shared_view_ = std::unordered_map<app_pc, DecodeInfo *>();
+        release_shared();
     }
 
 private:
+    // Stops using the shared entries, which shared_view_ must no longer point to.
+    void
+    release_shared()
+    {
+        if (shared_user_) {
+            shared_->remove_user();
+            shared_user_ = false;
+        }
+    }
+
+    // Decodes the instruction at decode_pc if requested and fills in info.
+    std::string
+    decode_and_set(const dynamorio::drmemtrace::_memref_instr_t &memref_instr,
+                   app_pc decode_pc, DecodeInfo &info)
+    {
+        const app_pc trace_pc = reinterpret_cast<app_pc>(memref_instr.addr);
+        // Optionally decode the instruction.
+        instr_t *instr = nullptr;
+        instr_noalloc_t noalloc;
+        if (include_decoded_instr_) {
+            if (persist_decoded_instr_) {
+                instr = instr_create(dcontext_);
+            } else {
+                instr_noalloc_init(dcontext_, &noalloc);
+                instr = instr_from_noalloc(&noalloc);
+            }
+
+            app_pc next_pc = decode_from_copy(dcontext_, decode_pc, trace_pc, instr);
+            if (next_pc == nullptr || !instr_valid(instr)) {
+                if (persist_decoded_instr_) {
+                    instr_destroy(dcontext_, instr);
+                }
+                info.error_string_ = "decode_from_copy failed";
+                return info.get_error_string();
+            }
+        }
+        info.set_decode_info(dcontext_, memref_instr, instr, decode_pc);
+        return info.get_error_string();
+    }
+
+    // The add_decode_info() implementation when a shared cache is in use.
+    // shared_view_ is a private first-level index into the shared entries so that
+    // repeated lookups of the same pc need no locking at all.
+    std::string
+    add_shared_decode_info(const dynamorio::drmemtrace::_memref_instr_t &memref_instr,
+                           DecodeInfo *&cached_decode_info)
+    {
+        const app_pc trace_pc = reinterpret_cast<app_pc>(memref_instr.addr);
+        auto it_view = shared_view_.find(trace_pc);
+        if (it_view != shared_view_.end() &&
+            (use_module_mapper_ || !memref_instr.encoding_is_new)) {
+            cached_decode_info = it_view->second;
+            return cached_decode_info->get_error_string();
+        }
+        if (!shared_user_) {
+            // We are being reused after clear_cache().
+            shared_->add_user();
+            shared_user_ = true;
+        }
+        shared_decode_cache_t::key_t key;
+        key.pc = trace_pc;
+        key.mode = shared_cache_mode(dcontext_);
+        key.type = static_cast<unsigned short>(memref_instr.type);
+        if (!use_module_mapper_) {
+            key.size = static_cast<unsigned short>(
+                std::min(memref_instr.size, static_cast<size_t>(MAX_ENCODING_LENGTH)));
+            memcpy(key.encoding, memref_instr.encoding, key.size);
+        }
+        shared_decode_cache_t::entry_t *entry = shared_->find_or_add(key);
+        decode_info_base_t *info = entry->get_slot(shared_slot_);
+        if (info == nullptr) {
+            app_pc decode_pc;
+            if (!use_module_mapper_) {
+                decode_pc = const_cast<app_pc>(memref_instr.encoding);
+            } else {
+                std::string err = find_mapped_trace_address(trace_pc, decode_pc);
+                if (!err.empty()) {
+                    // Mapping failures are specific to this instance's module
+                    // lookup state, so they are recorded privately.
+                    DecodeInfo &failed = decode_cache_[trace_pc];
+                    failed = DecodeInfo();
+                    failed.error_string_ = err;
+                    shared_view_[trace_pc] = &failed;
+                    cached_decode_info = &failed;
+                    return err;
+                }
+            }
+            DecodeInfo *new_info = new DecodeInfo();
+            decode_and_set(memref_instr, decode_pc, *new_info);
+            info = entry->set_slot_if_unset(shared_slot_, new_info);
+        }
+        cached_decode_info = static_cast<DecodeInfo *>(info);
+        shared_view_[trace_pc] = cached_decode_info;
+        return cached_decode_info->get_error_string();
+    }
+
     std::unordered_map<app_pc, DecodeInfo> decode_cache_;
+    // Used instead of decode_cache_ when shared_ is set.
+    std::unordered_map<app_pc, DecodeInfo *> shared_view_;
+    shared_decode_cache_t *shared_ = nullptr;
+    int shared_slot_ = -1;
+    // Whether we are counted as a user of shared_.
+    bool shared_user_ = false;
     void *dcontext_ = nullptr;
     std::mutex dcontext_mutex_;
     bool include_decoded_instr_ = false;
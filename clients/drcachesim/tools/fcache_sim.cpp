@@ -0,0 +1,618 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "fcache_sim.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "fcache_sim_create.h"
+#include "memref.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+const std::string fcache_sim_t::TOOL_NAME = "Code cache simulator";
+
+static bool
+parse_config_value(const std::string &value, uint64_t &result)
+{
+    if (value == "true") {
+        result = 1;
+        return true;
+    }
+    if (value == "false") {
+        result = 0;
+        return true;
+    }
+    if (value.empty())
+        return false;
+    char *end;
+    result = strtoull(value.c_str(), &end, 0);
+    if (*end == 'K' || *end == 'k') {
+        result *= 1024;
+        ++end;
+    } else if (*end == 'M' || *end == 'm') {
+        result *= 1024 * 1024;
+        ++end;
+    }
+    return *end == '\0';
+}
+
+std::string
+fcache_sim_parse_configs(const std::string &spec,
+                         std::vector<fcache_sim_config_t> &configs)
+{
+    configs.clear();
+    std::stringstream config_stream(spec);
+    std::string config_spec;
+    while (std::getline(config_stream, config_spec, ':')) {
+        fcache_sim_config_t config;
+        std::stringstream field_stream(config_spec);
+        std::string field;
+        while (std::getline(field_stream, field, ',')) {
+            if (field.empty())
+                continue;
+            size_t eq = field.find('=');
+            if (eq == std::string::npos)
+                return "Invalid field \"" + field + "\": expected name=value";
+            std::string name = field.substr(0, eq);
+            uint64_t value;
+            if (!parse_config_value(field.substr(eq + 1), value))
+                return "Invalid value for \"" + name + "\"";
+            if (name == "trace_threshold")
+                config.trace_threshold = static_cast<unsigned int>(value);
+            else if (name == "max_trace_bbs")
+                config.max_trace_bbs = static_cast<unsigned int>(value);
+            else if (name == "max_bb_instrs")
+                config.max_bb_instrs = static_cast<unsigned int>(value);
+            else if (name == "cache_bb_max")
+                config.cache_bb_max = value;
+            else if (name == "cache_trace_max")
+                config.cache_trace_max = value;
+            else if (name == "cache_bb_unit_init")
+                config.cache_bb_unit_init = value;
+            else if (name == "cache_bb_unit_max")
+                config.cache_bb_unit_max = value;
+            else if (name == "cache_trace_unit_init")
+                config.cache_trace_unit_init = value;
+            else if (name == "cache_trace_unit_max")
+                config.cache_trace_unit_max = value;
+            else if (name == "ibl_table_init")
+                config.ibl_table_init = static_cast<unsigned int>(value);
+            else if (name == "ibl_table_load")
+                config.ibl_table_load = static_cast<unsigned int>(value);
+            else if (name == "bb_ibl_targets")
+                config.bb_ibl_targets = value != 0;
+            else
+                return "Unknown field \"" + name + "\"";
+        }
+        if (config.max_trace_bbs == 0 || config.max_bb_instrs == 0)
+            return "max_trace_bbs and max_bb_instrs must be positive";
+        if (config.cache_bb_unit_init == 0 ||
+            config.cache_bb_unit_max < config.cache_bb_unit_init ||
+            config.cache_trace_unit_init == 0 ||
+            config.cache_trace_unit_max < config.cache_trace_unit_init)
+            return "Cache units must be positive and no larger than their maximum";
+        if (config.ibl_table_init == 0 || config.ibl_table_init > 30)
+            return "ibl_table_init must be between 1 and 30";
+        if (config.ibl_table_load == 0 || config.ibl_table_load > 100)
+            return "ibl_table_load must be between 1 and 100";
+        configs.push_back(config);
+    }
+    if (configs.empty())
+        configs.emplace_back();
+    return "";
+}
+
+analysis_tool_t *
+fcache_sim_tool_create(const std::vector<fcache_sim_config_t> &configs,
+                       unsigned int verbose)
+{
+    return new fcache_sim_t(configs, verbose);
+}
+
+fcache_sim_t::fcache_sim_t(const std::vector<fcache_sim_config_t> &configs,
+                           unsigned int verbose)
+    : knob_verbose_(verbose)
+{
+    for (const auto &config : configs)
+        sims_.emplace_back(new config_sim_t(config));
+}
+
+fcache_sim_t::~fcache_sim_t()
+{
+}
+
+bool
+fcache_sim_t::parallel_shard_supported()
+{
+    return false;
+}
+
+bool
+fcache_sim_t::process_memref(const memref_t &memref)
+{
+    if (type_is_instr(memref.instr.type)) {
+        for (auto &sim : sims_)
+            sim->process_instr(memref);
+    } else if (memref.marker.type == TRACE_TYPE_MARKER &&
+               (memref.marker.marker_type == TRACE_MARKER_TYPE_KERNEL_EVENT ||
+                memref.marker.marker_type == TRACE_MARKER_TYPE_KERNEL_XFER)) {
+        for (auto &sim : sims_)
+            sim->process_kernel_event(memref.marker.tid);
+    } else if (memref.exit.type == TRACE_TYPE_THREAD_EXIT) {
+        for (auto &sim : sims_)
+            sim->process_thread_exit(memref.exit.tid);
+    }
+    return true;
+}
+
+fcache_sim_t::statistics_t
+fcache_sim_t::get_statistics(size_t config) const
+{
+    return sims_[config]->get_statistics();
+}
+
+std::string
+fcache_sim_t::config_to_string(const fcache_sim_config_t &config)
+{
+    std::stringstream ss;
+    ss << "trace_threshold=" << config.trace_threshold
+       << ",max_trace_bbs=" << config.max_trace_bbs
+       << ",max_bb_instrs=" << config.max_bb_instrs
+       << ",cache_bb_max=" << config.cache_bb_max
+       << ",cache_trace_max=" << config.cache_trace_max
+       << ",cache_bb_unit_init=" << config.cache_bb_unit_init
+       << ",cache_bb_unit_max=" << config.cache_bb_unit_max
+       << ",cache_trace_unit_init=" << config.cache_trace_unit_init
+       << ",cache_trace_unit_max=" << config.cache_trace_unit_max
+       << ",ibl_table_init=" << config.ibl_table_init
+       << ",ibl_table_load=" << config.ibl_table_load
+       << ",bb_ibl_targets=" << (config.bb_ibl_targets ? "true" : "false");
+    return ss.str();
+}
+
+bool
+fcache_sim_t::print_results()
+{
+    std::cerr << TOOL_NAME << " results:\n";
+    std::cerr.imbue(std::locale("")); // Add commas, at least for my locale
+    const std::string prefix = "    ";
+    auto print_count = [&prefix](const std::string &label, uint64_t value) {
+        std::cerr << prefix << std::setw(40) << std::left << label << std::setw(16)
+                  << std::right << value << std::endl;
+    };
+    auto print_percent = [&prefix](const std::string &label, uint64_t numerator,
+                                   uint64_t denominator) {
+        if (denominator == 0)
+            return;
+        std::cerr << prefix << std::setw(40) << std::left << label << std::setw(15)
+                  << std::fixed << std::setprecision(2) << std::right
+                  << 100.0 * numerator / denominator << "%" << std::endl;
+    };
+    auto print_cache = [&](const std::string &name, const cache_statistics_t &cache) {
+        print_count(name + "s built:", cache.fragments_built);
+        print_count(name + "s rebuilt after eviction:", cache.fragments_rebuilt);
+        print_count(name + "s evicted:", cache.evictions);
+        print_count(name + " cache peak live bytes:", cache.peak_used_bytes);
+        print_count(name + " cache units:", cache.units);
+        print_count(name + " cache footprint bytes:", cache.footprint_bytes);
+    };
+    for (size_t i = 0; i < sims_.size(); ++i) {
+        sims_[i]->finish();
+        const statistics_t stats = sims_[i]->get_statistics();
+        std::cerr << "  Configuration #" << i << ": "
+                  << config_to_string(sims_[i]->get_config()) << "\n";
+        print_count("Instructions:", stats.instrs);
+        print_count("Instructions in traces:", stats.trace_instrs);
+        print_percent("Trace coverage:", stats.trace_instrs, stats.instrs);
+        print_count("Dispatcher entries:", stats.dispatch_entries);
+        print_count("Trace head entries:", stats.trace_head_entries);
+        print_cache("Basic block", stats.bb_cache);
+        print_cache("Trace", stats.trace_cache);
+        print_count("Indirect branches:", stats.indirect_branches);
+        print_count("Inlined trace target hits:", stats.ibl_inlined);
+        print_count("Lookup table lookups:", stats.ibl_lookups);
+        print_count("Lookup table misses:", stats.ibl_misses);
+        print_percent("Lookup table miss rate:", stats.ibl_misses, stats.ibl_lookups);
+        print_count("Lookup table resizes:", stats.ibl_table_resizes);
+        print_count("Lookup table bytes:", stats.ibl_table_bytes);
+    }
+    return true;
+}
+
+fcache_sim_t::config_sim_t::config_sim_t(const fcache_sim_config_t &config)
+    : config_(config)
+    , bb_cache_(config.cache_bb_max, config.cache_bb_unit_init,
+                config.cache_bb_unit_max)
+    , trace_cache_(config.cache_trace_max, config.cache_trace_unit_init,
+                   config.cache_trace_unit_max)
+{
+}
+
+void
+fcache_sim_t::config_sim_t::process_instr(const memref_t &memref)
+{
+    auto res = threads_.emplace(memref.instr.tid, thread_t());
+    thread_t &thread = res.first->second;
+    if (res.second) {
+        for (int i = 0; i < IBL_TYPE_COUNT; ++i)
+            thread.ibl[i].bits = config_.ibl_table_init;
+    }
+    addr_t pc = memref.instr.addr;
+    // DynamoRIO ends a block at every branch and system call.  We also end one
+    // at a discontinuity, which is a kernel transfer or a gap in the trace.
+    if (thread.have_block &&
+        (type_is_instr_branch(thread.last_type) ||
+         thread.last_type == TRACE_TYPE_INSTR_SYSENTER || thread.interrupted ||
+         pc != thread.last_pc + thread.last_size ||
+         thread.block_instrs >= config_.max_bb_instrs))
+        end_block(thread, pc);
+    if (!thread.have_block) {
+        thread.have_block = true;
+        thread.block_tag = pc;
+        thread.block_instrs = 0;
+        thread.block_bytes = 0;
+    }
+    ++thread.block_instrs;
+    thread.block_bytes += memref.instr.size;
+    thread.last_pc = pc;
+    thread.last_size = memref.instr.size;
+    thread.last_type = memref.instr.type;
+}
+
+void
+fcache_sim_t::config_sim_t::process_kernel_event(memref_tid_t tid)
+{
+    auto it = threads_.find(tid);
+    if (it == threads_.end())
+        return;
+    if (it->second.have_block)
+        it->second.interrupted = true;
+    else
+        it->second.arrival = ARRIVE_DISPATCH;
+}
+
+void
+fcache_sim_t::config_sim_t::process_thread_exit(memref_tid_t tid)
+{
+    auto it = threads_.find(tid);
+    if (it == threads_.end())
+        return;
+    retire_thread(it->second);
+    threads_.erase(it);
+}
+
+void
+fcache_sim_t::config_sim_t::finish()
+{
+    for (auto &[tid, thread] : threads_) {
+        if (thread.have_block)
+            flush_block(thread);
+    }
+}
+
+void
+fcache_sim_t::config_sim_t::retire_thread(thread_t &thread)
+{
+    if (thread.have_block)
+        flush_block(thread);
+    for (int i = 0; i < IBL_TYPE_COUNT; ++i)
+        stats_.ibl_table_bytes += (1ULL << thread.ibl[i].bits) * IBL_ENTRY_BYTES;
+}
+
+fcache_sim_t::statistics_t
+fcache_sim_t::config_sim_t::get_statistics() const
+{
+    statistics_t stats = stats_;
+    stats.bb_cache = bb_cache_.stats;
+    stats.trace_cache = trace_cache_.stats;
+    for (const auto &[tid, thread] : threads_) {
+        for (int i = 0; i < IBL_TYPE_COUNT; ++i)
+            stats.ibl_table_bytes += (1ULL << thread.ibl[i].bits) * IBL_ENTRY_BYTES;
+    }
+    return stats;
+}
+
+void
+fcache_sim_t::config_sim_t::flush_block(thread_t &thread)
+{
+    addr_t tag = thread.block_tag;
+    trace_type_t type = thread.last_type;
+    bool indirect = type_is_instr_branch(type) && !type_is_instr_direct_branch(type);
+    fragment_t &frag = fragments_[tag];
+    if (!frag.built) {
+        // A block's shape is fixed once DynamoRIO first builds it.
+        frag.app_bytes = thread.block_bytes;
+        frag.ends_in_indirect = indirect;
+        if (indirect)
+            frag.direct_exits = 0;
+        else if (type_is_instr_conditional_branch(type))
+            frag.direct_exits = 2;
+        else
+            frag.direct_exits = 1;
+    }
+    execute_block(thread, tag, thread.block_instrs);
+    thread.have_block = false;
+}
+
+void
+fcache_sim_t::config_sim_t::end_block(thread_t &thread, addr_t next_pc)
+{
+    addr_t tag = thread.block_tag;
+    trace_type_t type = thread.last_type;
+    bool indirect = type_is_instr_branch(type) && !type_is_instr_direct_branch(type);
+    flush_block(thread);
+    // On Linux, system calls are executed from the dispatcher.
+    if (thread.interrupted || type == TRACE_TYPE_INSTR_SYSENTER ||
+        (!type_is_instr_branch(type) && next_pc != thread.last_pc + thread.last_size)) {
+        thread.arrival = ARRIVE_DISPATCH;
+        thread.interrupted = false;
+    } else if (indirect) {
+        ++stats_.indirect_branches;
+        thread.arrival = ARRIVE_INDIRECT;
+        if (type == TRACE_TYPE_INSTR_RETURN)
+            thread.arrival_ibl = IBL_RETURN;
+        else if (type == TRACE_TYPE_INSTR_INDIRECT_CALL)
+            thread.arrival_ibl = IBL_INDIRECT_CALL;
+        else
+            thread.arrival_ibl = IBL_INDIRECT_JUMP;
+    } else {
+        thread.arrival = ARRIVE_DIRECT;
+        thread.arrival_backward = next_pc <= tag;
+    }
+}
+
+void
+fcache_sim_t::config_sim_t::execute_block(thread_t &thread, addr_t tag,
+                                          unsigned int instrs)
+{
+    stats_.instrs += instrs;
+    const arrival_t arrival = thread.arrival;
+    bool from_trace = false;
+    if (thread.trace_tag != 0) {
+        const trace_t &trace = traces_[thread.trace_tag];
+        if (trace.in_cache && trace.generation == thread.trace_generation &&
+            thread.trace_pos < trace.tags.size() && trace.tags[thread.trace_pos] == tag) {
+            // Still on the trace's recorded path.
+            ++thread.trace_pos;
+            stats_.trace_instrs += instrs;
+            if (arrival == ARRIVE_INDIRECT)
+                ++stats_.ibl_inlined;
+            return;
+        }
+        thread.trace_tag = 0;
+        from_trace = true;
+    }
+    bool dispatch = arrival == ARRIVE_DISPATCH;
+    bool ibl_miss = false;
+    ibl_table_t &table = thread.ibl[thread.arrival_ibl];
+    if (arrival == ARRIVE_INDIRECT) {
+        ++stats_.ibl_lookups;
+        uint64_t key = ibl_target_key(tag);
+        auto it = table.targets.find(tag);
+        if (key == 0 || it == table.targets.end() || it->second != key) {
+            ++stats_.ibl_misses;
+            ibl_miss = true;
+            dispatch = true;
+        }
+    }
+    fragment_t &frag = fragments_[tag];
+    // A trace head is the target of a backward direct branch or of a trace exit.
+    if (traces_enabled() &&
+        (from_trace || (arrival == ARRIVE_DIRECT && thread.arrival_backward)))
+        frag.is_trace_head = true;
+    auto trace_it = traces_.find(tag);
+    bool have_trace = trace_it != traces_.end() && trace_it->second.in_cache;
+    // Recording stops at a trace head or an existing trace.
+    if (thread.recording && !thread.recorded.empty() &&
+        (frag.is_trace_head || have_trace)) {
+        finish_trace(thread);
+        trace_it = traces_.find(tag);
+        have_trace = trace_it != traces_.end() && trace_it->second.in_cache;
+    }
+    if (have_trace) {
+        if (ibl_miss)
+            ibl_add(table, tag, ibl_target_key(tag));
+        if (dispatch)
+            ++stats_.dispatch_entries;
+        thread.trace_tag = tag;
+        thread.trace_generation = trace_it->second.generation;
+        thread.trace_pos = 1;
+        stats_.trace_instrs += instrs;
+        return;
+    }
+    if (!frag.in_cache) {
+        if (frag.built)
+            ++bb_cache_.stats.fragments_rebuilt;
+        frag.built = true;
+        frag.in_cache = true;
+        ++bb_cache_.stats.fragments_built;
+        cache_add(bb_cache_, tag, bb_size(frag), /*is_trace=*/false);
+        dispatch = true;
+    }
+    if (frag.is_trace_head) {
+        // Trace heads are left unlinked so that each entry reaches the
+        // dispatcher, which counts it.
+        dispatch = true;
+        ++stats_.trace_head_entries;
+        if (!thread.recording && ++frag.head_count >= config_.trace_threshold) {
+            frag.head_count = 0;
+            thread.recording = true;
+            thread.recorded.clear();
+        }
+    }
+    if (ibl_miss && bbs_are_ibl_targets())
+        ibl_add(table, tag, ibl_target_key(tag));
+    if (dispatch)
+        ++stats_.dispatch_entries;
+    if (thread.recording) {
+        thread.recorded.push_back(tag);
+        if (thread.recorded.size() >= config_.max_trace_bbs)
+            finish_trace(thread);
+    }
+}
+
+void
+fcache_sim_t::config_sim_t::finish_trace(thread_t &thread)
+{
+    thread.recording = false;
+    if (thread.recorded.empty())
+        return;
+    addr_t head = thread.recorded[0];
+    trace_t &trace = traces_[head];
+    // Another thread may have finished the same trace first.
+    if (!trace.in_cache) {
+        if (trace.built)
+            ++trace_cache_.stats.fragments_rebuilt;
+        trace.built = true;
+        trace.in_cache = true;
+        trace.tags = std::move(thread.recorded);
+        trace.size = trace_size(trace.tags);
+        ++trace_cache_.stats.fragments_built;
+        cache_add(trace_cache_, head, trace.size, /*is_trace=*/true);
+    }
+    thread.recorded.clear();
+}
+
+uint64_t
+fcache_sim_t::config_sim_t::bb_size(const fragment_t &frag) const
+{
+    return frag.app_bytes + frag.direct_exits * DIRECT_STUB_BYTES +
+        (frag.ends_in_indirect ? INDIRECT_EXIT_BYTES : 0) +
+        (bbs_are_ibl_targets() ? IBL_PREFIX_BYTES : 0);
+}
+
+uint64_t
+fcache_sim_t::config_sim_t::trace_size(const std::vector<addr_t> &tags)
+{
+    uint64_t size = IBL_PREFIX_BYTES;
+    for (size_t i = 0; i < tags.size(); ++i) {
+        const fragment_t &frag = fragments_[tags[i]];
+        size += frag.app_bytes;
+        if (i == tags.size() - 1) {
+            size += frag.direct_exits * DIRECT_STUB_BYTES +
+                (frag.ends_in_indirect ? INDIRECT_EXIT_BYTES : 0);
+        } else if (frag.ends_in_indirect) {
+            size += INLINE_IBL_CHECK_BYTES + INDIRECT_EXIT_BYTES;
+        } else if (frag.direct_exits > 1) {
+            // The path not taken while recording becomes a side exit; an
+            // unconditional jump to the next block is elided.
+            size += DIRECT_STUB_BYTES;
+        }
+    }
+    return size;
+}
+
+void
+fcache_sim_t::config_sim_t::cache_add(code_cache_t &cache, addr_t tag, uint64_t size,
+                                      bool is_trace)
+{
+    cache_statistics_t &stats = cache.stats;
+    while (cache.max_size > 0 && stats.used_bytes + size > cache.max_size &&
+           !cache.fifo.empty()) {
+        auto [victim, victim_size] = cache.fifo.front();
+        cache.fifo.pop_front();
+        stats.used_bytes -= victim_size;
+        ++stats.evictions;
+        if (is_trace) {
+            trace_t &trace = traces_[victim];
+            trace.in_cache = false;
+            ++trace.generation;
+        } else {
+            fragment_t &frag = fragments_[victim];
+            frag.in_cache = false;
+            ++frag.generation;
+        }
+    }
+    while (stats.used_bytes + size > stats.footprint_bytes &&
+           (cache.max_size == 0 || stats.footprint_bytes < cache.max_size)) {
+        uint64_t unit = cache.next_unit;
+        if (cache.max_size > 0)
+            unit = std::min(unit, cache.max_size - stats.footprint_bytes);
+        stats.footprint_bytes += unit;
+        ++stats.units;
+        cache.next_unit = std::min(cache.next_unit * 2, cache.unit_max);
+    }
+    stats.used_bytes += size;
+    stats.peak_used_bytes = std::max(stats.peak_used_bytes, stats.used_bytes);
+    cache.fifo.emplace_back(tag, size);
+}
+
+uint64_t
+fcache_sim_t::config_sim_t::ibl_target_key(addr_t tag)
+{
+    // The low bit distinguishes a trace from a block with the same tag.
+    auto trace_it = traces_.find(tag);
+    if (trace_it != traces_.end() && trace_it->second.in_cache)
+        return ((trace_it->second.generation + 1) << 1) | 1;
+    if (!bbs_are_ibl_targets())
+        return 0;
+    auto frag_it = fragments_.find(tag);
+    if (frag_it != fragments_.end() && frag_it->second.in_cache)
+        return (frag_it->second.generation + 1) << 1;
+    return 0;
+}
+
+void
+fcache_sim_t::config_sim_t::ibl_add(ibl_table_t &table, addr_t tag, uint64_t key)
+{
+    if (key == 0)
+        return;
+    auto res = table.targets.emplace(tag, key);
+    if (!res.second) {
+        res.first->second = key;
+        return;
+    }
+    while (table.targets.size() * 100 > (1ULL << table.bits) * config_.ibl_table_load) {
+        ++table.bits;
+        ++stats_.ibl_table_resizes;
+    }
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,284 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* fcache_sim: replays a trace through a model of DynamoRIO's own code cache to
+ * predict how a set of cache options would behave on the traced application.
+ */
+
+#ifndef _FCACHE_SIM_H_
+#define _FCACHE_SIM_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "fcache_sim_create.h"
+#include "memref.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+class fcache_sim_t : public analysis_tool_t {
+public:
+    fcache_sim_t(const std::vector<fcache_sim_config_t> &configs, unsigned int verbose);
+    virtual ~fcache_sim_t();
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+    // The caches are shared by all threads, so this tool is serial only.
+    bool
+    parallel_shard_supported() override;
+
+    struct cache_statistics_t {
+        uint64_t fragments_built = 0;
+        // Fragments built again after being evicted.
+        uint64_t fragments_rebuilt = 0;
+        uint64_t evictions = 0;
+        // Bytes of live fragments, at the end and at the peak.
+        uint64_t used_bytes = 0;
+        uint64_t peak_used_bytes = 0;
+        // Bytes of allocated units.
+        uint64_t footprint_bytes = 0;
+        uint64_t units = 0;
+    };
+
+    struct statistics_t {
+        uint64_t instrs = 0;
+        uint64_t trace_instrs = 0;
+        // Entries into the cache from DynamoRIO's dispatcher: first executions,
+        // unlinked transfers such as into trace heads, and lookup misses.
+        uint64_t dispatch_entries = 0;
+        uint64_t trace_head_entries = 0;
+        cache_statistics_t bb_cache;
+        cache_statistics_t trace_cache;
+        uint64_t indirect_branches = 0;
+        // Indirect branches inside a trace whose target matched the trace's
+        // inlined check and so needed no lookup.
+        uint64_t ibl_inlined = 0;
+        uint64_t ibl_lookups = 0;
+        uint64_t ibl_misses = 0;
+        uint64_t ibl_table_resizes = 0;
+        // The final size of every thread's tables, summed.
+        uint64_t ibl_table_bytes = 0;
+    };
+
+    // Returns the statistics of the configuration at index "config" as passed
+    // to the constructor.
+    statistics_t
+    get_statistics(size_t config) const;
+
+    static std::string
+    config_to_string(const fcache_sim_config_t &config);
+
+protected:
+    // Approximate x86-64 sizes of the code DynamoRIO adds to fragments.
+    // A direct exit stub spills xax, loads its linkstub, and jumps to dispatch.
+    static constexpr uint64_t DIRECT_STUB_BYTES = 23;
+    // Spill, target materialization, and jump to the lookup routine, plus a stub.
+    static constexpr uint64_t INDIRECT_EXIT_BYTES = 30;
+    // A trace's inlined comparison against the recorded target.
+    static constexpr uint64_t INLINE_IBL_CHECK_BYTES = 20;
+    // The prefix that restores the lookup routine's spill at lookup targets.
+    static constexpr uint64_t IBL_PREFIX_BYTES = 9;
+    // A lookup table entry holds a tag and a start pc.
+    static constexpr uint64_t IBL_ENTRY_BYTES = 16;
+
+    // DynamoRIO keeps a separate lookup table per indirect branch type.
+    enum ibl_type_t {
+        IBL_RETURN,
+        IBL_INDIRECT_CALL,
+        IBL_INDIRECT_JUMP,
+        IBL_TYPE_COUNT,
+    };
+
+    // How control reaches the next block.
+    enum arrival_t {
+        // From the dispatcher: the first block of a thread, or after a kernel
+        // event such as a signal.
+        ARRIVE_DISPATCH,
+        ARRIVE_DIRECT,
+        ARRIVE_INDIRECT,
+    };
+
+    struct fragment_t {
+        uint64_t app_bytes = 0;
+        // Exit stubs for direct branches and fall-throughs.
+        unsigned int direct_exits = 0;
+        bool ends_in_indirect = false;
+        bool built = false;
+        bool in_cache = false;
+        bool is_trace_head = false;
+        unsigned int head_count = 0;
+        // Incremented on each eviction so stale lookup table entries miss.
+        uint64_t generation = 0;
+    };
+
+    struct trace_t {
+        std::vector<addr_t> tags;
+        uint64_t size = 0;
+        bool built = false;
+        bool in_cache = false;
+        uint64_t generation = 0;
+    };
+
+    struct ibl_table_t {
+        unsigned int bits = 0;
+        // Maps a tag to the generation of the target it was added for.
+        std::unordered_map<addr_t, uint64_t> targets;
+    };
+
+    struct thread_t {
+        // The block being formed from the instruction stream.
+        bool have_block = false;
+        addr_t block_tag = 0;
+        unsigned int block_instrs = 0;
+        uint64_t block_bytes = 0;
+        addr_t last_pc = 0;
+        size_t last_size = 0;
+        trace_type_t last_type = TRACE_TYPE_INSTR;
+        bool interrupted = false;
+        // How the next block is reached.
+        arrival_t arrival = ARRIVE_DISPATCH;
+        ibl_type_t arrival_ibl = IBL_RETURN;
+        bool arrival_backward = false;
+        // The trace being executed, if any.
+        addr_t trace_tag = 0;
+        uint64_t trace_generation = 0;
+        size_t trace_pos = 0;
+        // The trace being recorded, if any.
+        bool recording = false;
+        std::vector<addr_t> recorded;
+        ibl_table_t ibl[IBL_TYPE_COUNT];
+    };
+
+    struct code_cache_t {
+        explicit code_cache_t(uint64_t max, uint64_t unit_init, uint64_t unit_max)
+            : max_size(max)
+            , next_unit(unit_init)
+            , unit_max(unit_max)
+        {
+        }
+        uint64_t max_size;
+        uint64_t next_unit;
+        uint64_t unit_max;
+        // Oldest first: the tag and size of each live fragment.
+        std::deque<std::pair<addr_t, uint64_t>> fifo;
+        cache_statistics_t stats;
+    };
+
+    // The model for one configuration.
+    class config_sim_t {
+    public:
+        explicit config_sim_t(const fcache_sim_config_t &config);
+        void
+        process_instr(const memref_t &memref);
+        void
+        process_kernel_event(memref_tid_t tid);
+        void
+        process_thread_exit(memref_tid_t tid);
+        // Finishes the pending block of each live thread.
+        void
+        finish();
+        const fcache_sim_config_t &
+        get_config() const
+        {
+            return config_;
+        }
+        statistics_t
+        get_statistics() const;
+
+    private:
+        bool
+        traces_enabled() const
+        {
+            return config_.trace_threshold > 0;
+        }
+        bool
+        bbs_are_ibl_targets() const
+        {
+            return config_.bb_ibl_targets || !traces_enabled();
+        }
+        // Builds or finds the thread's pending block and executes it.
+        void
+        flush_block(thread_t &thread);
+        // Flushes the pending block and records how control reaches next_pc.
+        void
+        end_block(thread_t &thread, addr_t next_pc);
+        void
+        execute_block(thread_t &thread, addr_t tag, unsigned int instrs);
+        void
+        finish_trace(thread_t &thread);
+        uint64_t
+        bb_size(const fragment_t &frag) const;
+        uint64_t
+        trace_size(const std::vector<addr_t> &tags);
+        // Adds a fragment to "cache", evicting the oldest fragments first if
+        // that would exceed its maximum size.
+        void
+        cache_add(code_cache_t &cache, addr_t tag, uint64_t size, bool is_trace);
+        // Returns the lookup table key of the current lookup target for "tag",
+        // or 0 if there is none.
+        uint64_t
+        ibl_target_key(addr_t tag);
+        void
+        ibl_add(ibl_table_t &table, addr_t tag, uint64_t key);
+        void
+        retire_thread(thread_t &thread);
+
+        fcache_sim_config_t config_;
+        std::unordered_map<memref_tid_t, thread_t> threads_;
+        std::unordered_map<addr_t, fragment_t> fragments_;
+        std::unordered_map<addr_t, trace_t> traces_;
+        code_cache_t bb_cache_;
+        code_cache_t trace_cache_;
+        statistics_t stats_;
+    };
+
+    std::vector<std::unique_ptr<config_sim_t>> sims_;
+    unsigned int knob_verbose_;
+
+    static const std::string TOOL_NAME;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _FCACHE_SIM_H_ */
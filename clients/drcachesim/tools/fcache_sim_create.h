@@ -0,0 +1,135 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* fcache simulator tool creation */
+
+#ifndef _FCACHE_SIM_CREATE_H_
+#define _FCACHE_SIM_CREATE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "analysis_tool.h"
+
+/**
+ * @file drmemtrace/fcache_sim_create.h
+ * @brief DrMemtrace DynamoRIO code cache simulator creation.
+ */
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * One candidate set of DynamoRIO code cache options for fcache_sim_tool_create().
+ * Each field is named after, and defaults to the x86-64 default of, the
+ * corresponding DynamoRIO runtime option.
+ */
+struct fcache_sim_config_t {
+    fcache_sim_config_t()
+        : trace_threshold(50)
+        , max_trace_bbs(128)
+        , max_bb_instrs(256)
+        , cache_bb_max(0)
+        , cache_trace_max(0)
+        , cache_bb_unit_init(56 * 1024)
+        , cache_bb_unit_max(56 * 1024)
+        , cache_trace_unit_init(56 * 1024)
+        , cache_trace_unit_max(56 * 1024)
+        , ibl_table_init(7)
+        , ibl_table_load(50)
+        , bb_ibl_targets(false)
+    {
+    }
+    /**
+     * The number of times a trace head must be reached before a trace is built
+     * from it.  0 disables traces, like DynamoRIO's -disable_traces.
+     */
+    unsigned int trace_threshold;
+    /** The maximum number of basic blocks in one trace. */
+    unsigned int max_trace_bbs;
+    /** The maximum number of instructions in one basic block. */
+    unsigned int max_bb_instrs;
+    /**
+     * The maximum size in bytes of the basic block cache.  Once full, the oldest
+     * blocks are evicted first.  0 means unlimited.
+     */
+    uint64_t cache_bb_max;
+    /** Like \p cache_bb_max, for the trace cache. */
+    uint64_t cache_trace_max;
+    /** The size of the first basic block cache unit. */
+    uint64_t cache_bb_unit_init;
+    /** Each new basic block cache unit doubles in size up to this size. */
+    uint64_t cache_bb_unit_max;
+    /** The size of the first trace cache unit. */
+    uint64_t cache_trace_unit_init;
+    /** Each new trace cache unit doubles in size up to this size. */
+    uint64_t cache_trace_unit_max;
+    /** The initial size, as a power of 2, of each indirect branch lookup table. */
+    unsigned int ibl_table_init;
+    /** The load factor percentage at which an indirect branch table is doubled. */
+    unsigned int ibl_table_load;
+    /**
+     * Whether basic blocks, and not just traces, are indirect branch lookup
+     * targets.  This is always the case when traces are disabled.
+     */
+    bool bb_ibl_targets;
+};
+
+/**
+ * Parses \p spec into \p configs.  The spec is a ':'-separated list of
+ * configurations, each a ','-separated list of name=value pairs naming the fields
+ * of #dynamorio::drmemtrace::fcache_sim_config_t; fields that are not named keep
+ * their defaults.  Sizes accept a K or M suffix.  An empty spec produces a single
+ * default configuration.  Returns an empty string on success or an error message.
+ */
+std::string
+fcache_sim_parse_configs(const std::string &spec,
+                         std::vector<fcache_sim_config_t> &configs);
+
+/**
+ * Creates an analysis tool which replays the instructions in a trace through a
+ * model of DynamoRIO's basic block and trace building, code cache units and
+ * eviction, and indirect branch lookup tables, once per configuration in
+ * \p configs.  It reports the predicted fragment counts, cache footprint,
+ * indirect branch lookup misses, and trace coverage of each configuration.
+ */
+analysis_tool_t *
+fcache_sim_tool_create(const std::vector<fcache_sim_config_t> &configs,
+                       unsigned int verbose = 0);
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _FCACHE_SIM_CREATE_H_ */
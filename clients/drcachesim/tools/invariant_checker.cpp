@@ -40,6 +40,7 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <stack>
 #include <string>
 #include <unordered_map>
@@ -235,9 +236,93 @@ invariant_checker_t::parallel_shard_exit(void *shard_data)
         report_if_false(shard, shard->expected_write_records_ == 0,
                         "Missing write records");
     }
+    summarize_shard(shard);
     return true;
 }
 
+void
+invariant_checker_t::summarize_shard(per_shard_t *shard)
+{
+    shard_summary_t summary;
+    summary.shard_id = shard->shard_id_;
+    summary.tid = shard->tid_;
+    summary.pid = shard->pid_;
+    summary.file_type = shard->file_type_;
+    summary.saw_filetype = shard->saw_filetype_;
+    summary.trace_version = shard->trace_version_;
+    summary.cache_line_size = shard->cache_line_size_;
+    summary.page_size = shard->page_size_;
+    summary.chunk_instr_count = shard->chunk_instr_count_;
+    summary.last_timestamp = shard->last_timestamp_;
+    summary.sched_data = std::move(shard->sched_data_);
+    // The remaining state is only needed while processing the shard. We keep
+    // the per_shard_t itself for its error count.
+    shard->decode_cache_.reset();
+    shard->retaddr_stack_ = std::stack<addr_t>();
+#ifdef UNIX
+    shard->context_stack_ = std::stack<per_shard_t::signal_context>();
+#endif
+    shard->saw_switch_trace_.clear();
+    shard->saw_syscall_trace_.clear();
+    std::lock_guard<std::mutex> guard(summary_mutex_);
+    shard_summaries_.push_back(std::move(summary));
+}
+
+void
+invariant_checker_t::check_cross_shard_invariants(per_shard_t *global)
+{
+    // Report in a deterministic order regardless of shard exit order.
+    std::sort(shard_summaries_.begin(), shard_summaries_.end(),
+              [](const shard_summary_t &a, const shard_summary_t &b) {
+                  return a.shard_id < b.shard_id;
+              });
+    // These checks are about the threads of a process, which are mixed together
+    // in core-sharded traces.
+    if (core_sharded_)
+        return;
+    // Use a synthetic stream object to allow report_if_false to work normally.
+    auto stream = std::unique_ptr<memtrace_stream_t>(
+        new default_memtrace_stream_t(&global->ref_count_));
+    global->stream = stream.get();
+    // Each thread must be in exactly one shard, and the threads of one process
+    // must agree on the trace-wide properties. Each property is compared against
+    // the first shard of the process that recorded it.
+    std::set<std::pair<memref_pid_t, memref_tid_t>> seen_threads;
+    std::unordered_map<memref_pid_t, uint64_t> filetype, version, line_size, page_size,
+        chunk_size;
+    auto check_same = [&](std::unordered_map<memref_pid_t, uint64_t> &first,
+                          memref_pid_t pid, bool have_value, uint64_t value,
+                          const std::string &name) {
+        if (!have_value)
+            return;
+        auto it_inserted = first.emplace(pid, value);
+        report_if_false(global, it_inserted.first->second == value,
+                        "Inconsistent " + name + " among threads of a process");
+    };
+    for (const shard_summary_t &summary : shard_summaries_) {
+        if (summary.tid == IDLE_THREAD_ID || summary.tid == -1 ||
+            TESTANY(OFFLINE_FILE_TYPE_CORE_SHARDED, summary.file_type))
+            continue;
+        global->tid_ = summary.tid;
+        global->last_timestamp_ = summary.last_timestamp;
+        report_if_false(global, seen_threads.insert({ summary.pid, summary.tid }).second,
+                        "Thread appears in multiple shards");
+        check_same(filetype, summary.pid, summary.saw_filetype, summary.file_type,
+                   "file type");
+        check_same(version, summary.pid, summary.trace_version != 0,
+                   summary.trace_version, "version");
+        check_same(line_size, summary.pid, summary.cache_line_size != 0,
+                   summary.cache_line_size, "cache line size");
+        check_same(page_size, summary.pid, summary.page_size != 0, summary.page_size,
+                   "page size");
+        check_same(chunk_size, summary.pid, summary.chunk_instr_count != 0,
+                   summary.chunk_instr_count, "chunk instruction count");
+    }
+    global->tid_ = -1;
+    global->last_timestamp_ = 0;
+    global->stream = nullptr;
+}
+
 std::string
 invariant_checker_t::parallel_shard_error(void *shard_data)
 {
@@ -344,6 +429,8 @@ invariant_checker_t::parallel_shard_memref(void *shard_data, const memref_t &mem
     }
     report_if_false(shard, core_sharded_ || shard->tid_ == memref.data.tid,
                     "Shard tid != memref tid");
+    if (shard->pid_ == -1)
+        shard->pid_ = memref.data.pid;
     if (shard->tid_ != memref.data.tid) {
         report_if_false(
             shard,
@@ -622,6 +709,7 @@ invariant_checker_t::parallel_shard_memref(void *shard_data, const memref_t &mem
     if (memref.marker.type == TRACE_TYPE_MARKER &&
         memref.marker.marker_type == TRACE_MARKER_TYPE_CACHE_LINE_SIZE) {
         shard->found_cache_line_size_marker_ = true;
+        shard->cache_line_size_ = memref.marker.marker_value;
         report_if_false(shard,
                         is_a_unit_test(shard) ||
                             memref.marker.marker_value ==
@@ -631,6 +719,7 @@ invariant_checker_t::parallel_shard_memref(void *shard_data, const memref_t &mem
     if (memref.marker.type == TRACE_TYPE_MARKER &&
         memref.marker.marker_type == TRACE_MARKER_TYPE_PAGE_SIZE) {
         shard->found_page_size_marker_ = true;
+        shard->page_size_ = memref.marker.marker_value;
         report_if_false(shard,
                         is_a_unit_test(shard) || is_a_unit_test(shard) ||
                             memref.marker.marker_value == shard->stream->get_page_size(),
@@ -1689,8 +1778,8 @@ invariant_checker_t::check_schedule_data(per_shard_t *global)
 
     std::string err;
     schedule_file_t sched;
-    for (auto &shard_keyval : shard_map_) {
-        err = sched.merge_shard_data(shard_keyval.second->sched_data_);
+    for (auto &summary : shard_summaries_) {
+        err = sched.merge_shard_data(summary.sched_data);
         if (!err.empty()) {
             report_if_false(global, false, "Failed to merge schedule data: " + err);
             return;
@@ -1794,6 +1883,7 @@ invariant_checker_t::print_results()
         }
     }
     per_shard_t global;
+    check_cross_shard_invariants(&global);
     check_schedule_data(&global);
     uint64_t total_error_count = global.error_count_;
     if (!abort_on_invariant_error_) {
@@ -120,6 +120,9 @@ protected:
     // For performance we support parallel analysis.
     // Most checks are thread-local; for thread switch checks we rely
     // on identifying thread switch points via timestamp entries.
+    // Checks that span shards are run at the end on the compact shard_summary_t
+    // produced by each shard's parallel_shard_exit(), so no cross-shard state is
+    // accessed while shards are being processed.
     struct per_shard_t {
         per_shard_t()
         {
@@ -237,6 +240,9 @@ protected:
         uint64_t dyn_injected_syscall_instr_count_ = 0;
         uint64_t last_timestamp_ = 0;
         uint64_t instr_count_since_last_timestamp_ = 0;
+        memref_pid_t pid_ = -1;
+        uint64_t cache_line_size_ = 0;
+        uint64_t page_size_ = 0;
         schedule_file_t::per_shard_t sched_data_;
         bool skipped_instrs_ = false;
         // Rseq region state.
@@ -278,6 +284,38 @@ protected:
         reset_at_context_switch(const memref_t &memref, bool core_sharded_on_disk);
     };
 
+    // The per-shard data needed by the cross-shard checks, recorded at shard exit
+    // after which the rest of the shard state is no longer needed.
+    struct shard_summary_t {
+        int shard_id = -1;
+        memref_tid_t tid = -1;
+        memref_pid_t pid = -1;
+        offline_file_type_t file_type = OFFLINE_FILE_TYPE_DEFAULT;
+        bool saw_filetype = false;
+        uint64_t trace_version = 0;
+        uint64_t cache_line_size = 0;
+        uint64_t page_size = 0;
+        uint64_t chunk_instr_count = 0;
+        // Only used to give context to failures reported from the summary.
+        uint64_t last_timestamp = 0;
+        schedule_file_t::per_shard_t sched_data;
+    };
+
+    // Records the summary for the exiting shard and releases its bulky state.
+    void
+    summarize_shard(per_shard_t *shard);
+
+    // This must be called at the end (typically from print_results) and passed in
+    // an empty shard structure. Checks invariants that relate data from different
+    // shards using the summaries.
+    // XXX: Timestamp and kernel/syscall ordering are only checked within each
+    // shard. Across shards, the threads of a process share no ordering we can
+    // rely on (e.g., threads taken over at attach start in arbitrary order), and
+    // checking that a thread never runs on two cores at once in core-sharded
+    // traces would need each shard's full run intervals rather than a summary.
+    virtual void
+    check_cross_shard_invariants(per_shard_t *global_shard);
+
     // We provide this for subclasses to run these invariants with custom
     // failure reporting.
     virtual void
@@ -332,6 +370,9 @@ protected:
     // In all other accesses to shard_map_ (process_memref, print_results) we are
     // single-threaded.
     std::mutex init_mutex_;
+    // Filled in by parallel_shard_exit() and consumed in print_results().
+    std::vector<shard_summary_t> shard_summaries_;
+    std::mutex summary_mutex_;
 
     bool knob_offline_;
     unsigned int knob_verbose_;
@@ -39,6 +39,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -67,12 +68,24 @@ schedule_stats_tool_create(uint64_t print_every, unsigned int verbose)
     return new schedule_stats_t(print_every, verbose);
 }
 
+analysis_tool_t *
+schedule_stats_tool_create(const schedule_stats_knobs_t &knobs)
+{
+    return new schedule_stats_t(knobs);
+}
+
 record_analysis_tool_t *
 record_schedule_stats_tool_create(uint64_t print_every, unsigned int verbose)
 {
     return new record_schedule_stats_t(print_every, verbose);
 }
 
+record_analysis_tool_t *
+record_schedule_stats_tool_create(const schedule_stats_knobs_t &knobs)
+{
+    return new record_schedule_stats_t(knobs);
+}
+
 /******************************************************************************
  * Specializations for schedule_stats_template_t<memref_t>, aka
  * schedule_stats_t.
@@ -187,6 +200,22 @@ schedule_stats_template_t<RecordType>::schedule_stats_template_t(uint64_t print_
     // Empty.
 }
 
+template <typename RecordType>
+schedule_stats_template_t<RecordType>::schedule_stats_template_t(
+    const schedule_stats_knobs_t &knobs)
+    : knob_print_every_(knobs.print_every)
+    , knob_verbose_(knobs.verbose)
+    , knob_streaming_(knobs.streaming)
+{
+    if (!knobs.json_path.empty()) {
+        json_file_.open(knobs.json_path, std::ios::out | std::ios::trunc);
+        if (!json_file_.good()) {
+            this->success_ = false;
+            this->error_string_ = "Failed to open " + knobs.json_path;
+        }
+    }
+}
+
 template <typename RecordType>
 schedule_stats_template_t<RecordType>::~schedule_stats_template_t()
 {
@@ -333,6 +362,17 @@ schedule_stats_template_t<RecordType>::update_state_time(per_shard_t *shard,
     return true;
 }
 
+template <typename RecordType>
+void
+schedule_stats_template_t<RecordType>::append_to_sequence(per_shard_t *shard,
+                                                          char symbol)
+{
+    if (knob_streaming_ && shard->thread_sequence.size() >= kStreamingMaxSequenceLength)
+        ++shard->sequence_chars_dropped;
+    else
+        shard->thread_sequence += symbol;
+}
+
 // shard->prev_workload_id and shard->prev_tid are cleared when this is called,
 // so we pass in the preserved values so there's no confusion.
 template <typename RecordType>
@@ -400,8 +440,13 @@ schedule_stats_template_t<RecordType>::record_context_switch(
                 shard->pre_syscall_timestamp = 0;
                 shard->post_syscall_timestamp = 0;
             }
-            shard->switch_record.push_back(record);
+            if (knob_streaming_ &&
+                shard->switch_record.size() >= kStreamingMaxSwitchRecords)
+                ++shard->switch_records_dropped;
+            else
+                shard->switch_record.push_back(record);
             shard->counters.instrs_per_switch->add(instr_delta);
+            shard->interval_instrs_per_switch->add(instr_delta);
             histogram_interface_t *hist_ptr = find_or_add_histogram(
                 shard->counters.tid2instrs_per_switch,
                 workload_tid_t(prev_workload_id, prev_tid), kSwitchBinSize);
@@ -442,8 +487,8 @@ schedule_stats_template_t<RecordType>::record_context_switch(
     if (tid != INVALID_THREAD_ID && tid != IDLE_THREAD_ID) {
         // We convert to letters (works best for <=26 inputs but still gives an
         // idea of the behavior for more inputs).
-        shard->thread_sequence +=
-            THREAD_LETTER_INITIAL_START + static_cast<char>(letter_ord % 26);
+        append_to_sequence(shard, THREAD_LETTER_INITIAL_START +
+                               static_cast<char>(letter_ord % 26));
         shard->cur_segment_instrs = 0;
     }
     if (knob_verbose_ >= 2) {
@@ -574,12 +619,12 @@ schedule_stats_template_t<RecordType>::parallel_shard_memref(void *shard_data,
     if (shard->cur_state == STATE_WAIT) {
         ++shard->counters.waits;
         if (prev_state != STATE_WAIT) {
-            shard->thread_sequence += WAIT_SYMBOL;
+            append_to_sequence(shard, WAIT_SYMBOL);
             shard->cur_segment_instrs = 0;
         } else {
             ++shard->cur_segment_instrs;
             if (shard->cur_segment_instrs == knob_print_every_) {
-                shard->thread_sequence += WAIT_SYMBOL;
+                append_to_sequence(shard, WAIT_SYMBOL);
                 shard->cur_segment_instrs = 0;
             }
         }
@@ -587,12 +632,12 @@ schedule_stats_template_t<RecordType>::parallel_shard_memref(void *shard_data,
     } else if (shard->cur_state == STATE_IDLE) {
         ++shard->counters.idles;
         if (prev_state != STATE_IDLE) {
-            shard->thread_sequence += IDLE_SYMBOL;
+            append_to_sequence(shard, IDLE_SYMBOL);
             shard->cur_segment_instrs = 0;
         } else {
             ++shard->cur_segment_instrs;
             if (shard->cur_segment_instrs == knob_print_every_) {
-                shard->thread_sequence += IDLE_SYMBOL;
+                append_to_sequence(shard, IDLE_SYMBOL);
                 shard->cur_segment_instrs = 0;
             }
         }
@@ -604,8 +649,8 @@ schedule_stats_template_t<RecordType>::parallel_shard_memref(void *shard_data,
         ++shard->cur_segment_instrs;
         shard->counters.idle_micros_at_last_instr = shard->counters.idle_microseconds;
         if (shard->cur_segment_instrs == knob_print_every_) {
-            shard->thread_sequence +=
-                THREAD_LETTER_SUBSEQUENT_START + static_cast<char>(letter_ord % 26);
+            append_to_sequence(shard, THREAD_LETTER_SUBSEQUENT_START +
+                                   static_cast<char>(letter_ord % 26));
             shard->cur_segment_instrs = 0;
         }
         if (shard->last_syscall_number >= 0 && !shard->stream->is_record_kernel()) {
@@ -892,7 +937,12 @@ schedule_stats_template_t<RecordType>::print_results()
     }
     for (const auto &shard : shard_map_) {
         std::cerr << "Core #" << shard.second->core
-                  << " schedule: " << shard.second->thread_sequence << "\n";
+                  << " schedule: " << shard.second->thread_sequence;
+        if (shard.second->sequence_chars_dropped > 0) {
+            std::cerr << "... (" << shard.second->sequence_chars_dropped
+                      << " more not retained in streaming mode)";
+        }
+        std::cerr << "\n";
     }
     // For the switch-out list, limit entries at low verbosity to avoid spewing
     // 100K entries to the screen.
@@ -920,6 +970,9 @@ schedule_stats_template_t<RecordType>::print_results()
         }
         if (i < shard.second->switch_record.size()) {
             std::cerr << "    ... (increase -verbose to see more)\n";
+        } else if (shard.second->switch_records_dropped > 0) {
+            std::cerr << "    ... (" << shard.second->switch_records_dropped
+                      << " more not retained in streaming mode)\n";
         }
     }
     std::cerr << "Max activity ratio between cores: " << max_core_activity_ratio_ << "\n";
@@ -928,6 +981,184 @@ schedule_stats_template_t<RecordType>::print_results()
     return true;
 }
 
+template <typename RecordType>
+typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *
+schedule_stats_template_t<RecordType>::generate_shard_interval_snapshot(
+    void *shard_data, uint64_t interval_id)
+{
+    per_shard_t *shard = reinterpret_cast<per_shard_t *>(shard_data);
+    snapshot_t *snapshot = new snapshot_t;
+    snapshot->instrs_per_switch = create_histogram(kSwitchBinSize);
+    add_shard_to_snapshot(shard, snapshot);
+    if (json_file_.is_open())
+        write_json_snapshot(shard, interval_id, snapshot);
+    return snapshot;
+}
+
+template <typename RecordType>
+typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *
+schedule_stats_template_t<RecordType>::generate_interval_snapshot(uint64_t interval_id)
+{
+    snapshot_t *snapshot = new snapshot_t;
+    snapshot->instrs_per_switch = create_histogram(kSwitchBinSize);
+    for (const auto &keyval : shard_map_) {
+        if (!json_file_.is_open()) {
+            add_shard_to_snapshot(keyval.second, snapshot);
+            continue;
+        }
+        // The JSON lines are per core, as in parallel mode.
+        snapshot_t core_snapshot;
+        core_snapshot.instrs_per_switch = create_histogram(kSwitchBinSize);
+        add_shard_to_snapshot(keyval.second, &core_snapshot);
+        write_json_snapshot(keyval.second, interval_id, &core_snapshot);
+        *snapshot += core_snapshot;
+        snapshot->instrs_per_switch->merge(core_snapshot.instrs_per_switch.get());
+    }
+    return snapshot;
+}
+
+template <typename RecordType>
+void
+schedule_stats_template_t<RecordType>::add_shard_to_snapshot(per_shard_t *shard,
+                                                             snapshot_t *snapshot)
+{
+    // Attribute the time so far in the current state to this interval.
+    update_state_time(shard, shard->cur_state);
+    const counters_t &counters = shard->counters;
+    snapshot->instrs += counters.instrs;
+    snapshot->total_switches += counters.total_switches;
+    snapshot->voluntary_switches += counters.voluntary_switches;
+    snapshot->direct_switches += counters.direct_switches;
+    snapshot->syscalls += counters.syscalls;
+    snapshot->observed_migrations += counters.observed_migrations;
+    snapshot->waits += counters.waits;
+    snapshot->idles += counters.idles;
+    snapshot->cpu_microseconds += counters.cpu_microseconds;
+    snapshot->idle_microseconds += counters.idle_microseconds;
+    snapshot->wait_microseconds += counters.wait_microseconds;
+    snapshot->instrs_per_switch->merge(shard->interval_instrs_per_switch.get());
+    shard->interval_instrs_per_switch = create_histogram(kSwitchBinSize);
+}
+
+template <typename RecordType>
+void
+schedule_stats_template_t<RecordType>::write_json_snapshot(const per_shard_t *shard,
+                                                           uint64_t interval_id,
+                                                           const snapshot_t *snapshot)
+{
+    // One self-contained object per line so the file can be consumed while
+    // the analysis is still running.
+    std::ostringstream line;
+    line << "{\"core\":" << shard->core << ",\"interval\":" << interval_id
+         << ",\"timestamp\":" << shard->stream->get_last_timestamp()
+         << ",\"instrs\":" << snapshot->instrs
+         << ",\"switches\":" << snapshot->total_switches
+         << ",\"voluntary_switches\":" << snapshot->voluntary_switches
+         << ",\"direct_switches\":" << snapshot->direct_switches
+         << ",\"syscalls\":" << snapshot->syscalls
+         << ",\"observed_migrations\":" << snapshot->observed_migrations
+         << ",\"waits\":" << snapshot->waits << ",\"idles\":" << snapshot->idles
+         << ",\"cpu_microseconds\":" << snapshot->cpu_microseconds
+         << ",\"idle_microseconds\":" << snapshot->idle_microseconds
+         << ",\"wait_microseconds\":" << snapshot->wait_microseconds
+         << ",\"interval_instrs_per_switch_p50\":"
+         << snapshot->instrs_per_switch->get_percentile(0.5)
+         << ",\"interval_instrs_per_switch_p99\":"
+         << snapshot->instrs_per_switch->get_percentile(0.99) << "}\n";
+    std::lock_guard<std::mutex> guard(json_mutex_);
+    json_file_ << line.str();
+    json_file_.flush();
+}
+
+template <typename RecordType>
+typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *
+schedule_stats_template_t<RecordType>::combine_interval_snapshots(
+    const std::vector<
+        const typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *>
+        latest_shard_snapshots,
+    uint64_t interval_end_timestamp)
+{
+    snapshot_t *result = new snapshot_t;
+    result->instrs_per_switch = create_histogram(kSwitchBinSize);
+    for (const auto base : latest_shard_snapshots) {
+        if (base == nullptr)
+            continue;
+        const snapshot_t *snapshot = dynamic_cast<const snapshot_t *>(base);
+        // The scalars are cumulative so we include every core's latest values.
+        *result += *snapshot;
+        // The histogram only covers its own interval, so we skip cores with no
+        // activity in this one.
+        if (snapshot->get_interval_end_timestamp() == interval_end_timestamp)
+            result->instrs_per_switch->merge(snapshot->instrs_per_switch.get());
+    }
+    return result;
+}
+
+template <typename RecordType>
+bool
+schedule_stats_template_t<RecordType>::print_interval_results(
+    const std::vector<typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t
+                          *> &interval_snapshots)
+{
+    using interval_state_snapshot_t =
+        typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t;
+    std::cerr << "Schedule stats per trace interval for ";
+    if (!interval_snapshots.empty() &&
+        interval_snapshots[0]->get_shard_id() !=
+            interval_state_snapshot_t::WHOLE_TRACE_SHARD_ID) {
+        std::cerr << "shard " << interval_snapshots[0]->get_shard_id() << ":\n";
+    } else {
+        std::cerr << "whole trace:\n";
+    }
+    int64_t last_instrs = 0;
+    int64_t last_switches = 0;
+    int64_t last_voluntary = 0;
+    uint64_t last_cpu = 0;
+    uint64_t last_idle = 0;
+    for (const auto &base : interval_snapshots) {
+        const snapshot_t *snapshot = dynamic_cast<const snapshot_t *>(base);
+        int64_t instrs = snapshot->instrs - last_instrs;
+        int64_t switches = snapshot->total_switches - last_switches;
+        std::cerr << "Interval #" << snapshot->get_interval_id()
+                  << " ending at timestamp " << snapshot->get_interval_end_timestamp()
+                  << ":\n";
+        std::cerr << std::setw(12) << instrs << " instructions\n";
+        std::cerr << std::setw(12) << switches << " total context switches\n";
+        double cspki = 0.;
+        if (instrs > 0)
+            cspki = 1000 * switches / static_cast<double>(instrs);
+        std::cerr << std::setw(12) << std::fixed << std::setprecision(7) << cspki
+                  << " CSPKI (context switches per 1000 instructions)\n";
+        print_percentage(
+            static_cast<double>(snapshot->voluntary_switches - last_voluntary),
+            static_cast<double>(switches), "% voluntary switches\n");
+        uint64_t cpu = snapshot->cpu_microseconds - last_cpu;
+        uint64_t idle = snapshot->idle_microseconds - last_idle;
+        print_percentage(static_cast<double>(cpu), static_cast<double>(cpu + idle),
+                         "% cpu busy by time\n");
+        std::cerr << std::setw(12) << snapshot->instrs_per_switch->get_percentile(0.5)
+                  << " median instructions per context switch\n";
+        std::cerr << std::setw(12) << snapshot->instrs_per_switch->get_percentile(0.99)
+                  << " 99th percentile instructions per context switch\n";
+        last_instrs = snapshot->instrs;
+        last_switches = snapshot->total_switches;
+        last_voluntary = snapshot->voluntary_switches;
+        last_cpu = snapshot->cpu_microseconds;
+        last_idle = snapshot->idle_microseconds;
+    }
+    return true;
+}
+
+template <typename RecordType>
+bool
+schedule_stats_template_t<RecordType>::release_interval_snapshot(
+    typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t
+        *interval_snapshot)
+{
+    delete interval_snapshot;
+    return true;
+}
+
 template <typename RecordType>
 typename schedule_stats_template_t<RecordType>::counters_t
 schedule_stats_template_t<RecordType>::get_total_counts()
@@ -36,6 +36,7 @@
 #include <stdint.h>
 
 #include <cstdint>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -48,6 +49,7 @@
 
 #include "analysis_tool.h"
 #include "memref.h"
+#include "schedule_stats_create.h"
 #include "utils.h"
 
 namespace dynamorio {
@@ -57,6 +59,7 @@ template <typename RecordType>
 class schedule_stats_template_t : public analysis_tool_tmpl_t<RecordType> {
 public:
     schedule_stats_template_t(uint64_t print_every, unsigned int verbose = 0);
+    explicit schedule_stats_template_t(const schedule_stats_knobs_t &knobs);
     ~schedule_stats_template_t() override;
     std::string
     initialize_stream(memtrace_stream_t *serial_stream) override;
@@ -82,6 +85,25 @@ public:
     parallel_shard_memref(void *shard_data, const RecordType &record) override;
     std::string
     parallel_shard_error(void *shard_data) override;
+    typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *
+    generate_interval_snapshot(uint64_t interval_id) override;
+    typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *
+    generate_shard_interval_snapshot(void *shard_data, uint64_t interval_id) override;
+    typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *
+    combine_interval_snapshots(
+        const std::vector<
+            const typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *>
+            latest_shard_snapshots,
+        uint64_t interval_end_timestamp) override;
+    bool
+    print_interval_results(
+        const std::vector<
+            typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t *>
+            &interval_snapshots) override;
+    bool
+    release_interval_snapshot(
+        typename analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t
+            *interval_snapshot) override;
 
     // Histogram interface for instrs-per-switch distribution.
     class histogram_interface_t {
@@ -97,6 +119,10 @@ public:
         print() const = 0;
         virtual bool
         empty() const = 0;
+        // Returns the inclusive lower bound of the bin holding the value at
+        // the given fraction (in [0,1]) of the distribution, or 0 if empty.
+        virtual uint64_t
+        get_percentile(double fraction) const = 0;
     };
 
     // Simple binning histogram for instrs-per-switch distribution.
@@ -150,6 +176,22 @@ public:
             return bin2count_.empty();
         }
 
+        uint64_t
+        get_percentile(double fraction) const override
+        {
+            uint64_t total = 0;
+            for (const auto &keyval : bin2count_)
+                total += keyval.second;
+            uint64_t target = static_cast<uint64_t>(fraction * total);
+            uint64_t sum = 0;
+            for (const auto &keyval : bin2count_) {
+                sum += keyval.second;
+                if (sum > target)
+                    return keyval.first;
+            }
+            return bin2count_.empty() ? 0 : bin2count_.rbegin()->first;
+        }
+
     protected:
         uint64_t bin_size_;
 
@@ -157,6 +199,107 @@ public:
         std::map<uint64_t, uint64_t> bin2count_;
     };
 
+    // Log-linear histogram with a bounded relative error, in the style of an
+    // HDR histogram.  Values below 2^kPrecisionBits have their own bins; above
+    // that, each power of 2 is split into 2^(kPrecisionBits-1) equal bins, so
+    // the bin width is at most 1/32 of its lower bound.  The bin count is
+    // bounded by the magnitude of the largest value rather than the number of
+    // distinct values, and merging is an element-wise sum, which makes these
+    // suitable for long traces.  Negative values are counted in the 0 bin.
+    class log_histogram_t : public histogram_interface_t {
+    public:
+        void
+        add(int64_t value) override
+        {
+            size_t index = value_to_index(value < 0 ? 0 : static_cast<uint64_t>(value));
+            if (index >= counts_.size())
+                counts_.resize(index + 1, 0);
+            ++counts_[index];
+        }
+
+        void
+        merge(const histogram_interface_t *rhs) override
+        {
+            const log_histogram_t *rhs_hist = dynamic_cast<const log_histogram_t *>(rhs);
+            if (rhs_hist->counts_.size() > counts_.size())
+                counts_.resize(rhs_hist->counts_.size(), 0);
+            for (size_t i = 0; i < rhs_hist->counts_.size(); ++i)
+                counts_[i] += rhs_hist->counts_[i];
+        }
+
+        std::string
+        to_string() const override
+        {
+            std::ostringstream stream;
+            for (size_t i = 0; i < counts_.size(); ++i) {
+                if (counts_[i] == 0)
+                    continue;
+                stream << std::setw(12) << index_to_lower_bound(i) << ".." << std::setw(8)
+                       << index_to_lower_bound(i + 1) << " " << std::setw(5)
+                       << counts_[i] << "\n";
+            }
+            return stream.str();
+        }
+
+        void
+        print() const override
+        {
+            std::cerr << to_string();
+        }
+
+        bool
+        empty() const override
+        {
+            return counts_.empty();
+        }
+
+        uint64_t
+        get_percentile(double fraction) const override
+        {
+            uint64_t total = 0;
+            for (uint64_t count : counts_)
+                total += count;
+            uint64_t target = static_cast<uint64_t>(fraction * total);
+            uint64_t sum = 0;
+            for (size_t i = 0; i < counts_.size(); ++i) {
+                sum += counts_[i];
+                if (sum > target)
+                    return index_to_lower_bound(i);
+            }
+            return counts_.empty() ? 0 : index_to_lower_bound(counts_.size() - 1);
+        }
+
+    protected:
+        static constexpr int kPrecisionBits = 6;
+        static constexpr uint64_t kLinearLimit = 1ULL << kPrecisionBits;
+
+        static size_t
+        value_to_index(uint64_t value)
+        {
+            if (value < kLinearLimit)
+                return static_cast<size_t>(value);
+            int msb = 63;
+            while ((value >> msb) == 0)
+                --msb;
+            int shift = msb - kPrecisionBits + 1;
+            return (static_cast<size_t>(shift) << (kPrecisionBits - 1)) +
+                static_cast<size_t>(value >> shift);
+        }
+
+        static uint64_t
+        index_to_lower_bound(size_t index)
+        {
+            if (index < kLinearLimit)
+                return index;
+            int shift = static_cast<int>(index >> (kPrecisionBits - 1)) - 1;
+            uint64_t mantissa =
+                index - (static_cast<uint64_t>(shift) << (kPrecisionBits - 1));
+            return mantissa << shift;
+        }
+
+        std::vector<uint64_t> counts_;
+    };
+
     struct workload_tid_t {
         workload_tid_t(int64_t workload, int64_t thread)
             : workload_id(workload)
@@ -381,11 +524,52 @@ protected:
     static constexpr uint64_t kSwitchBinSize = 50000;
     static constexpr uint64_t kCoresBinSize = 1;
     static constexpr int64_t INVALID_WORKLOAD_ID = -1;
+    // In streaming mode, at most this many switch records and schedule letters
+    // are retained per core.
+    static constexpr size_t kStreamingMaxSwitchRecords = 4096;
+    static constexpr size_t kStreamingMaxSequenceLength = 65536;
+
+    // Interval snapshot of one core or of the whole trace.  The scalar counters
+    // are cumulative while the histogram only covers the interval itself.
+    struct snapshot_t
+        : public analysis_tool_tmpl_t<RecordType>::interval_state_snapshot_t {
+        int64_t instrs = 0;
+        int64_t total_switches = 0;
+        int64_t voluntary_switches = 0;
+        int64_t direct_switches = 0;
+        int64_t syscalls = 0;
+        int64_t observed_migrations = 0;
+        int64_t waits = 0;
+        int64_t idles = 0;
+        uint64_t cpu_microseconds = 0;
+        uint64_t idle_microseconds = 0;
+        uint64_t wait_microseconds = 0;
+        std::unique_ptr<histogram_interface_t> instrs_per_switch;
+
+        // Adds the scalar counters only.
+        snapshot_t &
+        operator+=(const snapshot_t &rhs)
+        {
+            instrs += rhs.instrs;
+            total_switches += rhs.total_switches;
+            voluntary_switches += rhs.voluntary_switches;
+            direct_switches += rhs.direct_switches;
+            syscalls += rhs.syscalls;
+            observed_migrations += rhs.observed_migrations;
+            waits += rhs.waits;
+            idles += rhs.idles;
+            cpu_microseconds += rhs.cpu_microseconds;
+            idle_microseconds += rhs.idle_microseconds;
+            wait_microseconds += rhs.wait_microseconds;
+            return *this;
+        }
+    };
 
     struct per_shard_t {
         per_shard_t(schedule_stats_template_t *analyzer)
             : counters(analyzer)
         {
+            interval_instrs_per_switch = analyzer->create_histogram(kSwitchBinSize);
         }
         // Provide a virtual destructor to allow subclassing.
         virtual ~per_shard_t() = default;
@@ -417,13 +601,20 @@ protected:
         uint64_t switch_user_instrs = 0;
         uint64_t switch_start_input_instr_ordinal = 1; // Inclusive, so start at 1.
         bool in_syscall_trace = false;
-        // A complete record of the switches.
+        // A complete record of the switches, unless in streaming mode where
+        // only a prefix is kept and the rest are counted in switch_records_dropped.
         std::vector<schedule_record_t> switch_record;
+        uint64_t switch_records_dropped = 0;
+        uint64_t sequence_chars_dropped = 0;
+        // Instructions per switch since the last interval snapshot.
+        std::unique_ptr<histogram_interface_t> interval_instrs_per_switch;
     };
 
     virtual std::unique_ptr<histogram_interface_t>
     create_histogram(uint64_t bin_size)
     {
+        if (knob_streaming_)
+            return std::unique_ptr<histogram_interface_t>(new log_histogram_t());
         return std::unique_ptr<histogram_interface_t>(new histogram_t(bin_size));
     }
 
@@ -469,6 +660,18 @@ protected:
     bool
     update_state_time(per_shard_t *shard, state_t state);
 
+    void
+    append_to_sequence(per_shard_t *shard, char symbol);
+
+    // Adds the shard's cumulative counters and its histogram since the last
+    // snapshot into \p snapshot, and starts a new interval histogram.
+    void
+    add_shard_to_snapshot(per_shard_t *shard, snapshot_t *snapshot);
+
+    void
+    write_json_snapshot(const per_shard_t *shard, uint64_t interval_id,
+                        const snapshot_t *snapshot);
+
     // shard->prev_workload_id and shard->prev_tid are cleared when this is called,
     // so we pass in the preserved values so there's no confusion.
     virtual void
@@ -484,6 +687,10 @@ protected:
 
     uint64_t knob_print_every_ = 0;
     unsigned int knob_verbose_ = 0;
+    bool knob_streaming_ = false;
+    std::ofstream json_file_;
+    // Snapshots are generated concurrently by the shard workers.
+    std::mutex json_mutex_;
     // We use an ordered map to get our output in order.  This table is not
     // used on the hot path so its performance does not matter.
     std::map<int64_t, per_shard_t *> shard_map_;
@@ -38,6 +38,7 @@
 #include "analysis_tool.h"
 
 #include <cstdint>
+#include <string>
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -47,6 +48,31 @@ namespace drmemtrace {
  * @brief DrMemtrace schedule statistics analysis tool creation.
  */
 
+/**
+ * The options for schedule_stats_tool_create() and
+ * record_schedule_stats_tool_create().
+ * The options are currently documented in \ref sec_drcachesim_ops.
+ */
+// These options are currently documented in ../common/options.cpp.
+struct schedule_stats_knobs_t {
+    schedule_stats_knobs_t()
+        : print_every(500000)
+        , verbose(0)
+        , streaming(false)
+    {
+    }
+    uint64_t print_every;
+    unsigned int verbose;
+    // Bounds memory usage for long traces: histograms use fixed-precision
+    // log-scaled buckets and only a prefix of the per-core switch records and
+    // schedule strings is retained.
+    bool streaming;
+    // If non-empty, one JSON object is appended to this file for each per-core
+    // interval snapshot as it is generated, or for each core at each interval in
+    // serial mode.
+    std::string json_path;
+};
+
 /**
  * Creates an analysis tool which counts the number and type of context switches
  * in a core-sharded trace schedule.  The tool fails if run in any mode besides
@@ -55,6 +81,14 @@ namespace drmemtrace {
 analysis_tool_t *
 schedule_stats_tool_create(uint64_t print_every, unsigned int verbose = 0);
 
+/**
+ * Creates an analysis tool which counts the number and type of context switches
+ * in a core-sharded trace schedule, with the additional options in \p knobs.
+ * The tool fails if run in any mode besides core-sharded.
+ */
+analysis_tool_t *
+schedule_stats_tool_create(const schedule_stats_knobs_t &knobs);
+
 /**
  * Creates a record analysis tool which counts the number and type of context switches
  * in a core-sharded trace schedule.  The tool fails if run in any mode besides
@@ -63,6 +97,14 @@ schedule_stats_tool_create(uint64_t print_every, unsigned int verbose = 0);
 record_analysis_tool_t *
 record_schedule_stats_tool_create(uint64_t print_every, unsigned int verbose = 0);
 
+/**
+ * Creates a record analysis tool which counts the number and type of context switches
+ * in a core-sharded trace schedule, with the additional options in \p knobs.
+ * The tool fails if run in any mode besides core-sharded.
+ */
+record_analysis_tool_t *
+record_schedule_stats_tool_create(const schedule_stats_knobs_t &knobs);
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
@@ -493,6 +493,14 @@ view_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
             std::cerr << "<marker: skipped memref 0x" << std::hex
                       << memref.marker.marker_value << std::dec << "\n";
             break;
+        case TRACE_MARKER_TYPE_L0I_FILTER_SIZE:
+            std::cerr << "<marker: L0I filter size " << memref.marker.marker_value
+                      << " bytes>\n";
+            break;
+        case TRACE_MARKER_TYPE_L0D_FILTER_SIZE:
+            std::cerr << "<marker: L0D filter size " << memref.marker.marker_value
+                      << " bytes>\n";
+            break;
         default:
             std::cerr << "<marker: type " << memref.marker.marker_type << "; value "
                       << memref.marker.marker_value << ">\n";
@@ -517,6 +517,12 @@ func_trace_init(func_trace_append_entry_vec_t append_entry_vec_,
             DR_ASSERT(false);
             goto failed;
         }
+        if (!op_record_symbol_cache_dir.get_value().empty() &&
+            drsym_set_cache_dir(op_record_symbol_cache_dir.get_value().c_str()) !=
+                DRSYM_SUCCESS) {
+            NOTIFY(0, "Failed to use %s as the symbol cache directory\n",
+                   op_record_symbol_cache_dir.get_value().c_str());
+        }
     }
     /* For multi-instrumentation cases with drbbdup, we need the drwrap inverted
      * control mode where we invoke its instrumentation handlers.
@@ -1345,6 +1345,13 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap, bool at_thread_ex
     }
     BUF_PTR(data->seg_base) += append_unit_header(drcontext, BUF_PTR(data->seg_base),
                                                   dr_get_thread_id(drcontext), window);
+    if ((!op_L0_filter_until_instrs.get_value() ||
+         get_local_mode(data) == BBDUP_MODE_L0_FILTER) &&
+        adapt_L0_filters(data, current_num_refs * instru->sizeof_entry())) {
+        // The new sizes apply to everything after the header.
+        BUF_PTR(data->seg_base) +=
+            append_L0_filter_size_markers(data, BUF_PTR(data->seg_base));
+    }
     num_refs_racy += current_num_refs;
     if (mode == BBDUP_MODE_L0_FILTER) {
         num_filter_refs_racy += current_num_refs;
@@ -42,7 +42,9 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <atomic>
+#include <climits>
 #include <cstdarg>
 #include <cstdint>
 #include <new>
@@ -220,6 +222,161 @@ get_L0_filters_enabled(uintptr_t mode, DR_PARAM_OUT bool *l0i_enabled,
     return;
 }
 
+/***************************************************************************
+ * Adaptive L0 filter sizing for -L0_filter_target_bw.
+ */
+
+// The filter sizes are -L0I_size and -L0D_size scaled by 2^L0_filter_scale, which
+// stays within [L0_filter_min_scale, L0_filter_max_scale].  Both bounds are 0
+// without -L0_filter_target_bw.
+static std::atomic<int> L0_filter_scale;
+static int L0_filter_min_scale;
+static int L0_filter_max_scale;
+// Trace bytes and start time (in microseconds) of the current phase.
+static std::atomic<uint64> L0_filter_phase_bytes;
+static std::atomic<uint64> L0_filter_phase_start;
+
+static bool
+L0_filters_adaptive()
+{
+    return op_L0_filter_target_bw.get_value() > 0;
+}
+
+static uint64
+L0_filter_scaled_size(uint64 base_size, int scale)
+{
+    return scale >= 0 ? base_size << scale : base_size >> -scale;
+}
+
+// Returns the bytes of filter storage to allocate for a filter of base_size, which
+// must hold the largest scaled size.
+static size_t
+L0_filter_alloc_size(uint64 base_size)
+{
+    return (size_t)(L0_filter_scaled_size(base_size, L0_filter_max_scale) /
+                    op_line_size.get_value() * sizeof(void *));
+}
+
+static void
+init_L0_filter_scale()
+{
+    if (!L0_filters_adaptive())
+        return;
+    if (!op_L0I_filter.get_value() && !op_L0D_filter.get_value())
+        FATAL("Usage error: L0_filter_target_bw requires L0I_filter or L0D_filter.");
+    uint64 max_size = op_L0_filter_max_size.get_value();
+    if (!IS_POWER_OF_2(max_size))
+        FATAL("Usage error: L0_filter_max_size must be a power of 2.");
+    int max_bits = compute_log2(static_cast<ptr_int_t>(max_size));
+    int line_bits = compute_log2(op_line_size.get_value());
+    L0_filter_min_scale = INT_MIN;
+    L0_filter_max_scale = INT_MAX;
+    const uint64 base_sizes[] = {
+        op_L0I_filter.get_value() ? static_cast<uint64>(op_L0I_size.get_value()) : 0,
+        op_L0D_filter.get_value() ? static_cast<uint64>(op_L0D_size.get_value()) : 0
+    };
+    for (uint64 base_size : base_sizes) {
+        if (base_size == 0)
+            continue;
+        if (base_size > max_size) {
+            FATAL("Usage error: L0_filter_max_size must be no smaller than L0I_size "
+                  "and L0D_size.");
+        }
+        int base_bits = compute_log2(static_cast<ptr_int_t>(base_size));
+        L0_filter_min_scale = std::max(L0_filter_min_scale, line_bits - base_bits);
+        L0_filter_max_scale = std::min(L0_filter_max_scale, max_bits - base_bits);
+    }
+    if (L0_filter_min_scale > 0 || L0_filter_max_scale < 0) {
+        // Both sizes are 0 (and thus nothing to adapt) or smaller than a line.
+        L0_filter_min_scale = 0;
+        L0_filter_max_scale = 0;
+    }
+    L0_filter_scale.store(0, std::memory_order_release);
+    L0_filter_phase_bytes.store(0, std::memory_order_release);
+    L0_filter_phase_start.store(instru_t::get_timestamp(), std::memory_order_release);
+}
+
+// Empties the filters and points the inlined lookups at their current sizes.
+static void
+reset_L0_filters(per_thread_t *data)
+{
+    if (data->l0_dcache != nullptr) {
+        uint64 lines =
+            L0_filter_scaled_size(op_L0D_size.get_value(), data->l0_filter_scale) /
+            op_line_size.get_value();
+        memset(data->l0_dcache, 0, (size_t)lines * sizeof(void *));
+        *(ptr_uint_t *)TLS_SLOT(data->seg_base, MEMTRACE_TLS_OFFS_DCACHE_MASK) =
+            (ptr_uint_t)lines - 1;
+    }
+    if (data->l0_icache != nullptr) {
+        uint64 lines =
+            L0_filter_scaled_size(op_L0I_size.get_value(), data->l0_filter_scale) /
+            op_line_size.get_value();
+        memset(data->l0_icache, 0, (size_t)lines * sizeof(void *));
+        *(ptr_uint_t *)TLS_SLOT(data->seg_base, MEMTRACE_TLS_OFFS_ICACHE_MASK) =
+            (ptr_uint_t)lines - 1;
+    }
+}
+
+bool
+adapt_L0_filters(per_thread_t *data, uint64 bytes)
+{
+    if (!L0_filters_adaptive())
+        return false;
+    L0_filter_phase_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    uint64 now = instru_t::get_timestamp();
+    uint64 start = L0_filter_phase_start.load(std::memory_order_acquire);
+    uint64 phase_us = static_cast<uint64>(op_L0_filter_adapt_ms.get_value()) * 1000;
+    // Only the thread that wins the race to close the phase picks the new scale.
+    if (now > start && now - start >= phase_us &&
+        L0_filter_phase_start.compare_exchange_strong(start, now,
+                                                      std::memory_order_acq_rel)) {
+        uint64 phase_bytes = L0_filter_phase_bytes.exchange(0, std::memory_order_acq_rel);
+        uint64 rate = phase_bytes * 1000000 / (now - start);
+        uint64 target = op_L0_filter_target_bw.get_value();
+        int scale = L0_filter_scale.load(std::memory_order_acquire);
+        // Halving a filter less than doubles its misses, so we only shrink once
+        // well under the target to avoid oscillating around it.
+        if (rate > target && scale < L0_filter_max_scale)
+            ++scale;
+        else if (rate < target / 2 && scale > L0_filter_min_scale)
+            --scale;
+        if (scale != L0_filter_scale.load(std::memory_order_acquire)) {
+            NOTIFY(1,
+                   "Trace rate " UINT64_FORMAT_STRING
+                   " bytes/s vs target " UINT64_FORMAT_STRING
+                   ": scaling L0 filters by 2^%d\n",
+                   rate, target, scale);
+            L0_filter_scale.store(scale, std::memory_order_release);
+        }
+    }
+    int scale = L0_filter_scale.load(std::memory_order_acquire);
+    if (scale == data->l0_filter_scale)
+        return false;
+    data->l0_filter_scale = scale;
+    reset_L0_filters(data);
+    return true;
+}
+
+int
+append_L0_filter_size_markers(per_thread_t *data, byte *buf_ptr)
+{
+    int size = 0;
+    if (data->l0_icache != nullptr) {
+        size += instru->append_marker(
+            buf_ptr + size, TRACE_MARKER_TYPE_L0I_FILTER_SIZE,
+            (uintptr_t)L0_filter_scaled_size(op_L0I_size.get_value(),
+                                             data->l0_filter_scale));
+    }
+    if (data->l0_dcache != nullptr) {
+        size += instru->append_marker(
+            buf_ptr + size, TRACE_MARKER_TYPE_L0D_FILTER_SIZE,
+            (uintptr_t)L0_filter_scaled_size(op_L0D_size.get_value(),
+                                             data->l0_filter_scale));
+    }
+    return size;
+}
+
 std::atomic<ptr_int_t> tracing_window;
 
 struct file_ops_func_t file_ops_func;
@@ -976,9 +1133,16 @@ insert_filter_addr(void *drcontext, instrlist_t *ilist, instr_t *where, user_dat
     uint64 cache_size = is_icache ? op_L0I_size.get_value() : op_L0D_size.get_value();
     if (cache_size == 0)
         return DR_REG_NULL; // Skip instru.
+    // With -L0_filter_target_bw the mask changes at runtime and is loaded from TLS.
+    // We use the largest mask for the same-line check below.
+    bool adaptive = L0_filters_adaptive();
+    if (adaptive)
+        cache_size = L0_filter_scaled_size(cache_size, L0_filter_max_scale);
     ptr_int_t mask = (ptr_int_t)(cache_size / op_line_size.get_value()) - 1;
     int line_bits = compute_log2(op_line_size.get_value());
     uint offs = is_icache ? MEMTRACE_TLS_OFFS_ICACHE : MEMTRACE_TLS_OFFS_DCACHE;
+    uint mask_offs =
+        is_icache ? MEMTRACE_TLS_OFFS_ICACHE_MASK : MEMTRACE_TLS_OFFS_DCACHE_MASK;
     reg_id_t reg_addr;
     if (is_icache) {
         // For filtering the icache, we disable bundles + delays and call here on
@@ -1055,21 +1219,27 @@ insert_filter_addr(void *drcontext, instrlist_t *ilist, instr_t *where, user_dat
     MINSERT(ilist, where,
             XINST_CREATE_move(drcontext, opnd_create_reg(reg_idx),
                               opnd_create_reg(reg_addr)));
+    if (adaptive) {
+        dr_insert_read_raw_tls(drcontext, ilist, where, tls_seg,
+                               tls_offs + sizeof(void *) * mask_offs, reg_ptr);
+    } else {
 #ifndef X86
-    /* Unfortunately the mask is likely too big for an immediate (32K cache and
-     * 64-byte line => 0x1ff mask, and A32 and T32 have an 8-bit limit).
-     */
-    MINSERT(ilist, where,
-            XINST_CREATE_load_int(drcontext, opnd_create_reg(reg_ptr),
-                                  OPND_CREATE_INT32(mask)));
+        /* Unfortunately the mask is likely too big for an immediate (32K cache and
+         * 64-byte line => 0x1ff mask, and A32 and T32 have an 8-bit limit).
+         */
+        MINSERT(ilist, where,
+                XINST_CREATE_load_int(drcontext, opnd_create_reg(reg_ptr),
+                                      OPND_CREATE_INT32(mask)));
 #endif
+    }
 #ifdef RISCV64
     ASSERT(false, "NYI on RISCV64");
 #else
     MINSERT(ilist, where,
             XINST_CREATE_and_s(
                 drcontext, opnd_create_reg(reg_idx),
-                IF_X86_ELSE(OPND_CREATE_INT32(mask), opnd_create_reg(reg_ptr))));
+                IF_X86_ELSE(adaptive ? opnd_create_reg(reg_ptr) : OPND_CREATE_INT32(mask),
+                            opnd_create_reg(reg_ptr))));
 #endif
     dr_insert_read_raw_tls(drcontext, ilist, where, tls_seg,
                            tls_offs + sizeof(void *) * offs, reg_ptr);
@@ -1920,17 +2090,23 @@ init_thread_in_process(void *drcontext)
     init_thread_io(drcontext);
 
     if (op_L0D_filter.get_value() && op_L0D_size.get_value() > 0) {
-        data->l0_dcache = (byte *)dr_raw_mem_alloc(
-            (size_t)op_L0D_size.get_value() / op_line_size.get_value() * sizeof(void *),
-            DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+        data->l0_dcache =
+            (byte *)dr_raw_mem_alloc(L0_filter_alloc_size(op_L0D_size.get_value()),
+                                     DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
         *(byte **)TLS_SLOT(data->seg_base, MEMTRACE_TLS_OFFS_DCACHE) = data->l0_dcache;
     }
     if (op_L0I_filter.get_value() && op_L0I_size.get_value() > 0) {
-        data->l0_icache = (byte *)dr_raw_mem_alloc(
-            (size_t)op_L0I_size.get_value() / op_line_size.get_value() * sizeof(void *),
-            DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+        data->l0_icache =
+            (byte *)dr_raw_mem_alloc(L0_filter_alloc_size(op_L0I_size.get_value()),
+                                     DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
         *(byte **)TLS_SLOT(data->seg_base, MEMTRACE_TLS_OFFS_ICACHE) = data->l0_icache;
     }
+    if (L0_filters_adaptive()) {
+        // New threads start at the base sizes and pick up the current scale,
+        // along with the markers recording it, at their first buffer output.
+        data->l0_filter_scale = 0;
+        reset_L0_filters(data);
+    }
 
 #ifdef BUILD_PT_TRACER
     if (op_offline.get_value() && op_enable_kernel_tracing.get_value()) {
@@ -2030,15 +2206,13 @@ event_thread_exit(void *drcontext)
         if (op_L0D_filter.get_value()) {
             if (op_L0D_size.get_value() > 0) {
                 dr_raw_mem_free(data->l0_dcache,
-                                (size_t)op_L0D_size.get_value() /
-                                    op_line_size.get_value() * sizeof(void *));
+                                L0_filter_alloc_size(op_L0D_size.get_value()));
             }
         }
         if (op_L0I_filter.get_value()) {
             if (op_L0I_size.get_value() > 0) {
                 dr_raw_mem_free(data->l0_icache,
-                                (size_t)op_L0I_size.get_value() /
-                                    op_line_size.get_value() * sizeof(void *));
+                                L0_filter_alloc_size(op_L0I_size.get_value()));
             }
         }
 
@@ -2486,6 +2660,7 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
          op_L0D_size.get_value() != 0)) {
         FATAL("Usage error: L0I_size and L0D_size must be 0 or powers of 2.");
     }
+    init_L0_filter_scale();
     // We cannot elide addresses or ignore offsets when we need to translate
     // all addresses during tracing or when instruction or data address entries
     // are being filtered.
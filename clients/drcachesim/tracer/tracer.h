@@ -92,6 +92,10 @@ struct per_thread_t {
     /* For level 0 filters */
     byte *l0_dcache;
     byte *l0_icache;
+    /* For -L0_filter_target_bw: the log2 scale of the current filter sizes
+     * relative to -L0I_size and -L0D_size.
+     */
+    int l0_filter_scale;
     /* For passing data from app2app to other stages, b/c drbbdup doesn't provide
      * the same user_data path that drmgr does.
      */
@@ -149,6 +153,10 @@ enum {
     // For -L0_filter_until_instrs, this is used for triggering mode switch in other
     // threads when a thread changes tracing_mode.
     MEMTRACE_TLS_OFFS_MODE,
+    // For -L0_filter_target_bw, the current index masks of the L0 filters, which
+    // are otherwise inlined as immediates.
+    MEMTRACE_TLS_OFFS_DCACHE_MASK,
+    MEMTRACE_TLS_OFFS_ICACHE_MASK,
     MEMTRACE_TLS_COUNT, /* total number of TLS slots allocated */
 };
 
@@ -159,6 +167,17 @@ extern int tls_idx;
     (((void **)((byte *)(tls_base) + tls_offs)) + (enum_val))
 #define BUF_PTR(tls_base) *(byte **)TLS_SLOT(tls_base, MEMTRACE_TLS_OFFS_BUF_PTR)
 
+/* For -L0_filter_target_bw: accounts for "bytes" of trace output and, at the end of a
+ * phase, picks new filter sizes.  Returns whether this thread's filters were resized,
+ * in which case the caller should record the new sizes with
+ * append_L0_filter_size_markers().
+ */
+bool
+adapt_L0_filters(per_thread_t *data, uint64 bytes);
+
+int
+append_L0_filter_size_markers(per_thread_t *data, byte *buf_ptr);
+
 extern instru_t *instru;
 
 /* Lock for instrumentation phase transitions and global counters. */
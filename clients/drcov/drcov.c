@@ -46,6 +46,8 @@
  *                    Uses nudge to notify a child process being terminated
  *                    by its parent, so that the exit event will be called.
  * -logdir <dir>      Sets log directory, which by default is ".".
+ * -hit_counts        Also records how many times each basic block executed.
+ * -hit_counts_64bit  Like -hit_counts but with 64-bit counters.
  */
 
 #include "dr_api.h"
@@ -132,6 +134,10 @@ options_init(client_id_t id, int argc, const char *argv[], drcovlib_options_t *o
             ops->flags |= DRCOVLIB_DUMP_AS_TEXT;
         else if (strcmp(token, "-dump_binary") == 0)
             ops->flags &= ~DRCOVLIB_DUMP_AS_TEXT;
+        else if (strcmp(token, "-hit_counts") == 0)
+            ops->flags |= DRCOVLIB_HIT_COUNTS;
+        else if (strcmp(token, "-hit_counts_64bit") == 0)
+            ops->flags |= DRCOVLIB_HIT_COUNTS_64BIT;
         else if (strcmp(token, "-no_nudge_kills") == 0)
             nudge_kills = false;
         else if (strcmp(token, "-nudge_kills") == 0)
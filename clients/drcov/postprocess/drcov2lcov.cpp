@@ -45,7 +45,14 @@
 #include "drsyms.h"
 #include "hashtable.h"
 #include "dr_frontend.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "../../common/utils.h"
@@ -102,6 +109,7 @@ using ::dynamorio::droption::twostring_t;
     } while (0)
 
 #define DEFAULT_OUTPUT_FILE "coverage.info"
+#define DEFAULT_JOB_MAX 16
 
 /* Rather than skip these in the client and put them into the unknown module,
  * we give the user a chance to display these if desired.
@@ -192,6 +200,14 @@ static droption_t<bool> op_include_tool(
     "coverage output.  Normally such execution is excluded and the output focuses on "
     "the application only.");
 
+static droption_t<int> op_jobs(
+    DROPTION_SCOPE_FRONTEND, "jobs", -1, "Number of parallel jobs",
+    "By default, the input log files are read in parallel by a worker thread per "
+    "hardware thread, with a cap of 16.  This option controls the number of worker "
+    "threads.  0 disables concurrency and reads all of the files on the main thread.  "
+    "The files are always read serially with -reduce_set and -test_pattern, whose "
+    "results depend on the order in which the files are read.");
+
 static droption_t<bool> op_help(DROPTION_SCOPE_FRONTEND, "help", false,
                                 "Print this message", "Prints the usage message.");
 
@@ -282,6 +298,11 @@ static const char *cur_test = NULL;
 static const char *non_test = "<NON-TEST>"; /* for case like initialization code */
 static const char *non_exec = "<NON-EXEC>"; /* not executed code */
 
+/* Whether any input log file has hit counts, in which case we report line hit
+ * counts rather than just whether lines were executed.
+ */
+static std::atomic<bool> have_hit_counts;
+
 /* Not knowing the source file size, we may allocate several chunks per file,
  * and link them together as a linked-list to avoid realloc and copy overhead.
  */
@@ -294,6 +315,7 @@ struct _line_chunk_t {
         byte *exec;        /* array of the execution info on the line */
         const char **test; /* array of the test name ptr on the line */
     } info;
+    uint64 *hits; /* array of the hit count of the line, if have_hit_counts */
     line_chunk_t *next;
 };
 
@@ -325,6 +347,11 @@ line_chunk_alloc(uint num_lines)
         chunk->info.exec = (byte *)line_info;
     }
     ASSERT(line_info != NULL, "Failed to alloc line info array\n");
+    chunk->hits = NULL;
+    if (have_hit_counts && !op_test_pattern.specified()) {
+        chunk->hits = (uint64 *)calloc(num_lines, sizeof(chunk->hits[0]));
+        ASSERT(chunk->hits != NULL, "Failed to alloc line hit count array\n");
+    }
     return chunk;
 }
 
@@ -335,6 +362,7 @@ line_chunk_free(line_chunk_t *chunk)
         free((void *)chunk->info.test); /* cast from "const char **" to "void *" */
     else
         free(chunk->info.exec);
+    free(chunk->hits);
     free(chunk);
 }
 
@@ -364,9 +392,13 @@ line_chunk_print(line_chunk_t *chunk, char *start)
             }
         } else {
             if (chunk->info.exec[i] != (byte)SOURCE_LINE_STATUS_NONE) {
-                res = dr_snprintf(
-                    start, MAX_CHAR_PER_LINE, "DA:%u,%u\n", line_num,
-                    chunk->info.exec[i] == (byte)SOURCE_LINE_STATUS_SKIP ? 0 : 1);
+                uint64 hits =
+                    chunk->info.exec[i] == (byte)SOURCE_LINE_STATUS_SKIP ? 0 : 1;
+                /* A log file without hit counts can have executed the line. */
+                if (chunk->hits != NULL && chunk->hits[i] > hits)
+                    hits = chunk->hits[i];
+                res = dr_snprintf(start, MAX_CHAR_PER_LINE,
+                                  "DA:%u," UINT64_FORMAT_STRING "\n", line_num, hits);
             }
         }
         ASSERT(res < MAX_CHAR_PER_LINE && res != -1, "Error on printing\n");
@@ -439,7 +471,8 @@ line_table_delete(void *p)
 }
 
 static inline void
-line_table_add(line_table_t *line_table, uint line, byte status, const char *test_info)
+line_table_add(line_table_t *line_table, uint line, byte status, const char *test_info,
+               uint64 hits)
 {
     line_chunk_t *chunk = line_table->chunk;
 
@@ -496,6 +529,9 @@ line_table_add(line_table_t *line_table, uint line, byte status, const char *tes
                     chunk->info.exec[line - chunk->first_num] !=
                         (byte)SOURCE_LINE_STATUS_EXEC)
                     chunk->info.exec[line - chunk->first_num] = status;
+                /* A line's count is the largest among its instructions. */
+                if (chunk->hits != NULL && hits > chunk->hits[line - chunk->first_num])
+                    chunk->hits[line - chunk->first_num] = hits;
             }
             return;
         }
@@ -538,9 +574,19 @@ enum {
     BB_TABLE_ENTRY_SET = 1,
 };
 
+/* Hit counts of a module: ranges of bytes executed by a bb, each with the bb's count,
+ * until module_table_finalize_hits() turns them into a sorted list of disjoint
+ * ranges, each given by its start offset and the total count of the bbs containing
+ * it.
+ */
+struct hit_range_t {
+    uint start;
+    uint end;
+    uint64 count;
+};
+
 typedef struct _module_table_t {
     char *path;
-    uintptr_t seg_start;
     size_t seg_offs;
     size_t size;
     union {
@@ -548,11 +594,31 @@ typedef struct _module_table_t {
         const char **array;  /* store test info (char *) for each app byte */
     } bb_table;              /* data structure storing which bb is seen */
     hashtable_t test_htable; /* hashtable for test functions found in the module */
+    std::vector<hit_range_t> *hit_ranges;
+    std::vector<std::pair<uint, uint64>> *hits;
 } module_table_t;
 
 #define MODULE_HASH_TABLE_BITS 6
 static std::vector<module_table_t *> module_vec;
 
+/* A module loaded by many processes gets a single table for all of their log files,
+ * so that we enumerate its lines once rather than once per log file.  The logs do
+ * not record build ids, so we identify a module by its path, segment offset, and
+ * size, along with its checksum and timestamp on Windows.  With -test_pattern each
+ * log file keeps its own tables, as the test owning a block depends on the order of
+ * the blocks within each log file.
+ */
+static std::unordered_map<std::string, module_table_t *> module_map;
+static std::mutex module_map_lock;
+
+/* When reading log files in parallel, each worker adds blocks to its own copies of
+ * the shared module tables, which module_tables_merge() then folds into the shared
+ * tables.  This avoids any synchronization when adding blocks.
+ */
+struct worker_tables_t {
+    std::unordered_map<module_table_t *, module_table_t *> local;
+};
+
 static void
 module_vec_delete()
 {
@@ -561,6 +627,8 @@ module_vec_delete()
         if (table != MODULE_TABLE_IGNORE) {
             free(table->path);
             free(table->bb_table.bitmap);
+            delete table->hit_ranges;
+            delete table->hits;
             if (op_test_pattern.specified())
                 hashtable_delete(&table->test_htable);
             free(table);
@@ -649,6 +717,69 @@ bb_array_add(module_table_t *table, bb_entry_t *entry)
     return true;
 }
 
+static inline void
+module_table_hits_add(module_table_t *table, bb_entry_t *entry, uint64 count)
+{
+    if (table == MODULE_TABLE_IGNORE || count == 0)
+        return;
+    if (table->size <= entry->start + entry->size)
+        return; /* module_table_bb_add() warns about it */
+    if (table->hit_ranges == NULL)
+        table->hit_ranges = new std::vector<hit_range_t>();
+    table->hit_ranges->push_back({ entry->start, entry->start + entry->size, count });
+}
+
+static void
+module_table_finalize_hits(module_table_t *table)
+{
+    if (table->hit_ranges == NULL)
+        return;
+    /* Sweep over the range boundaries in order, keeping the total count of the
+     * ranges we are in.  We rely on unsigned wraparound to subtract what we added.
+     */
+    std::vector<std::pair<uint, uint64>> starts, ends;
+    starts.reserve(table->hit_ranges->size());
+    ends.reserve(table->hit_ranges->size());
+    for (const hit_range_t &range : *table->hit_ranges) {
+        starts.emplace_back(range.start, range.count);
+        ends.emplace_back(range.end, range.count);
+    }
+    delete table->hit_ranges;
+    table->hit_ranges = NULL;
+    std::sort(starts.begin(), starts.end());
+    std::sort(ends.begin(), ends.end());
+    table->hits = new std::vector<std::pair<uint, uint64>>();
+    uint64 count = 0;
+    size_t s = 0, e = 0;
+    while (s < starts.size() || e < ends.size()) {
+        uint offs =
+            (s < starts.size() && (e == ends.size() || starts[s].first < ends[e].first))
+            ? starts[s].first
+            : ends[e].first;
+        for (; s < starts.size() && starts[s].first == offs; s++)
+            count += starts[s].second;
+        for (; e < ends.size() && ends[e].first == offs; e++)
+            count -= ends[e].second;
+        if (!table->hits->empty() && table->hits->back().first == offs)
+            table->hits->back().second = count;
+        else
+            table->hits->emplace_back(offs, count);
+    }
+}
+
+static uint64
+module_table_hits_lookup(const module_table_t *table, uint64 addr_from_abs_base)
+{
+    if (table->hits == NULL || addr_from_abs_base - table->seg_offs > UINT_MAX)
+        return 0;
+    uint addr = (uint)(addr_from_abs_base - table->seg_offs);
+    auto it = std::upper_bound(table->hits->begin(), table->hits->end(),
+                               std::make_pair(addr, (uint64)ULLONG_MAX));
+    if (it == table->hits->begin())
+        return 0;
+    return (it - 1)->second;
+}
+
 static int
 module_table_bb_lookup(module_table_t *table, uint64 addr_from_abs_base,
                        const char **info)
@@ -734,7 +865,7 @@ module_table_search_testcase(const char *module, module_table_t *table)
 }
 
 static module_table_t *
-module_table_create(const char *module, uintptr_t seg_start, size_t seg_offs, size_t size)
+module_table_create(const char *module, size_t seg_offs, size_t size)
 {
     module_table_t *table;
     ASSERT(ALIGNED(size, dr_page_size()), "Module size is not aligned");
@@ -742,7 +873,6 @@ module_table_create(const char *module, uintptr_t seg_start, size_t seg_offs, si
     table = (module_table_t *)calloc(1, sizeof(*table));
     ASSERT(table != NULL, "Failed to allocate module table");
     table->path = my_strdup(module);
-    table->seg_start = seg_start;
     table->seg_offs = seg_offs;
     table->size = size;
     PRINT(3, "module table %p, %u\n", table, (uint)size);
@@ -766,6 +896,111 @@ module_table_create(const char *module, uintptr_t seg_start, size_t seg_offs, si
     return table;
 }
 
+/* Returns the table shared by all log files for the given module, creating it if
+ * this is the first log file with the module.
+ */
+static module_table_t *
+module_table_lookup_or_create(const char *module, size_t seg_offs,
+                              const drmodtrack_info_t *info)
+{
+    module_table_t *table;
+    if (op_test_pattern.specified()) {
+        table = module_table_create(module, seg_offs, info->size);
+        module_vec.push_back(table);
+        return table;
+    }
+    std::string key = std::string(module) + '|' + std::to_string(seg_offs) + '|' +
+        std::to_string(info->size);
+#ifdef WINDOWS
+    key += '|' + std::to_string(info->checksum) + '|' + std::to_string(info->timestamp);
+#endif
+    std::lock_guard<std::mutex> guard(module_map_lock);
+    auto it = module_map.find(key);
+    if (it != module_map.end())
+        return it->second;
+    table = module_table_create(module, seg_offs, info->size);
+    module_map.emplace(key, table);
+    module_vec.push_back(table);
+    return table;
+}
+
+/* Returns the worker's private copy of the shared table, or the shared table itself
+ * if the log file is read serially.
+ */
+static module_table_t *
+module_table_for_worker(worker_tables_t *worker, module_table_t *shared)
+{
+    if (worker == NULL || shared == MODULE_TABLE_IGNORE)
+        return shared;
+    auto it = worker->local.find(shared);
+    if (it != worker->local.end())
+        return it->second;
+    module_table_t *table = (module_table_t *)calloc(1, sizeof(*table));
+    ASSERT(table != NULL, "Failed to allocate module table");
+    table->path = shared->path; /* Not owned. */
+    table->seg_offs = shared->seg_offs;
+    table->size = shared->size;
+    table->bb_table.bitmap = (byte *)calloc(1, table->size / BITS_PER_BYTE);
+    ASSERT(table->bb_table.bitmap != NULL, "Failed to create module table");
+    worker->local.emplace(shared, table);
+    return table;
+}
+
+/* Folds the blocks and hit counts the workers added to their private copies of
+ * the given shared table into the shared table, and frees the copies.
+ */
+static void
+module_table_merge(module_table_t *shared, std::vector<worker_tables_t> &workers)
+{
+    /* The module size is page-aligned, so the bitmap is a whole number of words. */
+    size_t num_words = shared->size / BITS_PER_BYTE / sizeof(uint64);
+    uint64 *dst = (uint64 *)shared->bb_table.bitmap;
+    for (worker_tables_t &worker : workers) {
+        auto it = worker.local.find(shared);
+        if (it == worker.local.end())
+            continue;
+        module_table_t *local = it->second;
+        const uint64 *src = (const uint64 *)local->bb_table.bitmap;
+        for (size_t i = 0; i < num_words; i++)
+            dst[i] |= src[i];
+        if (local->hit_ranges != NULL) {
+            if (shared->hit_ranges == NULL) {
+                shared->hit_ranges = local->hit_ranges;
+            } else {
+                shared->hit_ranges->insert(shared->hit_ranges->end(),
+                                           local->hit_ranges->begin(),
+                                           local->hit_ranges->end());
+                delete local->hit_ranges;
+            }
+        }
+        free(local->bb_table.bitmap);
+        free(local);
+    }
+    module_table_finalize_hits(shared);
+}
+
+/* Merges the workers' tables into the shared tables, dividing the modules among
+ * num_threads threads.
+ */
+static void
+module_tables_merge(std::vector<worker_tables_t> &workers, uint num_threads)
+{
+    std::atomic<size_t> next(0);
+    auto merge_func = [&]() {
+        for (size_t i = next++; i < module_vec.size(); i = next++)
+            module_table_merge(module_vec[i], workers);
+    };
+    num_threads = std::min(num_threads, (uint)module_vec.size());
+    std::vector<std::thread> threads;
+    for (uint i = 1; i < num_threads; i++)
+        threads.emplace_back(merge_func);
+    merge_func();
+    for (std::thread &thread : threads)
+        thread.join();
+    for (worker_tables_t &worker : workers)
+        worker.local.clear();
+}
+
 static bool
 module_is_from_tool(const char *path)
 {
@@ -773,8 +1008,12 @@ module_is_from_tool(const char *path)
             strstr(path, DRCOV_LIB_NAME) != NULL || strstr(path, DRMEM_LIB_NAME) != NULL);
 }
 
+/* Sets *tables to the tables to add each module's blocks to: those of the worker,
+ * if worker is non-NULL, and otherwise the shared tables.
+ */
 static const char *
-read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
+read_module_list(const char *buf, worker_tables_t *worker, module_table_t ***tables,
+                 uint *num_mods)
 {
     const char *modpath;
     char subst[MAXIMUM_PATH];
@@ -790,6 +1029,7 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
     }
 
     *tables = (module_table_t **)calloc(*num_mods, sizeof(*tables));
+    std::vector<uintptr_t> starts(*num_mods);
     for (i = 0; i < *num_mods; i++) {
         module_table_t *mod_table;
         drmodtrack_info_t info = {
@@ -800,6 +1040,7 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
             ASSERT(false, "Failed to read module table");
         PRINT(5, "Module: %u, 0x%zx, %s\n", i, info.size, info.path);
         modpath = info.path;
+        starts[i] = (uintptr_t)info.start;
         if (info.size >= UINT_MAX)
             ASSERT(false, "module size is too large");
         /* XXX i#1445: we have seen the pdb convert paths to all-lowercase,
@@ -833,17 +1074,12 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
             size_t seg_offs = 0;
             if (info.containing_index != i) {
                 ASSERT(info.containing_index <= i, "invalid containing index");
-                seg_offs =
-                    (uintptr_t)info.start - (*tables)[info.containing_index]->seg_start;
+                seg_offs = (uintptr_t)info.start - starts[info.containing_index];
             }
-            mod_table =
-                module_table_create(modpath, (uintptr_t)info.start, seg_offs, info.size);
+            mod_table = module_table_for_worker(
+                worker, module_table_lookup_or_create(modpath, seg_offs, &info));
         }
-        PRINT(4, "Create module table " PFX " for module %s\n", mod_table, modpath);
-        module_vec.push_back(mod_table);
-        /* XXX: We could just use module_vec in the caller instead of this extra
-         * array, now that module_vec is a vector instead of a hashtable.
-         */
+        PRINT(4, "Use module table " PFX " for module %s\n", mod_table, modpath);
         (*tables)[i] = mod_table;
     }
     if (drmodtrack_offline_exit(handle) != DRCOVLIB_SUCCESS)
@@ -851,8 +1087,12 @@ read_module_list(const char *buf, module_table_t ***tables, uint *num_mods)
     return buf;
 }
 
+/* counts is NULL if the log file has no hit counts, and otherwise holds num_bbs
+ * counts of count_size bytes.
+ */
 static bool
-read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_bbs)
+read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_bbs,
+             const char *counts, uint count_size)
 {
     uint i;
     bb_entry_t *entry;
@@ -868,8 +1108,20 @@ read_bb_list(const char *buf, module_table_t **tables, uint num_mods, uint num_b
     for (i = 0, entry = (bb_entry_t *)buf; i < num_bbs; i++, entry++) {
         PRINT(6, "BB: 0x%x, %u, %u\n", entry->start, entry->size, entry->mod_id);
         /* we could have mod id USHRT_MAX for unknown module e.g., [vdso] */
-        if (entry->mod_id < num_mods)
+        if (entry->mod_id < num_mods) {
             add_new_bb = module_table_bb_add(tables[entry->mod_id], entry) || add_new_bb;
+            if (counts != NULL) {
+                uint64 count;
+                if (count_size == sizeof(uint64))
+                    memcpy(&count, counts + i * sizeof(uint64), sizeof(uint64));
+                else {
+                    uint count32;
+                    memcpy(&count32, counts + i * sizeof(uint), sizeof(uint));
+                    count = count32;
+                }
+                module_table_hits_add(tables[entry->mod_id], entry, count);
+            }
+        }
     }
     free(tables);
     return add_new_bb;
@@ -965,8 +1217,11 @@ close_input_file(file_t f, const char *map, size_t map_size)
     dr_close_file(f);
 }
 
+/* Adds the blocks of the given log file to the worker's tables, if worker is
+ * non-NULL, and otherwise to the shared tables.
+ */
 static bool
-read_drcov_file(const char *input)
+read_drcov_file(const char *input, worker_tables_t *worker)
 {
     file_t log;
     const char *map, *ptr;
@@ -984,24 +1239,52 @@ read_drcov_file(const char *input)
     ptr = read_file_header(map);
     if (ptr == NULL) {
         WARN(1, "Invalid version or bitwidth in drcov log file %s\n", input);
+        close_input_file(log, map, map_size);
         return false;
     }
 
-    ptr = read_module_list(ptr, &tables, &num_mods);
-    if (ptr == NULL)
+    ptr = read_module_list(ptr, worker, &tables, &num_mods);
+    if (ptr == NULL) {
+        close_input_file(log, map, map_size);
         return false;
+    }
 
     if (dr_sscanf(ptr, "BB Table: %u bbs\n", &num_bbs) != 1) {
         WARN(1, "Failed to read bb list from %s\n", input);
+        free(tables);
+        close_input_file(log, map, map_size);
         return false;
     }
     ptr = move_to_next_line(ptr);
-    if (num_bbs * sizeof(bb_entry_t) > map_size) {
+    if ((uint64)num_bbs * sizeof(bb_entry_t) > (uint64)(map + map_size - ptr)) {
         WARN(1, "Wrong number of bbs, corrupt log file %s\n", input);
+        free(tables);
         close_input_file(log, map, map_size);
         return false;
     }
-    res = read_bb_list(ptr, tables, num_mods, num_bbs);
+    /* An optional section of hit counts follows the blocks. */
+    const char *counts = NULL;
+    uint num_counts, count_size;
+    const char *counts_hdr = ptr + num_bbs * sizeof(bb_entry_t);
+    const char *map_end = map + map_size;
+    if (counts_hdr < map_end &&
+        dr_sscanf(counts_hdr, DRCOV_BB_COUNTS_HEADER, &num_counts, &count_size) == 2) {
+        /* The counts follow the header line right away: we do not use
+         * move_to_next_line(), which would skip counts that look like newlines.
+         */
+        const char *hdr_end =
+            (const char *)memchr(counts_hdr, '\n', map_end - counts_hdr);
+        if (num_counts != num_bbs ||
+            (count_size != sizeof(uint) && count_size != sizeof(uint64)) ||
+            hdr_end == NULL ||
+            (size_t)(map_end - (hdr_end + 1)) < (size_t)num_counts * count_size) {
+            WARN(1, "Invalid hit counts, corrupt log file %s\n", input);
+        } else {
+            counts = hdr_end + 1;
+            have_hit_counts = true;
+        }
+    }
+    res = read_bb_list(ptr, tables, num_mods, num_bbs, counts, count_size);
     if (res && set_log != INVALID_FILE)
         dr_fprintf(set_log, "%s\n", input);
     close_input_file(log, map, map_size);
@@ -1020,9 +1303,12 @@ is_drcov_log_file(const char *fname)
     return false;
 }
 
+/* The -dir and -list inputs append their log files to files for
+ * read_drcov_files().  They return whether any log files were found.
+ */
 #ifdef UNIX
 static bool
-read_drcov_dir(void)
+find_drcov_dir_files(std::vector<std::string> *files)
 {
     DIR *dir;
     struct dirent *ent;
@@ -1040,7 +1326,7 @@ read_drcov_dir(void)
                     WARN(1, "Fail to get full path of log file %s\n", ent->d_name);
                 } else {
                     NULL_TERMINATE_BUFFER(path);
-                    read_drcov_file(path);
+                    files->push_back(path);
                     found_logs = true;
                 }
             }
@@ -1057,7 +1343,7 @@ read_drcov_dir(void)
 }
 #else
 static bool
-read_drcov_dir(void)
+find_drcov_dir_files(std::vector<std::string> *files)
 {
     HANDLE hFind = INVALID_HANDLE_VALUE;
     WIN32_FIND_DATA ffd;
@@ -1087,7 +1373,8 @@ read_drcov_dir(void)
             if (!has_sep)
                 strcat(path, "\\");
             strcat(path, ffd.cFileName);
-            found_logs = read_drcov_file(path) || found_logs;
+            files->push_back(path);
+            found_logs = true;
         }
     } while (FindNextFile(hFind, &ffd) != 0);
     FindClose(hFind);
@@ -1098,7 +1385,7 @@ read_drcov_dir(void)
 #endif
 
 static bool
-read_drcov_list(void)
+find_drcov_list_files(std::vector<std::string> *files)
 {
     file_t list;
     const char *map, *ptr;
@@ -1120,7 +1407,8 @@ read_drcov_list(void)
         NULL_TERMINATE_BUFFER(path);
         ptr = move_to_next_line(ptr);
         null_terminate_path(path);
-        found_logs = read_drcov_file(path) || found_logs;
+        files->push_back(path);
+        found_logs = true;
     }
     close_input_file(list, map, map_size);
     if (!found_logs)
@@ -1128,16 +1416,85 @@ read_drcov_list(void)
     return found_logs;
 }
 
+static uint
+num_read_workers(size_t num_files)
+{
+    /* Which files add new coverage for -reduce_set, and which test owns a block for
+     * -test_pattern, depend on the order in which the files are read.
+     */
+    if (op_reduce_set.specified() || op_test_pattern.specified())
+        return 0;
+    int jobs = op_jobs.get_value();
+    if (jobs < 0) {
+        jobs = std::thread::hardware_concurrency();
+        if (jobs > DEFAULT_JOB_MAX)
+            jobs = DEFAULT_JOB_MAX;
+    }
+    if ((size_t)jobs > num_files)
+        jobs = (int)num_files;
+    return jobs <= 1 ? 0 : (uint)jobs;
+}
+
+/* Reads the given log files, each of which is memory-mapped and parsed in place.
+ * Returns whether each file was read successfully.
+ */
+static std::vector<char>
+read_drcov_files(const std::vector<std::string> &files)
+{
+    std::vector<char> read_ok(files.size());
+    uint num_workers = num_read_workers(files.size());
+    if (num_workers == 0) {
+        for (size_t i = 0; i < files.size(); i++)
+            read_ok[i] = read_drcov_file(files[i].c_str(), NULL);
+        return read_ok;
+    }
+    PRINT(2, "Reading %zu log files with %u workers\n", files.size(), num_workers);
+    /* The log files can differ greatly in size, so rather than a static division
+     * the workers take the next file from a shared index.
+     */
+    std::vector<worker_tables_t> workers(num_workers);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (uint i = 0; i < num_workers; i++) {
+        threads.emplace_back([&, i]() {
+            for (size_t j = next++; j < files.size(); j = next++)
+                read_ok[j] = read_drcov_file(files[j].c_str(), &workers[i]);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    PRINT(2, "Merging %zu module tables\n", module_vec.size());
+    module_tables_merge(workers, num_workers);
+    return read_ok;
+}
+
 static bool
 read_drcov_input(void)
 {
     bool res = true;
-    if (op_input.specified())
-        res = read_drcov_file(input_file_buf) && res;
-    if (op_list.specified())
-        res = read_drcov_list() && res;
-    if (op_dir.specified())
-        res = read_drcov_dir() && res;
+    std::vector<std::string> files;
+    /* Each input succeeds if any of its files is read successfully. */
+    std::vector<size_t> input_ends;
+    if (op_input.specified()) {
+        files.push_back(input_file_buf);
+        input_ends.push_back(files.size());
+    }
+    if (op_list.specified()) {
+        res = find_drcov_list_files(&files) && res;
+        input_ends.push_back(files.size());
+    }
+    if (op_dir.specified()) {
+        res = find_drcov_dir_files(&files) && res;
+        input_ends.push_back(files.size());
+    }
+    std::vector<char> read_ok = read_drcov_files(files);
+    size_t start = 0;
+    for (size_t end : input_ends) {
+        if (std::find(read_ok.begin() + start, read_ok.begin() + end, true) ==
+            read_ok.begin() + end)
+            res = false;
+        start = end;
+    }
     return res;
 }
 
@@ -1170,11 +1527,11 @@ enum_line_cb(drsym_line_info_t *info, void *data)
     if (status == BB_TABLE_ENTRY_SET) {
         PRINT(5, "exec: ");
         line_table_add(line_table, (uint)info->line, (byte)SOURCE_LINE_STATUS_EXEC,
-                       test_info);
+                       test_info, module_table_hits_lookup(table, info->line_addr));
     } else if (status == BB_TABLE_ENTRY_CLEAR) {
         PRINT(5, "skip: ");
         line_table_add(line_table, (uint)info->line, (byte)SOURCE_LINE_STATUS_SKIP,
-                       test_info);
+                       test_info, 0);
     } else {
         WARN(2, "Invalid bb lookup, Table: " PFX ", Addr: " PIFX "\n", table,
              IF_NOT_X64((uint)) info->line);
@@ -1188,9 +1545,10 @@ static bool
 enumerate_line_info(void)
 {
     /* iterate module table */
-    for (const auto *mod_table : module_vec) {
+    for (auto *mod_table : module_vec) {
         if (mod_table == MODULE_TABLE_IGNORE)
             continue;
+        module_table_finalize_hits(mod_table);
         if (strcmp(mod_table->path, "<unknown>") == 0)
             continue;
         bool has_lines = true;
@@ -44,14 +44,33 @@ string(REGEX REPLACE "@@" " " cmd "${cmd}")
 string(REGEX REPLACE "@" ";" cmd "${cmd}")
 string(REGEX REPLACE "!" "\\\;" cmd "${cmd}")
 
+# A variant passing -logdir keeps its logs apart from other runs of the same app.
+if ("${cmd}" MATCHES ";-logdir;([^;]+)")
+  set(log_dir "${CMAKE_MATCH_1}")
+  file(REMOVE_RECURSE "${log_dir}")
+  file(MAKE_DIRECTORY "${log_dir}")
+else ()
+  set(log_dir ".")
+endif ()
+
+# A -jobs variant runs the app several times and checks that merging the logs
+# in parallel gives the same output as merging them serially.
+if ("${cmp}" MATCHES "-jobs\\.expect$")
+  set(num_runs 3)
+else ()
+  set(num_runs 1)
+endif ()
+
 # run the cmd
-execute_process(COMMAND ${cmd}
-  RESULT_VARIABLE cmd_result
-  ERROR_VARIABLE cmd_err
-  OUTPUT_VARIABLE cmd_out)
-if (cmd_result)
-  message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
-endif (cmd_result)
+foreach (run RANGE 1 ${num_runs})
+  execute_process(COMMAND ${cmd}
+    RESULT_VARIABLE cmd_result
+    ERROR_VARIABLE cmd_err
+    OUTPUT_VARIABLE cmd_out)
+  if (cmd_result)
+    message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
+  endif (cmd_result)
+endforeach ()
 
 # get the real test name:
 # CMake uses the first '.' to identify the longest extension, so we cannot use
@@ -61,9 +80,11 @@ get_filename_component(test_name "${cmp}" NAME)
 string(REGEX REPLACE "\\.[^.]+$" "" test_name ${test_name})
 # tool.drcov.fib => fib
 string(REGEX REPLACE "^.+\\.([^.]+)$" "\\1" test_name ${test_name})
+# fib-counts => fib
+string(REGEX REPLACE "-.*$" "" test_name ${test_name})
 
-FILE(GLOB drcov_logs "drcov.*${test_name}*.log")
-set(cov_file "coverage.${test_name}")
+FILE(GLOB drcov_logs "${log_dir}/drcov.*${test_name}*.log")
+set(cov_file "${log_dir}/coverage.${test_name}")
 
 file(READ ${cmp} expect)
 if (WIN32)
@@ -71,19 +92,41 @@ if (WIN32)
   string(REGEX REPLACE "\r\\?" "" expect "${expect}")
 endif (WIN32)
 
-execute_process(COMMAND ${postcmd}
-  -dir        ./
-  -mod_filter ${test_name}
-  -src_filter ${test_name}
-  -output     ${cov_file}
-  RESULT_VARIABLE cmd_result
-  ERROR_VARIABLE cmd_err
-  OUTPUT_VARIABLE cmd_out)
-if (cmd_result)
-  message(FATAL_ERROR "*** ${postcmd} failed (${cmd_result}): ${cmd_err} ${cmd_out}***\n")
-endif (cmd_result)
+if (num_runs GREATER 1)
+  list(LENGTH drcov_logs num_logs)
+  if (NOT num_logs EQUAL num_runs)
+    message(FATAL_ERROR "expected ${num_runs} logs but found ${num_logs}")
+  endif ()
+  set(jobs_list 0 2)
+else ()
+  set(jobs_list default)
+endif ()
 
-file(READ ${cov_file} cov_out)
+foreach (jobs ${jobs_list})
+  if (jobs STREQUAL "default")
+    set(jobs_args "")
+  else ()
+    set(jobs_args -jobs ${jobs})
+  endif ()
+  execute_process(COMMAND ${postcmd}
+    -dir        ${log_dir}
+    -mod_filter ${test_name}
+    -src_filter ${test_name}
+    ${jobs_args}
+    -output     ${cov_file}
+    RESULT_VARIABLE cmd_result
+    ERROR_VARIABLE cmd_err
+    OUTPUT_VARIABLE cmd_out)
+  if (cmd_result)
+    message(FATAL_ERROR "*** ${postcmd} failed (${cmd_result}): ${cmd_err} ${cmd_out}***\n")
+  endif (cmd_result)
+  file(READ ${cov_file} cov_out)
+  if (DEFINED prev_cov_out AND NOT "${cov_out}" STREQUAL "${prev_cov_out}")
+    message(FATAL_ERROR "-jobs ${jobs} output ${cov_out} differs from -jobs 0 "
+      "output ${prev_cov_out}")
+  endif ()
+  set(prev_cov_out "${cov_out}")
+endforeach ()
 
 # cleanup
 foreach(logfile ${drcov_logs})
@@ -43,9 +43,16 @@
 #include "drmgr.h"
 #include "droption.h"
 #include "options.h"
+#include "../common/utils.h"
+#include <map>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <unordered_map>
+#include <string.h>
+#ifdef LINUX
+#    include <elf.h>
+#endif
 
 namespace dynamorio {
 namespace drcpusim {
@@ -740,13 +747,327 @@ report_invalid_opcode(int opc, app_pc pc)
         dr_abort();
 }
 
+/***************************************************************************
+ * Verdict cache
+ */
+
+// Checking every instruction each time a block is built is wasted work for code
+// that we have already checked: blocks are re-built after cache flushes and for
+// each thread with thread-private caches, and the same module code is checked again
+// on every run.  We remember the blocks of each module that were found to have no
+// unsupported instructions, and optionally save them across runs.
+
+// The verified blocks of a module, as a map from a block's start offset to the end
+// offset of the longest verified block starting there.
+struct module_verdicts_t {
+    app_pc start;
+    app_pc end;
+    // Whether violations in this module are never reported.
+    bool ignored;
+    // The file the verdicts are saved to, or empty if they are not saved.
+    std::string cache_file;
+    std::unordered_map<uint, uint> verified;
+    bool dirty;
+};
+
+#define VERDICT_FILE_MAGIC "DRCPUSIM VERDICTS 1\n"
+
+// Keyed by module start.  Protected by verdict_lock.
+static std::map<app_pc, module_verdicts_t *> verdict_modules;
+static void *verdict_lock;
+static uint num_blocks_checked;
+static uint num_blocks_cached;
+
+#ifdef LINUX
+#    ifdef X64
+typedef Elf64_Ehdr elf_ehdr_t;
+typedef Elf64_Phdr elf_phdr_t;
+#    else
+typedef Elf32_Ehdr elf_ehdr_t;
+typedef Elf32_Phdr elf_phdr_t;
+#    endif
+
+// Returns the GNU build id of the module in hex, read from its note segment, or the
+// empty string if it has none.
+static std::string
+module_build_id(const module_data_t *mod)
+{
+    elf_ehdr_t ehdr;
+    if (!dr_safe_read(mod->start, sizeof(ehdr), &ehdr, NULL) ||
+        memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr.e_phentsize != sizeof(elf_phdr_t))
+        return "";
+    ptr_int_t load_delta = mod->start - mod->preferred_base;
+    for (uint i = 0; i < ehdr.e_phnum; i++) {
+        elf_phdr_t phdr;
+        if (!dr_safe_read(mod->start + ehdr.e_phoff + i * sizeof(phdr), sizeof(phdr),
+                          &phdr, NULL))
+            return "";
+        if (phdr.p_type != PT_NOTE)
+            continue;
+        byte notes[1024];
+        size_t size = phdr.p_filesz < sizeof(notes) ? phdr.p_filesz : sizeof(notes);
+        if (!dr_safe_read((byte *)(phdr.p_vaddr + load_delta), size, notes, NULL))
+            continue;
+        for (size_t pos = 0; pos + sizeof(Elf32_Nhdr) <= size;) {
+            // The note header has the same layout for 64-bit.
+            Elf32_Nhdr *note = (Elf32_Nhdr *)(notes + pos);
+            size_t name_pos = pos + sizeof(*note);
+            size_t desc_pos = name_pos + ALIGN_FORWARD(note->n_namesz, 4);
+            size_t next_pos = desc_pos + ALIGN_FORWARD(note->n_descsz, 4);
+            if (next_pos > size)
+                break;
+            if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+                memcmp(notes + name_pos, "GNU", 4) == 0) {
+                std::string id;
+                for (uint j = 0; j < note->n_descsz; j++) {
+                    char hex[3];
+                    dr_snprintf(hex, BUFFER_SIZE_ELEMENTS(hex), "%02x",
+                                notes[desc_pos + j]);
+                    NULL_TERMINATE_BUFFER(hex);
+                    id += hex;
+                }
+                return id;
+            }
+            pos = next_pos;
+        }
+    }
+    return "";
+}
+#endif
+
+// Returns a string identifying the contents of the module's file, or the empty string
+// if we cannot identify it.
+static std::string
+module_identity(const module_data_t *mod)
+{
+#ifdef WINDOWS
+    char buf[64];
+    dr_snprintf(buf, BUFFER_SIZE_ELEMENTS(buf), "%x-%x", mod->checksum, mod->timestamp);
+    NULL_TERMINATE_BUFFER(buf);
+    return buf;
+#elif defined(MACOS)
+    char buf[3];
+    std::string id;
+    for (uint i = 0; i < sizeof(mod->uuid); i++) {
+        dr_snprintf(buf, BUFFER_SIZE_ELEMENTS(buf), "%02x", mod->uuid[i]);
+        NULL_TERMINATE_BUFFER(buf);
+        id += buf;
+    }
+    return id;
+#else
+    return module_build_id(mod);
+#endif
+}
+
+static void
+verdicts_load(module_verdicts_t *verdicts)
+{
+    file_t f = dr_open_file(verdicts->cache_file.c_str(), DR_FILE_READ);
+    if (f == INVALID_FILE)
+        return;
+    uint64 size;
+    std::vector<uint> buf;
+    if (dr_file_size(f, &size) && size >= strlen(VERDICT_FILE_MAGIC) &&
+        (size - strlen(VERDICT_FILE_MAGIC)) % (2 * sizeof(uint)) == 0) {
+        char magic[sizeof(VERDICT_FILE_MAGIC)];
+        buf.resize((size_t)(size - strlen(VERDICT_FILE_MAGIC)) / sizeof(uint));
+        if (dr_read_file(f, magic, strlen(VERDICT_FILE_MAGIC)) !=
+                (ssize_t)strlen(VERDICT_FILE_MAGIC) ||
+            memcmp(magic, VERDICT_FILE_MAGIC, strlen(VERDICT_FILE_MAGIC)) != 0 ||
+            dr_read_file(f, buf.data(), buf.size() * sizeof(uint)) !=
+                (ssize_t)(buf.size() * sizeof(uint)))
+            buf.clear();
+    }
+    dr_close_file(f);
+    for (size_t i = 0; i + 1 < buf.size(); i += 2) {
+        // Ignore corrupt entries.
+        if (buf[i] < buf[i + 1] &&
+            buf[i + 1] <= (size_t)(verdicts->end - verdicts->start))
+            verdicts->verified[buf[i]] = buf[i + 1];
+    }
+    NOTIFY(1, "Loaded %zu verified blocks from %s\n", verdicts->verified.size(),
+           verdicts->cache_file.c_str());
+}
+
+static void
+verdicts_save(module_verdicts_t *verdicts)
+{
+    if (verdicts->cache_file.empty() || !verdicts->dirty)
+        return;
+    // Other processes may be saving the same module, so we write a private file and
+    // rename it into place.
+    char tmp[MAXIMUM_PATH];
+    dr_snprintf(tmp, BUFFER_SIZE_ELEMENTS(tmp), "%s.%d.tmp",
+                verdicts->cache_file.c_str(), dr_get_process_id());
+    NULL_TERMINATE_BUFFER(tmp);
+    file_t f = dr_open_file(tmp, DR_FILE_WRITE_OVERWRITE);
+    if (f == INVALID_FILE) {
+        NOTIFY(0, "Failed to write verdict cache file %s\n", tmp);
+        return;
+    }
+    std::vector<uint> buf;
+    buf.reserve(verdicts->verified.size() * 2);
+    for (const auto &block : verdicts->verified) {
+        buf.push_back(block.first);
+        buf.push_back(block.second);
+    }
+    bool ok = dr_write_file(f, VERDICT_FILE_MAGIC, strlen(VERDICT_FILE_MAGIC)) ==
+            (ssize_t)strlen(VERDICT_FILE_MAGIC) &&
+        dr_write_file(f, buf.data(), buf.size() * sizeof(uint)) ==
+            (ssize_t)(buf.size() * sizeof(uint));
+    dr_close_file(f);
+    if (!ok || !dr_rename_file(tmp, verdicts->cache_file.c_str(), true)) {
+        NOTIFY(0, "Failed to write verdict cache file %s\n",
+               verdicts->cache_file.c_str());
+        dr_delete_file(tmp);
+        return;
+    }
+    NOTIFY(1, "Saved %zu verified blocks to %s\n", verdicts->verified.size(),
+           verdicts->cache_file.c_str());
+    verdicts->dirty = false;
+}
+
+static bool
+module_is_ignored(const module_data_t *mod)
+{
+    if (op_ignore_all_libs.get_value() && mod->start != exe_start)
+        return true;
+    const char *modname = dr_module_preferred_name(mod);
+    if (modname == NULL)
+        return false;
+    for (const std::string &entry : blocklist) {
+        if (entry == modname)
+            return true;
+    }
+    return false;
+}
+
+static void
+event_module_load(void *drcontext, const module_data_t *mod, bool loaded)
+{
+    module_verdicts_t *verdicts = new module_verdicts_t;
+    verdicts->start = mod->start;
+    verdicts->end = mod->end;
+    verdicts->ignored = module_is_ignored(mod);
+    verdicts->dirty = false;
+    const char *modname = dr_module_preferred_name(mod);
+    if (!op_verdict_cache_dir.get_value().empty() && !verdicts->ignored &&
+        modname != NULL) {
+        std::string id = module_identity(mod);
+        if (!id.empty()) {
+            verdicts->cache_file = op_verdict_cache_dir.get_value() + "/" + modname +
+                "." + id + "." + op_cpu.get_value() +
+                (op_allow_prefetchw.get_value() ? "" : "-noprefetchw") + ".verdicts";
+            verdicts_load(verdicts);
+        }
+    }
+    dr_mutex_lock(verdict_lock);
+    auto it = verdict_modules.find(mod->start);
+    if (it != verdict_modules.end()) {
+        // We missed an unload.
+        delete it->second;
+        verdict_modules.erase(it);
+    }
+    verdict_modules[mod->start] = verdicts;
+    dr_mutex_unlock(verdict_lock);
+}
+
+static void
+event_module_unload(void *drcontext, const module_data_t *mod)
+{
+    dr_mutex_lock(verdict_lock);
+    auto it = verdict_modules.find(mod->start);
+    if (it != verdict_modules.end()) {
+        verdicts_save(it->second);
+        delete it->second;
+        verdict_modules.erase(it);
+    }
+    dr_mutex_unlock(verdict_lock);
+}
+
+// Must be called with verdict_lock held.
+static module_verdicts_t *
+verdicts_lookup(app_pc pc)
+{
+    auto it = verdict_modules.upper_bound(pc);
+    if (it == verdict_modules.begin())
+        return NULL;
+    --it;
+    if (pc >= it->second->end)
+        return NULL;
+    return it->second;
+}
+
+static dr_emit_flags_t
+event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
+                  bool translating, void **user_data)
+{
+    // Traces and re-translations hold code that we already checked when it was
+    // built as a block.
+    if (for_trace || translating)
+        return DR_EMIT_DEFAULT;
+    instr_t *first = instrlist_first_app(bb);
+    instr_t *last = instrlist_last_app(bb);
+    if (first == NULL)
+        return DR_EMIT_DEFAULT;
+    app_pc start = instr_get_app_pc(first);
+    app_pc end = instr_get_app_pc(last) + instr_length(drcontext, last);
+    dr_mutex_lock(verdict_lock);
+    module_verdicts_t *verdicts = verdicts_lookup(start);
+    bool verified = false;
+    if (verdicts != NULL) {
+        if (verdicts->ignored || end > verdicts->end) {
+            // We report nothing for this module, or the block leaves it.
+            verified = verdicts->ignored;
+        } else {
+            auto it = verdicts->verified.find((uint)(start - verdicts->start));
+            verified = it != verdicts->verified.end() &&
+                end - verdicts->start <= (ptr_int_t)it->second;
+        }
+    }
+    num_blocks_checked++;
+    if (verified)
+        num_blocks_cached++;
+    dr_mutex_unlock(verdict_lock);
+    if (verified)
+        return DR_EMIT_DEFAULT;
+
+    bool supported = true;
+    app_pc next_pc = start;
+    for (instr_t *instr = instrlist_first(bb); instr != NULL;
+         instr = instr_get_next(instr)) {
+        // We check meta instrs too
+        if (!opcode_supported(instr)) {
+            supported = false;
+            report_invalid_opcode(instr_get_opcode(instr), instr_get_app_pc(instr));
+        }
+        if (instr_is_app(instr)) {
+            // Only cache blocks made of one contiguous range of code.
+            if (instr_get_app_pc(instr) != next_pc)
+                supported = false;
+            next_pc = instr_get_app_pc(instr) + instr_length(drcontext, instr);
+        }
+    }
+    if (!supported || verdicts == NULL || end > verdicts->end)
+        return DR_EMIT_DEFAULT;
+    dr_mutex_lock(verdict_lock);
+    // The module may have been unloaded and another loaded in its place.
+    if (verdicts_lookup(start) == verdicts) {
+        uint &verified_end = verdicts->verified[(uint)(start - verdicts->start)];
+        if ((uint)(end - verdicts->start) > verified_end) {
+            verified_end = (uint)(end - verdicts->start);
+            verdicts->dirty = true;
+        }
+    }
+    dr_mutex_unlock(verdict_lock);
+    return DR_EMIT_DEFAULT;
+}
+
 static dr_emit_flags_t
 event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
                       bool for_trace, bool translating, void *user_data)
 {
-    // We check meta instrs too
-    if (!opcode_supported(instr))
-        report_invalid_opcode(instr_get_opcode(instr), instr_get_app_pc(instr));
 #ifdef X86
     if (op_fool_cpuid.get_value() && instr_get_opcode(instr) == OP_cpuid) {
         // It's non-trivial to fully emulate cpuid, or even to emulate the cases
@@ -776,6 +1097,14 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
 static void
 event_exit(void)
 {
+    NOTIFY(1, "Checked %u blocks, skipping %u already verified or ignored\n",
+           num_blocks_checked, num_blocks_cached);
+    for (auto &it : verdict_modules) {
+        verdicts_save(it.second);
+        delete it.second;
+    }
+    verdict_modules.clear();
+    dr_mutex_destroy(verdict_lock);
     drmgr_exit();
 }
 
@@ -892,9 +1221,20 @@ dr_client_main(client_id_t id, int argc, const char *argv[])
     if (!drmgr_init())
         DR_ASSERT(false);
 
+    const std::string &cache_dir = dynamorio::drcpusim::op_verdict_cache_dir.get_value();
+    if (!cache_dir.empty() && !dr_directory_exists(cache_dir.c_str()) &&
+        !dr_create_dir(cache_dir.c_str())) {
+        NOTIFY(0, "Failed to create verdict cache directory %s\n", cache_dir.c_str());
+        dr_abort();
+    }
+    dynamorio::drcpusim::verdict_lock = dr_mutex_create();
+
     /* register events */
     drmgr_register_exit_event(dynamorio::drcpusim::event_exit);
-    if (!drmgr_register_bb_instrumentation_event(
-            NULL, dynamorio::drcpusim::event_app_instruction, NULL))
+    if (!drmgr_register_module_load_event(dynamorio::drcpusim::event_module_load) ||
+        !drmgr_register_module_unload_event(dynamorio::drcpusim::event_module_unload) ||
+        !drmgr_register_bb_instrumentation_event(
+            dynamorio::drcpusim::event_bb_analysis,
+            dynamorio::drcpusim::event_app_instruction, NULL))
         DR_ASSERT(false);
 }
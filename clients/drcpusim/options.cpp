@@ -148,6 +148,19 @@ droption_t<bool> op_ignore_all_libs(
     "Violations in libraries are ignored: only violations in the application executable "
     "itself are reported.");
 
+droption_t<std::string> op_verdict_cache_dir(
+    DROPTION_SCOPE_CLIENT, "verdict_cache_dir", "",
+    "Directory for caching verified code across runs.",
+    "drcpusim remembers which blocks of each module it has verified as supported by "
+    "the simulated CPU, so that re-building a block (after a cache flush or for another "
+    "thread) does not check its instructions again.  If this option names a directory, "
+    "the verified blocks of each module are also saved there at exit, in a file keyed by "
+    "the module's build id (its checksum and timestamp on Windows), the CPU model, and "
+    "-allow_prefetchw, and are loaded by later runs.  The directory is created if it "
+    "does not exist.  Only blocks with no unsupported instructions are cached, so each "
+    "run still reports every violation it executes.  Modules without a build id are not "
+    "saved.  The cache assumes that module code is not modified at runtime.");
+
 droption_t<unsigned int> op_verbose(DROPTION_SCOPE_CLIENT, "verbose", 0, 0, 64,
                                     "Verbosity level",
                                     "Verbosity level for notifications.");
@@ -47,6 +47,7 @@ extern dynamorio::droption::droption_t<bool> op_fool_cpuid;
 extern dynamorio::droption::droption_t<bool> op_allow_prefetchw;
 extern dynamorio::droption::droption_t<std::string> op_blocklist;
 extern dynamorio::droption::droption_t<bool> op_ignore_all_libs;
+extern dynamorio::droption::droption_t<std::string> op_verdict_cache_dir;
 extern dynamorio::droption::droption_t<unsigned int> op_verbose;
 
 } // namespace drcpusim
@@ -0,0 +1,66 @@
+# **********************************************************
+# Copyright (c) 2026 Google, Inc.    All rights reserved.
+# **********************************************************
+
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice,
+#   this list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+#   this list of conditions and the following disclaimer in the documentation
+#   and/or other materials provided with the distribution.
+#
+# * Neither the name of Google, Inc. nor the names of its contributors may be
+#   used to endorse or promote products derived from this software without
+#   specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+
+
+# Invoked by the test suite for testing -verdict_cache_dir: runs the command twice
+# and compares the second run's output, which should come from the cache.
+
+# input:
+# * precmd = command that clears the cache
+# * cmd = command to run
+#     should have intra-arg space=@@ and inter-arg space=@ and ;=!
+# * cmp = file containing the expected output of the second run
+
+foreach (var precmd cmd)
+  # Intra-arg space=@@ and inter-arg space=@.
+  string(REGEX REPLACE "@@" " " ${var} "${${var}}")
+  string(REGEX REPLACE "@" ";" ${var} "${${var}}")
+  string(REGEX REPLACE "!" "\\\;" ${var} "${${var}}")
+endforeach ()
+
+execute_process(COMMAND ${precmd} RESULT_VARIABLE cmd_result)
+if (cmd_result)
+  message(FATAL_ERROR "*** ${precmd} failed (${cmd_result})***\n")
+endif (cmd_result)
+
+foreach (run 1 2)
+  execute_process(COMMAND ${cmd}
+    RESULT_VARIABLE cmd_result
+    ERROR_VARIABLE cmd_err
+    OUTPUT_VARIABLE cmd_out)
+  if (cmd_result)
+    message(FATAL_ERROR "*** ${cmd} run ${run} failed (${cmd_result}): ${cmd_err}***\n")
+  endif (cmd_result)
+endforeach ()
+
+file(READ ${cmp} expect)
+if (NOT "${cmd_err}${cmd_out}" MATCHES "^${expect}$")
+  message(FATAL_ERROR "output |${cmd_err}${cmd_out}| failed to match |${expect}|")
+endif ()
@@ -0,0 +1,269 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Decoder benchmarking standalone app. */
+
+/* This is a standalone app for benchmarking the decoder.  We decode every
+ * executable section of an ELF file from start to end several times: one
+ * instruction at a time with decode(), in bulk with decode_region(), and with
+ * decode() again using the cache of decode_cache_enable().  We then check that
+ * the cache does not change any decoding.  A file that is not an ELF file for
+ * the target, such as the output of "objcopy -O binary" or a list of encodings,
+ * is decoded as raw code in its entirety.
+ */
+
+#include <elf.h>
+#include <link.h> /* for ElfW */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dr_api.h"
+
+#define GD GLOBAL_DCONTEXT
+
+#define DEFAULT_ITERATIONS 10
+#define DEFAULT_CACHE_ENTRIES 16384
+#define DIS_LEN 256
+#define REGION_RECORDS 4096
+
+typedef struct _section_t {
+    byte *start;
+    byte *end;
+} section_t;
+
+static int
+usage(const char *msg)
+{
+    if (msg != NULL && msg[0] != '\0')
+        fprintf(stderr, "%s\n", msg);
+    fprintf(stderr, "usage: drdecode_bench <elf_file> [iterations] [cache_entries]\n");
+    return 1;
+}
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static byte *
+read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    byte *buf = NULL;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long len = ftell(f);
+        if (len > 0 && fseek(f, 0, SEEK_SET) == 0) {
+            buf = (byte *)malloc(len);
+            if (buf != NULL && fread(buf, 1, len, f) != (size_t)len) {
+                free(buf);
+                buf = NULL;
+            }
+            *size = len;
+        }
+    }
+    fclose(f);
+    return buf;
+}
+
+/* Returns the number of executable sections found, up to max. */
+static int
+find_code_sections(byte *file, size_t size, section_t *sections, int max)
+{
+    ElfW(Ehdr) *ehdr = (ElfW(Ehdr) *)file;
+    if (size < sizeof(*ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != IF_X64_ELSE(ELFCLASS64, ELFCLASS32) ||
+        ehdr->e_shoff == 0 || ehdr->e_shoff + ehdr->e_shnum * sizeof(ElfW(Shdr)) > size)
+        return 0;
+    ElfW(Shdr) *shdr = (ElfW(Shdr) *)(file + ehdr->e_shoff);
+    int count = 0;
+    for (int i = 0; i < ehdr->e_shnum && count < max; i++) {
+        if (shdr[i].sh_type != SHT_PROGBITS || (shdr[i].sh_flags & SHF_EXECINSTR) == 0 ||
+            shdr[i].sh_offset + shdr[i].sh_size > size)
+            continue;
+        sections[count].start = file + shdr[i].sh_offset;
+        sections[count].end = sections[count].start + shdr[i].sh_size;
+        count++;
+    }
+    return count;
+}
+
+/* Decodes all the sections, skipping a byte past anything invalid, and returns the
+ * number of instructions decoded.
+ */
+static uint64
+decode_sections(section_t *sections, int num_sections)
+{
+    uint64 count = 0;
+    instr_t instr;
+    instr_init(GD, &instr);
+    for (int i = 0; i < num_sections; i++) {
+        byte *pc = sections[i].start;
+        while (pc < sections[i].end) {
+            instr_reset(GD, &instr);
+            byte *next_pc = decode(GD, pc, &instr);
+            pc = next_pc == NULL ? pc + 1 : next_pc;
+            count++;
+        }
+    }
+    instr_free(GD, &instr);
+    return count;
+}
+
+/* Decodes the sections into records with decode_region() and returns the number of
+ * instructions decoded.
+ */
+static uint64
+decode_sections_to_records(section_t *sections, int num_sections)
+{
+    static dr_decode_record_t records[REGION_RECORDS];
+    uint64 count = 0;
+    for (int i = 0; i < num_sections; i++) {
+        byte *pc = sections[i].start;
+        while (pc < sections[i].end) {
+            size_t num;
+            bool ok = decode_region(GD, pc, sections[i].end, records, REGION_RECORDS,
+                                    &num, &pc);
+            count += num;
+            if (!ok)
+                break; /* A partial instruction at the end. */
+        }
+    }
+    return count;
+}
+
+static double
+time_decoding(section_t *sections, int num_sections, int iterations, bool region,
+              uint64 *count)
+{
+    double start = now_seconds();
+    for (int i = 0; i < iterations; i++) {
+        *count = region ? decode_sections_to_records(sections, num_sections)
+                        : decode_sections(sections, num_sections);
+    }
+    return now_seconds() - start;
+}
+
+/* Returns the number of instructions decoded differently with the cache. */
+static uint64
+check_cache(section_t *sections, int num_sections)
+{
+    uint64 mismatches = 0;
+    char dis[DIS_LEN], cached_dis[DIS_LEN];
+    instr_t instr;
+    instr_init(GD, &instr);
+    for (int i = 0; i < num_sections; i++) {
+        byte *pc = sections[i].start;
+        while (pc < sections[i].end) {
+            byte *next_pc[2];
+            /* Decode each instruction twice, so that the second is a hit. */
+            for (int j = 0; j < 2; j++) {
+                instr_reset(GD, &instr);
+                next_pc[j] = decode(GD, pc, &instr);
+                instr_disassemble_to_buffer(GD, &instr, j == 0 ? dis : cached_dis,
+                                            DIS_LEN);
+            }
+            decode_cache_enable(0);
+            instr_reset(GD, &instr);
+            byte *uncached_next_pc = decode(GD, pc, &instr);
+            char uncached_dis[DIS_LEN];
+            instr_disassemble_to_buffer(GD, &instr, uncached_dis, DIS_LEN);
+            if (next_pc[0] != uncached_next_pc || next_pc[1] != uncached_next_pc ||
+                strcmp(dis, uncached_dis) != 0 || strcmp(cached_dis, uncached_dis) != 0) {
+                if (mismatches++ < 10)
+                    fprintf(stderr, "mismatch: %s vs %s\n", cached_dis, uncached_dis);
+            }
+            decode_cache_enable(64);
+            pc = uncached_next_pc == NULL ? pc + 1 : uncached_next_pc;
+        }
+    }
+    instr_free(GD, &instr);
+    return mismatches;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    if (argc < 2 || argc > 4)
+        return usage(NULL);
+    int iterations = argc > 2 ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    uint cache_entries = argc > 3 ? (uint)atoi(argv[3]) : DEFAULT_CACHE_ENTRIES;
+    if (iterations <= 0)
+        return usage("iterations must be positive");
+
+    size_t size;
+    byte *file = read_file(argv[1], &size);
+    if (file == NULL)
+        return usage("cannot read file");
+    section_t sections[64];
+    int num_sections = find_code_sections(file, size, sections,
+                                          sizeof(sections) / sizeof(sections[0]));
+    if (num_sections == 0) {
+        sections[0].start = file;
+        sections[0].end = file + size;
+        num_sections = 1;
+    }
+
+    uint64 count = 0;
+    double uncached = time_decoding(sections, num_sections, iterations, false, &count);
+    printf("%llu instrs x %d: %.3f s without cache (%.1f M instrs/s)\n",
+           (unsigned long long)count, iterations, uncached,
+           count * iterations / uncached / 1e6);
+    double region = time_decoding(sections, num_sections, iterations, true, &count);
+    printf("%llu instrs x %d: %.3f s with decode_region (%.1f M instrs/s, %.2fx)\n",
+           (unsigned long long)count, iterations, region,
+           count * iterations / region / 1e6, uncached / region);
+
+    if (!decode_cache_enable(cache_entries)) {
+        printf("decode cache not supported\n");
+        free(file);
+        return 0;
+    }
+    double cached = time_decoding(sections, num_sections, iterations, false, &count);
+    printf("%llu instrs x %d: %.3f s with %u-entry cache (%.1f M instrs/s, %.2fx)\n",
+           (unsigned long long)count, iterations, cached, cache_entries,
+           count * iterations / cached / 1e6, uncached / cached);
+
+    decode_cache_enable(64);
+    uint64 mismatches = check_cache(sections, num_sections);
+    decode_cache_enable(0);
+    printf("%llu instrs decoded differently with the cache\n",
+           (unsigned long long)mismatches);
+    free(file);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -33,8 +33,8 @@
 /* DrPoints: Basic Block Vector (BBV) Client.
  *
  * Given a user-defined instruction interval, computes the BBVs (histogram of BB
- * frequencies within the interval) of a program execution and outputs them in a .bbv
- * file.
+ * frequencies within the interval) of each thread of a program execution and outputs
+ * them in a .bbv file per thread.
  *
  * The generated .bbv file look like:
  *
@@ -46,6 +46,10 @@
  * and starts from 1, and count = number_of_times_BB_was_executed * instructions_of_BB.
  * This format follows what SimpointToolkit 3.2 expects:
  * https://cseweb.ucsd.edu/~calder/simpoint/releases/SimPoint.3.2.tar.gz
+ *
+ * With -num_simpoints, the intervals of each thread are also clustered in-process the
+ * way SimPoint does it, and the chosen simulation points and their weights are written
+ * to .simpoints and .weights files in SimPoint's output format.
  */
 
 #include "dr_api.h"
@@ -61,6 +65,7 @@
 #include "../common/utils.h"
 
 #include <cinttypes>
+#include <climits>
 #include <string>
 
 namespace dynamorio {
@@ -72,8 +77,6 @@ using ::dynamorio::droption::droption_parser_t;
 using ::dynamorio::droption::DROPTION_SCOPE_CLIENT;
 using ::dynamorio::droption::droption_t;
 
-#define CHECK_TRUNCATE_TYPE_uint(val) ((val) >= 0 && (val) <= UINT_MAX)
-
 #define FATAL(...)                       \
     do {                                 \
         dr_fprintf(STDERR, __VA_ARGS__); \
@@ -81,7 +84,6 @@ using ::dynamorio::droption::droption_t;
     } while (0)
 
 #define HASH_BITS_BB_ID 13
-#define HASH_BITS_BB_COUNT 13
 
 #define MINSERT instrlist_meta_preinsert
 
@@ -91,12 +93,33 @@ using ::dynamorio::droption::droption_t;
 // TODO i#7685: We don't have the inlining implementation yet for 32-bit architectures.
 #endif
 
+// The inlined counter update addresses a thread's counters with a 32-bit displacement
+// from the base of its counter array, and each thread reserves room for -max_bbs
+// counters up front: we keep both at a sane size.
+#define MAX_BBS_LIMIT (1U << 24)
+static_assert(static_cast<uint64_t>(MAX_BBS_LIMIT) * sizeof(uint64_t) <= INT_MAX,
+              "the largest BB counter must be reachable with a 32-bit displacement");
+
+// Number of dimensions BBVs are randomly projected to for clustering, as in SimPoint.
+#define PROJECTION_DIMS 15
+// Fixed-point precision of the normalized BBV entries and of the projection matrix
+// entries. We cluster in integer arithmetic, as the client does not save the
+// application's floating-point state, and these bounds keep a squared distance
+// between two projected BBVs well within 64 bits.
+#define PROJECTION_WEIGHT_BITS 16
+#define PROJECTION_COEFF_BITS 10
+// SimPoint's default bound on k-means iterations.
+#define KMEANS_MAX_ITERS 100
+
+// The first bytes of a binary .bbv file.
+#define BINARY_BBV_MAGIC "DRBBV\x01\n"
+
 static droption_t<bytesize_t> instr_interval(
     DROPTION_SCOPE_CLIENT, "instr_interval", 100000000 /*=100M instructions*/,
     "The instruction interval for which to generate BBVs",
-    "Divides the program execution into instruction intervals of the specified size and "
-    "generates BBVs as the BB execution frequency within the interval times the number "
-    "of instructions in the BB. Default is 100M instructions.");
+    "Divides the execution of each thread into instruction intervals of the specified "
+    "size and generates BBVs as the BB execution frequency within the interval times "
+    "the number of instructions in the BB. Default is 100M instructions.");
 
 static droption_t<bool>
     print_to_stdout(DROPTION_SCOPE_CLIENT, "print_to_stdout", false,
@@ -110,11 +133,12 @@ static droption_t<bool> no_out_bbv_file(
     "Disables the generation of the output .bbv file, but still runs the client. Useful "
     "for unit tests or paired with -print_to_stdout. Default is false.");
 
-static droption_t<std::string>
-    out_bbv_file(DROPTION_SCOPE_CLIENT, "out_bbv_file", "",
-                 "The path to the output .bbv file",
-                 "Specifies a different path to the .bbv file. Default is "
-                 "${PWD}/drpoints.BINARY_NAME.PID.UNIQUE_ID.bbv.");
+static droption_t<std::string> out_bbv_file(
+    DROPTION_SCOPE_CLIENT, "out_bbv_file", "", "The path to the output .bbv file",
+    "Specifies a different path to the .bbv file. Default is "
+    "${PWD}/drpoints.BINARY_NAME.PID.UNIQUE_ID.bbv. The files of threads other than the "
+    "first one have their thread id appended to the path, or in the default name take "
+    "the place of the PID.");
 
 static droption_t<uint> save_bbv_every(
     DROPTION_SCOPE_CLIENT, "save_bbv_every", 100,
@@ -123,41 +147,96 @@ static droption_t<uint> save_bbv_every(
     "the accumulated BBVs are written to the output file or stdout and cleared from "
     "memory. This is useful for long-running programs, or programs that execute a high "
     "number of BBs within an instruction interval to avoid out-of-memory issues. A value "
-    "of 0 means that all BBVs are kept in memory and only written at program exit. "
+    "of 0 means that all BBVs are kept in memory and only written at thread exit. "
     "Default is 100.");
 
+static droption_t<uint> max_bbs(
+    DROPTION_SCOPE_CLIENT, "max_bbs", 1 << 20, 1, MAX_BBS_LIMIT,
+    "Maximum number of distinct basic blocks",
+    "Each thread counts BB executions in a dense array indexed by BB id that is "
+    "reserved up front with room for this many BBs, and is only backed by memory as it "
+    "is touched. The client aborts if the application executes more distinct BBs. "
+    "Default is 1M; at most 16M.");
+
+static droption_t<uint> num_simpoints(
+    DROPTION_SCOPE_CLIENT, "num_simpoints", 0,
+    "Maximum number of simulation points to pick for each thread",
+    "When non-zero, clusters the instruction intervals of each thread into at most this "
+    "many clusters with k-means on random projections of their BBVs, as SimPoint does, "
+    "and writes the interval closest to the center of each cluster and the cluster's "
+    "weight to .simpoints and .weights files named like the .bbv file. They are also "
+    "printed with -print_to_stdout. Default is 0, which disables clustering.");
+
+static droption_t<bool> binary_bbv(
+    DROPTION_SCOPE_CLIENT, "binary_bbv", false,
+    "Writes the .bbv file in a compact binary format",
+    "Writes the .bbv file in a compact binary format instead of text. The file starts "
+    "with the 8 bytes \"DRBBV\\x01\\n\\0\", followed by one record per interval "
+    "holding LEB128-encoded unsigned integers: the number of BBs executed in the "
+    "interval, then for each such BB in increasing id order the difference between its "
+    "id and the previous BB's id (taken as 0 for the first BB) and its count. Output to "
+    "stdout stays text. Default is false.");
+
+// Raw TLS slots, which the inlined instrumentation accesses directly.
+enum {
+    // The base of the thread's dense array of BB execution counts.
+    DRPOINTS_TLS_OFFS_COUNTS,
+    // The thread's instruction counter to keep track of when we reach the end of the
+    // user-defined instruction interval. Starts at instr_interval and is decremented
+    // until <= 0.
+    DRPOINTS_TLS_OFFS_ICOUNT,
+    DRPOINTS_TLS_COUNT,
+};
+
+#define TLS_SLOT(tls_base, enum_val) \
+    (void **)((byte *)(tls_base) + tls_offs + (enum_val) * sizeof(void *))
+#define INSTR_COUNT(tls_base) *(ptr_int_t *)TLS_SLOT(tls_base, DRPOINTS_TLS_OFFS_ICOUNT)
+
+static reg_id_t tls_seg;
+static uint tls_offs;
+static int tls_idx;
+
+// Per-thread data. Each thread only ever touches its own, so none of it needs locking.
+struct per_thread_t {
+    thread_id_t tid;
+    // Whether this is the first thread, whose output files keep the process-wide
+    // names.
+    bool first_thread;
+    // Base of the raw TLS slots.
+    byte *seg_base;
+    // Dense array of BB execution counts in the current instruction interval, indexed
+    // by BB id. Each value is execution_count*BB_instruction_size.
+    uint64_t *counts;
+    // List of Basic Block Vectors (BBVs).
+    // This is a vector of vector pointers. Each vector element represents the BBV for
+    // an instruction interval, where the index is the BB id - 1 and the value is
+    // execution_count*BB_instruction_size.
+    drvector_t bbvs;
+    // The BBV index to count the number of processed instruction intervals.
+    uint bbv_idx;
+    // The random projection of the BBV of every instruction interval, for
+    // -num_simpoints. Each entry is an array of PROJECTION_DIMS int64_t.
+    drvector_t projections;
+    // The .bvv file handle.
+    file_t bbvs_file;
+};
+
 // Global hash table that maps the pair module-index and PC-offset to the module's base
 // address (which uniquely identify a BB) to a unique, 1-indexed, increasing ID that comes
-// from unique_bb_count.
+// from unique_bb_count. It is only used at instrumentation time, under bb_id_lock.
 static hashtable_t bb_id_table;
-
-// Global hash table to keep track of the execution count of BBs.
-// Key: unique BB ID, value: execution count times BB instruction size.
-static hashtable_t bb_count_table;
+static void *bb_id_lock;
 
 // Global unique BB counter used as ID. It must start from 1.
-static uint64_t unique_bb_count = 1;
-
-// Global instruction counter to keep track of when we reach the end of the user-defined
-// instruction interval. Starts at instr_interval and is decremented until <= 0.
-static int64_t instr_count;
+// It is written under bb_id_lock and read atomically by the threads when they save a
+// BBV.
+static volatile int unique_bb_count = 1;
 
-// List of Basic Block Vectors (BBVs).
-// This is a vector of vector pointers. Each vector element represents the BBV for an
-// instruction interval, where the index is the BB id and the value is
-// execution_count*BB_instruction_size.
-static drvector_t bbvs;
+// Number of threads seen so far.
+static volatile int thread_count;
 
-// Keeps track of the number of threads of the application. We abort when we detect a
-// multi-threaded application as it's not supported yet.
-// TODO i#7685: add support for multi-threaded applications.
-static int thread_count = 0;
-
-// The .bvv file handle.
-static file_t bbvs_file = INVALID_FILE;
-
-// The BBV index to count the number of processed instruction intervals.
-static uint bbv_idx = 0;
+// Serializes printing to stdout so that lines from different threads do not mix.
+static void *stdout_lock;
 
 // We use this structure as key for bb_id_table to uniquely identify a BB.
 struct modidx_offset_t {
@@ -199,6 +278,12 @@ free_bbv(void *entry)
     dr_global_free(vector, sizeof(*vector));
 }
 
+static void
+free_projection(void *entry)
+{
+    dr_global_free(entry, PROJECTION_DIMS * sizeof(int64_t));
+}
+
 static void
 free_bb_id(void *key)
 {
@@ -206,59 +291,134 @@ free_bb_id(void *key)
     dr_global_free(bb_id_key, sizeof(*bb_id_key));
 }
 
-static void
-free_count(void *entry)
+static size_t
+counts_size()
 {
-    uint64_t *count = static_cast<uint64_t *>(entry);
-    dr_global_free(count, sizeof(*count));
+    // BB ids start from 1, so we leave entry 0 unused.
+    return (static_cast<size_t>(max_bbs.get_value()) + 1) * sizeof(uint64_t);
 }
 
 static void
-add_to_bbv(void *key, void *payload, void *user_data)
+reset_instr_count(per_thread_t *data)
 {
-    uint64_t count = *(static_cast<uint64_t *>(payload));
-    // Skip BBs that were not executed in the current instruction interval.
-    if (count == 0)
-        return;
-    uint64_t id = reinterpret_cast<uint64_t>(key);
-    // We want to fail if id does not fit in a 32 bit integer, otherwise we will have an
-    // incorrect BBV.
-    if (!CHECK_TRUNCATE_TYPE_uint(id))
-        FATAL("ERROR: BB ID is too large");
-
-    // Add BB frequency to BBV.
-    drvector_t *bbv = static_cast<drvector_t *>(user_data);
-    drvector_set_entry(bbv, static_cast<uint>(id - 1), reinterpret_cast<void *>(count));
+    INSTR_COUNT(data->seg_base) = instr_interval.get_value();
+#if defined(INLINE_COUNTER_UPDATE) && defined(AARCH64)
+    // The counter inline optimization for AARCH64 uses OP_tbz (test bit and branch if 0),
+    // which in this case tests the sign bit and does not branch to save_bbv() when
+    // instr_count reaches 0, it branches only when instr_count < 0, so we decrement the
+    // initial count by 1 here to keep the same "branch when instr_count <= 0" behavior.
+    --INSTR_COUNT(data->seg_base);
+#endif
 }
 
-// We add execution counters to the table at instrumentation time. We cannot remove them
-// from the bb_count_table when we reach the instruction interval at execution time, or
-// the next interval won't have an execution counter. So, we set them to zero.
-static void
-set_count_to_zero(void *payload)
+// Opens the output file with the given suffix for the thread. The first thread uses the
+// process-wide name, while other threads use their thread id.
+static file_t
+open_thread_file(per_thread_t *data, const char *suffix, bool is_bbv)
 {
-    uint64_t *count = static_cast<uint64_t *>(payload);
-    *count = 0;
+    file_t file;
+    std::string path_to_bbv_file = out_bbv_file.get_value();
+    if (!path_to_bbv_file.empty()) {
+        // The .bbv file takes the path as is and the other files add their suffix.
+        const char *sep = is_bbv ? "" : ".";
+        if (is_bbv)
+            suffix = "";
+        char path[MAXIMUM_PATH];
+        if (data->first_thread) {
+            dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%s%s",
+                        path_to_bbv_file.c_str(), sep, suffix);
+        } else {
+            dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s.%d%s%s",
+                        path_to_bbv_file.c_str(), static_cast<int>(data->tid), sep,
+                        suffix);
+        }
+        NULL_TERMINATE_BUFFER(path);
+        file = dr_open_file(path, DR_FILE_WRITE_REQUIRE_NEW);
+    } else {
+        // Get the current working directory where drrun is executing. We save the
+        // output files there.
+        char cwd[MAXIMUM_PATH];
+        if (!dr_get_current_directory(cwd, sizeof(cwd)))
+            FATAL("ERROR: dr_get_current_directory() failed");
+
+        // Create and open the drpoints.PROC_BIN_NAME.ID.UNIQUE_ID.suffix file.
+        ptr_int_t id = data->first_thread ? dr_get_process_id() : data->tid;
+        char buf[MAXIMUM_PATH];
+        file = drx_open_unique_appid_file(cwd, id, "drpoints", suffix,
+                                          DR_FILE_WRITE_REQUIRE_NEW, buf, sizeof(buf));
+    }
+    if (file == INVALID_FILE)
+        FATAL("ERROR: unable to create %s file", suffix);
+    return file;
 }
 
 static void
-bbvs_clear()
+bbvs_clear(per_thread_t *data)
 {
-    for (uint i = 0; i < bbvs.entries; ++i) {
-        drvector_t *bbv = static_cast<drvector_t *>(drvector_get_entry(&bbvs, i));
+    for (uint i = 0; i < data->bbvs.entries; ++i) {
+        drvector_t *bbv = static_cast<drvector_t *>(drvector_get_entry(&data->bbvs, i));
         drvector_clear(bbv);
     }
 }
 
+// Appends val to buf as an unsigned LEB128 value and returns the new end of buf.
+static byte *
+append_leb128(byte *buf, uint64_t val)
+{
+    do {
+        byte b = val & 0x7f;
+        val >>= 7;
+        if (val != 0)
+            b |= 0x80;
+        *buf++ = b;
+    } while (val != 0);
+    return buf;
+}
+
 static void
-write_bbvs()
+write_binary_bbv(per_thread_t *data, drvector_t *bbv)
+{
+    uint num_pairs = 0;
+    for (uint j = 0; j < bbv->entries; ++j) {
+        if (drvector_get_entry(bbv, j) != nullptr)
+            ++num_pairs;
+    }
+    if (num_pairs == 0)
+        return;
+    // A LEB128-encoded 64-bit value takes at most 10 bytes.
+    size_t max_size = (1 + 2 * static_cast<size_t>(num_pairs)) * 10;
+    byte *record = static_cast<byte *>(dr_global_alloc(max_size));
+    byte *end = append_leb128(record, num_pairs);
+    uint prev_id = 0;
+    for (uint j = 0; j < bbv->entries; ++j) {
+        uint64_t count = reinterpret_cast<uint64_t>(drvector_get_entry(bbv, j));
+        if (count == 0)
+            continue;
+        uint id = j + 1;
+        end = append_leb128(end, id - prev_id);
+        end = append_leb128(end, count);
+        prev_id = id;
+    }
+    dr_write_file(data->bbvs_file, record, end - record);
+    dr_global_free(record, max_size);
+}
+
+static void
+write_bbvs(per_thread_t *data)
 {
     const char *first_pair_fmt_str = "T:%" PRIu64 ":%" PRIu64 " ";
     const char *middle_pair_fmt_str = ":%" PRIu64 ":%" PRIu64 " ";
     bool print_to_stdout_enabled = print_to_stdout.get_value();
     bool out_bbv_file_enabled = !no_out_bbv_file.get_value();
-    for (uint i = 0; i < bbvs.entries; ++i) {
-        drvector_t *bbv = static_cast<drvector_t *>(drvector_get_entry(&bbvs, i));
+    bool out_text_file = out_bbv_file_enabled && !binary_bbv.get_value();
+    if (print_to_stdout_enabled)
+        dr_mutex_lock(stdout_lock);
+    for (uint i = 0; i < data->bbvs.entries; ++i) {
+        drvector_t *bbv = static_cast<drvector_t *>(drvector_get_entry(&data->bbvs, i));
+        if (out_bbv_file_enabled && binary_bbv.get_value())
+            write_binary_bbv(data, bbv);
+        if (!print_to_stdout_enabled && !out_text_file)
+            continue;
         bool first_pair = true;
         for (uint j = 0; j < bbv->entries; ++j) {
             uint64_t count = reinterpret_cast<uint64_t>(drvector_get_entry(bbv, j));
@@ -275,87 +435,314 @@ write_bbvs()
             }
 
             char msg[64];
-            int len =
-                dr_snprintf(msg, BUFFER_SIZE_ELEMENTS(msg), format_string, j + 1, count);
+            int len = dr_snprintf(msg, BUFFER_SIZE_ELEMENTS(msg), format_string,
+                                  static_cast<uint64_t>(j + 1), count);
             NULL_TERMINATE_BUFFER(msg);
             DR_ASSERT(len > 0);
 
             if (print_to_stdout_enabled)
                 dr_fprintf(STDOUT, "%s", msg);
 
-            if (out_bbv_file_enabled)
-                dr_write_file(bbvs_file, msg, static_cast<size_t>(len));
+            if (out_text_file)
+                dr_write_file(data->bbvs_file, msg, static_cast<size_t>(len));
         }
         if (!first_pair) {
             if (print_to_stdout_enabled)
                 dr_fprintf(STDOUT, "\n");
-            if (out_bbv_file_enabled)
-                dr_write_file(bbvs_file, "\n", 1);
+            if (out_text_file)
+                dr_write_file(data->bbvs_file, "\n", 1);
         }
     }
+    if (print_to_stdout_enabled)
+        dr_mutex_unlock(stdout_lock);
+}
+
+// Returns a fixed pseudo-random entry in [-2^PROJECTION_COEFF_BITS,
+// 2^PROJECTION_COEFF_BITS) of the projection matrix. We derive it by hashing its
+// coordinates so that we never need to store the matrix, whose height grows with the
+// number of BBs.
+static int64_t
+projection_coefficient(int bb_id, int dim)
+{
+    // The splitmix64 finalizer.
+    uint64_t x = static_cast<uint64_t>(bb_id) * PROJECTION_DIMS + dim;
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<int64_t>(x >> (64 - PROJECTION_COEFF_BITS - 1)) -
+        (1 << PROJECTION_COEFF_BITS);
+}
+
+// Records the random projection of the current interval's BBV, normalized by the
+// interval's instruction count as SimPoint does.
+static void
+add_projection(per_thread_t *data, int num_ids)
+{
+    uint64_t total = 0;
+    for (int id = 1; id < num_ids; ++id)
+        total += data->counts[id];
+    int64_t *projection =
+        static_cast<int64_t *>(dr_global_alloc(PROJECTION_DIMS * sizeof(int64_t)));
+    for (int dim = 0; dim < PROJECTION_DIMS; ++dim)
+        projection[dim] = 0;
+    for (int id = 1; id < num_ids && total > 0; ++id) {
+        if (data->counts[id] == 0)
+            continue;
+        int64_t weight =
+            static_cast<int64_t>((data->counts[id] << PROJECTION_WEIGHT_BITS) / total);
+        for (int dim = 0; dim < PROJECTION_DIMS; ++dim)
+            projection[dim] += weight * projection_coefficient(id, dim);
+    }
+    drvector_append(&data->projections, projection);
+}
+
+static uint64_t
+projection_distance(const int64_t *a, const int64_t *b)
+{
+    uint64_t dist = 0;
+    for (int dim = 0; dim < PROJECTION_DIMS; ++dim) {
+        int64_t diff = a[dim] - b[dim];
+        dist += static_cast<uint64_t>(diff * diff);
+    }
+    return dist;
+}
+
+static void
+write_simpoint_line(file_t file, const char *msg, int len)
+{
+    if (file != INVALID_FILE)
+        dr_write_file(file, msg, static_cast<size_t>(len));
+    if (print_to_stdout.get_value())
+        dr_fprintf(STDOUT, "%s", msg);
+}
+
+// Clusters the thread's intervals with k-means and writes the interval closest to the
+// center of each cluster and the fraction of intervals in the cluster, in the format of
+// SimPoint's -saveSimpoints and -saveSimpointWeights files.
+static void
+write_simpoints(per_thread_t *data)
+{
+    uint num_intervals = data->projections.entries;
+    if (num_intervals == 0)
+        return;
+    uint k = num_simpoints.get_value();
+    if (k > num_intervals)
+        k = num_intervals;
+    // k drops below max_k if fewer distinct intervals than that are found.
+    const uint max_k = k;
+    int64_t **points = reinterpret_cast<int64_t **>(data->projections.array);
+    size_t centers_size = max_k * PROJECTION_DIMS * sizeof(int64_t);
+    int64_t *centers = static_cast<int64_t *>(dr_global_alloc(centers_size));
+    uint *cluster = static_cast<uint *>(dr_global_alloc(num_intervals * sizeof(uint)));
+    uint64_t *dist =
+        static_cast<uint64_t *>(dr_global_alloc(num_intervals * sizeof(uint64_t)));
+    uint *sizes = static_cast<uint *>(dr_global_alloc(max_k * sizeof(uint)));
+    uint *closest = static_cast<uint *>(dr_global_alloc(max_k * sizeof(uint)));
+
+    // Deterministic farthest-first initialization: start from the first interval and
+    // repeatedly add the interval farthest from every center so far. We stop early if
+    // the remaining intervals all coincide with a center.
+    for (int dim = 0; dim < PROJECTION_DIMS; ++dim)
+        centers[dim] = points[0][dim];
+    for (uint i = 0; i < num_intervals; ++i) {
+        cluster[i] = 0;
+        dist[i] = projection_distance(points[i], centers);
+    }
+    uint num_centers = 1;
+    while (num_centers < k) {
+        uint farthest = 0;
+        for (uint i = 1; i < num_intervals; ++i) {
+            if (dist[i] > dist[farthest])
+                farthest = i;
+        }
+        if (dist[farthest] == 0)
+            break;
+        int64_t *center = centers + num_centers * PROJECTION_DIMS;
+        for (int dim = 0; dim < PROJECTION_DIMS; ++dim)
+            center[dim] = points[farthest][dim];
+        for (uint i = 0; i < num_intervals; ++i) {
+            uint64_t d = projection_distance(points[i], center);
+            if (d < dist[i]) {
+                dist[i] = d;
+                cluster[i] = num_centers;
+            }
+        }
+        ++num_centers;
+    }
+    k = num_centers;
+
+    // Lloyd's iterations.
+    for (int iter = 0; iter < KMEANS_MAX_ITERS; ++iter) {
+        for (uint c = 0; c < k; ++c) {
+            int64_t *center = centers + c * PROJECTION_DIMS;
+            uint size = 0;
+            int64_t sum[PROJECTION_DIMS] = {};
+            for (uint i = 0; i < num_intervals; ++i) {
+                if (cluster[i] != c)
+                    continue;
+                ++size;
+                for (int dim = 0; dim < PROJECTION_DIMS; ++dim)
+                    sum[dim] += points[i][dim];
+            }
+            // An empty cluster keeps its center.
+            if (size > 0) {
+                for (int dim = 0; dim < PROJECTION_DIMS; ++dim)
+                    center[dim] = sum[dim] / static_cast<int64_t>(size);
+            }
+        }
+        bool changed = false;
+        for (uint i = 0; i < num_intervals; ++i) {
+            uint best = cluster[i];
+            uint64_t best_dist =
+                projection_distance(points[i], centers + best * PROJECTION_DIMS);
+            for (uint c = 0; c < k; ++c) {
+                uint64_t d =
+                    projection_distance(points[i], centers + c * PROJECTION_DIMS);
+                if (d < best_dist) {
+                    best_dist = d;
+                    best = c;
+                }
+            }
+            dist[i] = best_dist;
+            if (best != cluster[i]) {
+                cluster[i] = best;
+                changed = true;
+            }
+        }
+        if (!changed)
+            break;
+    }
+
+    file_t simpoints_file = INVALID_FILE;
+    file_t weights_file = INVALID_FILE;
+    if (!no_out_bbv_file.get_value()) {
+        simpoints_file = open_thread_file(data, "simpoints", false);
+        weights_file = open_thread_file(data, "weights", false);
+    }
+    if (print_to_stdout.get_value())
+        dr_mutex_lock(stdout_lock);
+    for (uint c = 0; c < k; ++c)
+        sizes[c] = 0;
+    for (uint i = 0; i < num_intervals; ++i) {
+        uint c = cluster[i];
+        if (sizes[c] == 0 || dist[i] < dist[closest[c]])
+            closest[c] = i;
+        ++sizes[c];
+    }
+    // Non-empty clusters are numbered in order, from 0.
+    char msg[64];
+    uint cluster_id = 0;
+    for (uint c = 0; c < k; ++c) {
+        if (sizes[c] == 0)
+            continue;
+        int len = dr_snprintf(msg, BUFFER_SIZE_ELEMENTS(msg), "%u %u\n", closest[c],
+                              cluster_id);
+        NULL_TERMINATE_BUFFER(msg);
+        DR_ASSERT(len > 0);
+        write_simpoint_line(simpoints_file, msg, len);
+        ++cluster_id;
+    }
+    cluster_id = 0;
+    for (uint c = 0; c < k; ++c) {
+        if (sizes[c] == 0)
+            continue;
+        // The weight is the fraction of the intervals in the cluster, which we print
+        // with 6 decimal digits. dr_snprintf() does not zero-pad, so we print the
+        // fractional digits after a leading 1 that we then skip.
+        uint64_t weight = static_cast<uint64_t>(sizes[c]) * 1000000 / num_intervals;
+        char fraction[16];
+        dr_snprintf(fraction, BUFFER_SIZE_ELEMENTS(fraction), "%u",
+                    static_cast<uint>(weight % 1000000 + 1000000));
+        NULL_TERMINATE_BUFFER(fraction);
+        int len = dr_snprintf(msg, BUFFER_SIZE_ELEMENTS(msg), "%u.%s %u\n",
+                              static_cast<uint>(weight / 1000000), fraction + 1,
+                              cluster_id);
+        NULL_TERMINATE_BUFFER(msg);
+        DR_ASSERT(len > 0);
+        write_simpoint_line(weights_file, msg, len);
+        ++cluster_id;
+    }
+    if (print_to_stdout.get_value())
+        dr_mutex_unlock(stdout_lock);
+    if (simpoints_file != INVALID_FILE)
+        dr_close_file(simpoints_file);
+    if (weights_file != INVALID_FILE)
+        dr_close_file(weights_file);
+
+    dr_global_free(centers, centers_size);
+    dr_global_free(cluster, num_intervals * sizeof(uint));
+    dr_global_free(dist, num_intervals * sizeof(uint64_t));
+    dr_global_free(sizes, max_k * sizeof(uint));
+    dr_global_free(closest, max_k * sizeof(uint));
 }
 
 static void
 save_bbv()
 {
-    // Clear global instruction count setting it to instr_interval, since we decrement it.
-    // Currently we only support single-threaded applications, so we don't use any locking
-    // mechanism to set this global counter.
-    instr_count = instr_interval.get_value();
-#if defined(INLINE_COUNTER_UPDATE) && defined(AARCH64)
-    // The counter inline optimization for AARCH64 uses OP_tbz (test bit and branch if 0),
-    // which in this case tests the sign bit and does not branch here (save_bbv()) when
-    // instr_count reaches 0, it branches only when instr_count < 0, so we decrement the
-    // initial count by 1 here to keep the same "branch when instr_count <= 0" behavior.
-    --instr_count;
-#endif
+    per_thread_t *data = static_cast<per_thread_t *>(
+        drmgr_get_tls_field(dr_get_current_drcontext(), tls_idx));
+    // Clear the thread's instruction count setting it to instr_interval, since we
+    // decrement it.
+    reset_instr_count(data);
+
+    // A BB only executes after its id was assigned, so every id this thread counted
+    // is below the value we read.
+    int num_ids = dr_atomic_load32(&unique_bb_count);
+    if (num_simpoints.get_value() > 0)
+        add_projection(data, num_ids);
 
     uint save_bbv_every_value = save_bbv_every.get_value();
+    drvector_t *bbv;
     if (save_bbv_every_value > 0) {
-        drvector_t *bbv = static_cast<drvector_t *>(drvector_get_entry(&bbvs, bbv_idx));
-        hashtable_apply_to_all_key_payload_pairs_user_data(&bb_count_table, add_to_bbv,
-                                                           bbv);
-        ++bbv_idx;
-        if (bbv_idx == save_bbv_every_value) {
-            write_bbvs();
-            bbvs_clear();
-            bbv_idx = 0;
-        }
+        bbv = static_cast<drvector_t *>(drvector_get_entry(&data->bbvs, data->bbv_idx));
     } else {
-        // Save current bb_count_table (i.e., the BBV for the current instruction
-        // interval).
-        drvector_t *bbv = static_cast<drvector_t *>(dr_global_alloc(sizeof(*bbv)));
+        // Save the current counts (i.e., the BBV for the current instruction interval).
+        bbv = static_cast<drvector_t *>(dr_global_alloc(sizeof(*bbv)));
         // Configure the vector to memset its storage (i.e., the BB frequency counts) to
         // zero whenever allocated (at init, but also resize).
         drvector_config_t config = { /*size=*/sizeof(config), /*zero_alloc=*/true };
-        // The index of the vector is the BB id, so we need the initial size to be able
-        // to contain all possible BB frequency counts, which is at most the number of
-        // entries in bb_count_table.
-        drvector_init_ex(bbv, bb_count_table.entries, /*synch=*/false,
-                         /*free_data_func=*/nullptr, &config);
-        // Iterate over the non-zero elements of bb_count_table and add them to the BBV.
-        hashtable_apply_to_all_key_payload_pairs_user_data(&bb_count_table, add_to_bbv,
-                                                           bbv);
+        // The index of the vector is the BB id - 1, so we need the initial size to be
+        // able to contain all possible BB frequency counts.
+        drvector_init_ex(bbv, num_ids - 1, /*synch=*/false, /*free_data_func=*/nullptr,
+                         &config);
         // Add the newly formed BBV to the list of BBVs.
-        drvector_append(&bbvs, bbv);
+        drvector_append(&data->bbvs, bbv);
+    }
+    // Move the non-zero counts to the BBV, clearing them for the next interval.
+    for (int id = 1; id < num_ids; ++id) {
+        uint64_t count = data->counts[id];
+        if (count == 0)
+            continue;
+        drvector_set_entry(bbv, static_cast<uint>(id - 1),
+                           reinterpret_cast<void *>(count));
+        data->counts[id] = 0;
     }
 
-    // Clear bb_count_table setting all the execution counts to zero.
-    hashtable_apply_to_all_payloads(&bb_count_table, set_count_to_zero);
+    if (save_bbv_every_value > 0) {
+        ++data->bbv_idx;
+        if (data->bbv_idx == save_bbv_every_value) {
+            write_bbvs(data);
+            bbvs_clear(data);
+            data->bbv_idx = 0;
+        }
+    }
 }
 
 #ifndef INLINE_COUNTER_UPDATE
 static void
-update_counters_and_save_bbv(uint64_t *execution_count, size_t bb_size)
+update_counters_and_save_bbv(uint bb_id, size_t bb_size)
 {
+    per_thread_t *data = static_cast<per_thread_t *>(
+        drmgr_get_tls_field(dr_get_current_drcontext(), tls_idx));
     // Increase execution count for the BB.
-    (*execution_count) += bb_size;
+    data->counts[bb_id] += bb_size;
 
     // Decrease instruction count of the interval by the BB #instructions.
-    instr_count -= bb_size;
+    INSTR_COUNT(data->seg_base) -= bb_size;
 
     // We reached the end of the instruction interval.
-    if (instr_count <= 0)
+    if (INSTR_COUNT(data->seg_base) <= 0)
         save_bbv();
 }
 #endif
@@ -363,9 +750,63 @@ update_counters_and_save_bbv(uint64_t *execution_count, size_t bb_size)
 static void
 event_thread_init(void *drcontext)
 {
-    if (thread_count > 0)
-        FATAL("ERROR: Multi-threaded applications are not currently supported");
-    ++thread_count;
+    per_thread_t *data =
+        static_cast<per_thread_t *>(dr_thread_alloc(drcontext, sizeof(*data)));
+    data->tid = dr_get_thread_id(drcontext);
+    data->first_thread = dr_atomic_add32_return_sum(&thread_count, 1) == 1;
+    data->seg_base = static_cast<byte *>(dr_get_dr_segment_base(tls_seg));
+    DR_ASSERT(data->seg_base != nullptr);
+    // We reserve room for every possible BB id. The memory is zero-initialized and,
+    // being mapped on demand, only costs as much as the BB ids actually executed.
+    data->counts = static_cast<uint64_t *>(dr_raw_mem_alloc(
+        counts_size(), DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+    if (data->counts == nullptr)
+        FATAL("ERROR: unable to allocate BB counters");
+    *TLS_SLOT(data->seg_base, DRPOINTS_TLS_OFFS_COUNTS) = data->counts;
+    reset_instr_count(data);
+
+    uint bbvs_capacity = save_bbv_every.get_value();
+    drvector_init(&data->bbvs, bbvs_capacity, /*synch=*/false, free_bbv);
+    // Avoid frequent resizing of the bbv vectors at the beginning by setting a reasonable
+    // large number as initial capacity.
+    constexpr uint BBV_INITIAL_CAPACITY = 512;
+    for (uint i = 0; i < bbvs_capacity; ++i) {
+        drvector_t *bbv = static_cast<drvector_t *>(dr_global_alloc(sizeof(*bbv)));
+        // Configure the vector to memset its storage (i.e., the BB frequency counts) to
+        // zero whenever allocated (at init, but also resize).
+        drvector_config_t config = { /*size=*/sizeof(config), /*zero_alloc=*/true };
+        drvector_init_ex(bbv, BBV_INITIAL_CAPACITY, /*synch=*/false,
+                         /*free_data_func=*/nullptr, &config);
+        drvector_set_entry(&data->bbvs, i, bbv);
+    }
+    data->bbv_idx = 0;
+    drvector_init(&data->projections, 0, /*synch=*/false, free_projection);
+
+    data->bbvs_file = INVALID_FILE;
+    if (!no_out_bbv_file.get_value()) {
+        data->bbvs_file = open_thread_file(data, "bbv", true);
+        if (binary_bbv.get_value())
+            dr_write_file(data->bbvs_file, BINARY_BBV_MAGIC, sizeof(BINARY_BBV_MAGIC));
+    }
+    drmgr_set_tls_field(drcontext, tls_idx, data);
+}
+
+static void
+event_thread_exit(void *drcontext)
+{
+    per_thread_t *data =
+        static_cast<per_thread_t *>(drmgr_get_tls_field(drcontext, tls_idx));
+    // Write remaining BBVs if in -save_bbv_every mode, or all BBVs otherwise.
+    write_bbvs(data);
+    if (num_simpoints.get_value() > 0)
+        write_simpoints(data);
+    if (data->bbvs_file != INVALID_FILE)
+        dr_close_file(data->bbvs_file);
+
+    if (!drvector_delete(&data->bbvs) || !drvector_delete(&data->projections))
+        FATAL("ERROR: BBVs drvector not deleted");
+    dr_raw_mem_free(data->counts, counts_size());
+    dr_thread_free(drcontext, data, sizeof(*data));
 }
 
 static dr_emit_flags_t
@@ -396,183 +837,146 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
     DR_ASSERT(res == DRCOVLIB_SUCCESS);
     uint64_t offset = static_cast<uint64_t>(bb_pc - modbase);
     modidx_offset_t bb_id_key = { modidx, offset };
+    dr_mutex_lock(bb_id_lock);
     void *bb_id_ptr = hashtable_lookup(&bb_id_table, &bb_id_key);
-    uint64_t bb_id = reinterpret_cast<uint64_t>(bb_id_ptr);
+    int bb_id = static_cast<int>(reinterpret_cast<ptr_int_t>(bb_id_ptr));
     if (bb_id_ptr == nullptr) {
         bb_id = unique_bb_count;
+        if (static_cast<uint>(bb_id) > max_bbs.get_value()) {
+            FATAL("ERROR: more than %u distinct BBs, increase -max_bbs\n",
+                  max_bbs.get_value());
+        }
         // Only allocate the key when adding to the table. Lookup key can stay on the
         // stack.
         modidx_offset_t *bb_id_key_to_add =
             static_cast<modidx_offset_t *>(dr_global_alloc(sizeof(*bb_id_key_to_add)));
         bb_id_key_to_add->modidx = modidx;
         bb_id_key_to_add->offset = offset;
-        hashtable_add(&bb_id_table, bb_id_key_to_add, reinterpret_cast<void *>(bb_id));
-        ++unique_bb_count;
-    }
-
-    // Get the BB execution counter.
-    uint64_t *bb_count_ptr = static_cast<uint64_t *>(
-        hashtable_lookup(&bb_count_table, reinterpret_cast<void *>(bb_id)));
-    if (bb_count_ptr == nullptr) {
-        // If execution count is not mapped to this BB, then add a new count to the table.
-        // We cannot save the initial value of 0 directly in the (void *)payload because
-        // NULL == 0 is used for lookup failure. Also, we need the counter address.
-        uint64_t *bb_count = static_cast<uint64_t *>(dr_global_alloc(sizeof(*bb_count)));
-        *bb_count = 0;
-        hashtable_add(&bb_count_table, reinterpret_cast<void *>(bb_id), bb_count);
-        bb_count_ptr = bb_count;
+        hashtable_add(&bb_id_table, bb_id_key_to_add,
+                      reinterpret_cast<void *>(static_cast<ptr_int_t>(bb_id)));
+        dr_atomic_add32_return_sum(&unique_bb_count, 1);
     }
+    dr_mutex_unlock(bb_id_lock);
 
     size_t bb_size = drx_instrlist_app_size(bb);
 
 #ifdef INLINE_COUNTER_UPDATE
-#    if defined(X86_64) || defined(AARCH64)
+    // The counters live in a per-thread array whose base is in a raw TLS slot, so
+    // each thread updates its own counters without atomics or locks.
     instr_t *skip_call = INSTR_CREATE_label(drcontext);
-#        if defined(X86_64)
-    // Increment the BB execution count by BB size in #instructions.
-    if (!drx_insert_counter_update(drcontext, bb, inst,
-                                   // We're using drmgr, so these slots
-                                   // here won't be used: drreg's slots will be.
-                                   static_cast<dr_spill_slot_t>(SPILL_SLOT_MAX + 1),
-                                   bb_count_ptr, static_cast<int>(bb_size),
-                                   DRX_COUNTER_64BIT)) {
+    reg_id_t scratch1;
+    if (drreg_reserve_register(drcontext, bb, inst, NULL, &scratch1) != DRREG_SUCCESS)
+        FATAL("ERROR: failed to reserve scratch register 1");
+    dr_insert_read_raw_tls(drcontext, bb, inst, tls_seg,
+                           tls_offs + sizeof(void *) * DRPOINTS_TLS_OFFS_COUNTS,
+                           scratch1);
+#    if defined(X86_64)
+    if (drreg_reserve_aflags(drcontext, bb, inst) != DRREG_SUCCESS)
         DR_ASSERT(false);
-    }
 
-    // Decrement the instruction count by BB size in #instructions.
-    if (!drx_insert_counter_update(drcontext, bb, inst,
-                                   // We're using drmgr, so these slots
-                                   // here won't be used: drreg's slots will be.
-                                   static_cast<dr_spill_slot_t>(SPILL_SLOT_MAX + 1),
-                                   &instr_count, -(static_cast<int>(bb_size)),
-                                   DRX_COUNTER_64BIT)) {
-        DR_ASSERT(false);
-    }
+    // Increment the BB execution count by BB size in #instructions. MAX_BBS_LIMIT
+    // keeps the displacement within 32 bits.
+    MINSERT(bb, inst,
+            INSTR_CREATE_add(drcontext,
+                             OPND_CREATE_MEM64(scratch1, bb_id * sizeof(uint64_t)),
+                             OPND_CREATE_INT32(static_cast<int>(bb_size))));
 
-    if (drreg_reserve_aflags(drcontext, bb, inst) != DRREG_SUCCESS)
-        DR_ASSERT(false);
+    // Decrement the instruction count by BB size in #instructions.
+    MINSERT(bb, inst,
+            INSTR_CREATE_sub(
+                drcontext,
+                opnd_create_far_base_disp(
+                    tls_seg, DR_REG_NULL, DR_REG_NULL, 0,
+                    tls_offs + sizeof(void *) * DRPOINTS_TLS_OFFS_ICOUNT, OPSZ_8),
+                OPND_CREATE_INT32(static_cast<int>(bb_size))));
 
     // If the user defined instruction interval is reached, jump to a clean call of the
     // instrumentation function that saves the current BBV, otherwise jump to the rest of
     // the BB and continue.
     MINSERT(bb, inst, INSTR_CREATE_jcc(drcontext, OP_jg, opnd_create_instr(skip_call)));
-#        elif defined(AARCH64)
-    reg_id_t scratch1, scratch2 = DR_REG_NULL;
-
-    // Increment the BB execution count by BB size in #instructions.
-    if (!drx_insert_counter_update(
-            drcontext, bb, inst, static_cast<dr_spill_slot_t>(SPILL_SLOT_MAX + 1),
-            static_cast<dr_spill_slot_t>(SPILL_SLOT_MAX + 1), bb_count_ptr,
-            static_cast<int>(bb_size), DRX_COUNTER_64BIT | DRX_COUNTER_REL_ACQ)) {
-        DR_ASSERT(false);
-    }
-
-    // Decrement the instruction count by BB size in #instructions.
-    if (!drx_insert_counter_update(
-            drcontext, bb, inst, static_cast<dr_spill_slot_t>(SPILL_SLOT_MAX + 1),
-            static_cast<dr_spill_slot_t>(SPILL_SLOT_MAX + 1), &instr_count,
-            -(static_cast<int>(bb_size)), DRX_COUNTER_64BIT | DRX_COUNTER_REL_ACQ)) {
-        DR_ASSERT(false);
-    }
-
-    // Reserve two scratch registers.
-    if (drreg_reserve_register(drcontext, bb, inst, NULL, &scratch1) != DRREG_SUCCESS)
-        FATAL("ERROR: failed to reserve scratch register 1");
+#    elif defined(AARCH64)
+    reg_id_t scratch2;
     if (drreg_reserve_register(drcontext, bb, inst, NULL, &scratch2) != DRREG_SUCCESS)
         FATAL("ERROR: failed to reserve scratch register 2");
+    // DR limits a BB to far fewer instructions than an add immediate can hold.
+    DR_ASSERT(bb_size < 4096);
 
-    // XXX i#7685: drx_insert_counter_update() above already loads instr_count in a
-    // register, so we could avoid the following two instructions, which are redundant.
-    // We can achieve this using some extra flag in drx_insert_counter_update() or
-    // performing the sub instruction directly here instead of using
-    // drx_insert_counter_update().
-    // Move the address of instr_count in a scratch register.
-    instrlist_insert_mov_immed_ptrsz(drcontext, reinterpret_cast<ptr_int_t>(&instr_count),
-                                     opnd_create_reg(scratch1), bb, inst, NULL, NULL);
-
-    // Load the value of instr_count into another scratch register.
+    // Increment the BB execution count by BB size in #instructions.
+    instrlist_insert_mov_immed_ptrsz(drcontext, bb_id * sizeof(uint64_t),
+                                     opnd_create_reg(scratch2), bb, inst, NULL, NULL);
+    MINSERT(bb, inst,
+            XINST_CREATE_add(drcontext, opnd_create_reg(scratch1),
+                             opnd_create_reg(scratch2)));
     MINSERT(bb, inst,
             XINST_CREATE_load(drcontext, opnd_create_reg(scratch2),
                               OPND_CREATE_MEMPTR(scratch1, 0)));
+    MINSERT(bb, inst,
+            XINST_CREATE_add(drcontext, opnd_create_reg(scratch2),
+                             OPND_CREATE_INT16(static_cast<int>(bb_size))));
+    MINSERT(bb, inst,
+            XINST_CREATE_store(drcontext, OPND_CREATE_MEMPTR(scratch1, 0),
+                               opnd_create_reg(scratch2)));
+
+    // Decrement the instruction count by BB size in #instructions.
+    dr_insert_read_raw_tls(drcontext, bb, inst, tls_seg,
+                           tls_offs + sizeof(void *) * DRPOINTS_TLS_OFFS_ICOUNT,
+                           scratch2);
+    MINSERT(bb, inst,
+            XINST_CREATE_sub(drcontext, opnd_create_reg(scratch2),
+                             OPND_CREATE_INT16(static_cast<int>(bb_size))));
+    dr_insert_write_raw_tls(drcontext, bb, inst, tls_seg,
+                            tls_offs + sizeof(void *) * DRPOINTS_TLS_OFFS_ICOUNT,
+                            scratch2);
 
     // If the top bit is still zero, then we have not reached the instr_interval yet, so
     // skip the save_bbv() call.
     MINSERT(bb, inst,
             INSTR_CREATE_tbz(drcontext, opnd_create_instr(skip_call),
                              opnd_create_reg(scratch2), OPND_CREATE_INTPTR(63)));
-#        endif
+#    else
+#        error NYI
+#    endif
     // Insert call to the instrumentation function that saves the current BBV.
     dr_insert_clean_call(drcontext, bb, inst, reinterpret_cast<void *>(save_bbv),
                          /*save_fpstate=*/false, 0);
     MINSERT(bb, inst, skip_call);
-#        if defined(X86_64)
+#    if defined(X86_64)
     if (drreg_unreserve_aflags(drcontext, bb, inst) != DRREG_SUCCESS)
         DR_ASSERT(false);
-#        elif defined(AARCH64)
-    if (drreg_unreserve_register(drcontext, bb, inst, scratch1) != DRREG_SUCCESS ||
-        drreg_unreserve_register(drcontext, bb, inst, scratch2) != DRREG_SUCCESS) {
+#    elif defined(AARCH64)
+    if (drreg_unreserve_register(drcontext, bb, inst, scratch2) != DRREG_SUCCESS)
         DR_ASSERT(false);
-    }
-#        endif
-#    else
-#        error NYI
 #    endif
+    if (drreg_unreserve_register(drcontext, bb, inst, scratch1) != DRREG_SUCCESS)
+        DR_ASSERT(false);
 #else
     // Default to a clean call to the instrumentation function that updates the
     // counters, checks if the user defined instruction interval is reached, and if so
     // saves the current BBV.
     dr_insert_clean_call(drcontext, bb, inst,
                          reinterpret_cast<void *>(update_counters_and_save_bbv),
-                         /*save_fpstate=*/false, 2, OPND_CREATE_INTPTR(bb_count_ptr),
+                         /*save_fpstate=*/false, 2, OPND_CREATE_INT32(bb_id),
                          OPND_CREATE_INTPTR(bb_size));
 #endif
     return DR_EMIT_DEFAULT;
 }
 
-static void
-open_bbv_file()
-{
-    if (!no_out_bbv_file.get_value()) {
-        std::string path_to_bbv_file = out_bbv_file.get_value();
-        if (!path_to_bbv_file.empty()) {
-            bbvs_file = dr_open_file(path_to_bbv_file.c_str(), DR_FILE_WRITE_REQUIRE_NEW);
-        } else {
-            // Get the current working directory where drrun is executing. We save the
-            // .bbv file there.
-            char cwd[MAXIMUM_PATH];
-            if (!dr_get_current_directory(cwd, sizeof(cwd)))
-                FATAL("ERROR: dr_get_current_directory() failed");
-
-            // Create and open the drpoints.PROC_BIN_NAME.PID.UNIQUE_ID.bbv file.
-            char buf[MAXIMUM_PATH];
-            bbvs_file =
-                drx_open_unique_appid_file(cwd, dr_get_process_id(), "drpoints", "bbv",
-                                           DR_FILE_WRITE_REQUIRE_NEW, buf, sizeof(buf));
-        }
-
-        if (bbvs_file == INVALID_FILE)
-            FATAL("ERROR: unable to create BBVs file");
-    }
-}
-
 static void
 event_exit(void)
 {
-    // Write remaining BBVs if in -save_bbv_every mode, or all BBVs otherwise.
-    write_bbvs();
-    if (!no_out_bbv_file.get_value())
-        dr_close_file(bbvs_file);
-
-    // Free DR memory.
+    // Each thread wrote its BBVs at thread exit.
     hashtable_delete(&bb_id_table);
-    hashtable_delete(&bb_count_table);
-    if (!drvector_delete(&bbvs))
-        FATAL("ERROR: BBVs drvector not deleted");
+    dr_mutex_destroy(bb_id_lock);
+    dr_mutex_destroy(stdout_lock);
+    if (!dr_raw_tls_cfree(tls_offs, DRPOINTS_TLS_COUNT))
+        DR_ASSERT(false);
 
     bool res = drmodtrack_exit();
     DR_ASSERT(res == DRCOVLIB_SUCCESS);
 
+    drmgr_unregister_tls_field(tls_idx);
     drmgr_unregister_thread_init_event(event_thread_init);
+    drmgr_unregister_thread_exit_event(event_thread_exit);
     drmgr_unregister_exit_event(event_exit);
     drx_exit();
     drreg_exit();
@@ -605,23 +1009,27 @@ dr_client_main(client_id_t id, int argc, const char *argv[])
     drcovlib_status_t res = drmodtrack_init();
     DR_ASSERT(res == DRCOVLIB_SUCCESS);
 
-    drreg_options_t ops = { sizeof(ops), 1 /*max slots needed: aflags*/, false };
+    drreg_options_t ops = { sizeof(ops), 2 /*max slots needed: aflags + reg*/, false };
     if (!drmgr_init() || !drx_init() || drreg_init(&ops) != DRREG_SUCCESS)
         DR_ASSERT(false);
 
+    if (!dr_raw_tls_calloc(&dynamorio::drpoints::tls_seg, &dynamorio::drpoints::tls_offs,
+                           dynamorio::drpoints::DRPOINTS_TLS_COUNT, 0))
+        FATAL("ERROR: unable to allocate raw TLS slots");
+    dynamorio::drpoints::tls_idx = drmgr_register_tls_field();
+    DR_ASSERT(dynamorio::drpoints::tls_idx != -1);
+
     // Register events.
     drmgr_register_exit_event(dynamorio::drpoints::event_exit);
     if (!drmgr_register_bb_instrumentation_event(
             nullptr, dynamorio::drpoints::event_app_instruction, nullptr) ||
-        (!drmgr_register_thread_init_event(dynamorio::drpoints::event_thread_init))) {
+        !drmgr_register_thread_init_event(dynamorio::drpoints::event_thread_init) ||
+        !drmgr_register_thread_exit_event(dynamorio::drpoints::event_thread_exit)) {
         DR_ASSERT(false);
     }
 
-    // Currently we only support single-threaded applications, so we don't use any locking
-    // mechanism for the following global data structures.
-    hashtable_init_ex(&dynamorio::drpoints::bb_count_table, HASH_BITS_BB_COUNT,
-                      HASH_INTPTR, /*str_dup=*/false, /*synch=*/false,
-                      dynamorio::drpoints::free_count, nullptr, nullptr);
+    dynamorio::drpoints::bb_id_lock = dr_mutex_create();
+    dynamorio::drpoints::stdout_lock = dr_mutex_create();
     hashtable_init_ex(&dynamorio::drpoints::bb_id_table, HASH_BITS_BB_ID, HASH_INTPTR,
                       /*str_dup=*/false, /*synch=*/false, nullptr,
                       dynamorio::drpoints::bb_id_hash, dynamorio::drpoints::bb_id_cmp);
@@ -634,34 +1042,6 @@ dr_client_main(client_id_t id, int argc, const char *argv[])
     bb_id_table_config.free_key_func = dynamorio::drpoints::free_bb_id;
     hashtable_configure(&dynamorio::drpoints::bb_id_table, &bb_id_table_config);
 
-    uint bbvs_capacity = dynamorio::drpoints::save_bbv_every.get_value();
-    drvector_init(&dynamorio::drpoints::bbvs, bbvs_capacity, /*synch=*/false,
-                  dynamorio::drpoints::free_bbv);
-    // Avoid frequent resizing of the bbv vectors at the beginning by setting a reasonable
-    // large number as initial capacity.
-    constexpr uint BBV_INITIAL_CAPACITY = 512;
-    for (uint i = 0; i < bbvs_capacity; ++i) {
-        drvector_t *bbv = static_cast<drvector_t *>(dr_global_alloc(sizeof(*bbv)));
-        // Configure the vector to memset its storage (i.e., the BB frequency counts) to
-        // zero whenever allocated (at init, but also resize).
-        drvector_config_t config = { /*size=*/sizeof(config), /*zero_alloc=*/true };
-        drvector_init_ex(bbv, BBV_INITIAL_CAPACITY, /*synch=*/false,
-                         /*free_data_func=*/nullptr, &config);
-        drvector_set_entry(&dynamorio::drpoints::bbvs, i, bbv);
-    }
-
-    dynamorio::drpoints::open_bbv_file();
-
     // Make it easy to tell, by looking at log file, which client executed.
     dr_log(nullptr, DR_LOG_ALL, 1, "DrPoints initializing\n");
-
-    // We count backward until 0, so we set the initial instr_count to be instr_interval.
-    dynamorio::drpoints::instr_count = dynamorio::drpoints::instr_interval.get_value();
-#if defined(INLINE_COUNTER_UPDATE) && defined(AARCH64)
-    // The counter inline optimization for AARCH64 uses OP_tbz (test bit and branch if 0),
-    // which in this case tests the sign bit and does not branch to save_bbv() when
-    // instr_count reaches 0, it branches only when instr_count < 0, so we decrement the
-    // initial count by 1 here to keep the same "branch when instr_count <= 0" behavior.
-    --dynamorio::drpoints::instr_count;
-#endif
 }
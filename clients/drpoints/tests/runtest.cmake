@@ -0,0 +1,91 @@
+# **********************************************************
+# Copyright (c) 2026 Google, Inc.    All rights reserved.
+# **********************************************************
+
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice,
+#   this list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+#   this list of conditions and the following disclaimer in the documentation
+#   and/or other materials provided with the distribution.
+#
+# * Neither the name of Google, Inc. nor the names of its contributors may be
+#   used to endorse or promote products derived from this software without
+#   specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+
+# Invoked by the test suite for testing drpoints' output files.
+
+# input:
+# * cmd = command to run, which must pass -out_bbv_file
+#     should have intra-arg space=@@ and inter-arg space=@ and ;=!
+# * cmp = file containing the regex to match the output files against
+#
+# The first thread's .bbv file is printed as "main bbv:" and the other threads'
+# as "thread bbv:", followed by their contents, in hex with -binary_bbv.
+
+string(REGEX REPLACE "@@" " " cmd "${cmd}")
+string(REGEX REPLACE "@" ";" cmd "${cmd}")
+string(REGEX REPLACE "!" "\\\;" cmd "${cmd}")
+
+if (NOT "${cmd}" MATCHES ";-out_bbv_file;([^;]+)")
+  message(FATAL_ERROR "*** ${cmd} does not pass -out_bbv_file ***\n")
+endif ()
+set(bbv_file "${CMAKE_MATCH_1}")
+set(binary OFF)
+if ("${cmd}" MATCHES ";-binary_bbv;")
+  set(binary ON)
+endif ()
+
+# The client requires the files to not exist yet.
+file(GLOB stale_files "${bbv_file}*")
+if (stale_files)
+  file(REMOVE ${stale_files})
+endif ()
+
+execute_process(COMMAND ${cmd}
+  RESULT_VARIABLE cmd_result
+  ERROR_VARIABLE cmd_err
+  OUTPUT_VARIABLE cmd_out)
+if (cmd_result)
+  message(FATAL_ERROR "*** ${cmd} failed (${cmd_result}): ${cmd_err}***\n")
+endif (cmd_result)
+
+# Other threads' files are named ${bbv_file}.<tid>.
+file(GLOB thread_files "${bbv_file}.*")
+list(SORT thread_files)
+set(output "")
+foreach (file ${bbv_file} ${thread_files})
+  if ("${file}" STREQUAL "${bbv_file}")
+    set(output "${output}main bbv:\n")
+  else ()
+    set(output "${output}thread bbv:\n")
+  endif ()
+  if (binary)
+    file(READ "${file}" contents HEX)
+    set(output "${output}${contents}\n")
+  else ()
+    file(READ "${file}" contents)
+    set(output "${output}${contents}")
+  endif ()
+  file(REMOVE "${file}")
+endforeach ()
+
+file(READ "${cmp}" expect)
+if (NOT "${output}" MATCHES "^${expect}$")
+  message(FATAL_ERROR "output |${output}| failed to match expected |${expect}|")
+endif ()
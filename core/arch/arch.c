@@ -949,6 +949,8 @@ d_r_arch_exit(IF_WINDOWS_ELSE_NP(bool detach_stacked_callbacks, void))
     heap_reachable_free(GLOBAL_DCONTEXT, d_r_avx512_code_in_use,
                         sizeof(*d_r_avx512_code_in_use) HEAPACCT(ACCT_OTHER));
 #endif
+    /* Free any decode cache a client left enabled. */
+    decode_cache_enable(0);
 
     interp_exit();
     mangle_exit();
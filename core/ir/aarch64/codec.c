@@ -9623,10 +9623,13 @@ decode_category(uint encoding, instr_t *instr)
 
 /******************************************************************************/
 
-/* Include automatically generated decoder and encoder files. Decode and encode
- * code is partitioned into versions of the AArch64 architecture starting with
- * v8.0. The decode/encode logic is chained together into a pipeline with v8.0
- * calling v8.1, which calls v8.2 and so on, returning from the decode/encode
+/* Include automatically generated decoder and encoder files. The decoder
+ * covers all versions of the AArch64 architecture: it looks up a table indexed
+ * by fixed opcode bits and then tests bits of the encoding against only the
+ * patterns for that entry, preferring the oldest version where they overlap.
+ * Encode code is partitioned into versions of the AArch64 architecture starting
+ * with v8.0. The encode logic is chained together into a pipeline with v8.0
+ * calling v8.1, which calls v8.2 and so on, returning from the encode
  * functions as soon as a match is found.
  *
  * The includes must be ordered newest to oldest so that the codec function
@@ -9635,15 +9638,7 @@ decode_category(uint encoding, instr_t *instr)
 #include "opnd_decode_funcs.h"
 #include "opnd_encode_funcs.h"
 #include "isa_features.h"
-#include "decode_gen_sve2.h"
-#include "decode_gen_sve.h"
-#include "decode_gen_v87.h"
-#include "decode_gen_v85.h"
-#include "decode_gen_v84.h"
-#include "decode_gen_v83.h"
-#include "decode_gen_v82.h"
-#include "decode_gen_v81.h"
-#include "decode_gen_v80.h"
+#include "decode_gen.h"
 #include "encode_gen_sve2.h"
 #include "encode_gen_sve.h"
 #include "encode_gen_v87.h"
@@ -9684,7 +9679,7 @@ decode_common(dcontext_t *dcontext, byte *pc, byte *orig_pc, instr_t *instr)
     CLIENT_ASSERT(instr->opcode == OP_INVALID || instr->opcode == OP_UNDECODED,
                   "decode: instr is already decoded, may need to call instr_reset()");
 
-    if (!decoder_v80(enc, dcontext, orig_pc, instr)) {
+    if (!decoder(enc, dcontext, orig_pc, instr)) {
         /* This clause handles undefined HINT instructions. See the comment
          * 'Notes on specific instructions' in codec.txt for details. If the
          * decoder reads an undefined hint, a message with the unallocated
@@ -35,7 +35,7 @@
 # opnd_decode_funcs.h
 # opnd_encode_funcs.h
 # encode_gen_<version>.h
-# decode_gen_<version>.h
+# decode_gen.h
 # isa_feature_gen_<version>.h
 # opcode_names.h
 # opcode_api.h
@@ -173,24 +173,114 @@ def generate_opndset_decoders(opndsettab, opndtab):
         c.append('')
     return '\n'.join(c) + '\n'
 
-def generate_decoder(patterns, opndsettab, opndtab, opc_props, curr_isa, next_isa):
-
-    # Recursive function to generate nested conditionals in main decoder.
+# The number of fixed opcode bits which index the first level of the decoder.
+DECODE_KEY_BITS = 8
+
+def pattern_keys(p, bits):
+    """Returns the keys, formed from bits with the first most significant, of the
+    encodings matching pattern p.
+    """
+    keys = [0]
+    for b in bits:
+        if (p.opnd_bits | p.high_soft_bits) >> b & 1:
+            keys = [k << 1 | v for k in keys for v in (0, 1)]
+        else:
+            keys = [k << 1 | (p.opcode_bits >> b & 1) for k in keys]
+    return keys
+
+def choose_decode_key_bits(patterns):
+    """Greedily picks the bits to index the first level of the decoder with,
+    aiming for small buckets without copying variable-bit patterns into too many
+    of them: each choice minimises the sum of the squares of the bucket sizes.
+    Returns the bits from most to least significant.
+    """
+    def cost(bits):
+        buckets = [0] * (1 << len(bits))
+        for p in patterns:
+            for key in pattern_keys(p, bits):
+                buckets[key] += 1
+        return sum(n * n for n in buckets)
+
+    bits = []
+    for _ in range(DECODE_KEY_BITS):
+        bits.append(min((b for b in range(N) if b not in bits),
+                        key=lambda b: cost(bits + [b])))
+    return sorted(bits, reverse=True)
+
+def decode_key_expr(bits):
+    """Returns C code gathering bits, most significant first, of enc into a key."""
+    terms = []
+    i = 0
+    while i < len(bits):
+        j = i
+        while j + 1 < len(bits) and bits[j + 1] == bits[j] - 1:
+            j += 1
+        key_lo = len(bits) - 1 - j
+        shift = bits[j] - key_lo
+        mask = ((1 << (j - i + 1)) - 1) << key_lo
+        terms.append('(enc >> %d & 0x%x)' % (shift, mask) if shift else
+                     '(enc & 0x%x)' % mask)
+        i = j + 1
+    return ' | '.join(terms)
+
+def generate_decoder(patterns, opndsettab, opndtab, opc_props):
+    """Generates the decoder for all versions of the architecture.
+
+    The first level is a table indexed by the DECODE_KEY_BITS fixed opcode bits
+    chosen by choose_decode_key_bits(): each entry is a function holding a tree
+    of single bit tests over just the patterns which can match that key.  Where
+    the patterns of several versions match an encoding, the earliest version is
+    used, as it would be by a chain of per-version decoders, and within a version
+    the first in pattern_order_key() order.
+    """
+    isa_index = {}
+    for i, isa_patterns in enumerate(patterns):
+        for p in isa_patterns:
+            isa_index[p] = i
+
+    def pattern_order_key(p):
+        f, v, m, t = p
+        # Overlapping patterns of one opcode and version never mix a named
+        # operand set with a list of operands, so we need only keep the two
+        # from being compared.
+        return (isa_index[p], m, isinstance(t, str), t, f, v)
+
+    # Recursive function to generate nested conditionals for one bucket.
     def gen(c, pats, depth):
-        def reorder_key(t):
-            f, v, m, t = t
-            return (m, t, f, v)
-
         def indent_append(text):
             c.append('{}{}'.format('    ' * depth, text))
 
-        if len(pats) < 4:
+        # Look for best bit to test. We aim to reduce the number of patterns
+        # remaining.
+        best_switch_bit = -1
+        least_patterns_selected = len(pats)
+        if len(pats) >= 4:
+            for switch_bit in range(N):
+                bit_not_set_or_variable = 0
+                bit_set_or_variable = 0
+                for p in pats:
+                    # In how many patterns is this bit not set or included
+                    # in the variable bits.
+                    if (1 << switch_bit) & (~p.opcode_bits | p.opnd_bits | p.high_soft_bits):
+                        bit_not_set_or_variable += 1
+                    # How many patterns have this b set and or in the variable
+                    # bits.
+                    if (1 << switch_bit) & (p.opcode_bits | p.opnd_bits | p.high_soft_bits):
+                        bit_set_or_variable += 1
+                patterns_selected = max(bit_not_set_or_variable, bit_set_or_variable)
+                if patterns_selected < least_patterns_selected:
+                    best_switch_bit = switch_bit
+                    least_patterns_selected = patterns_selected
+        # Patterns which no bit separates are tested in turn.
+        if best_switch_bit == -1:
             else_str = ''
-            for pattern in sorted(pats, key=reorder_key):
+            for pattern in sorted(pats, key=pattern_order_key):
+                isa = isa_index[pattern]
+                nzcv_rw = opc_props[isa][pattern.opcode].nzcv_rw
 
                 not_zero_mask = 0
                 try:
-                    opnd_set  = opndsettab[pattern.generated_name]
+                    opnd_set  = opndsettab[isa][pattern.generated_name]
                     for mask in (opndtab[o].non_zero for o in opnd_set.dsts + opnd_set.srcs):
                         not_zero_mask |= mask
                 except KeyError:
@@ -204,18 +294,18 @@ def generate_decoder(patterns, opndsettab, opndtab, opc_props, curr_isa, next_is
 
                 if not else_str:
                     else_str = 'else '
-                if opc_props[pattern.opcode].nzcv_rw != 'n':
+                if nzcv_rw != 'n':
                     c[-1] = c[-1] + ' {'
                     # Uncomment this for debug output in generated code:
-                    # indent_append('    // %s->%s' % (m, opc_props[m].nzcv_rw))
-                    if opc_props[pattern.opcode].nzcv_rw == 'r':
+                    # indent_append('    // %s->%s' % (m, nzcv_rw))
+                    if nzcv_rw == 'r':
                         indent_append('    instr->eflags |= EFLAGS_READ_NZCV;')
-                    elif opc_props[pattern.opcode].nzcv_rw == 'w':
+                    elif nzcv_rw == 'w':
                         indent_append('    instr->eflags |= EFLAGS_WRITE_NZCV;')
-                    elif opc_props[pattern.opcode].nzcv_rw in ['rw', 'wr']:
+                    elif nzcv_rw in ['rw', 'wr']:
                         indent_append('    instr->eflags |= (EFLAGS_READ_NZCV | '
                                       'EFLAGS_WRITE_NZCV);')
-                    elif opc_props[pattern.opcode].nzcv_rw in ['er', 'ew']:
+                    elif nzcv_rw in ['er', 'ew']:
                         indent_append(
                             '    // instr->eflags handling for %s is '
                             'manually handled in codec.c\'s decode_common().' % pattern.opcode)
@@ -223,29 +313,9 @@ def generate_decoder(patterns, opndsettab, opndtab, opc_props, curr_isa, next_is
                         indent_append('    ASSERT(0);')
                 indent_append('    return decode_opnds%s(enc, dc, pc, '
                                   'instr, OP_%s);' % (pattern.generated_name, pattern.opcode))
-                if opc_props[pattern.opcode].nzcv_rw != 'n':
+                if nzcv_rw != 'n':
                     indent_append('}')
             return
-        # Look for best bit to test. We aim to reduce the number of patterns
-        # remaining.
-        best_switch_bit = -1
-        least_patterns_selected = len(pats)
-        for switch_bit in range(N):
-            bit_not_set_or_variable = 0
-            bit_set_or_variable = 0
-            for p in pats:
-                # In how many patterns is this bit not set or included
-                # in the variable bits.
-                if (1 << switch_bit) & (~p.opcode_bits | p.opnd_bits | p.high_soft_bits):
-                    bit_not_set_or_variable += 1
-                # How many patterns have this b set and or in the variable
-                # bits.
-                if (1 << switch_bit) & (p.opcode_bits | p.opnd_bits | p.high_soft_bits):
-                    bit_set_or_variable += 1
-            patterns_selected = max(bit_not_set_or_variable, bit_set_or_variable)
-            if patterns_selected < least_patterns_selected:
-                best_switch_bit = switch_bit
-                least_patterns_selected = patterns_selected
         indent_append('if ((enc >> %d & 1) == 0) {' % (best_switch_bit,))
         pats0 = []
         pats1 = []
@@ -261,16 +331,47 @@ def generate_decoder(patterns, opndsettab, opndtab, opc_props, curr_isa, next_is
         gen(c, pats1, depth + 1)
         indent_append('}')
 
-    c = ['static bool',
-         'decoder_' + curr_isa + '(uint enc, dcontext_t *dc, byte *pc, instr_t *instr)',
-          '{']
-    gen(c, patterns, 1)
-    # Call the next version of the decoder if defined.
-    if next_isa != '':
-        c.append('    return decoder_' + next_isa + '(enc, dc, pc, instr);')
-    else:
-        c.append('    return false;')
-    c.append('}')
+    all_patterns = [p for isa_patterns in patterns for p in isa_patterns]
+    key_bits = choose_decode_key_bits(all_patterns)
+    buckets = [[] for _ in range(1 << len(key_bits))]
+    for p in all_patterns:
+        for key in pattern_keys(p, key_bits):
+            buckets[key].append(p)
+    bucket_funcs = []
+    c = []
+    for key, pats in enumerate(buckets):
+        if not pats:
+            bucket_funcs.append('decode_bucket_none')
+            continue
+        name = 'decode_bucket_%02x' % key
+        bucket_funcs.append(name)
+        c += ['static bool',
+              name + '(uint enc, dcontext_t *dc, byte *pc, instr_t *instr)',
+              '{']
+        gen(c, pats, 1)
+        c += ['    return false;', '}', '']
+
+    if 'decode_bucket_none' in bucket_funcs:
+        c = ['static bool',
+             'decode_bucket_none(uint enc, dcontext_t *dc, byte *pc, instr_t *instr)',
+             '{',
+             '    return false;',
+             '}',
+             ''] + c
+    c += ['typedef bool (*decode_bucket_func_t)(uint enc, dcontext_t *dc, byte *pc, '
+          'instr_t *instr);',
+          '',
+          'static const decode_bucket_func_t decode_buckets[] = {']
+    c += ['    %s,' % f for f in bucket_funcs]
+    c += ['};',
+          '',
+          '/* The buckets are indexed by bits %s of the encoding. */' %
+          ', '.join(str(b) for b in key_bits),
+          'static bool',
+          'decoder(uint enc, dcontext_t *dc, byte *pc, instr_t *instr)',
+          '{',
+          '    return decode_buckets[%s](enc, dc, pc, instr);' % decode_key_expr(key_bits),
+          '}']
     return '\n'.join(c) + '\n'
 
 def find_required(fixed, reordered, i, opndtab):
@@ -795,17 +896,24 @@ def main():
 
     # Read all instruction definitions and use the instructions' bitmask to
     # generate decode and encode logic.
+    decode_patterns = []
+    decode_opndsettabs = []
+    decode_opc_props = []
     for idx, isa_version in enumerate(isa_versions):
         (patterns, opc_props) = read_codec_file(os.path.join(input_dir, 'codec_' + isa_version + '.txt'))
         (patterns, opndsettab) = opndset_naming(patterns, opndtab)
-        write_if_changed(os.path.join(output_dir, 'decode_gen_' + isa_version +'.h'),
-                         codec_header(isa_version) + generate_decoder(patterns, opndsettab, opndtab, opc_props, isa_version, isa_versions[idx + 1]))
+        decode_patterns.append(patterns)
+        decode_opndsettabs.append(opndsettab)
+        decode_opc_props.append(opc_props)
         write_if_changed(os.path.join(output_dir, 'encode_gen_' + isa_version +'.h'),
                          codec_header(isa_version) + generate_encoder(patterns, opndsettab, opndtab, opc_props, isa_version, isa_versions[idx + 1]))
         write_if_changed(os.path.join(output_dir, 'isa_feature_gen_' + isa_version +'.h'),
                          codec_header(isa_version) + generate_get_isa_feature(patterns, isa_version, isa_versions[idx + 1]))
         if isa_versions[idx + 1] == '':
             break
+    write_if_changed(os.path.join(output_dir, 'decode_gen.h'),
+                     opcode_header + generate_decoder(decode_patterns, decode_opndsettabs,
+                                                      opndtab, decode_opc_props))
 
     # Generate opcode declarations and definitions for the API and fuzz
     # testing.
@@ -2713,6 +2713,14 @@ get_next_instr_info(const instr_info_t *info)
     return (const instr_info_t *)(info->code);
 }
 
+DR_API
+bool
+decode_cache_enable(uint num_entries)
+{
+    /* Not implemented for this architecture. */
+    return false;
+}
+
 byte
 decode_first_opcode_byte(int opcode)
 {
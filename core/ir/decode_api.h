@@ -100,6 +100,83 @@ DR_API
 byte *
 decode_from_copy(void *drcontext, byte *copy_pc, byte *orig_pc, instr_t *instr);
 
+/** Operand kinds recorded by decode_region() in #dr_decode_record_t. */
+typedef enum {
+    DR_DECODE_OPND_REG,    /**< A register: opnd_is_reg(). */
+    DR_DECODE_OPND_IMMED,  /**< An immediate value: opnd_is_immed(). */
+    DR_DECODE_OPND_PC,     /**< A code target: opnd_is_pc() or opnd_is_far_pc(). */
+    DR_DECODE_OPND_MEMORY, /**< A memory reference: opnd_is_memory_reference(). */
+    DR_DECODE_OPND_OTHER,  /**< Any other operand. */
+} dr_decode_opnd_kind_t;
+
+/** The number of operand kinds held by a #dr_decode_record_t. */
+#define DR_DECODE_RECORD_MAX_OPNDS 8
+
+/**
+ * A compact description of one instruction, filled in by decode_region().
+ */
+typedef struct _dr_decode_record_t {
+    /** The offset of the instruction from the start of the decoded region. */
+    uint offset;
+    /** The length of the instruction in bytes. */
+    byte length;
+    /** The number of destination operands. */
+    byte num_dsts;
+    /** The number of source operands. */
+    byte num_srcs;
+    /**
+     * The #dr_decode_opnd_kind_t of the destination operands followed by those of
+     * the source operands.  Only the first #DR_DECODE_RECORD_MAX_OPNDS are present.
+     * Entries beyond the instruction's operands are #DR_DECODE_OPND_OTHER.
+     */
+    byte opnd_kinds[DR_DECODE_RECORD_MAX_OPNDS];
+    /** The OP_ opcode constant, or OP_INVALID for an invalid instruction. */
+    int opcode;
+    /** The #dr_instr_category_t bits of the instruction. */
+    uint category;
+} dr_decode_record_t;
+
+DR_API
+/**
+ * Decodes the instructions in [\p start, \p end) into the array \p records, which
+ * holds \p max_records entries, without allocating any memory.  If \p records is
+ * NULL, up to \p max_records instructions are instead skipped using only the
+ * lengths found by the fast path of decode_sizeof(), which does not detect every
+ * invalid instruction.  No byte at or beyond \p end is read.  An invalid
+ * instruction is recorded with an opcode of OP_INVALID and a length of one byte on
+ * x86, or one instruction unit elsewhere, and decoding continues after it.
+ * Decoding stops at \p end, when \p max_records instructions have been decoded or
+ * skipped, or at an instruction that extends past \p end.  Sets \p num_records, if
+ * non-NULL, to the number of instructions decoded or skipped and \p next_pc, if
+ * non-NULL, to the address at which decoding stopped, from which a further call
+ * can continue.  Returns false if decoding stopped at an instruction that is
+ * truncated by \p end, and true otherwise.
+ * Uses the x86/x64 or ARM/Thumb mode for the thread \p drcontext.
+ */
+bool
+decode_region(void *drcontext, byte *start, byte *end, dr_decode_record_t *records,
+              size_t max_records, size_t *num_records DR_PARAM_OUT,
+              byte **next_pc DR_PARAM_OUT);
+
+DR_API
+/**
+ * Enables a process-wide cache of decoded instructions with room for \p
+ * num_entries instructions (rounded up to a power of 2), replacing any previous
+ * cache, or disables and frees the cache if \p num_entries is 0.  While the cache
+ * is enabled, decode() and decode_from_copy() look up the instruction's raw bytes
+ * and fill in \p instr from a matching entry rather than decoding it operand by
+ * operand.  The results are identical either way, including pc-relative
+ * operands, which are adjusted for the address being decoded.  The cache is
+ * safe for concurrent decoding by multiple threads but this routine itself must
+ * not be called while any other thread might be decoding.  It is meant for
+ * tools such as trace post-processors that decode the same instructions many
+ * times; each entry uses about 300 bytes.
+ * Returns false if the cache could not be allocated or is not supported: it is
+ * currently only implemented for x86 and x64.
+ */
+bool
+decode_cache_enable(uint num_entries);
+
 /* decode_as_bb() is defined in interp.c, but declared here so it will
  * be listed next to the other decode routines in the API headers.
  */
@@ -304,6 +304,110 @@ dr_get_isa_mode(void *drcontext)
         return dcontext->isa_mode;
 }
 
+static byte
+decode_region_opnd_kind(opnd_t opnd)
+{
+    if (opnd_is_reg(opnd))
+        return DR_DECODE_OPND_REG;
+    if (opnd_is_immed(opnd))
+        return DR_DECODE_OPND_IMMED;
+    if (opnd_is_pc(opnd) || opnd_is_far_pc(opnd))
+        return DR_DECODE_OPND_PC;
+    if (opnd_is_memory_reference(opnd))
+        return DR_DECODE_OPND_MEMORY;
+    return DR_DECODE_OPND_OTHER;
+}
+
+bool
+decode_region(void *drcontext, byte *start, byte *end, dr_decode_record_t *records,
+              size_t max_records, size_t *num_records DR_PARAM_OUT,
+              byte **next_pc DR_PARAM_OUT)
+{
+    dcontext_t *dcontext = (dcontext_t *)drcontext;
+    /* We reset one noalloc instr for each instruction rather than allocating. */
+    instr_noalloc_t noalloc;
+    instr_noalloc_init(dcontext, &noalloc);
+    instr_t *instr = instr_from_noalloc(&noalloc);
+    /* The decoders may look at bytes beyond the instruction they are given, so near
+     * the end we decode from a zero-padded copy of the remaining bytes rather than
+     * reading past it.
+     */
+    byte tail[2 * MAX_INSTR_LENGTH];
+    byte *pc = start;
+    size_t count = 0;
+    bool truncated = false;
+    while (pc < end && count < max_records) {
+        byte *copy = pc;
+        if (end - pc < MAX_INSTR_LENGTH) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, pc, end - pc);
+            copy = tail;
+        }
+        /* Skipping only needs the length, which the fast decoder provides.  Near the
+         * end it also tells us whether the instruction is cut off before decoding it.
+         */
+        int size = 0;
+        if (records == NULL || copy == tail) {
+            size = decode_sizeof(dcontext, copy, NULL _IF_X86_64(NULL));
+            if (size > end - pc) {
+                truncated = true;
+                break;
+            }
+        }
+        if (records == NULL) {
+            /* Like a disassembler, step a single byte past invalid x86 code. */
+            pc += size > 0 ? size : 1;
+            count++;
+            continue;
+        }
+        dr_decode_record_t *record = &records[count];
+        instr_reset(dcontext, instr);
+        byte *decoded_next_pc = decode_from_copy(dcontext, copy, pc, instr);
+        if (decoded_next_pc != NULL && decoded_next_pc - copy > end - pc) {
+            truncated = true;
+            break;
+        }
+        record->offset = (uint)(pc - start);
+        memset(record->opnd_kinds, DR_DECODE_OPND_OTHER, sizeof(record->opnd_kinds));
+        if (decoded_next_pc == NULL) {
+            /* Step a single byte past invalid x86 code, but keep fixed-width
+             * instructions aligned elsewhere.
+             */
+#ifdef X86
+            size = 1;
+#else
+            if (size == 0)
+                size = decode_sizeof(dcontext, copy, NULL);
+#endif
+            record->length = (byte)(size > 0 ? size : 1);
+            record->num_dsts = 0;
+            record->num_srcs = 0;
+            record->opcode = OP_INVALID;
+            record->category = DR_INSTR_CATEGORY_UNCATEGORIZED;
+        } else {
+            record->length = (byte)(decoded_next_pc - copy);
+            record->num_dsts = (byte)instr_num_dsts(instr);
+            record->num_srcs = (byte)instr_num_srcs(instr);
+            record->opcode = instr_get_opcode(instr);
+            record->category = instr_get_category(instr);
+            for (int i = 0; i < record->num_dsts + record->num_srcs &&
+                 i < DR_DECODE_RECORD_MAX_OPNDS;
+                 i++) {
+                record->opnd_kinds[i] = decode_region_opnd_kind(
+                    i < record->num_dsts ? instr_get_dst(instr, i)
+                                         : instr_get_src(instr, i - record->num_dsts));
+            }
+        }
+        pc += record->length;
+        count++;
+    }
+    if (num_records != NULL)
+        *num_records = count;
+    if (next_pc != NULL)
+        *next_pc = pc;
+    return !truncated;
+}
+
 #ifdef DEBUG
 void
 decode_debug_checks(void)
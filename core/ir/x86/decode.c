@@ -2593,6 +2593,217 @@ check_is_variable_size(opnd_t op)
 }
 #endif
 
+/****************************************************************************
+ * Decoded instruction cache
+ *
+ * A direct-mapped table of fully decoded instructions keyed by their raw bytes
+ * and mode, enabled by decode_cache_enable().  Operands that depend on the
+ * instruction's address (relative branch targets and rip-relative addresses) are
+ * stored relative to it.  Each entry is guarded by a sequence count which is odd
+ * while the entry is being written: a writer that cannot claim the entry simply
+ * does not cache, and a reader that sees the count change treats it as a miss,
+ * so neither ever waits.
+ */
+
+#define DECODE_CACHE_MAX_OPNDS 16
+
+typedef struct _decode_cache_entry_t {
+    volatile int seq;
+    byte len; /* 0 if the entry has never been written. */
+    byte x86_mode;
+    byte num_dsts;
+    byte num_srcs;
+    byte bytes[MAX_INSTR_LENGTH];
+    /* Bit i is set if opnds[i] holds an offset from the instruction's address. */
+    ushort pc_relative;
+    int opcode;
+    uint eflags;
+    uint prefixes;
+    dr_pred_type_t predicate;
+    uint category;
+    int rip_rel_pos;
+    opnd_t opnds[DECODE_CACHE_MAX_OPNDS]; /* Dsts followed by srcs. */
+} decode_cache_entry_t;
+
+/* Only changed by decode_cache_enable(), which must not race with decoding. */
+static decode_cache_entry_t *decode_cache;
+static uint decode_cache_size;
+
+#ifdef STANDALONE_UNIT_TEST
+/* Called by decode_cache_lookup() after it reads an entry, to emulate a writer. */
+static void (*decode_cache_lookup_hook)(decode_cache_entry_t *entry);
+#endif
+
+DR_API
+bool
+decode_cache_enable(uint num_entries)
+{
+    if (decode_cache != NULL) {
+        heap_free(GLOBAL_DCONTEXT, decode_cache,
+                  decode_cache_size * sizeof(*decode_cache) HEAPACCT(ACCT_IR));
+        decode_cache = NULL;
+        decode_cache_size = 0;
+    }
+    if (num_entries == 0)
+        return true;
+    /* Round up to a power of 2 so we can mask the hash. */
+    uint size = 1;
+    while (size < num_entries) {
+        if (size > (UINT_MAX >> 1) / sizeof(*decode_cache))
+            return false;
+        size <<= 1;
+    }
+    decode_cache_entry_t *cache = (decode_cache_entry_t *)heap_alloc(
+        GLOBAL_DCONTEXT, size * sizeof(*cache) HEAPACCT(ACCT_IR));
+    if (cache == NULL)
+        return false;
+    memset(cache, 0, size * sizeof(*cache));
+    decode_cache_size = size;
+    decode_cache = cache;
+    return true;
+}
+
+static inline decode_cache_entry_t *
+decode_cache_entry(byte *pc, uint len, bool x86_mode)
+{
+    /* FNV-1a. */
+    uint hash = 2166136261U ^ (uint)x86_mode;
+    for (uint i = 0; i < len; i++)
+        hash = (hash ^ pc[i]) * 16777619U;
+    return &decode_cache[hash & (decode_cache_size - 1)];
+}
+
+static opnd_t
+decode_cache_rebase_opnd(opnd_t opnd, ptr_int_t delta)
+{
+    if (opnd_is_near_pc(opnd))
+        return opnd_create_pc(opnd_get_pc(opnd) + delta);
+#ifdef X64
+    CLIENT_ASSERT(opnd_is_rel_addr(opnd), "decode cache: unexpected pc-relative opnd");
+    return opnd_create_far_rel_addr(opnd_get_segment(opnd),
+                                    (byte *)opnd_get_addr(opnd) + delta,
+                                    opnd_get_size(opnd));
+#else
+    CLIENT_ASSERT(false, "decode cache: unexpected pc-relative opnd");
+    return opnd;
+#endif
+}
+
+static inline bool
+decode_cache_opnd_is_pc_relative(opnd_t opnd)
+{
+    return opnd_is_near_pc(opnd) IF_X64(|| opnd_is_rel_addr(opnd));
+}
+
+/* Fills in instr from the cache and returns true if the len-byte instruction at
+ * pc is present in entry.
+ */
+static bool
+decode_cache_lookup(dcontext_t *dcontext, decode_cache_entry_t *entry, byte *pc,
+                    byte *orig_pc, uint len, bool x86_mode, instr_t *instr)
+{
+    int seq = entry->seq;
+    if (TESTANY(1, seq))
+        return false;
+    IR_CACHE_BARRIER();
+    uint num_dsts = entry->num_dsts;
+    uint num_srcs = entry->num_srcs;
+    if (entry->len != len || entry->x86_mode != (byte)x86_mode ||
+        num_dsts + num_srcs > DECODE_CACHE_MAX_OPNDS ||
+        memcmp(entry->bytes, pc, len) != 0)
+        return false;
+    int opcode = entry->opcode;
+    uint eflags = entry->eflags;
+    uint prefixes = entry->prefixes;
+    dr_pred_type_t predicate = entry->predicate;
+    uint category = entry->category;
+    int rip_rel_pos = entry->rip_rel_pos;
+    ushort pc_relative = entry->pc_relative;
+    /* instr is not touched until we know the copy is consistent: on a miss the
+     * caller decodes into it from scratch.
+     */
+    opnd_t opnds[DECODE_CACHE_MAX_OPNDS];
+    memcpy(opnds, entry->opnds, (num_dsts + num_srcs) * sizeof(opnd_t));
+#ifdef STANDALONE_UNIT_TEST
+    if (decode_cache_lookup_hook != NULL)
+        (*decode_cache_lookup_hook)(entry);
+#endif
+    IR_CACHE_BARRIER();
+    if (entry->seq != seq)
+        return false;
+
+    for (uint i = 0; i < num_dsts + num_srcs; i++) {
+        if (TESTANY(1U << i, pc_relative))
+            opnds[i] = decode_cache_rebase_opnd(opnds[i], (ptr_int_t)orig_pc);
+    }
+    instr_set_num_opnds(dcontext, instr, num_dsts, num_srcs);
+    if (num_dsts > 0)
+        memcpy(instr->dsts, opnds, num_dsts * sizeof(opnd_t));
+    if (num_srcs > 0) {
+        instr->src0 = opnds[num_dsts];
+        if (num_srcs > 1)
+            memcpy(instr->srcs, &opnds[num_dsts + 1], (num_srcs - 1) * sizeof(opnd_t));
+    }
+    /* instr_set_num_opnds() marks the operands valid, but as in decode_common() we
+     * say so explicitly since we don't use set_src/set_dst for most of them: a hit
+     * left at Level 1 would be decoded all over again on its first operand query.
+     */
+    instr_set_operands_valid(instr, true);
+    instr_set_opcode(instr, opcode);
+    IF_X64(instr_set_x86_mode(instr, x86_mode));
+    instr->eflags = eflags;
+    instr_set_eflags_valid(instr, true);
+    instr->prefixes |= prefixes;
+    if (predicate != DR_PRED_NONE)
+        instr_set_predicate(instr, predicate);
+    if (orig_pc != pc)
+        instr_set_translation(instr, orig_pc);
+    instr_set_raw_bits(instr, pc, len);
+    if (rip_rel_pos > 0)
+        instr_set_rip_rel_pos(instr, rip_rel_pos);
+    instr_set_category(instr, category);
+    return true;
+}
+
+/* Stores the just-decoded instr, which was at pc as far as its operands are
+ * concerned, in entry unless another thread is writing to entry.
+ */
+static void
+decode_cache_insert(decode_cache_entry_t *entry, instr_t *instr, byte *pc,
+                    byte *orig_pc, uint len, bool x86_mode, int rip_rel_pos)
+{
+    int num_opnds = instr_num_dsts(instr) + instr_num_srcs(instr);
+    if (num_opnds > DECODE_CACHE_MAX_OPNDS)
+        return;
+    int seq = entry->seq;
+    if (TESTANY(1, seq) || !atomic_compare_exchange_int(&entry->seq, seq, seq + 1))
+        return;
+    IR_CACHE_BARRIER();
+    entry->len = (byte)len;
+    entry->x86_mode = (byte)x86_mode;
+    entry->num_dsts = (byte)instr_num_dsts(instr);
+    entry->num_srcs = (byte)instr_num_srcs(instr);
+    memcpy(entry->bytes, pc, len);
+    entry->opcode = instr_get_opcode(instr);
+    entry->eflags = instr->eflags;
+    entry->prefixes = instr->prefixes;
+    entry->predicate = instr_get_predicate(instr);
+    entry->category = instr_get_category(instr);
+    entry->rip_rel_pos = rip_rel_pos;
+    entry->pc_relative = 0;
+    for (int i = 0; i < num_opnds; i++) {
+        opnd_t opnd = i < entry->num_dsts ? instr_get_dst(instr, i)
+                                          : instr_get_src(instr, i - entry->num_dsts);
+        if (decode_cache_opnd_is_pc_relative(opnd)) {
+            entry->pc_relative |= (ushort)(1U << i);
+            opnd = decode_cache_rebase_opnd(opnd, -(ptr_int_t)orig_pc);
+        }
+        entry->opnds[i] = opnd;
+    }
+    IR_CACHE_BARRIER();
+    entry->seq = seq + 2;
+}
+
 /* Decodes the instruction at address pc into instr, filling in the
  * instruction's opcode, eflags usage, prefixes, and operands.
  * This corresponds to a Level 3 decoding.
@@ -2625,6 +2836,21 @@ decode_common(dcontext_t *dcontext, byte *pc, byte *orig_pc, instr_t *instr)
                   "decode: instr is already decoded, may need to call instr_reset()");
 
     IF_X64(di.x86_mode = get_x86_mode(dcontext));
+    /* We only use the cache for instrs without prior prefixes, so that what we
+     * store is exactly what decoding produced.
+     */
+    decode_cache_entry_t *cache_entry = NULL;
+    uint cache_len = 0;
+    bool x86_mode = IF_X64_ELSE(di.x86_mode, false);
+    if (decode_cache != NULL && instr->prefixes == 0) {
+        cache_len = (uint)decode_sizeof(dcontext, pc, NULL _IF_X64(NULL));
+        if (cache_len > 0) {
+            cache_entry = decode_cache_entry(pc, cache_len, x86_mode);
+            if (decode_cache_lookup(dcontext, cache_entry, pc, orig_pc, cache_len,
+                                    x86_mode, instr))
+                return pc + cache_len;
+        }
+    }
     next_pc = read_instruction(dcontext, pc, orig_pc, &info, &di,
                                false /* not just opcode,
                                         decode operands too */
@@ -2776,6 +3002,13 @@ decode_common(dcontext_t *dcontext, byte *pc, byte *orig_pc, instr_t *instr)
 
     decode_category(instr);
 
+    /* A data16 prefix truncates a branch target, making it not simply relative. */
+    if (cache_entry != NULL && next_pc == pc + cache_len &&
+        !(di.disp_abs > di.start_pc && TESTANY(PREFIX_DATA, di.prefixes))) {
+        decode_cache_insert(cache_entry, instr, pc, orig_pc, cache_len, x86_mode,
+                            di.disp_abs > di.start_pc ? (int)(di.disp_abs - di.start_pc)
+                                                      : 0);
+    }
     return next_pc;
 
 decode_invalid:
@@ -2852,6 +3085,54 @@ decode_debug_checks_arch(void)
 }
 #endif
 
+#ifdef STANDALONE_UNIT_TEST
+static void
+decode_cache_rewrite_entry(decode_cache_entry_t *entry)
+{
+    /* What a complete write by another thread leaves behind. */
+    entry->seq += 2;
+}
+
+void
+unit_test_decode_cache(void)
+{
+    dcontext_t *dcontext = GLOBAL_DCONTEXT;
+    byte add[] = { 0x83, 0xc0, 0x01 }; /* add eax, 1 */
+    bool x86_mode = IF_X64_ELSE(get_x86_mode(dcontext), false);
+    instr_t instr;
+
+    EXPECT(decode_cache_enable(64), true);
+    instr_init(dcontext, &instr);
+    EXPECT(decode(dcontext, add, &instr), add + sizeof(add));
+    instr_reset(dcontext, &instr);
+
+    /* A lookup that sees the entry change is a miss and leaves instr untouched, so
+     * the full decode that follows can fill it in.
+     */
+    decode_cache_lookup_hook = decode_cache_rewrite_entry;
+    EXPECT(decode_cache_lookup(dcontext, decode_cache_entry(add, sizeof(add), x86_mode),
+                               add, add, sizeof(add), x86_mode, &instr),
+           false);
+    EXPECT(instr.num_dsts, 0);
+    EXPECT(instr.num_srcs, 0);
+    EXPECT(instr_operands_valid(&instr), false);
+    EXPECT(decode(dcontext, add, &instr), add + sizeof(add));
+    EXPECT(instr_get_opcode(&instr), OP_add);
+    EXPECT(instr_num_dsts(&instr), 1);
+    EXPECT(instr_num_srcs(&instr), 2);
+    decode_cache_lookup_hook = NULL;
+
+    instr_reset(dcontext, &instr);
+    EXPECT(decode(dcontext, add, &instr), add + sizeof(add));
+    EXPECT(instr_get_opcode(&instr), OP_add);
+    EXPECT(instr_num_dsts(&instr), 1);
+    EXPECT(instr_num_srcs(&instr), 2);
+    instr_free(dcontext, &instr);
+    EXPECT(decode_cache_enable(0), true);
+    print_file(STDERR, "done testing decode cache\n");
+}
+#endif /* STANDALONE_UNIT_TEST */
+
 #ifdef DECODE_UNIT_TEST
 #    include "instr_create_shared.h"
 
@@ -569,4 +569,15 @@ extern const instr_info_t evex_Wb_extensions[][4];
 /* table that translates opcode enums into pointers into decoding tables */
 extern const instr_info_t *const op_instr[];
 
+/* The decoded instruction cache in decode.c and the encoding template cache in
+ * encode.c guard their entries with sequence counts.  x86 does not reorder loads
+ * with loads or stores with stores, so we need only stop the compiler from doing so.
+ */
+#ifdef WINDOWS
+#    include <intrin.h> /* for _ReadWriteBarrier */
+#    define IR_CACHE_BARRIER() _ReadWriteBarrier()
+#else
+#    define IR_CACHE_BARRIER() __asm__ __volatile__("" : : : "memory")
+#endif
+
 #endif /* DECODE_PRIVATE_H */
@@ -3128,6 +3128,190 @@ copy_and_re_relativize_raw_instr(dcontext_t *dcontext, instr_t *instr, byte *dst
     return orig_dst_pc + instr->length;
 }
 
+/****************************************************************************
+ * Encoding template cache
+ *
+ * Mangling, clean calls, and client instrumentation encode the same few
+ * instruction shapes over and over: spills, restores, counter increments, and
+ * buffer stores that differ only in their immediates and displacements.  Rather
+ * than search the opcode's templates with encoding_possible() each time, we
+ * remember the template that matched, along with the prefixes it required, keyed
+ * by the opcode, prefixes, and operands.  Template matching depends on an
+ * immediate only through whether it is 1 and which sizes it fits in, and on a
+ * displacement only through whether it equals 0 or a small multiple of an operand
+ * size, so we replace each with a representative value in the key.  Operands that
+ * depend on the encoding address (pc, instr, and pc-relative or absolute address
+ * operands) are never cached.  Entries are guarded by sequence counts just like
+ * the decode cache in decode.c.
+ */
+
+#define ENCODE_TEMPLATE_CACHE_SIZE 128 /* Must be a power of 2. */
+/* The operands held in the templates without extra operands: 2 dsts and 3 srcs. */
+#define ENCODE_TEMPLATE_MAX_DSTS 2
+#define ENCODE_TEMPLATE_MAX_SRCS 3
+#define ENCODE_TEMPLATE_MAX_OPNDS (ENCODE_TEMPLATE_MAX_DSTS + ENCODE_TEMPLATE_MAX_SRCS)
+/* Displacements with a larger magnitude are all equivalent for matching. */
+#define ENCODE_TEMPLATE_MAX_EXACT_DISP 4096
+
+typedef struct _encode_template_t {
+    volatile int seq;
+    int opcode; /* OP_INVALID if the entry has never been written. */
+    uint prefixes;
+    uint encoding_hints;
+    byte x86_mode;
+    byte num_dsts;
+    byte num_srcs;
+    opnd_t opnds[ENCODE_TEMPLATE_MAX_OPNDS]; /* Dsts followed by srcs. */
+    /* The result of encoding_possible(). */
+    const instr_info_t *info;
+    uint info_prefixes;
+} encode_template_t;
+
+typedef struct _encode_template_key_t {
+    uint hash;
+    opnd_t opnds[ENCODE_TEMPLATE_MAX_OPNDS];
+} encode_template_key_t;
+
+DECLARE_NEVERPROT_VAR(static encode_template_t
+                          encode_template_cache[ENCODE_TEMPLATE_CACHE_SIZE],
+                      { { 0 } });
+
+/* Sets *key to opnd with any immediate or displacement replaced by a value that
+ * matches the same templates, and returns false if opnd cannot be cached.
+ */
+static bool
+encode_template_opnd(opnd_t opnd, opnd_t *key)
+{
+    *key = opnd;
+    if (opnd_is_reg(opnd))
+        return true;
+    if (opnd_is_immed_int(opnd)) {
+        if (TESTANY(DR_OPND_MULTI_PART, opnd_get_flags(opnd)))
+            return false;
+        /* See opnd_type_ok() and immed_size_ok(). */
+        ptr_int_t val = opnd_get_immed_int(opnd);
+        if (val == 1)
+            key->value.immed_int = 1;
+        else if (val >= INT8_MIN && val <= INT8_MAX)
+            key->value.immed_int = 2;
+        else if (val >= INT16_MIN && val <= INT16_MAX)
+            key->value.immed_int = INT16_MAX;
+        else if (IF_X64_ELSE(val >= INT32_MIN && val <= INT32_MAX, true))
+            key->value.immed_int = INT32_MAX;
+        else
+            key->value.immed_int = IF_X64_ELSE(INT64_MAX, INT32_MAX);
+        return true;
+    }
+    if (opnd_is_base_disp(opnd)) {
+        int disp = opnd_get_disp(opnd);
+        if (disp > ENCODE_TEMPLATE_MAX_EXACT_DISP || disp < -ENCODE_TEMPLATE_MAX_EXACT_DISP)
+            key->value.base_disp.disp = ENCODE_TEMPLATE_MAX_EXACT_DISP + 1;
+        return true;
+    }
+    return false;
+}
+
+static inline bool
+encode_template_opnd_same(opnd_t op1, opnd_t op2)
+{
+    /* opnd_same() allows some size mismatches which matter to us. */
+    return op1.size == op2.size && opnd_get_flags(op1) == opnd_get_flags(op2) &&
+        opnd_same(op1, op2);
+}
+
+/* Fills in key for instr and returns false if instr cannot be cached. */
+static bool
+encode_template_key(instr_t *instr, encode_template_key_t *key)
+{
+    int num_dsts = instr_num_dsts(instr);
+    int num_srcs = instr_num_srcs(instr);
+    if (num_dsts > ENCODE_TEMPLATE_MAX_DSTS || num_srcs > ENCODE_TEMPLATE_MAX_SRCS)
+        return false;
+    /* FNV-1a over the parts of the key that vary most. */
+    uint hash = 2166136261U;
+    hash = (hash ^ (uint)instr_get_opcode(instr)) * 16777619U;
+    hash = (hash ^ (uint)(num_dsts << 4 | num_srcs)) * 16777619U;
+    for (int i = 0; i < num_dsts + num_srcs; i++) {
+        opnd_t opnd = i < num_dsts ? instr_get_dst(instr, i)
+                                   : instr_get_src(instr, i - num_dsts);
+        if (!encode_template_opnd(opnd, &key->opnds[i]))
+            return false;
+        hash = (hash ^ (uint)(key->opnds[i].kind << 8 | key->opnds[i].size)) * 16777619U;
+        if (opnd_is_reg(opnd))
+            hash = (hash ^ opnd_get_reg(opnd)) * 16777619U;
+        else if (opnd_is_base_disp(opnd)) {
+            hash = (hash ^ (uint)(opnd_get_base(opnd) << 16 | opnd_get_index(opnd))) *
+                16777619U;
+            hash = (hash ^ (uint)key->opnds[i].value.base_disp.disp) * 16777619U;
+        } else
+            hash = (hash ^ (uint)key->opnds[i].value.immed_int) * 16777619U;
+    }
+    key->hash = hash;
+    return true;
+}
+
+/* Returns the cached template for instr with key, setting *prefixes to the
+ * prefixes it requires, or NULL if there is none.
+ */
+static const instr_info_t *
+encode_template_lookup(instr_t *instr, encode_template_key_t *key,
+                       uint *prefixes DR_PARAM_OUT)
+{
+    encode_template_t *entry =
+        &encode_template_cache[key->hash & (ENCODE_TEMPLATE_CACHE_SIZE - 1)];
+    int seq = entry->seq;
+    if (TESTANY(1, seq))
+        return NULL;
+    IR_CACHE_BARRIER();
+    int num_opnds = instr_num_dsts(instr) + instr_num_srcs(instr);
+    if (entry->opcode != instr_get_opcode(instr) || entry->prefixes != instr->prefixes ||
+        entry->encoding_hints != instr->encoding_hints ||
+        entry->x86_mode != (byte)IF_X64_ELSE(instr_get_x86_mode(instr), false) ||
+        entry->num_dsts != instr_num_dsts(instr) ||
+        entry->num_srcs != instr_num_srcs(instr))
+        return NULL;
+    for (int i = 0; i < num_opnds; i++) {
+        if (!encode_template_opnd_same(entry->opnds[i], key->opnds[i]))
+            return NULL;
+    }
+    const instr_info_t *info = entry->info;
+    *prefixes = entry->info_prefixes;
+    IR_CACHE_BARRIER();
+    if (entry->seq != seq)
+        return NULL;
+    return info;
+}
+
+/* Records that info, requiring prefixes, is the template for instr with key,
+ * unless another thread is writing to the entry.
+ */
+static void
+encode_template_insert(instr_t *instr, encode_template_key_t *key,
+                       const instr_info_t *info, uint prefixes)
+{
+    /* Our key does not cover extra operands. */
+    if (TESTANY(HAS_EXTRA_OPERANDS, info->flags))
+        return;
+    encode_template_t *entry =
+        &encode_template_cache[key->hash & (ENCODE_TEMPLATE_CACHE_SIZE - 1)];
+    int seq = entry->seq;
+    if (TESTANY(1, seq) || !atomic_compare_exchange_int(&entry->seq, seq, seq + 1))
+        return;
+    IR_CACHE_BARRIER();
+    entry->opcode = instr_get_opcode(instr);
+    entry->prefixes = instr->prefixes;
+    entry->encoding_hints = instr->encoding_hints;
+    entry->x86_mode = (byte)IF_X64_ELSE(instr_get_x86_mode(instr), false);
+    entry->num_dsts = (byte)instr_num_dsts(instr);
+    entry->num_srcs = (byte)instr_num_srcs(instr);
+    memcpy(entry->opnds, key->opnds,
+           (entry->num_dsts + entry->num_srcs) * sizeof(entry->opnds[0]));
+    entry->info = info;
+    entry->info_prefixes = prefixes;
+    IR_CACHE_BARRIER();
+    entry->seq = seq + 2;
+}
+
 /* Encodes instruction instr.  The parameter copy_pc points
  * to the address of this instruction in the fragment cache.
  * Checks for and fixes pc-relative instructions.
@@ -3223,7 +3407,29 @@ instr_encode_arch(dcontext_t *dcontext, instr_t *instr, byte *copy_pc, byte *fin
     di.start_pc = cache_pc;
     di.final_pc = final_pc;
 
-    while (!encoding_possible(&di, instr, info)) {
+    encode_template_key_t template_key;
+    bool cacheable = encode_template_key(instr, &template_key);
+    const instr_info_t *cached_info = NULL;
+    if (cacheable) {
+        uint prefixes;
+        cached_info = encode_template_lookup(instr, &template_key, &prefixes);
+        if (cached_info != NULL) {
+#ifdef DEBUG
+            /* Ensure the key covers everything the template search depends on. */
+            const instr_info_t *search_info = info;
+            while (!encoding_possible(&di, instr, search_info)) {
+                search_info = get_next_instr_info(search_info);
+                if (search_info == NULL)
+                    break;
+            }
+            CLIENT_ASSERT(search_info == cached_info && di.prefixes == prefixes,
+                          "encode template cache mismatch");
+#endif
+            info = cached_info;
+            di.prefixes = prefixes;
+        }
+    }
+    while (cached_info == NULL && !encoding_possible(&di, instr, info)) {
         LOG(THREAD, LOG_EMIT, ENC_LEVEL, "\tencoding for 0x%x no good...\n",
             info->opcode);
         info = get_next_instr_info(info);
@@ -3241,6 +3447,8 @@ instr_encode_arch(dcontext_t *dcontext, instr_t *instr, byte *copy_pc, byte *fin
             return NULL;
         }
     }
+    if (cacheable && cached_info == NULL)
+        encode_template_insert(instr, &template_key, info, di.prefixes);
 
     /* fill out the other fields of di */
     di.size_immed = OPSZ_NA;
@@ -54,6 +54,10 @@ void
 unit_test_utils(void);
 void
 unit_test_opnd_shared(void);
+#ifdef X86
+void
+unit_test_decode_cache(void);
+#endif
 #ifdef WINDOWS
 void
 unit_test_drwinapi(void);
@@ -82,6 +86,9 @@ main(int argc, char **argv, char **envp)
 #endif
     unit_test_utils();
     unit_test_opnd_shared();
+#ifdef X86
+    unit_test_decode_cache();
+#endif
     unit_test_options();
     unit_test_vmareas();
 #ifdef WINDOWS
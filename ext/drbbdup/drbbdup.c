@@ -72,6 +72,14 @@
 #    define MAX_IMMED_IN_CMP 255
 #endif
 
+#if defined(X86) || defined(AARCHXX)
+/* With at least this many non-default cases, the dispatcher selects the case with
+ * a binary search over the sorted encodings instead of comparing against each case
+ * in turn.
+ */
+#    define SEARCH_DISPATCH_MIN_CASES 4
+#endif
+
 typedef enum {
     DRBBDUP_ENCODING_SLOT = 0, /* Used as a spill slot for dynamic case generation. */
     DRBBDUP_SCRATCH_REG_SLOT = 1,
@@ -116,6 +124,7 @@ typedef struct {
     bool is_scratch_reg2_dead; /* If _needed, is DRBBDUP_SCRATCH_REG2 dead at start. */
 #endif
     bool is_gen; /* Denotes whether a new bb copy is dynamically being generated. */
+    bool use_search_dispatch; /* Denotes whether cases are selected by binary search. */
     drbbdup_case_t default_case;
     drbbdup_case_t *cases; /* Is NULL if enable_dup is not set. */
 } drbbdup_manager_t;
@@ -1018,6 +1027,10 @@ drbbdup_encode_runtime_case(void *drcontext, drbbdup_per_thread *pt, void *tag,
      * is executed.
      */
 
+#ifdef SEARCH_DISPATCH_MIN_CASES
+    manager->use_search_dispatch = drbbdup_count(manager) >= SEARCH_DISPATCH_MIN_CASES;
+#endif
+
     /* Spill scratch register and flags. We use drreg to check their liveness but
      * manually perform the spilling for finer control across branches used by the
      * dispatcher.
@@ -1128,6 +1141,50 @@ drbbdup_encode_runtime_case(void *drcontext, drbbdup_per_thread *pt, void *tag,
 #endif
 }
 
+#if !defined(RISCV64)
+/* Compares reg_encoding with current_case->encoding, setting the flags. */
+static void
+drbbdup_insert_compare_encoding(void *drcontext, instrlist_t *bb, instr_t *where,
+                                drbbdup_manager_t *manager, drbbdup_case_t *current_case,
+                                reg_id_t reg_encoding)
+{
+#    ifdef X86_64
+    if (current_case->encoding <= INT_MAX) {
+        /* It fits in an immediate so we can avoid the load. */
+        opnd_t opnd = opnd_create_immed_uint(current_case->encoding, OPSZ_4);
+        instrlist_meta_preinsert(
+            bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
+    } else {
+        opnd_t opnd = opnd_create_abs_addr(&current_case->encoding, OPSZ_PTR);
+        instrlist_meta_preinsert(
+            bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
+    }
+#    elif defined(X86_32)
+    opnd_t opnd = opnd_create_immed_uint(current_case->encoding, OPSZ_PTR);
+    instrlist_meta_preinsert(
+        bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
+#    elif defined(AARCHXX)
+    if (current_case->encoding <= MAX_IMMED_IN_CMP) {
+        /* Various larger immediates can be handled but it varies by ISA and mode.
+         * XXX: Should DR provide utilities to help figure out whether an integer
+         * will fit in a compare immediate?
+         */
+        opnd_t opnd = opnd_create_immed_uint(current_case->encoding, OPSZ_PTR);
+        instrlist_meta_preinsert(
+            bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
+        return;
+    }
+    DR_ASSERT_MSG(manager->is_scratch_reg2_needed, "scratch2 was not saved");
+    instrlist_insert_mov_immed_ptrsz(drcontext, current_case->encoding,
+                                     opnd_create_reg(DRBBDUP_SCRATCH_REG2), bb, where,
+                                     NULL, NULL);
+    instrlist_meta_preinsert(bb, where,
+                             XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding),
+                                              opnd_create_reg(DRBBDUP_SCRATCH_REG2)));
+#    endif
+}
+#endif
+
 /* If avoid_flags and current_case->encoding == 0, uses a compare that does not
  * affect the flags.
  */
@@ -1177,22 +1234,8 @@ drbbdup_insert_compare_encoding_and_branch(void *drcontext, instrlist_t *bb,
         }
         return;
     }
-#    ifdef X86_64
-    if (current_case->encoding <= INT_MAX) {
-        /* It fits in an immediate so we can avoid the load. */
-        opnd_t opnd = opnd_create_immed_uint(current_case->encoding, OPSZ_4);
-        instrlist_meta_preinsert(
-            bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
-    } else {
-        opnd_t opnd = opnd_create_abs_addr(&current_case->encoding, OPSZ_PTR);
-        instrlist_meta_preinsert(
-            bb, where, XINST_CREATE_cmp(drcontext, opnd, opnd_create_reg(reg_encoding)));
-    }
-#    elif defined(X86_32)
-    opnd_t opnd = opnd_create_immed_uint(current_case->encoding, OPSZ_PTR);
-    instrlist_meta_preinsert(
-        bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
-#    endif
+    drbbdup_insert_compare_encoding(drcontext, bb, where, manager, current_case,
+                                    reg_encoding);
     instrlist_meta_preinsert(bb, where,
                              INSTR_CREATE_jcc(drcontext, jmp_if_equal ? OP_jz : OP_jnz,
                                               opnd_create_instr(jmp_label)));
@@ -1234,27 +1277,8 @@ drbbdup_insert_compare_encoding_and_branch(void *drcontext, instrlist_t *bb,
         }
 #    endif
     }
-    if (current_case->encoding <= MAX_IMMED_IN_CMP) {
-        /* Various larger immediates can be handled but it varies by ISA and mode.
-         * XXX: Should DR provide utilities to help figure out whether an integer
-         * will fit in a compare immediate?
-         */
-        opnd_t opnd = opnd_create_immed_uint(current_case->encoding, OPSZ_PTR);
-        instrlist_meta_preinsert(
-            bb, where, XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding), opnd));
-        instrlist_meta_preinsert(
-            bb, where,
-            XINST_CREATE_jump_cond(drcontext, jmp_if_equal ? DR_PRED_EQ : DR_PRED_NE,
-                                   opnd_create_instr(jmp_label)));
-        return;
-    }
-    DR_ASSERT_MSG(manager->is_scratch_reg2_needed, "scratch2 was not saved");
-    instrlist_insert_mov_immed_ptrsz(drcontext, current_case->encoding,
-                                     opnd_create_reg(DRBBDUP_SCRATCH_REG2), bb, where,
-                                     NULL, NULL);
-    instrlist_meta_preinsert(bb, where,
-                             XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_encoding),
-                                              opnd_create_reg(DRBBDUP_SCRATCH_REG2)));
+    drbbdup_insert_compare_encoding(drcontext, bb, where, manager, current_case,
+                                    reg_encoding);
     instrlist_meta_preinsert(
         bb, where,
         XINST_CREATE_jump_cond(drcontext, jmp_if_equal ? DR_PRED_EQ : DR_PRED_NE,
@@ -1295,6 +1319,123 @@ drbbdup_insert_dispatch(void *drcontext, instrlist_t *bb, instr_t *where,
     drbbdup_insert_landing_restoration(drcontext, bb, where, manager);
 }
 
+#ifdef SEARCH_DISPATCH_MIN_CASES
+/* A case together with the start of its bb copy, for search dispatch. */
+typedef struct {
+    drbbdup_case_t *drbbdup_case;
+    instr_t *target;
+} drbbdup_dispatch_target_t;
+
+/* Branches to target if the flags from the preceding compare of the runtime encoding
+ * against a case encoding show equal or, if if_below, show the runtime encoding as
+ * the lower of the two as unsigned values.
+ */
+static void
+drbbdup_insert_branch(void *drcontext, instrlist_t *bb, instr_t *where, bool if_below,
+                      instr_t *target)
+{
+#    ifdef X86
+    instrlist_meta_preinsert(bb, where,
+                             INSTR_CREATE_jcc(drcontext, if_below ? OP_jb : OP_jz,
+                                              opnd_create_instr(target)));
+#    else
+    instrlist_meta_preinsert(
+        bb, where,
+        XINST_CREATE_jump_cond(drcontext, if_below ? DR_PRED_CC : DR_PRED_EQ,
+                               opnd_create_instr(target)));
+#    endif
+}
+
+/* Inserts a binary search over targets[lo..hi), sorted by encoding, that branches to
+ * the copy of the matching case or else to default_label.  depth is the number of
+ * compares executed before reaching this subtree.  Adds the compares executed to
+ * reach each case to *compare_total and returns the most executed on any path.
+ */
+static uint
+drbbdup_insert_search(void *drcontext, instrlist_t *bb, instr_t *where,
+                      drbbdup_manager_t *manager, drbbdup_dispatch_target_t *targets,
+                      int lo, int hi, instr_t *default_label, uint depth,
+                      uint *compare_total)
+{
+    int i;
+    if (hi - lo <= 2) {
+        /* Too few cases left for another split to pay off. */
+        for (i = lo; i < hi; i++) {
+            drbbdup_case_t *drbbdup_case = targets[i].drbbdup_case;
+            drbbdup_insert_compare_encoding(drcontext, bb, where, manager, drbbdup_case,
+                                            manager->scratch_reg);
+            drbbdup_insert_branch(drcontext, bb, where, false, targets[i].target);
+            *compare_total += depth + (i - lo) + 1;
+        }
+        instrlist_meta_preinsert(
+            bb, where, XINST_CREATE_jump(drcontext, opnd_create_instr(default_label)));
+        return depth + (hi - lo);
+    }
+    int mid = lo + (hi - lo) / 2;
+    instr_t *lower_label = INSTR_CREATE_label(drcontext);
+    drbbdup_insert_compare_encoding(drcontext, bb, where, manager,
+                                    targets[mid].drbbdup_case, manager->scratch_reg);
+    drbbdup_insert_branch(drcontext, bb, where, false, targets[mid].target);
+    drbbdup_insert_branch(drcontext, bb, where, true, lower_label);
+    *compare_total += depth + 1;
+    uint upper_max = drbbdup_insert_search(drcontext, bb, where, manager, targets,
+                                           mid + 1, hi, default_label, depth + 1,
+                                           compare_total);
+    instrlist_meta_preinsert(bb, where, lower_label);
+    uint lower_max = drbbdup_insert_search(drcontext, bb, where, manager, targets, lo,
+                                           mid, default_label, depth + 1, compare_total);
+    return upper_max > lower_max ? upper_max : lower_max;
+}
+
+/* Inserts a dispatcher at the start of the first bb copy, after first_start, that
+ * selects the case by binary search and branches directly to its copy.  Control
+ * falls through for the first copy's case.  The copies' own dispatch code then only
+ * restores registers.  Returns the most compares executed to reach any case, and
+ * sets *compare_total to the sum over all cases including the default.
+ */
+static uint
+drbbdup_insert_search_dispatch(void *drcontext, instrlist_t *bb, instr_t *where,
+                               drbbdup_manager_t *manager, instr_t *first_start,
+                               uint *compare_total)
+{
+    uint count = drbbdup_count(manager);
+    drbbdup_dispatch_target_t *targets =
+        dr_thread_alloc(drcontext, count * sizeof(*targets));
+    instr_t *first_match = INSTR_CREATE_label(drcontext);
+    instr_t *start = first_start;
+    uint num = 0, max_compares;
+    int i, j;
+
+    /* Copies appear in the order of the defined cases, followed by the default. */
+    for (i = 0; i < opts.non_default_case_limit; i++) {
+        if (!manager->cases[i].is_defined)
+            continue;
+        ASSERT(start != NULL, "mismatch between bb copy count and case count detected");
+        targets[num].drbbdup_case = &manager->cases[i];
+        targets[num].target = num == 0 ? first_match : start;
+        num++;
+        start = drbbdup_next_start(drbbdup_next_end(instr_get_next(start)));
+    }
+    ASSERT(num == count && start != NULL, "default copy must follow the cases");
+    /* Sort by encoding: an insertion sort suffices for the handful of cases. */
+    for (i = 1; i < (int)num; i++) {
+        drbbdup_dispatch_target_t tmp = targets[i];
+        uintptr_t encoding = tmp.drbbdup_case->encoding;
+        for (j = i - 1; j >= 0 && targets[j].drbbdup_case->encoding > encoding; j--)
+            targets[j + 1] = targets[j];
+        targets[j + 1] = tmp;
+    }
+
+    *compare_total = 0;
+    max_compares = drbbdup_insert_search(drcontext, bb, where, manager, targets, 0,
+                                         (int)num, start, 0, compare_total);
+    *compare_total += max_compares; /* The default case, on its longest path. */
+    instrlist_meta_preinsert(bb, where, first_match);
+    dr_thread_free(drcontext, targets, count * sizeof(*targets));
+    return max_compares;
+}
+#endif
+
 /* Returns whether or not additional cases should be handled by checking if the
  * copy limit, defined by the user, has been reached.
  */
@@ -1313,6 +1454,25 @@ drbbdup_do_dynamic_handling(drbbdup_manager_t *manager)
     return false;
 }
 
+/* Accounts for the dispatch code emitted for one fragment, whose slowest case
+ * takes max_compares compares and whose cases take compare_total in all.
+ */
+static void
+drbbdup_record_dispatch_stats(drbbdup_manager_t *manager, uint max_compares,
+                              uint compare_total)
+{
+    if (!opts.is_stat_enabled)
+        return;
+    dr_mutex_lock(stat_mutex);
+    if (manager->use_search_dispatch)
+        stats.search_dispatch_count++;
+    stats.dispatch_case_count += drbbdup_count(manager) + 1 /* default */;
+    stats.dispatch_compare_count += compare_total;
+    if (max_compares > stats.max_dispatch_compares)
+        stats.max_dispatch_compares = max_compares;
+    dr_mutex_unlock(stat_mutex);
+}
+
 /* Increments the execution count of bails to default case. */
 static void
 drbbdup_inc_bail_count(void)
@@ -1577,10 +1737,34 @@ drbbdup_instrument_dups(void *drcontext, void *tag, instrlist_t *bb, instr_t *in
             ASSERT(drbbdup_case->is_defined, "the found case cannot be undefined");
             ASSERT(pt->case_index + 1 == i,
                    "the next case considered should be the next increment");
+            bool is_first_copy = pt->case_index == -1;
             pt->case_index = i; /* Move on to the next case. */
-            drbbdup_insert_dispatch(drcontext, bb,
-                                    next_instr /* insert after START label. */, manager,
-                                    next_bb_label, drbbdup_case);
+#ifdef SEARCH_DISPATCH_MIN_CASES
+            if (manager->use_search_dispatch) {
+                if (is_first_copy) {
+                    uint compare_total;
+                    uint max_compares = drbbdup_insert_search_dispatch(
+                        drcontext, bb, next_instr, manager, instr, &compare_total);
+                    if (!translating)
+                        drbbdup_record_dispatch_stats(manager, max_compares,
+                                                      compare_total);
+                }
+                /* The search dispatcher branched straight here. */
+                drbbdup_insert_landing_restoration(drcontext, bb, next_instr, manager);
+            } else {
+#endif
+                if (is_first_copy && !translating) {
+                    /* The copies compare in turn: the default is reached last. */
+                    uint count = drbbdup_count(manager);
+                    drbbdup_record_dispatch_stats(manager, count,
+                                                  count * (count + 1) / 2 + count);
+                }
+                drbbdup_insert_dispatch(drcontext, bb,
+                                        next_instr /* insert after START label. */,
+                                        manager, next_bb_label, drbbdup_case);
+#ifdef SEARCH_DISPATCH_MIN_CASES
+            }
+#endif
         }
 
         /* XXX i#4134: statistics -- insert code that tracks the number of times the
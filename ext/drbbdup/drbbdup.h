@@ -370,6 +370,27 @@ typedef struct {
      * cases.
      */
     unsigned long bail_count;
+    /**
+     * Number of emitted fragments whose dispatcher selects the case with a binary
+     * search over the case encodings rather than by comparing against each case in
+     * turn.  drbbdup uses a search once a block has enough cases for it to be faster.
+     */
+    unsigned long search_dispatch_count;
+    /**
+     * Number of cases, including default cases, in emitted fragments with
+     * duplication enabled.
+     */
+    unsigned long dispatch_case_count;
+    /**
+     * Sum over the cases counted in \p dispatch_case_count of the number of encoding
+     * compares the dispatcher executes to select the case, taking the longest path
+     * for a default case and not counting the check for a new case when dynamic
+     * handling is enabled.  Divided by \p dispatch_case_count, this gives the average
+     * dispatch cost of a case.
+     */
+    unsigned long dispatch_compare_count;
+    /** The largest number of compares executed to select any case of any fragment. */
+    unsigned long max_dispatch_compares;
 } drbbdup_stats_t;
 
 /**
@@ -33,9 +33,11 @@
 /* DynamoRIO Callstack Walker. */
 
 #include "dr_api.h"
+#include "drmgr.h"
 #include "drcallstack.h"
 #include "dr_project_wide_defines.h"
 #include "../../core/unix/os_public.h" /* SIGCXT_FROM_UCXT, SC_FIELD */
+#include <stddef.h>                    /* offsetof */
 #include <string.h>
 
 #define UNW_LOCAL_ONLY /* Speed up libunwind by disallowing remote. */
@@ -43,19 +45,178 @@
 
 static int drcallstack_init_count;
 
+static drcallstack_options_t ops;
+
 struct _drcallstack_walk_t {
     /* For now we only support libunwind. */
     unw_context_t uc;
     unw_cursor_t cursor;
+    /* The current frame, for walking frame pointers. */
+    app_pc pc;
+    reg_t sp;
+    reg_t fp;
+    /* Whether the first frame has been unwound. */
+    bool stepped;
+    /* Whether frame pointer steps have left cursor behind the current frame. */
+    bool cursor_stale;
 };
 
+/***************************************************************************
+ * Per-module frame pointer verdicts.
+ *
+ * Frame pointers are only trusted in a module once its first frames walked by
+ * libunwind are found to match its frame pointer chain.  The verdicts are
+ * kept in an array of module ranges sorted by start, which walks search under
+ * a read lock; only the first walk through each module needs the write lock.
+ */
+
+#ifdef X86
+#    define FP_WALK_SUPPORTED 1
+#endif
+
+/* The number of agreeing frames after which a module is trusted. */
+#define FP_VERIFY_FRAMES 16
+
+typedef enum {
+    FP_UNKNOWN,
+    FP_TRUSTED,
+    FP_UNTRUSTED,
+} fp_state_t;
+
+typedef struct _fp_module_t {
+    app_pc start;
+    app_pc end;
+    volatile int agreed;
+    volatile int state; /* fp_state_t */
+} fp_module_t;
+
+static void *fp_module_lock;
+static fp_module_t *fp_modules;
+static uint fp_modules_count;
+static uint fp_modules_capacity;
+
+/* Returns the index of the first module whose end is above pc.
+ * The caller must hold fp_module_lock.
+ */
+static uint
+fp_module_search(app_pc pc)
+{
+    uint lo = 0, hi = fp_modules_count;
+    while (lo < hi) {
+        uint mid = lo + (hi - lo) / 2;
+        if (fp_modules[mid].end <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void
+fp_module_insert(module_data_t *data)
+{
+    uint pos;
+    dr_rwlock_write_lock(fp_module_lock);
+    pos = fp_module_search(data->start);
+    if (pos < fp_modules_count && fp_modules[pos].start <= data->start) {
+        /* Another thread added it first. */
+        dr_rwlock_write_unlock(fp_module_lock);
+        return;
+    }
+    if (fp_modules_count == fp_modules_capacity) {
+        uint new_capacity = fp_modules_capacity == 0 ? 32 : 2 * fp_modules_capacity;
+        fp_module_t *grown =
+            (fp_module_t *)dr_global_alloc(new_capacity * sizeof(*grown));
+        if (fp_modules != NULL) {
+            memcpy(grown, fp_modules, fp_modules_count * sizeof(*grown));
+            dr_global_free(fp_modules, fp_modules_capacity * sizeof(*fp_modules));
+        }
+        fp_modules = grown;
+        fp_modules_capacity = new_capacity;
+    }
+    memmove(&fp_modules[pos + 1], &fp_modules[pos],
+            (fp_modules_count - pos) * sizeof(*fp_modules));
+    fp_modules[pos].start = data->start;
+    fp_modules[pos].end = data->end;
+    fp_modules[pos].agreed = 0;
+    fp_modules[pos].state = FP_UNKNOWN;
+    fp_modules_count++;
+    dr_rwlock_write_unlock(fp_module_lock);
+}
+
+/* Looks up pc's module, adding it if necessary, and returns its verdict. */
+static fp_state_t
+fp_module_state(app_pc pc)
+{
+    fp_state_t state = FP_UNTRUSTED;
+    bool found = false;
+    uint pos;
+    dr_rwlock_read_lock(fp_module_lock);
+    pos = fp_module_search(pc);
+    if (pos < fp_modules_count && fp_modules[pos].start <= pc) {
+        state = (fp_state_t)fp_modules[pos].state;
+        found = true;
+    }
+    dr_rwlock_read_unlock(fp_module_lock);
+    if (!found) {
+        /* XXX: Code outside of any module, such as generated code, pays for this
+         * lookup on every frame.  We could cache such ranges as untrusted.
+         */
+        module_data_t *data = dr_lookup_module(pc);
+        if (data == NULL)
+            return FP_UNTRUSTED;
+        fp_module_insert(data);
+        dr_free_module_data(data);
+        state = FP_UNKNOWN;
+    }
+    return state;
+}
+
+static void
+fp_module_record(app_pc pc, bool agreed)
+{
+    uint pos;
+    dr_rwlock_read_lock(fp_module_lock);
+    pos = fp_module_search(pc);
+    if (pos < fp_modules_count && fp_modules[pos].start <= pc &&
+        fp_modules[pos].state == FP_UNKNOWN) {
+        if (!agreed)
+            dr_atomic_store32(&fp_modules[pos].state, FP_UNTRUSTED);
+        else if (dr_atomic_add32_return_sum(&fp_modules[pos].agreed, 1) >=
+                 FP_VERIFY_FRAMES) {
+            /* A concurrent disagreement could be overwritten here, but only
+             * after FP_VERIFY_FRAMES agreements.
+             */
+            dr_atomic_store32(&fp_modules[pos].state, FP_TRUSTED);
+        }
+    }
+    dr_rwlock_read_unlock(fp_module_lock);
+}
+
+static void
+event_module_unload(void *drcontext, const module_data_t *info)
+{
+    uint pos;
+    dr_rwlock_write_lock(fp_module_lock);
+    pos = fp_module_search(info->start);
+    if (pos < fp_modules_count && fp_modules[pos].start == info->start) {
+        memmove(&fp_modules[pos], &fp_modules[pos + 1],
+                (fp_modules_count - pos - 1) * sizeof(*fp_modules));
+        fp_modules_count--;
+    }
+    dr_rwlock_write_unlock(fp_module_lock);
+}
+
+/***************************************************************************
+ * INIT
+ */
+
 drcallstack_status_t
 drcallstack_init(drcallstack_options_t *ops_in)
 {
-    /* This does nothing now.  We anticipate adding callstack storage and
-     * module indexing which might need event registration in the future.
-     */
-    if (ops_in->struct_size != sizeof(*ops_in))
+    /* Clients built before the flags field was added pass a smaller struct. */
+    if (ops_in->struct_size != sizeof(*ops_in) &&
+        ops_in->struct_size != offsetof(drcallstack_options_t, flags))
         return DRCALLSTACK_ERROR_INVALID_PARAMETER;
     int count = dr_atomic_add32_return_sum(&drcallstack_init_count, 1);
     if (count > 1) {
@@ -64,6 +225,15 @@ drcallstack_init(drcallstack_options_t *ops_in)
          */
         return DRCALLSTACK_SUCCESS;
     }
+    memset(&ops, 0, sizeof(ops));
+    memcpy(&ops, ops_in, ops_in->struct_size);
+    if (TESTANY(DRCALLSTACK_FRAME_POINTERS, ops.flags)) {
+        if (!drmgr_init())
+            return DRCALLSTACK_ERROR;
+        fp_module_lock = dr_rwlock_create();
+        if (!drmgr_register_module_unload_event(event_module_unload))
+            return DRCALLSTACK_ERROR;
+    }
     return DRCALLSTACK_SUCCESS;
 }
 
@@ -73,18 +243,26 @@ drcallstack_exit(void)
     int count = dr_atomic_add32_return_sum(&drcallstack_init_count, -1);
     if (count != 0)
         return DRCALLSTACK_SUCCESS;
+    if (TESTANY(DRCALLSTACK_FRAME_POINTERS, ops.flags)) {
+        drmgr_unregister_module_unload_event(event_module_unload);
+        drmgr_exit();
+        if (fp_modules != NULL)
+            dr_global_free(fp_modules, fp_modules_capacity * sizeof(*fp_modules));
+        fp_modules = NULL;
+        fp_modules_count = 0;
+        fp_modules_capacity = 0;
+        dr_rwlock_destroy(fp_module_lock);
+    }
     return DRCALLSTACK_SUCCESS;
 }
 
-drcallstack_status_t
-drcallstack_init_walk(dr_mcontext_t *mc, DR_PARAM_OUT drcallstack_walk_t **walk_out)
-{
-    if (!TESTALL(DR_MC_CONTROL | DR_MC_INTEGER, mc->flags))
-        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
-
-    drcallstack_walk_t *walk = dr_thread_alloc(dr_get_current_drcontext(), sizeof(*walk));
-    *walk_out = walk;
+/***************************************************************************
+ * WALKING
+ */
 
+static drcallstack_status_t
+walk_init(dr_mcontext_t *mc, drcallstack_walk_t *walk)
+{
     /* We assume that SIMD registers are not needed and thus we do not call
      * unw_getcontext(&walk->uc).
      */
@@ -148,9 +326,29 @@ drcallstack_init_walk(dr_mcontext_t *mc, DR_PARAM_OUT drcallstack_walk_t **walk_
      */
     unw_init_local(&walk->cursor, &walk->uc);
 
+    walk->pc = mc->pc;
+    walk->sp = mc->xsp;
+#ifdef X86
+    walk->fp = mc->xbp;
+#else
+    walk->fp = 0;
+#endif
+    walk->stepped = false;
+    walk->cursor_stale = false;
     return DRCALLSTACK_SUCCESS;
 }
 
+drcallstack_status_t
+drcallstack_init_walk(dr_mcontext_t *mc, DR_PARAM_OUT drcallstack_walk_t **walk_out)
+{
+    if (!TESTALL(DR_MC_CONTROL | DR_MC_INTEGER, mc->flags))
+        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+
+    drcallstack_walk_t *walk = dr_thread_alloc(dr_get_current_drcontext(), sizeof(*walk));
+    *walk_out = walk;
+    return walk_init(mc, walk);
+}
+
 drcallstack_status_t
 drcallstack_cleanup_walk(drcallstack_walk_t *walk)
 {
@@ -158,11 +356,24 @@ drcallstack_cleanup_walk(drcallstack_walk_t *walk)
     return DRCALLSTACK_SUCCESS;
 }
 
-drcallstack_status_t
-drcallstack_next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame)
+static drcallstack_status_t
+unwind_step(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame)
 {
-    if (frame->struct_size != sizeof(*frame))
-        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+#ifdef FP_WALK_SUPPORTED
+    if (walk->cursor_stale) {
+        /* Restart libunwind from the frame we reached via frame pointers.
+         * The other callee-saved registers still hold their values from the
+         * start of the walk, but the unwind tables only need these to find
+         * the frame.
+         */
+        sigcontext_t *sc = SIGCXT_FROM_UCXT(&walk->uc);
+        sc->SC_XIP = (ptr_uint_t)walk->pc;
+        sc->SC_XSP = walk->sp;
+        sc->SC_XBP = walk->fp;
+        unw_init_local(&walk->cursor, &walk->uc);
+        walk->cursor_stale = false;
+    }
+#endif
     int res = unw_step(&walk->cursor);
     if (res == 0)
         return DRCALLSTACK_NO_MORE_FRAMES;
@@ -184,5 +395,112 @@ drcallstack_next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_
     if (unw_get_reg(&walk->cursor, UNW_REG_IP, (ptr_uint_t *)&frame->pc) != 0 ||
         unw_get_reg(&walk->cursor, UNW_REG_SP, &frame->sp) != 0)
         return DRCALLSTACK_ERROR;
+    walk->pc = frame->pc;
+    walk->sp = frame->sp;
+#ifdef FP_WALK_SUPPORTED
+    if (unw_get_reg(&walk->cursor, UNW_TDEP_BP, &walk->fp) != 0)
+        walk->fp = 0;
+#endif
+    walk->stepped = true;
+    return DRCALLSTACK_SUCCESS;
+}
+
+#ifdef FP_WALK_SUPPORTED
+/* Reads the saved frame pointer and return address of the frame at walk->fp. */
+static bool
+read_frame_record(drcallstack_walk_t *walk, DR_PARAM_OUT reg_t record[2])
+{
+    size_t read;
+    if (walk->fp == 0 || !ALIGNED(walk->fp, sizeof(reg_t)) || walk->fp < walk->sp)
+        return false;
+    if (!dr_safe_read((void *)walk->fp, 2 * sizeof(reg_t), record, &read) ||
+        read != 2 * sizeof(reg_t))
+        return false;
+    return record[1] != 0;
+}
+
+static drcallstack_status_t
+fp_step(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame)
+{
+    reg_t record[2];
+    /* At the bottom of the stack or on a broken chain we let libunwind
+     * decide what comes next.
+     */
+    if (!read_frame_record(walk, record))
+        return unwind_step(walk, frame);
+    frame->pc = (app_pc)record[1];
+    frame->sp = walk->fp + 2 * sizeof(reg_t);
+    walk->pc = frame->pc;
+    walk->sp = frame->sp;
+    walk->fp = record[0];
+    walk->cursor_stale = true;
     return DRCALLSTACK_SUCCESS;
 }
+
+/* Steps with libunwind and records whether the frame pointer chain agreed. */
+static drcallstack_status_t
+verify_step(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame)
+{
+    reg_t record[2];
+    app_pc pc = walk->pc;
+    reg_t fp = walk->fp;
+    bool have_record = read_frame_record(walk, record);
+    drcallstack_status_t res = unwind_step(walk, frame);
+    if (res == DRCALLSTACK_SUCCESS) {
+        fp_module_record(pc,
+                         have_record && frame->pc == (app_pc)record[1] &&
+                             frame->sp == fp + 2 * sizeof(reg_t) &&
+                             walk->fp == record[0]);
+    }
+    return res;
+}
+#endif
+
+static drcallstack_status_t
+next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame)
+{
+#ifdef FP_WALK_SUPPORTED
+    /* The first frame may be at a function entry, before its frame pointer is
+     * set up, so it always goes through the unwind tables.
+     */
+    if (TESTANY(DRCALLSTACK_FRAME_POINTERS, ops.flags) && walk->stepped) {
+        switch (fp_module_state(walk->pc)) {
+        case FP_TRUSTED: return fp_step(walk, frame);
+        case FP_UNKNOWN: return verify_step(walk, frame);
+        default: break;
+        }
+    }
+#endif
+    return unwind_step(walk, frame);
+}
+
+drcallstack_status_t
+drcallstack_next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame)
+{
+    if (frame->struct_size != sizeof(*frame))
+        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+    return next_frame(walk, frame);
+}
+
+drcallstack_status_t
+drcallstack_collect(dr_mcontext_t *mc, DR_PARAM_OUT app_pc *pcs, uint max_frames,
+                    DR_PARAM_OUT uint *num_frames)
+{
+    /* The walk is small enough for the stack, which avoids a heap allocation
+     * per callstack.
+     */
+    drcallstack_walk_t walk;
+    drcallstack_frame_t frame;
+    drcallstack_status_t res;
+    if (!TESTALL(DR_MC_CONTROL | DR_MC_INTEGER, mc->flags) ||
+        (pcs == NULL && max_frames > 0) || num_frames == NULL)
+        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+    *num_frames = 0;
+    res = walk_init(mc, &walk);
+    while (res == DRCALLSTACK_SUCCESS && *num_frames < max_frames) {
+        res = next_frame(&walk, &frame);
+        if (res == DRCALLSTACK_SUCCESS)
+            pcs[(*num_frames)++] = frame.pc;
+    }
+    return res == DRCALLSTACK_NO_MORE_FRAMES ? DRCALLSTACK_SUCCESS : res;
+}
@@ -62,11 +62,32 @@ typedef enum {
  * INIT
  */
 
+/** Flags controlling how drcallstack walks callstacks. */
+typedef enum {
+    /**
+     * Walks the frame pointer chain through modules that maintain one, rather
+     * than consulting their unwind tables for every frame.  The first frames
+     * walked through each module are walked with both methods; a module whose
+     * frame pointer chain agrees with its unwind tables is walked with frame
+     * pointers from then on, while a module where they disagree never is.
+     * The first frame of a walk always uses the unwind tables, as the context
+     * may be at a function entry before the frame is set up.  Functions in a
+     * trusted module that do not maintain a frame pointer are skipped in the
+     * resulting callstack.  Currently this only has an effect on x86.
+     */
+    DRCALLSTACK_FRAME_POINTERS = 0x0001,
+} drcallstack_flags_t;
+
 /** Specifies the options when initializing drcallstack. */
 typedef struct _drcallstack_options_t {
     /** Set this to the size of this structure. */
     size_t struct_size;
-    /* We expect to add more options in the future. */
+    /**
+     * A combination of #drcallstack_flags_t values.  Only the flags passed to
+     * the first call to drcallstack_init() take effect.  Clients built against
+     * older headers that lack this field continue to work and get no flags.
+     */
+    drcallstack_flags_t flags;
 } drcallstack_options_t;
 
 /** Describes one callstack frame. */
@@ -139,6 +160,23 @@ DR_EXPORT
 drcallstack_status_t
 drcallstack_next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame);
 
+DR_EXPORT
+/**
+ * Walks the whole callstack for the context 'mc', which must meet the same
+ * requirements as for drcallstack_init_walk(), and stores the program counter
+ * of each frame in 'pcs'.  The frames are the same ones that repeated calls to
+ * drcallstack_next_frame() would return, but with no per-walk heap allocation
+ * or per-frame call overhead.  At most 'max_frames' are stored; the number
+ * stored is written to 'num_frames'.  Reaching 'max_frames' before the bottom
+ * of the stack is not an error.  If the walk fails partway, an error code is
+ * returned and 'num_frames' holds the count of frames found before the failure.
+ *
+ * \note Currently callstack walking is only available for Linux.
+ */
+drcallstack_status_t
+drcallstack_collect(dr_mcontext_t *mc, DR_PARAM_OUT app_pc *pcs, uint max_frames,
+                    DR_PARAM_OUT uint *num_frames);
+
 /**@}*/ /* end doxygen group */
 
 #ifdef __cplusplus
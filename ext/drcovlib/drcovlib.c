@@ -36,6 +36,8 @@
  * It simply stores the information of basic blocks seen in bb callback event
  * into a table without any instrumentation, and dumps the buffer into log files
  * on thread/process exit.
+ * With DRCOVLIB_HIT_COUNTS, each basic block also gets an inline counter update,
+ * whose counter lives in a table parallel to the basic block table.
  *
  * There are pros and cons to creating this coverage library as opposed to other
  * tools using the drcov client straight-up as a 2nd client: DR has support for
@@ -78,6 +80,15 @@ static char logdir[MAXIMUM_PATH];
 
 typedef struct _per_thread_t {
     void *bb_table;
+    /* For hit counts: the counter of each entry of bb_table, at the same index.
+     * Its lock guards adding entries to both tables, to keep them in step.
+     */
+    void *count_table;
+    /* For hit counts: the most recent counter of each tag, for basic blocks at
+     * index 0 and for trace constituents at index 1, so that translation can
+     * recreate the original counter update.
+     */
+    hashtable_t *tag_counters;
     file_t log;
     char logname[MAXIMUM_PATH];
 } per_thread_t;
@@ -87,6 +98,9 @@ static bool drcov_per_thread = false;
 static volatile bool go_native;
 static int tls_idx = -1;
 static int drcovlib_init_count;
+/* The size of a hit counter, or 0 if hit counts are not enabled. */
+static uint count_size;
+#define TAG_COUNTERS_HASH_BITS 12
 
 /****************************************************************************
  * Utility Functions
@@ -122,6 +136,16 @@ log_file_create(void *drcontext, per_thread_t *data)
  * BB Table Functions
  */
 
+static uint64
+bb_table_entry_count(per_thread_t *data, ptr_uint_t idx)
+{
+    void *counter = drtable_get_entry(data->count_table, idx);
+    ASSERT(counter != NULL, "count table out of sync with bb table");
+    if (count_size == sizeof(uint64))
+        return *(uint64 *)counter;
+    return *(uint *)counter;
+}
+
 static bool
 bb_table_entry_print(ptr_uint_t idx, void *entry, void *iter_data)
 {
@@ -129,6 +153,8 @@ bb_table_entry_print(ptr_uint_t idx, void *entry, void *iter_data)
     bb_entry_t *bb_entry = (bb_entry_t *)entry;
     dr_fprintf(data->log, "module[%3u]: " PFX ", %3u", bb_entry->mod_id, bb_entry->start,
                bb_entry->size);
+    if (data->count_table != NULL)
+        dr_fprintf(data->log, ", " UINT64_FORMAT_STRING, bb_table_entry_count(data, idx));
     dr_fprintf(data->log, "\n");
     return true; /* continue iteration */
 }
@@ -147,23 +173,48 @@ bb_table_print(void *drcontext, per_thread_t *data)
      */
     ASSERT(drtable_num_entries(data->bb_table) <= UINT_MAX,
            "block count exceeds 32-bit max");
+    /* Keep blocks from being added between dumping the two tables. */
+    if (data->count_table != NULL)
+        drtable_lock(data->count_table);
     dr_fprintf(data->log, "BB Table: %u bbs\n",
                (uint)drtable_num_entries(data->bb_table));
     if (TESTANY(DRCOVLIB_DUMP_AS_TEXT, options.flags)) {
-        dr_fprintf(data->log, "module id, start, size:\n");
+        dr_fprintf(data->log, "module id, start, size%s:\n",
+                   data->count_table != NULL ? ", count" : "");
         drtable_iterate(data->bb_table, data, bb_table_entry_print);
-    } else
+    } else {
         drtable_dump_entries(data->bb_table, data->log);
+        if (data->count_table != NULL) {
+            ASSERT(drtable_num_entries(data->count_table) ==
+                       drtable_num_entries(data->bb_table),
+                   "count table out of sync with bb table");
+            dr_fprintf(data->log, DRCOV_BB_COUNTS_HEADER,
+                       (uint)drtable_num_entries(data->count_table), count_size);
+            drtable_dump_entries(data->count_table, data->log);
+        }
+    }
+    if (data->count_table != NULL)
+        drtable_unlock(data->count_table);
 }
 
-static void
-bb_table_entry_add(void *drcontext, per_thread_t *data, app_pc start, uint size)
+/* Returns the block's counter for hit counts, or NULL. */
+static void *
+bb_table_entry_add(void *drcontext, per_thread_t *data, void *tag, bool for_trace,
+                   app_pc start, uint size)
 {
-    bb_entry_t *bb_entry = drtable_alloc(data->bb_table, 1, NULL);
+    bb_entry_t *bb_entry;
+    void *counter = NULL;
     uint mod_id;
     app_pc mod_seg_start;
     drcovlib_status_t res =
         drmodtrack_lookup_segment(drcontext, start, &mod_id, &mod_seg_start);
+    if (data->count_table != NULL) {
+        drtable_lock(data->count_table);
+        counter = drtable_alloc(data->count_table, 1, NULL);
+    }
+    bb_entry = drtable_alloc(data->bb_table, 1, NULL);
+    if (data->count_table != NULL)
+        drtable_unlock(data->count_table);
     /* we do not de-duplicate repeated bbs */
     ASSERT(size < USHRT_MAX, "size overflow");
     bb_entry->size = (ushort)size;
@@ -181,6 +232,9 @@ bb_table_entry_add(void *drcontext, per_thread_t *data, app_pc start, uint size)
         bb_entry->mod_id = UNKNOWN_MODULE_ID;
         bb_entry->start = (uint)(ptr_uint_t)start;
     }
+    if (counter != NULL)
+        hashtable_add_replace(&data->tag_counters[for_trace ? 1 : 0], tag, counter);
+    return counter;
 }
 
 #define INIT_BB_TABLE_ENTRIES 4096
@@ -191,6 +245,18 @@ bb_table_create(bool synch)
                           NULL);
 }
 
+static void *
+count_table_create(void)
+{
+    if (count_size == 0)
+        return NULL;
+    /* The inlined counter updates need the counters to be reachable from the code
+     * cache.  The table is not synch, as we lock it ourselves.
+     */
+    return drtable_create(INIT_BB_TABLE_ENTRIES, count_size, DRTABLE_MEM_REACHABLE,
+                          false /* synch */, NULL);
+}
+
 static void
 bb_table_destroy(void *table, void *data)
 {
@@ -258,6 +324,15 @@ thread_data_create(void *drcontext)
      * if so, no lock is required for bb_table operation.
      */
     data->bb_table = bb_table_create(drcontext == NULL ? true : false);
+    data->count_table = count_table_create();
+    data->tag_counters = NULL;
+    if (data->count_table != NULL) {
+        data->tag_counters = dr_global_alloc(2 * sizeof(*data->tag_counters));
+        hashtable_init_ex(&data->tag_counters[0], TAG_COUNTERS_HASH_BITS, HASH_INTPTR,
+                          false /*!strdup*/, drcontext == NULL, NULL, NULL, NULL);
+        hashtable_init_ex(&data->tag_counters[1], TAG_COUNTERS_HASH_BITS, HASH_INTPTR,
+                          false /*!strdup*/, drcontext == NULL, NULL, NULL, NULL);
+    }
     log_file_create(drcontext, data);
     return data;
 }
@@ -267,6 +342,13 @@ thread_data_destroy(void *drcontext, per_thread_t *data)
 {
     /* destroy the bb table */
     bb_table_destroy(data->bb_table, data);
+    if (data->count_table != NULL)
+        drtable_destroy(data->count_table, data);
+    if (data->tag_counters != NULL) {
+        hashtable_delete(&data->tag_counters[0]);
+        hashtable_delete(&data->tag_counters[1]);
+        dr_global_free(data->tag_counters, 2 * sizeof(*data->tag_counters));
+    }
     dr_close_file(data->log);
     /* free thread data */
     if (drcontext == NULL) {
@@ -330,7 +412,8 @@ event_pre_syscall(void *drcontext, int sysnum)
 
 /* We collect the basic block information including offset from module base,
  * size, and num of instructions, and add it into a basic block table without
- * instrumentation.
+ * instrumentation.  For hit counts, we pass the block's counter to
+ * event_app_instruction() in user_data.
  */
 static dr_emit_flags_t
 event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
@@ -340,11 +423,19 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
     instr_t *instr;
     app_pc tag_pc, start_pc, end_pc;
 
-    /* do nothing for translation */
-    if (translating)
+    data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    /* For translation, we only need the counter the block was built with, as the
+     * counter update's encoding can depend on its address (e.g., on AArch64).
+     * XXX: If the tag was rebuilt since, this is the newer block's counter.
+     */
+    if (translating) {
+        if (data->tag_counters != NULL) {
+            *user_data = hashtable_lookup(&data->tag_counters[for_trace ? 1 : 0], tag);
+            ASSERT(*user_data != NULL, "no counter for translated block");
+        }
         return DR_EMIT_DEFAULT;
+    }
 
-    data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     /* Collect the number of instructions and the basic block size,
      * assuming the basic block does not have any elision on control
      * transfer instructions, which is true for default options passed
@@ -376,7 +467,8 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
      * 4. The duplication can be easily handled in a post-processing step,
      *    which is required anyway.
      */
-    bb_table_entry_add(drcontext, data, tag_pc, (uint)(end_pc - start_pc));
+    *user_data = bb_table_entry_add(drcontext, data, tag, for_trace, tag_pc,
+                                    (uint)(end_pc - start_pc));
 
     if (go_native)
         return DR_EMIT_GO_NATIVE;
@@ -384,6 +476,22 @@ event_basic_block_analysis(void *drcontext, void *tag, instrlist_t *bb, bool for
         return DR_EMIT_DEFAULT;
 }
 
+static dr_emit_flags_t
+event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                      bool for_trace, bool translating, void *user_data)
+{
+    if (!drmgr_is_first_instr(drcontext, instr))
+        return DR_EMIT_DEFAULT;
+    ASSERT(user_data != NULL, "missing counter");
+    if (!drx_insert_counter_update(
+            drcontext, bb, instr, SPILL_SLOT_MAX + 1,
+            IF_AARCHXX_OR_RISCV64_(SPILL_SLOT_MAX + 1) user_data, 1,
+            count_size == sizeof(uint64) ? DRX_COUNTER_64BIT : 0)) {
+        ASSERT(false, "failed to insert counter update");
+    }
+    return DR_EMIT_DEFAULT;
+}
+
 static void
 event_thread_exit(void *drcontext)
 {
@@ -556,7 +664,9 @@ drcovlib_init(drcovlib_options_t *ops)
 
     if (ops->struct_size != sizeof(options))
         return DRCOVLIB_ERROR_INVALID_PARAMETER;
-    if ((ops->flags & (~(DRCOVLIB_DUMP_AS_TEXT | DRCOVLIB_THREAD_PRIVATE))) != 0)
+    if ((ops->flags &
+         (~(DRCOVLIB_DUMP_AS_TEXT | DRCOVLIB_THREAD_PRIVATE | DRCOVLIB_HIT_COUNTS |
+            DRCOVLIB_HIT_COUNTS_64BIT))) != 0)
         return DRCOVLIB_ERROR_INVALID_PARAMETER;
     if (TESTANY(DRCOVLIB_THREAD_PRIVATE, ops->flags)) {
         if (!dr_using_all_private_caches())
@@ -574,6 +684,12 @@ drcovlib_init(drcovlib_options_t *ops)
         options.logprefix = "drcov";
     if (options.native_until_thread > 0)
         go_native = true;
+    if (TESTANY(DRCOVLIB_HIT_COUNTS_64BIT, options.flags))
+        count_size = sizeof(uint64);
+    else if (TESTANY(DRCOVLIB_HIT_COUNTS, options.flags))
+        count_size = sizeof(uint);
+    else
+        count_size = 0;
 
     drmgr_init();
     drx_init();
@@ -588,7 +704,8 @@ drcovlib_init(drcovlib_options_t *ops)
 
     drmgr_register_thread_init_event(event_thread_init);
     drmgr_register_thread_exit_event(event_thread_exit);
-    drmgr_register_bb_instrumentation_event(event_basic_block_analysis, NULL, NULL);
+    drmgr_register_bb_instrumentation_event(
+        event_basic_block_analysis, count_size > 0 ? event_app_instruction : NULL, NULL);
     drmgr_register_filter_syscall_event(event_filter_syscall);
     drmgr_register_pre_syscall_event(event_pre_syscall);
 #ifdef UNIX
@@ -76,6 +76,22 @@ typedef enum {
      * drcovlib's own thread exit events rather than in drcovlib_exit().
      */
     DRCOVLIB_THREAD_PRIVATE = 0x0002,
+    /**
+     * Requests that an execution count be maintained for each basic block, in
+     * addition to recording which blocks were executed.  Each block is instrumented
+     * with an inline update of a 32-bit counter (see drx_insert_counter_update()),
+     * and the counts are dumped in a section following the block table, which
+     * \ref sec_drcov2lcov turns into line hit counts.  The counters are
+     * thread-private if #DRCOVLIB_THREAD_PRIVATE is in effect.  Otherwise they are
+     * shared by all threads and are not updated atomically, so concurrent
+     * executions of the same block may be undercounted.
+     */
+    DRCOVLIB_HIT_COUNTS = 0x0004,
+    /**
+     * Like #DRCOVLIB_HIT_COUNTS, but with 64-bit counters, which do not wrap around
+     * for blocks executed more than 2^32 times.
+     */
+    DRCOVLIB_HIT_COUNTS_64BIT = 0x0008,
 } drcovlib_flags_t;
 
 /** Specifies the options when initializing drcovlib. */
@@ -148,6 +164,13 @@ typedef struct _bb_entry_t {
     ushort mod_id;
 } bb_entry_t;
 
+/* With #DRCOVLIB_HIT_COUNTS or #DRCOVLIB_HIT_COUNTS_64BIT, the block table is
+ * followed by a header line in this format, where the first value is the number of
+ * blocks (the same as in the block table header) and the second is the size of each
+ * count in bytes.  It is followed by the counts, in the same order as the blocks.
+ */
+#define DRCOV_BB_COUNTS_HEADER "BB Counts: %u bbs, %u bytes\n"
+
 /***************************************************************************
  * Coverage interface
  */
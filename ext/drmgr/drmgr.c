@@ -268,6 +268,8 @@ typedef struct _local_ctx_t {
     drmgr_bbdup_insert_encoding_cb_t bbdup_insert_encoding_cb;
     cb_list_t iter_pre_bbdup;
     cb_entry_t pre_bbdup[EVENTS_STACK_SZ];
+    /* for drmgr_set_translation_reuse_threshold(): */
+    uint xl8_reuse_threshold;
 } local_cb_info_t;
 
 /***************************************************************************
@@ -299,6 +301,13 @@ static void *opcode_table_lock; /* Denotes whether opcode event was ever registe
  */
 static bool was_opcode_instrum_registered;
 
+/* For drmgr_set_translation_reuse_threshold().  The threshold is protected by
+ * bb_cb_lock; the table, which maps a tag to the number of times its block has
+ * been re-created for translation, has its own lock.
+ */
+static uint xl8_reuse_threshold;
+static hashtable_t xl8_count_table;
+
 /* Count of callbacks needing user_data, protected by bb_cb_lock */
 static uint pair_count;
 static uint quintet_count;
@@ -1202,6 +1211,7 @@ drmgr_bb_event_set_local_cb_info(void *drcontext,
     local_info->pair_count = pair_count;
     local_info->quintet_count = quintet_count;
     local_info->was_opcode_instrum_registered = was_opcode_instrum_registered;
+    local_info->xl8_reuse_threshold = xl8_reuse_threshold;
     /* We do not make a complete local copy of the opcode hashtable as this can be
      * expensive. Instead, we create a scoped table later on that only maps the cb lists
      * of those opcodes required by this specific bb.
@@ -1244,6 +1254,35 @@ drmgr_bb_event_delete_local_cb_info(void *drcontext,
     }
 }
 
+/* Counts re-creations of tag for translation and, once there have been threshold
+ * of them, requests a flush so that tag's block is rebuilt storing its
+ * translations.  Returns the emit flags to use for a new (non-translating) block.
+ */
+static dr_emit_flags_t
+drmgr_bb_translation_reuse(void *tag, bool translating, uint threshold)
+{
+    uint count;
+    bool flush = false;
+    hashtable_lock(&xl8_count_table);
+    count = (uint)(ptr_uint_t)hashtable_lookup(&xl8_count_table, tag);
+    if (translating && count < threshold) {
+        count++;
+        hashtable_add_replace(&xl8_count_table, tag, (void *)(ptr_uint_t)count);
+        flush = (count == threshold);
+    }
+    hashtable_unlock(&xl8_count_table);
+    if (flush) {
+        /* The existing fragments for tag did not store translations, so we replace
+         * them.  We cannot flush synchronously from inside a translation.
+         */
+        dr_delay_flush_region((app_pc)tag, 1, 0, NULL);
+    }
+    /* There is no point in asking to store translations while translating. */
+    if (translating || count < threshold)
+        return DR_EMIT_DEFAULT;
+    return DR_EMIT_STORE_TRANSLATIONS;
+}
+
 static dr_emit_flags_t
 drmgr_bb_event(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
                bool translating)
@@ -1278,6 +1317,14 @@ drmgr_bb_event(void *drcontext, void *tag, instrlist_t *bb, bool for_trace,
                                                pt, &local_info, pair_data, quintet_data);
     }
 
+    /* drbbdup's restore-state handling needs the recreated ilist, so we never store
+     * translations for duplicated blocks.
+     */
+    if (local_info.xl8_reuse_threshold > 0 && !is_dups) {
+        res |= drmgr_bb_translation_reuse(tag, translating,
+                                          local_info.xl8_reuse_threshold);
+    }
+
     /* Do final fix passes: */
     /* Pass 5: our private pass to support multiple non-meta ctis in app2app phase */
     drmgr_fix_app_ctis(drcontext, bb);
@@ -1594,6 +1641,9 @@ drmgr_bb_init(void)
     cblist_init(&cblist_instrumentation, sizeof(cb_entry_t));
     cblist_init(&cblist_instru2instru, sizeof(cb_entry_t));
     cblist_init(&cblist_meta_instru, sizeof(cb_entry_t));
+    /* We use the table lock explicitly to make the increment atomic. */
+    hashtable_init_ex(&xl8_count_table, 8, HASH_INTPTR, false /*!strdup*/,
+                      false /*!synch*/, NULL, NULL, NULL);
 }
 
 static void
@@ -1607,6 +1657,8 @@ drmgr_bb_exit(void)
     cblist_delete(&cblist_instrumentation);
     cblist_delete(&cblist_instru2instru);
     cblist_delete(&cblist_meta_instru);
+    hashtable_delete(&xl8_count_table);
+    xl8_reuse_threshold = 0;
 }
 
 static bool
@@ -3556,6 +3608,16 @@ drmgr_reserve_note_range(size_t size)
     return res;
 }
 
+DR_EXPORT
+bool
+drmgr_set_translation_reuse_threshold(uint threshold)
+{
+    dr_rwlock_write_lock(bb_cb_lock);
+    xl8_reuse_threshold = threshold;
+    dr_rwlock_write_unlock(bb_cb_lock);
+    return true;
+}
+
 DR_EXPORT
 bool
 drmgr_disable_auto_predication(void *drcontext, instrlist_t *ilist)
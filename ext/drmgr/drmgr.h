@@ -646,6 +646,29 @@ DR_EXPORT
 bool
 drmgr_is_last_instr(void *drcontext, instr_t *instr);
 
+DR_EXPORT
+/**
+ * Requests that drmgr stop re-running the instrumentation passes to translate a
+ * basic block once that block has been re-created for translation \p threshold
+ * times.  At that point drmgr flushes the block (see dr_delay_flush_region())
+ * and returns #DR_EMIT_STORE_TRANSLATIONS every time the block is built again,
+ * so that DR translates faults and signals in it from stored information.  This
+ * is meant for applications that fault repeatedly in the same code, such as
+ * garbage collectors using memory protection barriers.  Blocks duplicated by
+ * \p drbbdup are never affected.  A \p threshold of 0, the default, disables
+ * the feature; the most recent call takes effect.
+ *
+ * Once a block stores its translations, the restore-state events for it are
+ * passed a NULL \p fragment_info.ilist field, so any restore-state event
+ * handler in use must support that case.  The memory cost of stored
+ * translations is only paid for blocks that reach \p threshold, but while the
+ * feature is enabled every block creation performs one synchronized table
+ * lookup.
+ * \return whether successful.
+ */
+bool
+drmgr_set_translation_reuse_threshold(uint threshold);
+
 /***************************************************************************
  * TLS
  */
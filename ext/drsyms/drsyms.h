@@ -113,6 +113,16 @@ typedef enum {
      * This adds overhead: see drsym_search_symbols_ex() for details.
      */
     DRSYM_FULL_SEARCH = 0x08,
+    /**
+     * For DWARF line information, for drsym_lookup_address().  Requests that
+     * the module's entire line table be read into a sorted in-memory table on
+     * this query, from which this and all later line lookups in the module are
+     * answered by binary search without acquiring any lock.  This costs memory
+     * proportional to the number of line table rows but makes concurrent
+     * lookups from many threads scale.  The table is released by
+     * drsym_free_resources().  Not supported for Windows PDB symbols.
+     */
+    DRSYM_LINE_INDEX = 0x10,
     DRSYM_DEFAULT_FLAGS = DRSYM_DEMANGLE, /**< Default flags. */
 } drsym_flags_t;
 
@@ -220,6 +230,27 @@ DR_EXPORT
 drsym_error_t
 drsym_exit(void);
 
+DR_EXPORT
+/**
+ * Enables a persistent cache of each module's symbol and line tables in the
+ * directory \p dir, or disables it if \p dir is NULL.  Cache files are named
+ * by the module's build id, so only ELF modules with a build id note are
+ * cached.  The first process to query such a module writes the file on its
+ * first symbol or address lookup (which costs one full read of the module's
+ * symbols and DWARF line table), and later processes map it and look up
+ * symbols via drsym_lookup_symbol() and lines via drsym_lookup_address()
+ * directly from the mapping, without demangling the symbol table or parsing
+ * DWARF.  A file whose module size, debug kind, or
+ * checksum does not match is rewritten.  The directory can be shared by
+ * concurrent processes.  Should be called before any queries.
+ *
+ * @param[in] dir  The cache directory, which must exist.
+ *
+ * \note Not supported on Windows.
+ */
+drsym_error_t
+drsym_set_cache_dir(const char *dir);
+
 DR_EXPORT
 /**
  * Retrieves symbol information for a given module offset.
@@ -239,6 +270,45 @@ drsym_error_t
 drsym_lookup_address(const char *modpath, size_t modoffs, drsym_info_t *info /*INOUT*/,
                      uint flags);
 
+/** One query passed to drsym_lookup_addresses(). */
+typedef struct _drsym_lookup_t {
+    /** The full path to the module to be queried. */
+    const char *modpath;
+    /** The offset from the base of the module of the address to be queried. */
+    size_t modoffs;
+    /**
+     * Information about the symbol at the queried address, as filled in by
+     * drsym_lookup_address().  The caller must set its struct_size and name and
+     * file buffers, which must not be shared with other queries in the batch.
+     */
+    drsym_info_t *info;
+    /** Set to the value drsym_lookup_address() would return for this query. */
+    drsym_error_t result;
+} drsym_lookup_t;
+
+DR_EXPORT
+/**
+ * Performs drsym_lookup_address() for each of \p count queries, in any order
+ * and for any mix of modules, setting each query's \p info and \p result.
+ * Each module is looked up once, and on Linux the queries for it are sorted and
+ * then resolved in a single pass over its symbol table sorted by address, which
+ * is much faster than individual lookups when symbolizing many addresses.  With
+ * #DRSYM_LINE_INDEX in \p flags, line information likewise comes from a single
+ * pass over the module's sorted line table; otherwise each query searches the
+ * DWARF line information as drsym_lookup_address() does.  On Windows this
+ * simply performs each lookup in turn.
+ *
+ * @param[in,out] lookups The queries.
+ * @param[in] count The number of entries in \p lookups.
+ * @param[in] flags Options for the operation as a combination of drsym_flags_t
+ *    values, as for drsym_lookup_address().
+ *
+ * \return DRSYM_SUCCESS if every query was attempted, in which case each
+ * query's \p result holds its outcome.
+ */
+drsym_error_t
+drsym_lookup_addresses(drsym_lookup_t *lookups, size_t count, uint flags);
+
 enum {
     DRSYM_TYPE_OTHER,    /**< Unknown type, cannot downcast. */
     DRSYM_TYPE_INT,      /**< Integer, cast to drsym_int_type_t. */
@@ -662,9 +732,11 @@ DR_EXPORT
  *
  * @param[in] modpath   The full path to the module to be unloaded.
  *
- * \note When called from within a callback for drsym_enumerate_symbols()
- * or drsym_search_symbols(), will fail with DRSYM_ERROR_RECURSIVE as it
- * is not safe to free resources while iterating.
+ * \note On Windows, when called from within a callback for
+ * drsym_enumerate_symbols() or drsym_search_symbols(), will fail with
+ * DRSYM_ERROR_RECURSIVE as it is not safe to free resources while iterating.
+ * Elsewhere, if another query or iteration on the module is in progress, its
+ * resources are freed when that completes.
  */
 drsym_error_t
 drsym_free_resources(const char *modpath);
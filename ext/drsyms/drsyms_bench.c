@@ -32,8 +32,11 @@
 
 /* DRSyms benchmarking standalone app. */
 
-/* This is a standalone app for benchmarking drsyms.  Currently we just time
- * symbol enumeration of an arbitrary object file.
+/* This is a standalone app for benchmarking drsyms.  We time symbol
+ * enumeration of an arbitrary object file, and then address lookups of its
+ * line table entries from several threads at once, with and without
+ * DRSYM_LINE_INDEX.  Last we compare one thread's individual lookups with a
+ * single drsym_lookup_addresses() batch, again with and without the flag.
  */
 
 #include <stdio.h>
@@ -43,6 +46,13 @@
 #include "dr_api.h"
 #include "drsyms.h"
 
+#ifdef UNIX
+#    include <pthread.h>
+#endif
+
+/* Upper bound on the addresses each lookup thread queries. */
+#define MAX_LOOKUP_ADDRS 200000
+
 static char sym_buf[4096];
 
 static int
@@ -58,7 +68,7 @@ usage(const char *msg)
     if (msg != NULL && msg[0] != '\0') {
         dr_fprintf(STDERR, "%s\n", msg);
     }
-    dr_fprintf(STDERR, "usage: bench <modpath>\n");
+    dr_fprintf(STDERR, "usage: bench <modpath> [num_lookup_threads]\n");
     return 1;
 }
 
@@ -103,10 +113,139 @@ enumerate_with_flags(const char *modpath, drsym_flags_t flags)
     dr_printf("Took %d.%03d seconds.\n", (int)(time / 1000), (int)(time % 1000));
 }
 
+typedef struct _lookup_data_t {
+    const char *modpath;
+    size_t *addrs;
+    size_t num_addrs;
+    drsym_flags_t flags;
+    uint64 found;
+} lookup_data_t;
+
+static bool
+line_callback(drsym_line_info_t *info, void *data)
+{
+    lookup_data_t *ld = (lookup_data_t *)data;
+    if (ld->num_addrs < MAX_LOOKUP_ADDRS && info->line_addr != 0)
+        ld->addrs[ld->num_addrs++] = info->line_addr;
+    return true;
+}
+
+#ifdef WINDOWS
+static DWORD WINAPI
+#else
+static void *
+#endif
+lookup_thread(void *arg)
+{
+    lookup_data_t *ld = (lookup_data_t *)arg;
+    char name[256];
+    char file[MAXIMUM_PATH];
+    drsym_info_t info;
+    size_t i;
+    for (i = 0; i < ld->num_addrs; i++) {
+        info.struct_size = sizeof(info);
+        info.name = name;
+        info.name_size = sizeof(name);
+        info.file = file;
+        info.file_size = sizeof(file);
+        if (drsym_lookup_address(ld->modpath, ld->addrs[i], &info, ld->flags) ==
+            DRSYM_SUCCESS)
+            ld->found++;
+    }
+    return 0;
+}
+
+/* Looks up every address in ld->addrs from each of num_threads threads. */
+static void
+lookup_with_threads(lookup_data_t *ld, int num_threads, drsym_flags_t flags)
+{
+    uint64 start, end, time, found = 0;
+    lookup_data_t *per_thread =
+        (lookup_data_t *)dr_global_alloc(num_threads * sizeof(*per_thread));
+#ifdef WINDOWS
+    HANDLE *threads = (HANDLE *)dr_global_alloc(num_threads * sizeof(*threads));
+#else
+    pthread_t *threads = (pthread_t *)dr_global_alloc(num_threads * sizeof(*threads));
+#endif
+    int i;
+
+    dr_printf("Beginning %d-thread lookup of %d addresses%s\n", num_threads,
+              (int)ld->num_addrs,
+              (flags & DRSYM_LINE_INDEX) != 0 ? " with line index" : "");
+    start = dr_get_milliseconds();
+    for (i = 0; i < num_threads; i++) {
+        per_thread[i] = *ld;
+        per_thread[i].flags = flags;
+#ifdef WINDOWS
+        threads[i] = CreateThread(NULL, 0, lookup_thread, &per_thread[i], 0, NULL);
+#else
+        pthread_create(&threads[i], NULL, lookup_thread, &per_thread[i]);
+#endif
+    }
+    for (i = 0; i < num_threads; i++) {
+#ifdef WINDOWS
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+        found += per_thread[i].found;
+    }
+    end = dr_get_milliseconds();
+    time = end - start;
+    dr_printf("Finished lookups: %d with line info.\n", (int)found);
+    dr_printf("Took %d.%03d seconds.\n", (int)(time / 1000), (int)(time % 1000));
+
+    dr_global_free(threads, num_threads * sizeof(*threads));
+    dr_global_free(per_thread, num_threads * sizeof(*per_thread));
+}
+
+/* Looks up every address in ld->addrs with a single batch query. */
+static void
+lookup_batch(lookup_data_t *ld, drsym_flags_t flags)
+{
+    uint64 start, end, time, found = 0;
+    /* The name and file buffers are shared: we only count the results. */
+    char name[256];
+    char file[MAXIMUM_PATH];
+    drsym_lookup_t *lookups =
+        (drsym_lookup_t *)dr_global_alloc(ld->num_addrs * sizeof(*lookups));
+    drsym_info_t *infos = (drsym_info_t *)dr_global_alloc(ld->num_addrs * sizeof(*infos));
+    size_t i;
+
+    dr_printf("Beginning batch lookup of %d addresses%s\n", (int)ld->num_addrs,
+              (flags & DRSYM_LINE_INDEX) != 0 ? " with line index" : "");
+    start = dr_get_milliseconds();
+    for (i = 0; i < ld->num_addrs; i++) {
+        infos[i].struct_size = sizeof(infos[i]);
+        infos[i].name = name;
+        infos[i].name_size = sizeof(name);
+        infos[i].file = file;
+        infos[i].file_size = sizeof(file);
+        lookups[i].modpath = ld->modpath;
+        lookups[i].modoffs = ld->addrs[i];
+        lookups[i].info = &infos[i];
+    }
+    drsym_lookup_addresses(lookups, ld->num_addrs, flags);
+    for (i = 0; i < ld->num_addrs; i++) {
+        if (lookups[i].result == DRSYM_SUCCESS)
+            found++;
+    }
+    end = dr_get_milliseconds();
+    time = end - start;
+    dr_printf("Finished lookups: %d with line info.\n", (int)found);
+    dr_printf("Took %d.%03d seconds.\n", (int)(time / 1000), (int)(time % 1000));
+
+    dr_global_free(infos, ld->num_addrs * sizeof(*infos));
+    dr_global_free(lookups, ld->num_addrs * sizeof(*lookups));
+}
+
 int
 main(int argc, char **argv)
 {
     const char *modpath;
+    int num_threads = 4;
+    lookup_data_t ld;
 #ifdef WINDOWS
     char full_path[2048];
 #endif
@@ -114,10 +253,15 @@ main(int argc, char **argv)
     dr_standalone_init();
     drsym_init(0);
 
-    if (argc != 2) {
+    if (argc != 2 && argc != 3) {
         return usage(NULL);
     }
     modpath = argv[1];
+    if (argc == 3) {
+        num_threads = atoi(argv[2]);
+        if (num_threads <= 0)
+            return usage("Invalid thread count.");
+    }
 #ifdef WINDOWS
     /* Work around i#289. */
     if (GetFullPathName(modpath, sizeof(full_path), full_path, NULL) == 0) {
@@ -135,6 +279,31 @@ main(int argc, char **argv)
     enumerate_with_flags(modpath, DRSYM_DEFAULT_FLAGS);
     enumerate_with_flags(modpath, DRSYM_DEFAULT_FLAGS);
 
+    /* Multi-threaded symbolization of addresses that have line information.
+     * The line index run must come second as once built it serves all lookups.
+     */
+    memset(&ld, 0, sizeof(ld));
+    ld.modpath = modpath;
+    ld.addrs = (size_t *)dr_global_alloc(MAX_LOOKUP_ADDRS * sizeof(*ld.addrs));
+    if (drsym_enumerate_lines(modpath, line_callback, &ld) == DRSYM_SUCCESS &&
+        ld.num_addrs > 0) {
+        lookup_with_threads(&ld, num_threads, DRSYM_DEFAULT_FLAGS);
+        lookup_with_threads(&ld, num_threads, DRSYM_DEFAULT_FLAGS | DRSYM_LINE_INDEX);
+        /* Each of these starts from a freshly loaded module so that the line
+         * index build is counted.
+         */
+        drsym_free_resources(modpath);
+        lookup_with_threads(&ld, 1, DRSYM_DEFAULT_FLAGS);
+        drsym_free_resources(modpath);
+        lookup_batch(&ld, DRSYM_DEFAULT_FLAGS);
+        drsym_free_resources(modpath);
+        lookup_with_threads(&ld, 1, DRSYM_DEFAULT_FLAGS | DRSYM_LINE_INDEX);
+        drsym_free_resources(modpath);
+        lookup_batch(&ld, DRSYM_DEFAULT_FLAGS | DRSYM_LINE_INDEX);
+    } else
+        dr_printf("No line information: skipping lookups.\n");
+    dr_global_free(ld.addrs, MAX_LOOKUP_ADDRS * sizeof(*ld.addrs));
+
     drsym_exit();
     dr_standalone_exit();
 }
@@ -47,6 +47,7 @@
 #    include "libdwarf.h"
 #endif
 
+#include <stdlib.h> /* qsort */
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -128,11 +129,19 @@ static int verbose = 0;
 #    endif
 #endif
 
+typedef struct _sym_range_t {
+    size_t lo_offs;
+    size_t hi_offs;
+    uint idx;
+} sym_range_t;
+
 typedef struct _elf_info_t {
     Elf *elf;
     Elf_Sym *syms;
     int strtab_idx;
     int num_syms;
+    /* The symbols sorted by start, built by drsym_obj_addrsearch_symtab_prepare(). */
+    sym_range_t *ranges;
     byte *map_base;
     ptr_uint_t load_base;
     drsym_debug_kind_t debug_kind;
@@ -361,6 +370,8 @@ drsym_obj_mod_exit(void *mod_in)
         return;
     if (mod->elf != NULL)
         elf_end(mod->elf);
+    if (mod->ranges != NULL)
+        dr_global_free(mod->ranges, mod->num_syms * sizeof(*mod->ranges));
     dr_global_free(mod, sizeof(*mod));
 }
 
@@ -498,6 +509,123 @@ drsym_obj_addrsearch_symtab(void *mod_in, size_t modoffs, uint *idx DR_PARAM_OUT
     return DRSYM_ERROR_SYMBOL_NOT_FOUND;
 }
 
+static int
+sym_range_compare(const void *a_in, const void *b_in)
+{
+    const sym_range_t *a = (const sym_range_t *)a_in;
+    const sym_range_t *b = (const sym_range_t *)b_in;
+    if (a->lo_offs != b->lo_offs)
+        return a->lo_offs < b->lo_offs ? -1 : 1;
+    return a->idx < b->idx ? -1 : (a->idx > b->idx ? 1 : 0);
+}
+
+/* A binary min-heap of positions in ranges, ordered by symbol table index. */
+static void
+range_heap_push(const sym_range_t *ranges, uint *heap, uint *size, uint pos)
+{
+    uint i = (*size)++;
+    while (i > 0) {
+        uint parent = (i - 1) / 2;
+        if (ranges[heap[parent]].idx <= ranges[pos].idx)
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = pos;
+}
+
+static void
+range_heap_pop(const sym_range_t *ranges, uint *heap, uint *size)
+{
+    uint last = heap[--(*size)];
+    uint i = 0;
+    for (;;) {
+        uint child = 2 * i + 1;
+        if (child >= *size)
+            break;
+        if (child + 1 < *size && ranges[heap[child + 1]].idx < ranges[heap[child]].idx)
+            child++;
+        if (ranges[last].idx <= ranges[heap[child]].idx)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (*size > 0)
+        heap[i] = last;
+}
+
+void
+drsym_obj_addrsearch_symtab_prepare(void *mod_in)
+{
+    elf_info_t *mod = (elf_info_t *)mod_in;
+    sym_range_t *ranges;
+    int i;
+    if (mod == NULL || mod->syms == NULL || mod->num_syms == 0 || mod->ranges != NULL)
+        return;
+    ranges = (sym_range_t *)dr_global_alloc(mod->num_syms * sizeof(*ranges));
+    for (i = 0; i < mod->num_syms; i++) {
+        ranges[i].lo_offs = mod->syms[i].st_value - mod->load_base;
+        ranges[i].hi_offs = ranges[i].lo_offs + mod->syms[i].st_size;
+        ranges[i].idx = i;
+    }
+    qsort(ranges, mod->num_syms, sizeof(*ranges), sym_range_compare);
+    mod->ranges = ranges;
+}
+
+drsym_error_t
+drsym_obj_addrsearch_symtab_batch(void *mod_in, const size_t *modoffs, size_t count,
+                                  uint *idx DR_PARAM_OUT)
+{
+    elf_info_t *mod = (elf_info_t *)mod_in;
+    const sym_range_t *ranges;
+    uint *heap, heap_size = 0;
+    size_t q;
+    int next = 0, closest = -1;
+
+    if (mod == NULL || mod->syms == NULL || idx == NULL)
+        return DRSYM_ERROR;
+    ranges = mod->ranges;
+    if (ranges == NULL) {
+        for (q = 0; q < count; q++) {
+            if (drsym_obj_addrsearch_symtab(mod_in, modoffs[q], &idx[q]) != DRSYM_SUCCESS)
+                idx[q] = DRSYM_OBJ_NO_SYMBOL;
+        }
+        return DRSYM_SUCCESS;
+    }
+
+    /* We sweep the sorted queries across the symbols sorted by start, keeping
+     * the symbols that have started in a heap so that the first one in table
+     * order that still contains the query is on top: that is the one the
+     * linear search above finds.
+     */
+    heap = (uint *)dr_global_alloc(mod->num_syms * sizeof(*heap));
+    for (q = 0; q < count; q++) {
+        size_t offs = modoffs[q];
+        while (next < mod->num_syms && ranges[next].lo_offs <= offs) {
+            /* The first of the closest symbols in table order (i#1337). */
+            if (closest < 0 || ranges[next].lo_offs != ranges[closest].lo_offs)
+                closest = next;
+            range_heap_push(ranges, heap, &heap_size, next);
+            next++;
+        }
+        /* Later queries are no lower, so a range that ends here is done. */
+        while (heap_size > 0 && ranges[heap[0]].hi_offs <= offs)
+            range_heap_pop(ranges, heap, &heap_size);
+        if (heap_size > 0)
+            idx[q] = ranges[heap[0]].idx;
+        else if (closest >= 0 && mod->syms[ranges[closest].idx].st_size == 0) {
+            const char *name = drsym_obj_symbol_name(mod_in, ranges[closest].idx);
+            if (name != NULL && name[0] != '\0')
+                idx[q] = ranges[closest].idx;
+            else
+                idx[q] = DRSYM_OBJ_NO_SYMBOL;
+        } else
+            idx[q] = DRSYM_OBJ_NO_SYMBOL;
+    }
+    dr_global_free(heap, mod->num_syms * sizeof(*heap));
+    return DRSYM_SUCCESS;
+}
+
 const char *
 drsym_obj_build_id(void *mod_in)
 {
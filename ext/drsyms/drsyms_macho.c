@@ -614,6 +614,25 @@ drsym_obj_addrsearch_symtab(void *mod_in, size_t modoffs, uint *idx DR_PARAM_OUT
     return DRSYM_ERROR_SYMBOL_NOT_FOUND;
 }
 
+void
+drsym_obj_addrsearch_symtab_prepare(void *mod_in)
+{
+    /* The symbols are sorted at load time. */
+}
+
+drsym_error_t
+drsym_obj_addrsearch_symtab_batch(void *mod_in, const size_t *modoffs, size_t count,
+                                  uint *idx DR_PARAM_OUT)
+{
+    /* The single search is already a binary search. */
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (drsym_obj_addrsearch_symtab(mod_in, modoffs[i], &idx[i]) != DRSYM_SUCCESS)
+            idx[i] = DRSYM_OBJ_NO_SYMBOL;
+    }
+    return DRSYM_SUCCESS;
+}
+
 /******************************************************************************
  * Unix-specific helpers
  */
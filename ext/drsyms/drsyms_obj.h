@@ -107,6 +107,24 @@ drsym_obj_symbol_offs(void *mod_in, uint idx, size_t *offs_start DR_PARAM_OUT,
 drsym_error_t
 drsym_obj_addrsearch_symtab(void *mod_in, size_t modoffs, uint *idx DR_PARAM_OUT);
 
+#define DRSYM_OBJ_NO_SYMBOL ((uint)-1)
+
+/* Builds whatever drsym_obj_addrsearch_symtab_batch() needs beyond the symbol
+ * table, once per module.  Calls must be serialized with each other, but not
+ * with the searches.
+ */
+void
+drsym_obj_addrsearch_symtab_prepare(void *mod_in);
+
+/* Performs drsym_obj_addrsearch_symtab() for each of the count entries of
+ * modoffs, which must be sorted in increasing order, storing the result in the
+ * corresponding entry of idx, or DRSYM_OBJ_NO_SYMBOL if not found.  Without
+ * drsym_obj_addrsearch_symtab_prepare() this may fall back to a search per query.
+ */
+drsym_error_t
+drsym_obj_addrsearch_symtab_batch(void *mod_in, const size_t *modoffs, size_t count,
+                                  uint *idx DR_PARAM_OUT);
+
 bool
 drsym_obj_same_file(const char *path1, const char *path2);
 
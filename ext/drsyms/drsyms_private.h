@@ -53,7 +53,8 @@
         }                                    \
     } while (0)
 
-#define UNSUPPORTED_PDB_FLAGS (DRSYM_DEMANGLE_FULL | DRSYM_LEAVE_MANGLED)
+#define UNSUPPORTED_PDB_FLAGS \
+    (DRSYM_DEMANGLE_FULL | DRSYM_LEAVE_MANGLED | DRSYM_LINE_INDEX)
 #define UNSUPPORTED_NONPDB_FLAGS (DRSYM_DEMANGLE_PDB_TEMPLATES | DRSYM_FULL_SEARCH)
 
 /* Memory pool that uses externally allocated memory.
@@ -91,6 +92,9 @@ drsym_unix_init(void);
 void
 drsym_unix_exit(void);
 
+bool
+drsym_unix_set_cache_dir(const char *dir);
+
 void *
 drsym_unix_load(const char *modpath);
 
@@ -101,6 +105,11 @@ drsym_error_t
 drsym_unix_lookup_address(void *moddata, size_t modoffs, drsym_info_t *out DR_PARAM_INOUT,
                           uint flags);
 
+/* The entries of lookups must all be for moddata and sorted by modoffs. */
+void
+drsym_unix_lookup_addresses(void *moddata, drsym_lookup_t **lookups, size_t count,
+                            uint flags);
+
 drsym_error_t
 drsym_unix_lookup_symbol(void *moddata, const char *symbol, size_t *modoffs DR_PARAM_OUT,
                          uint flags);
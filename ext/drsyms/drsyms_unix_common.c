@@ -43,6 +43,7 @@
 #include <string.h> /* strlen */
 #include <errno.h>
 #include <stddef.h> /* offsetof */
+#include <stdlib.h> /* qsort */
 
 #include "demangle.h"
 #ifdef DRSYM_HAVE_LIBELFTC
@@ -58,6 +59,63 @@
 /* For debugging */
 static bool verbose = false;
 
+typedef struct _line_entry_t {
+    size_t modoffs;
+    const char *file; /* Owned by dbg_module_t.line_files. */
+    uint line;
+    /* Enumeration order, to keep the last of several entries at one address. */
+    uint seq;
+} line_entry_t;
+
+enum {
+    LINE_INDEX_NONE,
+    LINE_INDEX_READY,
+    LINE_INDEX_FAILED,
+};
+
+/* Layout of an on-disk cache file (see drsym_set_cache_dir()): the header, then
+ * the symbol array, then the line array, then the string table.  Values are in
+ * host byte order: a file from a host of the other endianness fails the magic
+ * check.
+ */
+#define CACHE_MAGIC 0x43535244 /* "DRSC" */
+#define CACHE_VERSION 1
+#define CACHE_SUFFIX ".drsymcache"
+
+typedef struct _cache_header_t {
+    uint magic;
+    uint version;
+    /* The cache is only used for a module of the same size and debug kind, so
+     * that a stripped and an unstripped build with the same id do not mix.
+     */
+    uint64 module_size;
+    uint debug_kind;
+    uint has_lines;
+    uint num_syms;
+    uint num_lines;
+    uint64 strtab_size;
+    /* FNV-1a hash of everything after the header. */
+    uint64 checksum;
+} cache_header_t;
+
+/* What drsym_lookup_symbol() matches, i.e., the contents of
+ * dbg_module_t.symtable, sorted by name.
+ */
+typedef struct _cache_sym_t {
+    uint64 modoffs;
+    uint name; /* Offset into the string table. */
+    uint unused;
+} cache_sym_t;
+
+/* The line table as built for DRSYM_LINE_INDEX. */
+typedef struct _cache_line_t {
+    uint64 modoffs;
+    uint file; /* Offset into the string table, or CACHE_NO_FILE. */
+    uint line;
+} cache_line_t;
+
+#define CACHE_NO_FILE 0xffffffff
+
 typedef struct _dbg_module_t {
     file_t fd;
     size_t file_size;
@@ -73,8 +131,39 @@ typedef struct _dbg_module_t {
     struct _dbg_module_t *mod_with_dwarf;
 #define SYMTABLE_HASH_BITS 12
     hashtable_t symtable;
+    /* Set once symtable is filled, after which it is read without the lock. */
+    volatile int symtable_ready;
+    /* Set once drsym_obj_addrsearch_symtab_prepare() has run for batch lookups. */
+    volatile int addrsearch_ready;
+    /* Guards the DWARF library state (which caches the last CU searched), the
+     * filling of symtable and the other lazily built tables.  It is recursive
+     * as enumeration callbacks may issue queries on the same module.
+     */
+    void *lock;
+    /* The optional sorted line table (see DRSYM_LINE_INDEX).  It is immutable
+     * once line_index_state is LINE_INDEX_READY, and is then searched without
+     * acquiring the lock.
+     */
+    volatile int line_index_state;
+    line_entry_t *line_index;
+    size_t line_index_count;
+    size_t line_index_capacity;
+#define LINE_FILE_HASH_BITS 8
+    hashtable_t line_files;
+    /* Set once the first query has looked for the cache file (and written it
+     * if missing), which is done under the lock.
+     */
+    volatile int cache_attached;
+    /* The mapped, validated cache file, if any.  It replaces symtable and
+     * line_index and is read without the lock once cache_attached is set.
+     */
+    byte *cache_base;
+    size_t cache_map_size;
 } dbg_module_t;
 
+/* Where cache files are read and written.  Empty if caching is disabled. */
+static char cache_dir[MAXIMUM_PATH];
+
 /******************************************************************************
  * Forward declarations.
  */
@@ -100,7 +189,7 @@ load_module(const char *modpath)
     uint64 file_size;
 
     /* static depth count to prevent stack overflow from circular .gnu_debuglink
-     * sections.  We're protected by symbol_lock.
+     * sections.  The frontend serializes loads.
      */
     static int load_module_depth;
 
@@ -115,6 +204,7 @@ load_module(const char *modpath)
     /* Alloc and zero the struct so it can be unloaded safely in case of error. */
     mod = dr_global_alloc(sizeof(*mod));
     memset(mod, 0, sizeof(*mod));
+    mod->lock = dr_recurlock_create();
 
     mod->fd = dr_open_file(modpath, DR_FILE_READ);
     if (mod->fd == INVALID_FILE) {
@@ -331,6 +421,14 @@ unload_module(dbg_module_t *mod)
         drsym_obj_mod_exit(mod->obj_info);
     if (mod->symtable.table != NULL)
         hashtable_delete(&mod->symtable);
+    if (mod->line_index != NULL)
+        dr_global_free(mod->line_index, mod->line_index_capacity * sizeof(line_entry_t));
+    if (mod->line_files.table != NULL)
+        hashtable_delete(&mod->line_files);
+    if (mod->lock != NULL)
+        dr_recurlock_destroy(mod->lock);
+    if (mod->cache_base != NULL)
+        dr_unmap_file(mod->cache_base, mod->cache_map_size);
     if (mod->map_base != NULL)
         dr_unmap_file(mod->map_base, mod->map_size);
     if (mod->fd != INVALID_FILE)
@@ -434,16 +532,11 @@ symsearch_symtab(dbg_module_t *mod, drsym_enumerate_cb callback,
 }
 
 static drsym_error_t
-addrsearch_symtab(dbg_module_t *mod, size_t modoffs, drsym_info_t *info DR_PARAM_INOUT,
-                  uint flags)
+fill_symbol_info(dbg_module_t *mod, uint idx, drsym_info_t *info DR_PARAM_INOUT,
+                 uint flags)
 {
     const char *symbol;
     size_t name_len = 0;
-    uint idx;
-    drsym_error_t res = drsym_obj_addrsearch_symtab(mod->obj_info, modoffs, &idx);
-
-    if (res != DRSYM_SUCCESS)
-        return res;
 
     symbol = drsym_obj_symbol_name(mod->obj_info, idx);
     if (symbol == NULL)
@@ -466,6 +559,17 @@ addrsearch_symtab(dbg_module_t *mod, size_t modoffs, drsym_info_t *info DR_PARAM
     return drsym_obj_symbol_offs(mod->obj_info, idx, &info->start_offs, &info->end_offs);
 }
 
+static drsym_error_t
+addrsearch_symtab(dbg_module_t *mod, size_t modoffs, drsym_info_t *info DR_PARAM_INOUT,
+                  uint flags)
+{
+    uint idx;
+    drsym_error_t res = drsym_obj_addrsearch_symtab(mod->obj_info, modoffs, &idx);
+    if (res != DRSYM_SUCCESS)
+        return res;
+    return fill_symbol_info(mod, idx, info, flags);
+}
+
 /******************************************************************************
  * Hashtable building for symbol lookup.
  *
@@ -581,6 +685,508 @@ drsym_fill_symtable_cb(const char *sym, size_t modoffs, void *data DR_PARAM_OUT)
     return true;
 }
 
+static void
+fill_symtable(dbg_module_t *mod)
+{
+    if (dr_atomic_load32(&mod->symtable_ready) != 0)
+        return;
+    dr_recurlock_lock(mod->lock);
+    if (mod->symtable_ready == 0) {
+        symsearch_symtab(mod, drsym_fill_symtable_cb, NULL, sizeof(drsym_info_t), mod,
+                         DRSYM_LEAVE_MANGLED);
+        dr_atomic_store32(&mod->symtable_ready, 1);
+    }
+    dr_recurlock_unlock(mod->lock);
+}
+
+static void
+prepare_addrsearch(dbg_module_t *mod)
+{
+    if (dr_atomic_load32(&mod->addrsearch_ready) != 0)
+        return;
+    dr_recurlock_lock(mod->lock);
+    if (mod->addrsearch_ready == 0) {
+        drsym_obj_addrsearch_symtab_prepare(mod->obj_info);
+        dr_atomic_store32(&mod->addrsearch_ready, 1);
+    }
+    dr_recurlock_unlock(mod->lock);
+}
+
+/******************************************************************************
+ * Sorted line table, for lookups that avoid the DWARF library and its lock.
+ *
+ * We copy every row of the module's line table into one array sorted by
+ * module offset.  Each address maps to the last row at or below it, which is
+ * what the per-CU search in drsyms_dw.c and drsyms_dwarf.c finds.
+ */
+
+static void
+line_strings_init(hashtable_t *strings)
+{
+    hashtable_config_t config;
+    hashtable_init_ex(strings, LINE_FILE_HASH_BITS, HASH_STRING, false /*strdup*/,
+                      false /*!synch*/, NULL, NULL, NULL);
+    config.size = sizeof(config);
+    config.resizable = true;
+    config.resize_threshold = 70;
+    config.free_key_func = drsym_free_hash_key;
+    hashtable_configure(strings, &config);
+}
+
+/* The file strings are shared by many rows, so we keep one copy of each. */
+static const char *
+line_string_intern(hashtable_t *strings, const char *str)
+{
+    char *copy;
+    size_t len;
+    if (str == NULL)
+        return NULL;
+    copy = (char *)hashtable_lookup(strings, (void *)str);
+    if (copy != NULL)
+        return copy;
+    len = strlen(str);
+    copy = __wrap_malloc(len + 1);
+    memcpy(copy, str, len + 1);
+    hashtable_add(strings, copy, copy);
+    return copy;
+}
+
+static bool
+line_index_add_cb(drsym_line_info_t *info, void *data)
+{
+    dbg_module_t *mod = (dbg_module_t *)data;
+    line_entry_t *entry;
+    if (mod->line_index_count == mod->line_index_capacity) {
+        size_t new_cap =
+            mod->line_index_capacity == 0 ? 1024 : mod->line_index_capacity * 2;
+        line_entry_t *grown =
+            (line_entry_t *)dr_global_alloc(new_cap * sizeof(line_entry_t));
+        if (mod->line_index != NULL) {
+            memcpy(grown, mod->line_index, mod->line_index_count * sizeof(line_entry_t));
+            dr_global_free(mod->line_index,
+                           mod->line_index_capacity * sizeof(line_entry_t));
+        }
+        mod->line_index = grown;
+        mod->line_index_capacity = new_cap;
+    }
+    entry = &mod->line_index[mod->line_index_count];
+    entry->modoffs = info->line_addr;
+    entry->line = (uint)info->line;
+    entry->seq = (uint)mod->line_index_count;
+    entry->file = line_string_intern(&mod->line_files, info->file);
+    mod->line_index_count++;
+    return true;
+}
+
+static int
+line_entry_compare(const void *a_in, const void *b_in)
+{
+    const line_entry_t *a = (const line_entry_t *)a_in;
+    const line_entry_t *b = (const line_entry_t *)b_in;
+    if (a->modoffs != b->modoffs)
+        return a->modoffs < b->modoffs ? -1 : 1;
+    return a->seq < b->seq ? -1 : (a->seq > b->seq ? 1 : 0);
+}
+
+/* Builds mod's line table if it has not been attempted yet.  Returns whether it
+ * is available.
+ */
+static bool
+line_index_build(dbg_module_t *mod, dbg_module_t *mod4line)
+{
+    size_t i, kept;
+    if (dr_atomic_load32(&mod->line_index_state) == LINE_INDEX_READY)
+        return true;
+    dr_recurlock_lock(mod->lock);
+    if (mod->line_index_state != LINE_INDEX_NONE) {
+        dr_recurlock_unlock(mod->lock);
+        return mod->line_index_state == LINE_INDEX_READY;
+    }
+    line_strings_init(&mod->line_files);
+    if (drsym_dwarf_enumerate_lines(mod4line->dwarf_info, line_index_add_cb, mod) !=
+            DRSYM_SUCCESS ||
+        mod->line_index_count == 0) {
+        NOTIFY("%s: failed to build line index\n", __FUNCTION__);
+        dr_atomic_store32(&mod->line_index_state, LINE_INDEX_FAILED);
+        dr_recurlock_unlock(mod->lock);
+        return false;
+    }
+    qsort(mod->line_index, mod->line_index_count, sizeof(line_entry_t),
+          line_entry_compare);
+    /* Of several rows at one address only the last can be found. */
+    kept = 0;
+    for (i = 0; i < mod->line_index_count; i++) {
+        if (kept > 0 && mod->line_index[kept - 1].modoffs == mod->line_index[i].modoffs)
+            kept--;
+        mod->line_index[kept++] = mod->line_index[i];
+    }
+    mod->line_index_count = kept;
+    NOTIFY("%s: %d line entries, %d files\n", __FUNCTION__, (int)kept,
+           (int)mod->line_files.entries);
+    /* Publish only once the table is complete. */
+    dr_atomic_store32(&mod->line_index_state, LINE_INDEX_READY);
+    dr_recurlock_unlock(mod->lock);
+    return true;
+}
+
+/* Fills in the line fields of out the same way drsym_dwarf_search_addr2line()
+ * does, given the row at or below modoffs, if any.
+ */
+static bool
+fill_line_info(size_t modoffs, size_t line_modoffs, const char *file, uint line,
+               drsym_info_t *out DR_PARAM_OUT)
+{
+    if (file == NULL) {
+        out->file_available_size = 0;
+        if (out->file != NULL)
+            out->file[0] = '\0';
+        out->line = 0;
+        out->line_offs = 0;
+        return false;
+    }
+    out->file_available_size = strlen(file);
+    if (out->file != NULL) {
+        strncpy(out->file, file, out->file_size);
+        out->file[out->file_size - 1] = '\0';
+    }
+    out->line = line;
+    out->line_offs = modoffs - line_modoffs;
+    return true;
+}
+
+/* The caller must have observed LINE_INDEX_READY. */
+static bool
+line_index_search(dbg_module_t *mod, size_t modoffs, drsym_info_t *out DR_PARAM_OUT)
+{
+    size_t lo = 0, hi = mod->line_index_count;
+    const line_entry_t *entry;
+    /* Find the first entry above modoffs: the one before it contains modoffs. */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (mod->line_index[mid].modoffs <= modoffs)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return fill_line_info(modoffs, 0, NULL, 0, out);
+    entry = &mod->line_index[lo - 1];
+    return fill_line_info(modoffs, entry->modoffs, entry->file, entry->line, out);
+}
+
+/******************************************************************************
+ * On-disk cache of the symbol and line tables, keyed by build id.
+ *
+ * Filling symtable demangles every symbol and building the line table walks all
+ * of the DWARF line programs.  Processes that load the same library can instead
+ * map a cache file written by the first of them, which is searched in place.
+ */
+
+static uint64
+cache_hash(uint64 hash, const void *data, size_t size)
+{
+    const byte *p = (const byte *)data;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#define CACHE_HASH_INIT 0xcbf29ce484222325ULL
+
+static const cache_sym_t *
+cache_syms(const cache_header_t *header)
+{
+    return (const cache_sym_t *)(header + 1);
+}
+
+static const cache_line_t *
+cache_lines(const cache_header_t *header)
+{
+    return (const cache_line_t *)(cache_syms(header) + header->num_syms);
+}
+
+static const char *
+cache_strtab(const cache_header_t *header)
+{
+    return (const char *)(cache_lines(header) + header->num_lines);
+}
+
+/* Returns 0 if symbol is not present. */
+static size_t
+cache_lookup_symbol(dbg_module_t *mod, const char *symbol)
+{
+    const cache_header_t *header = (const cache_header_t *)mod->cache_base;
+    const cache_sym_t *syms = cache_syms(header);
+    const char *strtab = cache_strtab(header);
+    size_t lo = 0, hi = header->num_syms;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(strtab + syms[mid].name, symbol);
+        if (cmp == 0)
+            return (size_t)syms[mid].modoffs;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return 0;
+}
+
+static bool
+cache_search_line(dbg_module_t *mod, size_t modoffs, drsym_info_t *out DR_PARAM_OUT)
+{
+    const cache_header_t *header = (const cache_header_t *)mod->cache_base;
+    const cache_line_t *lines = cache_lines(header);
+    size_t lo = 0, hi = header->num_lines;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lines[mid].modoffs <= modoffs)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 || lines[lo - 1].file == CACHE_NO_FILE)
+        return fill_line_info(modoffs, 0, NULL, 0, out);
+    return fill_line_info(modoffs, (size_t)lines[lo - 1].modoffs,
+                          cache_strtab(header) + lines[lo - 1].file, lines[lo - 1].line,
+                          out);
+}
+
+static bool
+cache_validate(dbg_module_t *mod, const byte *base, uint64 file_size)
+{
+    const cache_header_t *header = (const cache_header_t *)base;
+    const cache_sym_t *syms;
+    const cache_line_t *lines;
+    uint64 checksum;
+    uint i;
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION ||
+        header->module_size != mod->file_size || header->debug_kind != mod->debug_kind)
+        return false;
+    if (sizeof(*header) + (uint64)header->num_syms * sizeof(cache_sym_t) +
+            (uint64)header->num_lines * sizeof(cache_line_t) + header->strtab_size !=
+        file_size)
+        return false;
+    checksum = cache_hash(CACHE_HASH_INIT, header + 1,
+                          (size_t)(file_size - sizeof(*header)));
+    if (checksum != header->checksum)
+        return false;
+    if (header->strtab_size > 0 &&
+        cache_strtab(header)[header->strtab_size - 1] != '\0')
+        return false;
+    syms = cache_syms(header);
+    for (i = 0; i < header->num_syms; i++) {
+        if (syms[i].name >= header->strtab_size)
+            return false;
+    }
+    lines = cache_lines(header);
+    for (i = 0; i < header->num_lines; i++) {
+        if (lines[i].file != CACHE_NO_FILE && lines[i].file >= header->strtab_size)
+            return false;
+    }
+    return true;
+}
+
+static bool
+cache_map(dbg_module_t *mod, const char *path)
+{
+    file_t fd = dr_open_file(path, DR_FILE_READ);
+    uint64 file_size;
+    size_t map_size;
+    byte *base;
+    if (fd == INVALID_FILE)
+        return false;
+    if (!dr_file_size(fd, &file_size) || file_size < sizeof(cache_header_t)) {
+        dr_close_file(fd);
+        return false;
+    }
+    map_size = (size_t)file_size;
+    base = (byte *)dr_map_file(fd, &map_size, 0, NULL, DR_MEMPROT_READ, DR_MAP_PRIVATE);
+    dr_close_file(fd);
+    if (base == NULL)
+        return false;
+    if (map_size < file_size || !cache_validate(mod, base, file_size)) {
+        NOTIFY("%s: ignoring stale or corrupt %s\n", __FUNCTION__, path);
+        dr_unmap_file(base, map_size);
+        return false;
+    }
+    mod->cache_base = base;
+    mod->cache_map_size = map_size;
+    return true;
+}
+
+static int
+cache_sym_compare(const void *a_in, const void *b_in)
+{
+    const hash_entry_t *a = *(const hash_entry_t **)a_in;
+    const hash_entry_t *b = *(const hash_entry_t **)b_in;
+    return strcmp((const char *)a->key, (const char *)b->key);
+}
+
+static bool
+cache_write_buf(file_t fd, const void *buf, size_t size)
+{
+    return size == 0 || dr_write_file(fd, buf, size) == (ssize_t)size;
+}
+
+/* Fills symtable and the line table and writes them to path.  Another process
+ * may be writing the same file, so we write to a private name and rename.
+ */
+static bool
+cache_write(dbg_module_t *mod, const char *path)
+{
+    dbg_module_t *mod4line = mod->mod_with_dwarf != NULL ? mod->mod_with_dwarf : mod;
+    cache_header_t header;
+    hash_entry_t **sorted = NULL;
+    cache_sym_t *syms = NULL;
+    cache_line_t *lines = NULL;
+    char *strtab = NULL;
+    size_t syms_size, lines_size, strtab_size = 0, pos = 0, count = 0, i;
+    hashtable_t file_offs;
+    char tmp_path[MAXIMUM_PATH];
+    file_t fd;
+    bool ok = false;
+
+    fill_symtable(mod);
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.module_size = mod->file_size;
+    header.debug_kind = mod->debug_kind;
+    header.has_lines =
+        mod4line->dwarf_info != NULL && line_index_build(mod, mod4line) ? 1 : 0;
+    header.num_syms = mod->symtable.entries;
+    header.num_lines = header.has_lines ? (uint)mod->line_index_count : 0;
+    syms_size = header.num_syms * sizeof(cache_sym_t);
+    lines_size = header.num_lines * sizeof(cache_line_t);
+
+    for (i = 0; i < HASHTABLE_SIZE(mod->symtable.table_bits); i++) {
+        hash_entry_t *e;
+        for (e = mod->symtable.table[i]; e != NULL; e = e->next)
+            strtab_size += strlen((const char *)e->key) + 1;
+    }
+    if (header.has_lines) {
+        for (i = 0; i < HASHTABLE_SIZE(mod->line_files.table_bits); i++) {
+            hash_entry_t *e;
+            for (e = mod->line_files.table[i]; e != NULL; e = e->next)
+                strtab_size += strlen((const char *)e->key) + 1;
+        }
+    }
+    if (strtab_size >= CACHE_NO_FILE) {
+        NOTIFY("%s: too many symbols to cache\n", __FUNCTION__);
+        return false;
+    }
+    header.strtab_size = strtab_size;
+
+    hashtable_init_ex(&file_offs, LINE_FILE_HASH_BITS, HASH_INTPTR, false /*strdup*/,
+                      false /*!synch*/, NULL, NULL, NULL);
+    if (strtab_size > 0)
+        strtab = (char *)dr_global_alloc(strtab_size);
+    if (header.num_syms > 0) {
+        sorted = (hash_entry_t **)dr_global_alloc(header.num_syms * sizeof(*sorted));
+        for (i = 0; i < HASHTABLE_SIZE(mod->symtable.table_bits); i++) {
+            hash_entry_t *e;
+            for (e = mod->symtable.table[i]; e != NULL; e = e->next)
+                sorted[count++] = e;
+        }
+        qsort(sorted, count, sizeof(*sorted), cache_sym_compare);
+        syms = (cache_sym_t *)dr_global_alloc(syms_size);
+        for (i = 0; i < count; i++) {
+            size_t len = strlen((const char *)sorted[i]->key) + 1;
+            syms[i].modoffs = (uint64)(ptr_uint_t)sorted[i]->payload;
+            syms[i].name = (uint)pos;
+            syms[i].unused = 0;
+            memcpy(strtab + pos, sorted[i]->key, len);
+            pos += len;
+        }
+    }
+    if (header.num_lines > 0) {
+        for (i = 0; i < HASHTABLE_SIZE(mod->line_files.table_bits); i++) {
+            hash_entry_t *e;
+            for (e = mod->line_files.table[i]; e != NULL; e = e->next) {
+                size_t len = strlen((const char *)e->key) + 1;
+                /* Store offset+1 as a 0 payload means absent. */
+                hashtable_add(&file_offs, e->key, (void *)(ptr_uint_t)(pos + 1));
+                memcpy(strtab + pos, e->key, len);
+                pos += len;
+            }
+        }
+        lines = (cache_line_t *)dr_global_alloc(lines_size);
+        for (i = 0; i < header.num_lines; i++) {
+            const line_entry_t *entry = &mod->line_index[i];
+            lines[i].modoffs = entry->modoffs;
+            if (entry->file == NULL)
+                lines[i].file = CACHE_NO_FILE;
+            else {
+                lines[i].file =
+                    (uint)(ptr_uint_t)hashtable_lookup(&file_offs, (void *)entry->file) -
+                    1;
+            }
+            lines[i].line = entry->line;
+        }
+    }
+    header.checksum = cache_hash(CACHE_HASH_INIT, syms, syms_size);
+    header.checksum = cache_hash(header.checksum, lines, lines_size);
+    header.checksum = cache_hash(header.checksum, strtab, strtab_size);
+
+    dr_snprintf(tmp_path, MAXIMUM_PATH, "%s.%d.tmp", path, (int)dr_get_process_id());
+    NULL_TERMINATE_BUFFER(tmp_path);
+    fd = dr_open_file(tmp_path, DR_FILE_WRITE_OVERWRITE);
+    if (fd != INVALID_FILE) {
+        ok = cache_write_buf(fd, &header, sizeof(header)) &&
+            cache_write_buf(fd, syms, syms_size) &&
+            cache_write_buf(fd, lines, lines_size) &&
+            cache_write_buf(fd, strtab, strtab_size);
+        dr_close_file(fd);
+        if (ok)
+            ok = dr_rename_file(tmp_path, path, true /*replace*/);
+        if (!ok)
+            dr_delete_file(tmp_path);
+    }
+    NOTIFY("%s: %s %s\n", __FUNCTION__, ok ? "wrote" : "failed to write", path);
+
+    hashtable_delete(&file_offs);
+    if (sorted != NULL)
+        dr_global_free(sorted, header.num_syms * sizeof(*sorted));
+    if (syms != NULL)
+        dr_global_free(syms, syms_size);
+    if (lines != NULL)
+        dr_global_free(lines, lines_size);
+    if (strtab != NULL)
+        dr_global_free(strtab, strtab_size);
+    return ok;
+}
+
+/* Maps the module's cache file, or writes it if there is none, on the first
+ * query.  This is not done at load time as the frontend loads modules with its
+ * table lock held, and filling the tables for the file takes a while.
+ */
+static void
+cache_attach(dbg_module_t *mod)
+{
+    char path[MAXIMUM_PATH];
+    const char *build_id;
+    if (dr_atomic_load32(&mod->cache_attached) != 0)
+        return;
+    dr_recurlock_lock(mod->lock);
+    build_id = drsym_obj_build_id(mod->obj_info);
+    if (mod->cache_attached == 0 && cache_dir[0] != '\0' && build_id != NULL &&
+        build_id[0] != '\0') {
+        dr_snprintf(path, MAXIMUM_PATH, "%s/%s" CACHE_SUFFIX, cache_dir, build_id);
+        NULL_TERMINATE_BUFFER(path);
+        if (cache_map(mod, path))
+            NOTIFY("%s: using %s\n", __FUNCTION__, path);
+        else
+            cache_write(mod, path);
+    }
+    /* Publish cache_base. */
+    dr_atomic_store32(&mod->cache_attached, 1);
+    dr_recurlock_unlock(mod->lock);
+}
+
 /******************************************************************************
  * Exports
  */
@@ -597,6 +1203,20 @@ drsym_unix_exit(void)
     /* nothing */
 }
 
+bool
+drsym_unix_set_cache_dir(const char *dir)
+{
+    if (dir == NULL || dir[0] == '\0') {
+        cache_dir[0] = '\0';
+        return true;
+    }
+    if (strlen(dir) >= BUFFER_SIZE_ELEMENTS(cache_dir) || !dr_directory_exists(dir))
+        return false;
+    strncpy(cache_dir, dir, BUFFER_SIZE_ELEMENTS(cache_dir));
+    NULL_TERMINATE_BUFFER(cache_dir);
+    return true;
+}
+
 void *
 drsym_unix_load(const char *modpath)
 {
@@ -646,6 +1266,7 @@ drsym_unix_lookup_symbol(void *mod_in, const char *symbol, size_t *modoffs DR_PA
     }
 
     *modoffs = 0;
+    cache_attach(mod);
 
     if (!TESTANY(DRSYM_SYMBOLS, mod->debug_kind)) {
         /* XXX i#883: we have no symbols and we're just looking at exports so we
@@ -656,12 +1277,10 @@ drsym_unix_lookup_symbol(void *mod_in, const char *symbol, size_t *modoffs DR_PA
          */
     }
 
-    if (*modoffs == 0) {
-        if (mod->symtable.entries == 0) {
-            /* Initialize the hashtable. */
-            symsearch_symtab(mod, drsym_fill_symtable_cb, NULL, sizeof(drsym_info_t), mod,
-                             DRSYM_LEAVE_MANGLED);
-        }
+    if (*modoffs == 0 && mod->cache_base != NULL)
+        *modoffs = cache_lookup_symbol(mod, sym_no_mod);
+    else if (*modoffs == 0) {
+        fill_symtable(mod);
         *modoffs = (size_t)hashtable_lookup(&mod->symtable, (void *)sym_no_mod);
     }
     if (*modoffs == 0)
@@ -669,12 +1288,40 @@ drsym_unix_lookup_symbol(void *mod_in, const char *symbol, size_t *modoffs DR_PA
     return DRSYM_SUCCESS;
 }
 
+/* Searches DWARF directly, for when there is no line table. */
+static bool
+dwarf_search_line(dbg_module_t *mod, dbg_module_t *mod4line, size_t modoffs,
+                  drsym_info_t *out DR_PARAM_OUT)
+{
+    bool found;
+    dr_recurlock_lock(mod->lock);
+    found = drsym_dwarf_search_addr2line(
+        mod4line->dwarf_info,
+        (Dwarf_Addr)(ptr_uint_t)(drsym_obj_load_base(mod->obj_info) + modoffs), out);
+    dr_recurlock_unlock(mod->lock);
+    return found;
+}
+
+static void
+finish_address_info(dbg_module_t *mod, drsym_info_t *out DR_PARAM_INOUT, uint flags)
+{
+    out->debug_kind = mod->debug_kind;
+    /* Fields beyond name require compatibility checks */
+    if (out->struct_size > offsetof(drsym_info_t, flags)) {
+        /* Remove unsupported flags */
+        out->flags = flags & ~(UNSUPPORTED_NONPDB_FLAGS);
+    }
+}
+
 drsym_error_t
 drsym_unix_lookup_address(void *mod_in, size_t modoffs, drsym_info_t *out DR_PARAM_INOUT,
                           uint flags)
 {
     dbg_module_t *mod = (dbg_module_t *)mod_in;
-    drsym_error_t r = addrsearch_symtab(mod, modoffs, out, flags);
+    drsym_error_t r;
+
+    cache_attach(mod);
+    r = addrsearch_symtab(mod, modoffs, out, flags);
 
     /* If we did find an address for the symbol, go look for its line number
      * information.
@@ -685,24 +1332,141 @@ drsym_unix_lookup_address(void *mod_in, size_t modoffs, drsym_info_t *out DR_PAR
          * least have the name of the function.
          */
         dbg_module_t *mod4line = mod;
+        bool found;
         if (mod->mod_with_dwarf != NULL)
             mod4line = mod->mod_with_dwarf;
-        if (mod4line->dwarf_info == NULL ||
-            !drsym_dwarf_search_addr2line(
-                mod4line->dwarf_info,
-                (Dwarf_Addr)(ptr_uint_t)(drsym_obj_load_base(mod->obj_info) + modoffs),
-                out)) {
+        if (mod->cache_base != NULL &&
+            ((const cache_header_t *)mod->cache_base)->has_lines)
+            found = cache_search_line(mod, modoffs, out);
+        else if (mod4line->dwarf_info == NULL)
+            found = false;
+        else if (dr_atomic_load32(&mod->line_index_state) == LINE_INDEX_READY ||
+                 (TESTANY(DRSYM_LINE_INDEX, flags) && line_index_build(mod, mod4line)))
+            found = line_index_search(mod, modoffs, out);
+        else
+            found = dwarf_search_line(mod, mod4line, modoffs, out);
+        if (!found)
             r = DRSYM_ERROR_LINE_NOT_AVAILABLE;
+    }
+
+    finish_address_info(mod, out, flags);
+    return r;
+}
+
+void
+drsym_unix_lookup_addresses(void *mod_in, drsym_lookup_t **lookups, size_t count,
+                            uint flags)
+{
+    dbg_module_t *mod = (dbg_module_t *)mod_in;
+    dbg_module_t *mod4line = mod->mod_with_dwarf != NULL ? mod->mod_with_dwarf : mod;
+    const cache_header_t *cache;
+    const cache_line_t *cache_line = NULL;
+    size_t *offs = (size_t *)dr_global_alloc(count * sizeof(*offs));
+    uint *idx = (uint *)dr_global_alloc(count * sizeof(*idx));
+    size_t i, num_lines = 0, line_pos = 0;
+    drsym_error_t res;
+
+    cache_attach(mod);
+    cache = (const cache_header_t *)mod->cache_base;
+    /* Rather than a search per query, the sorted queries are merged with the
+     * sorted line table when there is one.  As for single lookups we only build
+     * it for DRSYM_LINE_INDEX: otherwise each query searches DWARF, which for
+     * sorted queries mostly hits its cached CU.
+     */
+    if (cache != NULL && cache->has_lines) {
+        cache_line = cache_lines(cache);
+        num_lines = cache->num_lines;
+    } else if (mod4line->dwarf_info != NULL &&
+               (dr_atomic_load32(&mod->line_index_state) == LINE_INDEX_READY ||
+                (TESTANY(DRSYM_LINE_INDEX, flags) && line_index_build(mod, mod4line))))
+        num_lines = mod->line_index_count;
+
+    for (i = 0; i < count; i++)
+        offs[i] = lookups[i]->modoffs;
+    prepare_addrsearch(mod);
+    res = drsym_obj_addrsearch_symtab_batch(mod->obj_info, offs, count, idx);
+
+    for (i = 0; i < count; i++) {
+        drsym_info_t *out = lookups[i]->info;
+        drsym_error_t r = res;
+        if (r == DRSYM_SUCCESS) {
+            if (idx[i] == DRSYM_OBJ_NO_SYMBOL)
+                r = DRSYM_ERROR_SYMBOL_NOT_FOUND;
+            else
+                r = fill_symbol_info(mod, idx[i], out, flags);
+        }
+        if (r == DRSYM_SUCCESS) {
+            bool found;
+            if (cache_line != NULL) {
+                while (line_pos < num_lines && cache_line[line_pos].modoffs <= offs[i])
+                    line_pos++;
+                if (line_pos == 0 || cache_line[line_pos - 1].file == CACHE_NO_FILE)
+                    found = fill_line_info(offs[i], 0, NULL, 0, out);
+                else {
+                    const cache_line_t *entry = &cache_line[line_pos - 1];
+                    found = fill_line_info(offs[i], (size_t)entry->modoffs,
+                                           cache_strtab(cache) + entry->file,
+                                           entry->line, out);
+                }
+            } else if (num_lines > 0) {
+                while (line_pos < num_lines &&
+                       mod->line_index[line_pos].modoffs <= offs[i])
+                    line_pos++;
+                if (line_pos == 0)
+                    found = fill_line_info(offs[i], 0, NULL, 0, out);
+                else {
+                    const line_entry_t *entry = &mod->line_index[line_pos - 1];
+                    found = fill_line_info(offs[i], entry->modoffs, entry->file,
+                                           entry->line, out);
+                }
+            } else if (mod4line->dwarf_info != NULL)
+                found = dwarf_search_line(mod, mod4line, offs[i], out);
+            else
+                found = false;
+            if (!found)
+                r = DRSYM_ERROR_LINE_NOT_AVAILABLE;
         }
+        finish_address_info(mod, out, flags);
+        lookups[i]->result = r;
     }
 
-    out->debug_kind = mod->debug_kind;
-    /* Fields beyond name require compatibility checks */
-    if (out->struct_size > offsetof(drsym_info_t, flags)) {
-        /* Remove unsupported flags */
-        out->flags = flags & ~(UNSUPPORTED_NONPDB_FLAGS);
+    dr_global_free(idx, count * sizeof(*idx));
+    dr_global_free(offs, count * sizeof(*offs));
+}
+
+/* The rows of a module's line table, copied out of the DWARF library so that
+ * drsym_enumerate_lines() can invoke its callbacks without holding the lock.
+ */
+typedef struct _line_rows_t {
+    drsym_line_info_t *rows;
+    size_t count;
+    size_t capacity;
+    /* The copies of the CU and file names, which many rows share. */
+    hashtable_t strings;
+} line_rows_t;
+
+static bool
+line_rows_add_cb(drsym_line_info_t *info, void *data)
+{
+    line_rows_t *copy = (line_rows_t *)data;
+    drsym_line_info_t *row;
+    if (copy->count == copy->capacity) {
+        size_t new_cap = copy->capacity == 0 ? 1024 : copy->capacity * 2;
+        drsym_line_info_t *grown =
+            (drsym_line_info_t *)dr_global_alloc(new_cap * sizeof(drsym_line_info_t));
+        if (copy->rows != NULL) {
+            memcpy(grown, copy->rows, copy->count * sizeof(drsym_line_info_t));
+            dr_global_free(copy->rows, copy->capacity * sizeof(drsym_line_info_t));
+        }
+        copy->rows = grown;
+        copy->capacity = new_cap;
     }
-    return r;
+    row = &copy->rows[copy->count++];
+    row->cu_name = line_string_intern(&copy->strings, info->cu_name);
+    row->file = line_string_intern(&copy->strings, info->file);
+    row->line = info->line;
+    row->line_addr = info->line_addr;
+    return true;
 }
 
 drsym_error_t
@@ -710,12 +1474,30 @@ drsym_unix_enumerate_lines(void *mod_in, drsym_enumerate_lines_cb callback, void
 {
     dbg_module_t *mod = (dbg_module_t *)mod_in;
     dbg_module_t *mod4line = mod;
+    line_rows_t copy;
+    drsym_error_t res;
+    size_t i;
     if (mod->mod_with_dwarf != NULL)
         mod4line = mod->mod_with_dwarf;
-    if (mod4line->dwarf_info != NULL)
-        return drsym_dwarf_enumerate_lines(mod4line->dwarf_info, callback, data);
-    else
+    if (mod4line->dwarf_info == NULL)
         return DRSYM_ERROR_LINE_NOT_AVAILABLE;
+    /* Callbacks commonly query this or another module, so we cannot hold the
+     * lock across them: two threads each enumerating one module while querying
+     * the other's would deadlock.  We copy the rows out instead.
+     */
+    memset(&copy, 0, sizeof(copy));
+    line_strings_init(&copy.strings);
+    dr_recurlock_lock(mod->lock);
+    res = drsym_dwarf_enumerate_lines(mod4line->dwarf_info, line_rows_add_cb, &copy);
+    dr_recurlock_unlock(mod->lock);
+    for (i = 0; i < copy.count; i++) {
+        if (!(*callback)(&copy.rows[i], data))
+            break;
+    }
+    if (copy.rows != NULL)
+        dr_global_free(copy.rows, copy.capacity * sizeof(drsym_line_info_t));
+    hashtable_delete(&copy.strings);
+    return res;
 }
 
 drsym_error_t
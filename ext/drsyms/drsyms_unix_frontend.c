@@ -47,15 +47,25 @@
 #include "drsyms_private.h"
 #include "hashtable.h"
 
-/* Guards our internal state and libdwarf's modifications of mod->dbg.
- * We use a recursive lock to allow queries to be called from enumerate callbacks.
+#include <stdlib.h> /* qsort */
+#include <string.h>
+
+/* Guards modtable.  Queries run outside of this lock: each table entry is
+ * reference counted so that a module being queried by one thread is not
+ * unloaded out from under it by drsym_free_resources() on another thread.
+ * Synchronization of a module's own lazily built state is handled per module
+ * in drsyms_unix_common.c, so queries on different modules, and address
+ * lookups on the same module once its line index is built, proceed in parallel.
  */
-static void *symbol_lock;
+static void *modtable_lock;
 
-/* We have to restrict operations when operating in a nested query from a callback */
-static bool recursive_context;
+typedef struct _modentry_t {
+    void *mod;
+    /* One reference is held by modtable and one by each in-flight query. */
+    volatile int refcount;
+} modentry_t;
 
-/* Hashtable for mapping module paths to dbg_module_t*. */
+/* Hashtable for mapping module paths to modentry_t*. */
 #define MODTABLE_HASH_BITS 8
 static hashtable_t modtable;
 
@@ -68,17 +78,49 @@ static int shmid;
  * Linux lookup layer
  */
 
-static void *
+static void
+modentry_release(void *p)
+{
+    modentry_t *entry = (modentry_t *)p;
+    if (dr_atomic_add32_return_sum(&entry->refcount, -1) == 0) {
+        drsym_unix_unload(entry->mod);
+        dr_global_free(entry, sizeof(*entry));
+    }
+}
+
+/* Returns the entry for modpath with a reference added, which the caller must
+ * drop with modentry_release().
+ */
+static modentry_t *
 lookup_or_load(const char *modpath)
 {
-    void *mod = hashtable_lookup(&modtable, (void *)modpath);
-    if (mod == NULL) {
-        mod = drsym_unix_load(modpath);
+    modentry_t *entry;
+    dr_rwlock_read_lock(modtable_lock);
+    entry = (modentry_t *)hashtable_lookup(&modtable, (void *)modpath);
+    if (entry != NULL)
+        dr_atomic_add32_return_sum(&entry->refcount, 1);
+    dr_rwlock_read_unlock(modtable_lock);
+    if (entry != NULL)
+        return entry;
+
+    /* Loads are serialized, which also protects the debuglink depth count in
+     * load_module().  Another thread may have loaded it while we waited.
+     */
+    dr_rwlock_write_lock(modtable_lock);
+    entry = (modentry_t *)hashtable_lookup(&modtable, (void *)modpath);
+    if (entry == NULL) {
+        void *mod = drsym_unix_load(modpath);
         if (mod != NULL) {
-            hashtable_add(&modtable, (void *)modpath, mod);
+            entry = (modentry_t *)dr_global_alloc(sizeof(*entry));
+            entry->mod = mod;
+            entry->refcount = 1;
+            hashtable_add(&modtable, (void *)modpath, entry);
         }
     }
-    return mod;
+    if (entry != NULL)
+        dr_atomic_add32_return_sum(&entry->refcount, 1);
+    dr_rwlock_write_unlock(modtable_lock);
+    return entry;
 }
 
 static drsym_error_t
@@ -86,24 +128,20 @@ drsym_enumerate_symbols_local(const char *modpath, drsym_enumerate_cb callback,
                               drsym_enumerate_ex_cb callback_ex, size_t info_size,
                               void *data, uint flags)
 {
-    void *mod;
+    modentry_t *entry;
     drsym_error_t r;
 
     if (modpath == NULL || (callback == NULL && callback_ex == NULL))
         return DRSYM_ERROR_INVALID_PARAMETER;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    entry = lookup_or_load(modpath);
+    if (entry == NULL)
         return DRSYM_ERROR_LOAD_FAILED;
-    }
 
-    recursive_context = true;
-    r = drsym_unix_enumerate_symbols(mod, callback, callback_ex, info_size, data, flags);
-    recursive_context = false;
+    r = drsym_unix_enumerate_symbols(entry->mod, callback, callback_ex, info_size, data,
+                                     flags);
 
-    dr_recurlock_unlock(symbol_lock);
+    modentry_release(entry);
     return r;
 }
 
@@ -111,22 +149,19 @@ static drsym_error_t
 drsym_lookup_symbol_local(const char *modpath, const char *symbol,
                           size_t *modoffs DR_PARAM_OUT, uint flags)
 {
-    void *mod;
+    modentry_t *entry;
     drsym_error_t r;
 
     if (modpath == NULL || symbol == NULL || modoffs == NULL)
         return DRSYM_ERROR_INVALID_PARAMETER;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    entry = lookup_or_load(modpath);
+    if (entry == NULL)
         return DRSYM_ERROR_LOAD_FAILED;
-    }
 
-    r = drsym_unix_lookup_symbol(mod, symbol, modoffs, flags);
+    r = drsym_unix_lookup_symbol(entry->mod, symbol, modoffs, flags);
 
-    dr_recurlock_unlock(symbol_lock);
+    modentry_release(entry);
     return r;
 }
 
@@ -134,7 +169,7 @@ static drsym_error_t
 drsym_lookup_address_local(const char *modpath, size_t modoffs,
                            drsym_info_t *out DR_PARAM_INOUT, uint flags)
 {
-    void *mod;
+    modentry_t *entry;
     drsym_error_t r;
 
     if (modpath == NULL || out == NULL)
@@ -143,39 +178,90 @@ drsym_lookup_address_local(const char *modpath, size_t modoffs,
     if (out->struct_size != sizeof(*out))
         return DRSYM_ERROR_INVALID_SIZE;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    entry = lookup_or_load(modpath);
+    if (entry == NULL)
         return DRSYM_ERROR_LOAD_FAILED;
-    }
 
-    r = drsym_unix_lookup_address(mod, modoffs, out, flags);
+    r = drsym_unix_lookup_address(entry->mod, modoffs, out, flags);
 
-    dr_recurlock_unlock(symbol_lock);
+    modentry_release(entry);
     return r;
 }
 
+/* Orders queries by module and then by offset. */
+static int
+lookup_compare(const void *a_in, const void *b_in)
+{
+    const drsym_lookup_t *a = *(const drsym_lookup_t **)a_in;
+    const drsym_lookup_t *b = *(const drsym_lookup_t **)b_in;
+    int cmp = strcmp(a->modpath, b->modpath);
+    if (cmp != 0)
+        return cmp;
+    if (a->modoffs != b->modoffs)
+        return a->modoffs < b->modoffs ? -1 : 1;
+    return 0;
+}
+
+static drsym_error_t
+drsym_lookup_addresses_local(drsym_lookup_t *lookups, size_t count, uint flags)
+{
+    drsym_lookup_t **sorted;
+    size_t i, start, num = 0;
+
+    if (lookups == NULL && count > 0)
+        return DRSYM_ERROR_INVALID_PARAMETER;
+    if (count == 0)
+        return DRSYM_SUCCESS;
+
+    sorted = (drsym_lookup_t **)dr_global_alloc(count * sizeof(*sorted));
+    for (i = 0; i < count; i++) {
+        drsym_lookup_t *lookup = &lookups[i];
+        if (lookup->modpath == NULL || lookup->info == NULL)
+            lookup->result = DRSYM_ERROR_INVALID_PARAMETER;
+        else if (lookup->info->struct_size != sizeof(*lookup->info))
+            lookup->result = DRSYM_ERROR_INVALID_SIZE;
+        else
+            sorted[num++] = lookup;
+    }
+    qsort(sorted, num, sizeof(*sorted), lookup_compare);
+
+    for (start = 0; start < num; start = i) {
+        modentry_t *entry;
+        const char *modpath = sorted[start]->modpath;
+        for (i = start + 1; i < num && strcmp(sorted[i]->modpath, modpath) == 0; i++)
+            ; /* empty */
+        entry = lookup_or_load(modpath);
+        if (entry == NULL) {
+            size_t j;
+            for (j = start; j < i; j++)
+                sorted[j]->result = DRSYM_ERROR_LOAD_FAILED;
+            continue;
+        }
+        drsym_unix_lookup_addresses(entry->mod, &sorted[start], i - start, flags);
+        modentry_release(entry);
+    }
+
+    dr_global_free(sorted, count * sizeof(*sorted));
+    return DRSYM_SUCCESS;
+}
+
 static drsym_error_t
 drsym_enumerate_lines_local(const char *modpath, drsym_enumerate_lines_cb callback,
                             void *data)
 {
-    void *mod;
+    modentry_t *entry;
     drsym_error_t res;
 
     if (modpath == NULL || callback == NULL)
         return DRSYM_ERROR_INVALID_PARAMETER;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    entry = lookup_or_load(modpath);
+    if (entry == NULL)
         return DRSYM_ERROR_LOAD_FAILED;
-    }
 
-    res = drsym_unix_enumerate_lines(mod, callback, data);
+    res = drsym_unix_enumerate_lines(entry->mod, callback, data);
 
-    dr_recurlock_unlock(symbol_lock);
+    modentry_release(entry);
     return res;
 }
 
@@ -196,7 +282,7 @@ drsym_init(int shmid_in)
 
     shmid = shmid_in;
 
-    symbol_lock = dr_recurlock_create();
+    modtable_lock = dr_rwlock_create();
 
     drsym_unix_init();
 
@@ -206,8 +292,8 @@ drsym_init(int shmid_in)
          */
     } else {
         hashtable_init_ex(&modtable, MODTABLE_HASH_BITS, HASH_STRING, true /*strdup*/,
-                          false /*!synch: using symbol_lock*/, drsym_unix_unload, NULL,
-                          NULL);
+                          false /*!synch: using modtable_lock*/, modentry_release,
+                          NULL, NULL);
     }
     return DRSYM_SUCCESS;
 }
@@ -229,10 +315,19 @@ drsym_exit(void)
         /* TODO NYI i#446 */
     }
     hashtable_delete(&modtable);
-    dr_recurlock_destroy(symbol_lock);
+    dr_rwlock_destroy(modtable_lock);
     return res;
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_set_cache_dir(const char *dir)
+{
+    if (IS_SIDELINE)
+        return DRSYM_ERROR_NOT_IMPLEMENTED;
+    return drsym_unix_set_cache_dir(dir) ? DRSYM_SUCCESS : DRSYM_ERROR_INVALID_PARAMETER;
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_address(const char *modpath, size_t modoffs,
@@ -245,6 +340,17 @@ drsym_lookup_address(const char *modpath, size_t modoffs,
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_lookup_addresses(drsym_lookup_t *lookups, size_t count, uint flags)
+{
+    if (IS_SIDELINE) {
+        return DRSYM_ERROR_NOT_IMPLEMENTED;
+    } else {
+        return drsym_lookup_addresses_local(lookups, count, flags);
+    }
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_symbol(const char *modpath, const char *symbol, size_t *modoffs DR_PARAM_OUT,
@@ -322,16 +428,17 @@ drsym_get_module_debug_kind(const char *modpath, drsym_debug_kind_t *kind DR_PAR
     if (IS_SIDELINE) {
         return DRSYM_ERROR_NOT_IMPLEMENTED;
     } else {
-        void *mod;
+        modentry_t *entry;
         drsym_error_t r;
 
         if (modpath == NULL || kind == NULL)
             return DRSYM_ERROR_INVALID_PARAMETER;
 
-        dr_recurlock_lock(symbol_lock);
-        mod = lookup_or_load(modpath);
-        r = drsym_unix_get_module_debug_kind(mod, kind);
-        dr_recurlock_unlock(symbol_lock);
+        entry = lookup_or_load(modpath);
+        if (entry == NULL)
+            return DRSYM_ERROR_LOAD_FAILED;
+        r = drsym_unix_get_module_debug_kind(entry->mod, kind);
+        modentry_release(entry);
         return r;
     }
 }
@@ -359,13 +466,12 @@ drsym_free_resources(const char *modpath)
         if (modpath == NULL)
             return DRSYM_ERROR_INVALID_PARAMETER;
 
-        /* unsafe to free during iteration */
-        if (recursive_context)
-            return DRSYM_ERROR_RECURSIVE;
-
-        dr_recurlock_lock(symbol_lock);
+        /* This drops the table's reference: if a query or iteration on this
+         * module is in progress the unload happens when it finishes.
+         */
+        dr_rwlock_write_lock(modtable_lock);
         found = hashtable_remove(&modtable, (void *)modpath);
-        dr_recurlock_unlock(symbol_lock);
+        dr_rwlock_write_unlock(modtable_lock);
 
         return (found ? DRSYM_SUCCESS : DRSYM_ERROR);
     }
@@ -1455,6 +1455,22 @@ drsym_lookup_address(const char *modpath, size_t modoffs,
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_lookup_addresses(drsym_lookup_t *lookups, size_t count, uint flags)
+{
+    size_t i;
+    if (lookups == NULL && count > 0)
+        return DRSYM_ERROR_INVALID_PARAMETER;
+    /* XXX: dbghelp has no batch query; we simply loop. */
+    for (i = 0; i < count; i++) {
+        drsym_lookup_t *lookup = &lookups[i];
+        lookup->result =
+            drsym_lookup_address(lookup->modpath, lookup->modoffs, lookup->info, flags);
+    }
+    return DRSYM_SUCCESS;
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_symbol(const char *modpath, const char *symbol, size_t *modoffs DR_PARAM_OUT,
@@ -1821,6 +1837,14 @@ drsym_module_has_symbols(const char *modpath)
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_set_cache_dir(const char *dir)
+{
+    /* Only ELF modules, identified by build id, are cached. */
+    return DRSYM_ERROR_NOT_IMPLEMENTED;
+}
+
 /* We do not want to take unlimited resources when a client queries a whole
  * bunch of libraries.  Usually the client will query at module load and
  * then not again, unless in a callstack later.  So we can save a lot of memory
@@ -40,15 +40,7 @@ set(AARCH64_CODEC_GEN_SRCS
   ${PROJECT_BINARY_DIR}/opcode_api.h
   ${PROJECT_BINARY_DIR}/opnd_decode_funcs.h
   ${PROJECT_BINARY_DIR}/opnd_encode_funcs.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v80.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v81.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v82.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v83.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v84.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v85.h
-  ${PROJECT_BINARY_DIR}/decode_gen_v87.h
-  ${PROJECT_BINARY_DIR}/decode_gen_sve.h
-  ${PROJECT_BINARY_DIR}/decode_gen_sve2.h
+  ${PROJECT_BINARY_DIR}/decode_gen.h
   ${PROJECT_BINARY_DIR}/encode_gen_v80.h
   ${PROJECT_BINARY_DIR}/encode_gen_v81.h
   ${PROJECT_BINARY_DIR}/encode_gen_v82.h
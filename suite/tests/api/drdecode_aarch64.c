@@ -338,6 +338,36 @@ test_isa_features(void)
     instr_destroy(GD, instr);
 }
 
+static void
+test_decode_region(void)
+{
+    const uint b[] = {
+        0x0b010000, /* add %w0 %w1 lsl $0x00 -> %w0 */
+        0xd65f03c0, /* ret %x30 */
+    };
+    dr_decode_record_t records[4];
+    byte *next_pc;
+    size_t count;
+    bool ok = decode_region(GD, (byte *)b, (byte *)b + sizeof(b), records,
+                            BUFFER_SIZE_ELEMENTS(records), &count, &next_pc);
+    ASSERT(ok && count == 2 && next_pc == (byte *)b + sizeof(b));
+    ASSERT(records[0].offset == 0 && records[0].length == 4);
+    ASSERT(records[0].opcode == OP_add);
+    ASSERT(records[0].num_dsts == 1 && records[0].opnd_kinds[0] == DR_DECODE_OPND_REG);
+    ASSERT(records[1].offset == 4 && records[1].length == 4);
+    ASSERT(records[1].opcode == OP_ret);
+    /* A partial instruction at the end is reported rather than decoded. */
+    ok = decode_region(GD, (byte *)b, (byte *)b + sizeof(b) - 2, records,
+                       BUFFER_SIZE_ELEMENTS(records), &count, &next_pc);
+    ASSERT(!ok && count == 1 && next_pc == (byte *)&b[1]);
+    /* Skipping steps over whole instructions without filling in records. */
+    ok = decode_region(GD, (byte *)b, (byte *)b + sizeof(b), NULL, 1, &count, &next_pc);
+    ASSERT(ok && count == 1 && next_pc == (byte *)&b[1]);
+    ok = decode_region(GD, (byte *)b, (byte *)b + sizeof(b) - 2, NULL,
+                       BUFFER_SIZE_ELEMENTS(records), &count, &next_pc);
+    ASSERT(!ok && count == 1 && next_pc == (byte *)&b[1]);
+}
+
 int
 main(int argc, const char *argv[])
 {
@@ -353,6 +383,8 @@ main(int argc, const char *argv[])
 
     test_isa_features();
 
+    test_decode_region();
+
     print("done\n");
 
     return 0;
@@ -311,6 +311,259 @@ test_isa_features(void)
     instr_destroy(GD, instr);
 }
 
+#define DECODE_CACHE_MAX_INSTRS 16
+#define DECODE_CACHE_DIS_LEN 256
+
+/* Decodes [pc, end) as though it were at orig_pc into one line per instr. */
+static int
+disassemble_range(byte *pc, byte *end, byte *orig_pc,
+                  char dis[DECODE_CACHE_MAX_INSTRS][DECODE_CACHE_DIS_LEN])
+{
+    int count = 0;
+    while (pc < end) {
+        instr_t instr;
+        instr_init(GD, &instr);
+        byte *next_pc = decode_from_copy(GD, pc, orig_pc, &instr);
+        ASSERT(next_pc != NULL && count < DECODE_CACHE_MAX_INSTRS);
+        ASSERT(instr_raw_bits_valid(&instr) && instr_get_raw_bits(&instr) == pc);
+        ASSERT(instr_operands_valid(&instr));
+        size_t len = instr_disassemble_to_buffer(GD, &instr, dis[count],
+                                                 DECODE_CACHE_DIS_LEN);
+        snprintf(dis[count] + len, DECODE_CACHE_DIS_LEN - len, " cat=0x%x len=%d",
+                 instr_get_category(&instr), instr_length(GD, &instr));
+        instr_free(GD, &instr);
+        orig_pc += next_pc - pc;
+        pc = next_pc;
+        count++;
+    }
+    return count;
+}
+
+static void
+check_disassembly(byte *pc, byte *end, byte *orig_pc, int expect_count,
+                  char expect[DECODE_CACHE_MAX_INSTRS][DECODE_CACHE_DIS_LEN])
+{
+    char dis[DECODE_CACHE_MAX_INSTRS][DECODE_CACHE_DIS_LEN];
+    int count = disassemble_range(pc, end, orig_pc, dis);
+    ASSERT(count == expect_count);
+    for (int i = 0; i < count; i++)
+        ASSERT(strcmp(dis[i], expect[i]) == 0);
+}
+
+static void
+test_decode_cache(void)
+{
+    byte buf[128], copy[128];
+    byte *end;
+    instrlist_t *ilist = instrlist_create(GD);
+    instr_t *loop = INSTR_CREATE_label(GD);
+    instrlist_append(ilist, loop);
+    instrlist_append(ilist,
+                     INSTR_CREATE_mov_ld(GD, opnd_create_reg(DR_REG_XAX),
+                                         OPND_CREATE_MEMPTR(DR_REG_XBX, 0x40)));
+    instrlist_append(
+        ilist, INSTR_CREATE_add(GD, opnd_create_reg(DR_REG_XAX), OPND_CREATE_INT8(1)));
+    /* Operands relative to the instruction's address must be adjusted on a hit. */
+    instrlist_append(ilist, INSTR_CREATE_jcc(GD, OP_jne, opnd_create_instr(loop)));
+    instrlist_append(ilist, INSTR_CREATE_call(GD, opnd_create_pc(buf + 0x1000)));
+#ifdef X64
+    instrlist_append(ilist,
+                     INSTR_CREATE_lea(GD, opnd_create_reg(DR_REG_XCX),
+                                      opnd_create_rel_addr(buf + 0x2000, OPSZ_lea)));
+#endif
+    instrlist_append(ilist, INSTR_CREATE_ret(GD));
+    end = instrlist_encode(GD, ilist, buf, true);
+    ASSERT(end != NULL && end - buf < BUFFER_SIZE_ELEMENTS(buf));
+    instrlist_clear_and_destroy(GD, ilist);
+    memcpy(copy, buf, end - buf);
+    byte *copy_end = copy + (end - buf);
+
+    char at_buf[DECODE_CACHE_MAX_INSTRS][DECODE_CACHE_DIS_LEN];
+    char at_copy[DECODE_CACHE_MAX_INSTRS][DECODE_CACHE_DIS_LEN];
+    int count = disassemble_range(buf, end, buf, at_buf);
+    ASSERT(disassemble_range(copy, copy_end, copy, at_copy) == count);
+#ifdef X64
+    char x86_at_buf[DECODE_CACHE_MAX_INSTRS][DECODE_CACHE_DIS_LEN];
+    bool old_mode = set_x86_mode(GD, true);
+    int x86_count = disassemble_range(buf, end, buf, x86_at_buf);
+    set_x86_mode(GD, old_mode);
+#endif
+
+    /* A small cache also exercises replacing entries. */
+    ASSERT(decode_cache_enable(4));
+    for (int i = 0; i < 2; i++) {
+        check_disassembly(buf, end, buf, count, at_buf);
+        check_disassembly(copy, copy_end, copy, count, at_copy);
+        check_disassembly(copy, copy_end, buf, count, at_buf);
+#ifdef X64
+        /* The same bytes mean something else in 32-bit mode. */
+        old_mode = set_x86_mode(GD, true);
+        check_disassembly(buf, end, buf, x86_count, x86_at_buf);
+        set_x86_mode(GD, old_mode);
+#endif
+    }
+    ASSERT(decode_cache_enable(64));
+    for (int i = 0; i < 2; i++) {
+        check_disassembly(buf, end, buf, count, at_buf);
+        check_disassembly(copy, copy_end, buf, count, at_buf);
+    }
+    ASSERT(decode_cache_enable(0));
+    check_disassembly(buf, end, buf, count, at_buf);
+}
+
+/* Checks that an instr from a cache hit is fully decoded, by changing the bytes it
+ * points at: were its operands not valid, querying them would decode those bytes.
+ */
+static void
+test_decode_cache_hit_operands(void)
+{
+    byte buf[16];
+    instr_t *instr =
+        INSTR_CREATE_mov_ld(GD, opnd_create_reg(DR_REG_XAX),
+                            OPND_CREATE_MEMPTR(DR_REG_XBX, 0x40));
+    byte *end = instr_encode(GD, instr, buf);
+    ASSERT(end != NULL);
+    instr_destroy(GD, instr);
+    instr = INSTR_CREATE_mov_ld(GD, opnd_create_reg(DR_REG_XCX),
+                                OPND_CREATE_MEMPTR(DR_REG_XDX, 0x40));
+    byte other[16];
+    ASSERT(instr_encode(GD, instr, other) - other == end - buf);
+    instr_destroy(GD, instr);
+
+    ASSERT(decode_cache_enable(64));
+    instr_t hit;
+    instr_init(GD, &hit);
+    for (int i = 0; i < 2; i++) {
+        /* The first decode fills the cache and the second hits. */
+        instr_reset(GD, &hit);
+        ASSERT(decode(GD, buf, &hit) == end);
+        ASSERT(instr_operands_valid(&hit));
+    }
+    memcpy(buf, other, end - buf);
+    ASSERT(instr_get_opcode(&hit) == OP_mov_ld);
+    ASSERT(instr_num_dsts(&hit) == 1 && instr_num_srcs(&hit) == 1);
+    ASSERT(opnd_get_reg(instr_get_dst(&hit, 0)) == DR_REG_XAX);
+    ASSERT(opnd_get_base(instr_get_src(&hit, 0)) == DR_REG_XBX);
+    ASSERT(instr_get_category(&hit) != DR_INSTR_CATEGORY_UNCATEGORIZED);
+    instr_free(GD, &hit);
+    ASSERT(decode_cache_enable(0));
+}
+
+static void
+test_decode_region(void)
+{
+    byte buf[128];
+    byte *end;
+    instrlist_t *ilist = instrlist_create(GD);
+    instr_t *loop = INSTR_CREATE_label(GD);
+    instrlist_append(ilist, loop);
+    instrlist_append(ilist,
+                     INSTR_CREATE_mov_ld(GD, opnd_create_reg(DR_REG_XAX),
+                                         OPND_CREATE_MEMPTR(DR_REG_XBX, 0x40)));
+    instrlist_append(
+        ilist, INSTR_CREATE_add(GD, opnd_create_reg(DR_REG_XAX), OPND_CREATE_INT8(1)));
+    instrlist_append(ilist, INSTR_CREATE_jcc(GD, OP_jne, opnd_create_instr(loop)));
+    instrlist_append(ilist, INSTR_CREATE_ret(GD));
+    end = instrlist_encode(GD, ilist, buf, true);
+    ASSERT(end != NULL && end - buf + 2 < BUFFER_SIZE_ELEMENTS(buf));
+    instrlist_clear_and_destroy(GD, ilist);
+    /* Append an invalid instruction. */
+    byte *invalid = end;
+    *end++ = 0x0f;
+    *end++ = 0x04;
+
+    dr_decode_record_t records[16];
+    byte *next_pc;
+    /* Stale contents must not show through unused operand kinds. */
+    memset(records, 0xab, sizeof(records));
+    size_t count;
+    bool ok = decode_region(GD, buf, invalid, records, BUFFER_SIZE_ELEMENTS(records),
+                            &count, &next_pc);
+    ASSERT(ok && count == 4 && next_pc == invalid);
+    instr_t instr;
+    instr_init(GD, &instr);
+    byte *pc = buf;
+    for (size_t i = 0; i < count; i++) {
+        instr_reset(GD, &instr);
+        byte *decoded_next_pc = decode(GD, pc, &instr);
+        ASSERT(records[i].offset == pc - buf);
+        ASSERT(records[i].length == decoded_next_pc - pc);
+        ASSERT(records[i].opcode == instr_get_opcode(&instr));
+        ASSERT(records[i].category == instr_get_category(&instr));
+        ASSERT(records[i].num_dsts == instr_num_dsts(&instr));
+        ASSERT(records[i].num_srcs == instr_num_srcs(&instr));
+        pc = decoded_next_pc;
+    }
+    instr_free(GD, &instr);
+    ASSERT(records[0].opcode == OP_mov_ld);
+    ASSERT(records[0].opnd_kinds[0] == DR_DECODE_OPND_REG);
+    ASSERT(records[0].opnd_kinds[1] == DR_DECODE_OPND_MEMORY);
+    ASSERT(records[1].opnd_kinds[records[1].num_dsts] == DR_DECODE_OPND_IMMED);
+    ASSERT(records[2].opnd_kinds[0] == DR_DECODE_OPND_PC);
+    uint jcc_offs = records[2].offset;
+    for (int i = records[0].num_dsts + records[0].num_srcs;
+         i < DR_DECODE_RECORD_MAX_OPNDS; i++)
+        ASSERT(records[0].opnd_kinds[i] == DR_DECODE_OPND_OTHER);
+
+    /* Invalid code is skipped a byte at a time. */
+    memset(records, 0xab, sizeof(records));
+    ok = decode_region(GD, invalid, end, records, 1, &count, &next_pc);
+    ASSERT(ok && count == 1 && next_pc == invalid + 1);
+    ASSERT(records[0].opcode == OP_INVALID && records[0].length == 1);
+    for (int i = 0; i < DR_DECODE_RECORD_MAX_OPNDS; i++)
+        ASSERT(records[0].opnd_kinds[i] == DR_DECODE_OPND_OTHER);
+
+    /* Decoding stops with an error at an instruction that extends past the end, and
+     * without one when the records run out, and can be resumed from where it stopped.
+     * The code is placed just before an inaccessible page so that any read past the
+     * end faults.
+     */
+    byte *mem = (byte *)allocate_mem(2 * PAGE_SIZE, ALLOW_READ | ALLOW_WRITE);
+    protect_mem(mem + PAGE_SIZE, PAGE_SIZE, 0);
+    size_t size = invalid - buf;
+    byte *code = mem + PAGE_SIZE - size;
+    memcpy(code, buf, size);
+    byte *code_end = mem + PAGE_SIZE;
+    ok = decode_region(GD, code, code_end, records, BUFFER_SIZE_ELEMENTS(records),
+                       &count, &next_pc);
+    ASSERT(ok && count == 4 && next_pc == code_end && records[3].opcode == OP_ret);
+    ok = decode_region(GD, code, code_end, records, 2, &count, &next_pc);
+    ASSERT(ok && count == 2 && next_pc == code + records[1].offset + records[1].length);
+    ok = decode_region(GD, next_pc, code_end, records, 16, &count, &next_pc);
+    ASSERT(ok && count == 2 && next_pc == code_end && records[1].opcode == OP_ret);
+    /* Cut the first instruction short. */
+    ok = decode_region(GD, buf, invalid, records, 1, &count, &next_pc);
+    ASSERT(ok && count == 1);
+    code = code_end - (records[0].length - 1);
+    memcpy(code, buf, records[0].length - 1);
+    memset(records, 0xab, sizeof(records));
+    ok = decode_region(GD, code, code_end, records, BUFFER_SIZE_ELEMENTS(records),
+                       &count, &next_pc);
+    ASSERT(!ok && count == 0 && next_pc == code);
+    ok = decode_region(GD, code, code_end, NULL, 1, &count, &next_pc);
+    ASSERT(!ok && count == 0 && next_pc == code);
+    /* The instructions before a cut-off one are still recorded. */
+    code = code_end - (jcc_offs + 1);
+    memcpy(code, buf, jcc_offs + 1);
+    ok = decode_region(GD, code, code_end, records, BUFFER_SIZE_ELEMENTS(records),
+                       &count, &next_pc);
+    ASSERT(!ok && count == 2 && next_pc == code + jcc_offs);
+    ok = decode_region(GD, code, code_end, NULL, 16, &count, &next_pc);
+    ASSERT(!ok && count == 2 && next_pc == code + jcc_offs);
+
+    /* Skipping finds the same lengths without filling in records. */
+    code = mem + PAGE_SIZE - size;
+    memcpy(code, buf, size);
+    ok = decode_region(GD, code, code_end, NULL, 3, &count, &next_pc);
+    ASSERT(ok && count == 3);
+    ok = decode_region(GD, code, code_end, records, 3, NULL, &pc);
+    ASSERT(ok && next_pc == pc);
+    ok = decode_region(GD, next_pc, code_end, NULL, 16, &count, &next_pc);
+    ASSERT(ok && count == 1 && next_pc == code_end);
+    protect_mem(mem + PAGE_SIZE, PAGE_SIZE, ALLOW_READ | ALLOW_WRITE);
+    free_mem((char *)mem, 2 * PAGE_SIZE);
+}
+
 int
 main(int argc, const char *argv[])
 {
@@ -328,6 +581,12 @@ main(int argc, const char *argv[])
 
     test_isa_features();
 
+    test_decode_cache();
+
+    test_decode_cache_hit_operands();
+
+    test_decode_region();
+
     print("done\n");
 
     return 0;
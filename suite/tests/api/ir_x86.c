@@ -2791,6 +2791,106 @@ test_evex_compressed_disp_with_segment_prefix(void *dc)
 #endif
 }
 
+/* Encodes instr, checks that it decodes back to the same thing, and destroys it. */
+static void
+test_encode_round_trip(void *dc, instr_t *instr)
+{
+    byte *pc = instr_encode(dc, instr, buf);
+    ASSERT(pc != NULL);
+    instr_t *decin = instr_create(dc);
+    ASSERT(decode(dc, buf, decin) == pc);
+#if VERBOSE
+    disassemble_with_info(dc, buf, STDOUT, true, true);
+#endif
+    ASSERT(instr_same(instr, decin));
+    instr_destroy(dc, instr);
+    instr_destroy(dc, decin);
+}
+
+/* The encoder caches the template it chose for an instruction, sharing it among
+ * instructions that differ only in immediates and displacements of the same size
+ * class.  We encode the shapes that mangling and instrumentation emit most with
+ * values on either side of each class boundary, in both directions, so that each
+ * is encoded right after a neighbor that may have filled the cache.
+ */
+static void
+test_encode_template_cache(void *dc)
+{
+    static const int disps[] = { 0,      1,       8,      0x7f,       0x80,
+                                 -0x80,  -0x81,   0x1000, 0x1001,     -0x1001,
+                                 0x1234, -0x1234, 0x12345678, -0x12345678 };
+    static const ptr_int_t immeds[] = { 0,
+                                        1,
+                                        2,
+                                        -1,
+                                        0x7f,
+                                        0x80,
+                                        -0x80,
+                                        -0x81,
+                                        0x7fff,
+                                        0x8000,
+                                        -0x8001,
+                                        0x12345678,
+                                        -0x12345678,
+                                        IF_X64_ELSE(0x123456789LL, 0x7fffffff),
+                                        IF_X64_ELSE(-0x123456789LL, 0) };
+    const int num_disps = (int)BUFFER_SIZE_ELEMENTS(disps);
+    const int num_immeds = (int)BUFFER_SIZE_ELEMENTS(immeds);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int j = 0; j < num_disps; j++) {
+            int disp = disps[pass == 0 ? j : num_disps - 1 - j];
+            test_encode_round_trip(
+                dc,
+                INSTR_CREATE_mov_st(dc, OPND_CREATE_MEMPTR(REG_XBX, disp),
+                                    opnd_create_reg(REG_XAX)));
+            test_encode_round_trip(
+                dc,
+                INSTR_CREATE_mov_ld(dc, opnd_create_reg(REG_XCX),
+                                    OPND_CREATE_MEMPTR(REG_XSP, disp)));
+            test_encode_round_trip(
+                dc,
+                INSTR_CREATE_lea(dc, opnd_create_reg(REG_XCX),
+                                 OPND_CREATE_MEM_lea(REG_XCX, REG_XDX, 8, disp)));
+            test_encode_round_trip(dc,
+                                   INSTR_CREATE_add(dc, OPND_CREATE_MEMPTR(REG_XDX, disp),
+                                                    OPND_CREATE_INT8(1)));
+            test_encode_round_trip(
+                dc,
+                INSTR_CREATE_mov_st(dc, OPND_CREATE_MEM32(REG_XCX, disp),
+                                    OPND_CREATE_INT32(disp)));
+        }
+        for (int j = 0; j < num_immeds; j++) {
+            ptr_int_t val = immeds[pass == 0 ? j : num_immeds - 1 - j];
+            if (val >= INT8_MIN && val <= INT8_MAX) {
+                test_encode_round_trip(
+                    dc,
+                    INSTR_CREATE_add(dc, OPND_CREATE_MEMPTR(REG_XDX, 8),
+                                     OPND_CREATE_INT8(val)));
+                test_encode_round_trip(dc,
+                                       INSTR_CREATE_shl(dc, opnd_create_reg(REG_EAX),
+                                                        OPND_CREATE_INT8(val)));
+            }
+            if (val >= INT16_MIN && val <= INT16_MAX) {
+                test_encode_round_trip(dc,
+                                       INSTR_CREATE_cmp(dc, opnd_create_reg(REG_CX),
+                                                        OPND_CREATE_INT16(val)));
+            }
+            if (val >= INT32_MIN && val <= INT32_MAX) {
+                test_encode_round_trip(dc,
+                                       INSTR_CREATE_cmp(dc, opnd_create_reg(REG_XCX),
+                                                        OPND_CREATE_INT32(val)));
+                test_encode_round_trip(
+                    dc, INSTR_CREATE_push_imm(dc, OPND_CREATE_INT32(val)));
+            }
+#ifdef X64
+            test_encode_round_trip(dc,
+                                   INSTR_CREATE_mov_imm(dc, opnd_create_reg(REG_RAX),
+                                                        OPND_CREATE_INT64(val)));
+#endif
+        }
+    }
+}
+
 static void
 test_extra_leading_prefixes(void *dc)
 {
@@ -3042,6 +3142,8 @@ main(int argc, char *argv[])
 
     test_extra_leading_prefixes(dcontext);
 
+    test_encode_template_cache(dcontext);
+
     test_ud1_operands(dcontext);
 
     test_disasm_to_buffer(dcontext);
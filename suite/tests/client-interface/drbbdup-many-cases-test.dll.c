@@ -0,0 +1,152 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests drbbdup's search dispatch for blocks with many cases.  Each copy checks that
+ * it was selected for the runtime encoding and then moves the encoding on to the next
+ * value, so that every path through the dispatcher is taken.
+ */
+
+#include "dr_api.h"
+#include "client_tools.h"
+#include "drmgr.h"
+#include "drbbdup.h"
+
+#define DEFAULT_ENCODING 1
+#define UNHANDLED_ENCODING 7
+
+/* Sparse encodings, in no particular order, including ones too large for an
+ * immediate compare on AArchXX.
+ */
+static const uintptr_t case_encodings[] = { 250,  2,  0x1000, 33, 9,
+                                            3000, 17, 64,     5,  0x8001 };
+#define NUM_CASES (sizeof(case_encodings) / sizeof(case_encodings[0]))
+
+/* The runtime encoding cycles through every case, the default, and an encoding
+ * without a case.
+ */
+static uintptr_t cycle[NUM_CASES + 2];
+static uint cycle_pos;
+static uintptr_t case_encoding = DEFAULT_ENCODING;
+static uint case_hits[NUM_CASES + 1];
+
+static uintptr_t
+set_up_bb_dups(void *drbbdup_ctx, void *drcontext, void *tag, instrlist_t *bb,
+               bool *enable_dups, bool *enable_dynamic_handling, void *user_data)
+{
+    for (uint i = 0; i < NUM_CASES; i++) {
+        drbbdup_status_t res = drbbdup_register_case_encoding(drbbdup_ctx,
+                                                              case_encodings[i]);
+        CHECK(res == DRBBDUP_SUCCESS, "failed to register case");
+    }
+    *enable_dups = true;
+    *enable_dynamic_handling = false;
+    return DEFAULT_ENCODING;
+}
+
+static void
+check_case(uint case_idx)
+{
+    if (case_idx == NUM_CASES) {
+        CHECK(case_encoding == DEFAULT_ENCODING || case_encoding == UNHANDLED_ENCODING,
+              "default case selected for a registered encoding");
+    } else
+        CHECK(case_encoding == case_encodings[case_idx], "wrong case selected");
+    case_hits[case_idx]++;
+    cycle_pos = (cycle_pos + 1) % (NUM_CASES + 2);
+    case_encoding = cycle[cycle_pos];
+}
+
+static void
+instrument_instr(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                 instr_t *where, uintptr_t encoding, void *user_data,
+                 void *orig_analysis_data, void *analysis_data)
+{
+    bool is_start;
+    drbbdup_status_t res = drbbdup_is_first_instr(drcontext, instr, &is_start);
+    CHECK(res == DRBBDUP_SUCCESS, "failed to check whether instr is start");
+    if (!is_start)
+        return;
+    uint case_idx = NUM_CASES;
+    for (uint i = 0; i < NUM_CASES; i++) {
+        if (encoding == case_encodings[i])
+            case_idx = i;
+    }
+    dr_insert_clean_call(drcontext, bb, where, check_case, false, 1,
+                         OPND_CREATE_INT32(case_idx));
+}
+
+static void
+event_exit(void)
+{
+    drbbdup_stats_t stats = { 0 };
+    stats.struct_size = sizeof(stats);
+    drbbdup_status_t res = drbbdup_get_stats(&stats);
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup get stats failed");
+#if defined(X86) || defined(AARCHXX)
+    CHECK(stats.search_dispatch_count > 0, "search dispatch was not used");
+    /* A chain would take NUM_CASES compares to reach the default case. */
+    CHECK(stats.max_dispatch_compares < NUM_CASES, "search dispatch is too slow");
+#endif
+    CHECK(stats.dispatch_case_count > 0 &&
+              stats.dispatch_compare_count >= stats.dispatch_case_count,
+          "dispatch stats were not recorded");
+    for (uint i = 0; i <= NUM_CASES; i++)
+        CHECK(case_hits[i] > 0, "case was never selected");
+
+    res = drbbdup_exit();
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup exit failed");
+    drmgr_exit();
+}
+
+DR_EXPORT void
+dr_init(client_id_t id)
+{
+    drmgr_init();
+
+    for (uint i = 0; i < NUM_CASES; i++)
+        cycle[i] = case_encodings[i];
+    cycle[NUM_CASES] = DEFAULT_ENCODING;
+    cycle[NUM_CASES + 1] = UNHANDLED_ENCODING;
+
+    drbbdup_options_t opts = { 0 };
+    opts.struct_size = sizeof(drbbdup_options_t);
+    opts.set_up_bb_dups = set_up_bb_dups;
+    opts.instrument_instr = instrument_instr;
+    opts.runtime_case_opnd = OPND_CREATE_ABSMEM(&case_encoding, OPSZ_PTR);
+    opts.non_default_case_limit = NUM_CASES;
+    opts.is_stat_enabled = true;
+
+    drbbdup_status_t res = drbbdup_init(&opts);
+    CHECK(res == DRBBDUP_SUCCESS, "drbbdup init failed");
+    drmgr_register_exit_event(event_exit);
+}
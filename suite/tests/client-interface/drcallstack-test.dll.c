@@ -62,6 +62,32 @@ print_qualified_function_name(app_pc pc)
     dr_free_module_data(mod);
 }
 
+#define MAX_FRAMES 64
+
+/* Walks the same callstack enough times for drcallstack to decide whether to
+ * trust the frame pointers in each module, checking that the result does not
+ * change either way.
+ */
+static void
+check_collect(dr_mcontext_t *mc, app_pc *expect, uint expect_count)
+{
+    app_pc pcs[MAX_FRAMES];
+    uint num_frames, i;
+    int walk;
+    for (walk = 0; walk < 32; walk++) {
+        drcallstack_status_t res = drcallstack_collect(mc, pcs, MAX_FRAMES, &num_frames);
+        DR_ASSERT(res == DRCALLSTACK_SUCCESS);
+        DR_ASSERT(num_frames == expect_count);
+        for (i = 0; i < num_frames; i++)
+            DR_ASSERT(pcs[i] == expect[i]);
+    }
+    /* A truncated walk is not an error. */
+    if (expect_count > 1) {
+        drcallstack_status_t res = drcallstack_collect(mc, pcs, 1, &num_frames);
+        DR_ASSERT(res == DRCALLSTACK_SUCCESS && num_frames == 1 && pcs[0] == expect[0]);
+    }
+}
+
 static void
 wrap_pre(void *wrapcxt, DR_PARAM_OUT void **user_data)
 {
@@ -72,18 +98,21 @@ wrap_pre(void *wrapcxt, DR_PARAM_OUT void **user_data)
     drcallstack_frame_t frame = {
         sizeof(frame),
     };
-    int count = 0;
+    app_pc pcs[MAX_FRAMES];
+    uint count = 0;
     print_qualified_function_name(drwrap_get_func(wrapcxt));
     do {
         res = drcallstack_next_frame(walk, &frame);
         if (res != DRCALLSTACK_SUCCESS)
             break;
         print_qualified_function_name(frame.pc);
-        ++count;
+        DR_ASSERT(count < MAX_FRAMES);
+        pcs[count++] = frame.pc;
     } while (res == DRCALLSTACK_SUCCESS);
     DR_ASSERT(res == DRCALLSTACK_NO_MORE_FRAMES);
     res = drcallstack_cleanup_walk(walk);
     DR_ASSERT(res == DRCALLSTACK_SUCCESS);
+    check_collect(mc, pcs, count);
 }
 
 static void
@@ -101,11 +130,13 @@ event_exit(void)
 }
 
 DR_EXPORT void
-dr_init(client_id_t id)
+dr_client_main(client_id_t id, int argc, const char *argv[])
 {
     drcallstack_options_t ops = {
         sizeof(ops),
     };
+    if (argc > 1 && strcmp(argv[1], "-frame_pointers") == 0)
+        ops.flags = DRCALLSTACK_FRAME_POINTERS;
     if (!drwrap_init() || drcallstack_init(&ops) != DRCALLSTACK_SUCCESS ||
         drsym_init(0) != DRSYM_SUCCESS)
         DR_ASSERT(false);
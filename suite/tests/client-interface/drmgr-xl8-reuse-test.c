@@ -0,0 +1,76 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Faults over and over at the same load, as a garbage collector using memory
+ * protection barriers would.
+ */
+
+#include "tools.h"
+#include <setjmp.h>
+#include <signal.h>
+
+#define NUM_FAULTS 200
+
+static SIGJMP_BUF mark;
+static int fault_count;
+
+static void
+handle_sigsegv(int signal, siginfo_t *siginfo, void *context)
+{
+    fault_count++;
+    SIGLONGJMP(mark, 1);
+}
+
+static int
+load(volatile int *addr)
+{
+    return *addr;
+}
+
+int
+main(int argc, char *argv[])
+{
+    intercept_signal(SIGSEGV, (handler_3_t)&handle_sigsegv, false);
+    char *p = allocate_mem((int)PAGE_SIZE, ALLOW_READ | ALLOW_WRITE);
+    if (p == NULL) {
+        print("allocate_mem() failed\n");
+        abort();
+    }
+    protect_mem(p, PAGE_SIZE, 0);
+    for (int i = 0; i < NUM_FAULTS; i++) {
+        if (SIGSETJMP(mark) == 0)
+            load((volatile int *)p);
+    }
+    print("%d faults\n", fault_count);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Tests drmgr_set_translation_reuse_threshold(): the app faults many times in
+ * the same block, which should only be re-instrumented for translation until
+ * the threshold is reached.
+ */
+
+#include "dr_api.h"
+#include "client_tools.h"
+#include "drmgr.h"
+
+#define XL8_THRESHOLD 4
+
+static int translating_count;
+static int recreated_count;
+static int stored_count;
+
+static dr_emit_flags_t
+event_insertion(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst,
+                bool for_trace, bool translating, void *user_data)
+{
+    if (translating && drmgr_is_first_instr(drcontext, inst))
+        dr_atomic_add32_return_sum(&translating_count, 1);
+    return DR_EMIT_DEFAULT;
+}
+
+static bool
+event_restore_state(void *drcontext, bool restore_memory, dr_restore_state_info_t *info)
+{
+    if (info->fragment_info.cache_start_pc == NULL)
+        return true;
+    if (info->fragment_info.ilist == NULL)
+        dr_atomic_add32_return_sum(&stored_count, 1);
+    else
+        dr_atomic_add32_return_sum(&recreated_count, 1);
+    return true;
+}
+
+static void
+event_exit(void)
+{
+    /* Besides the faulting block, a few others may be translated, and a trace
+     * containing the faulting block re-creates each of its blocks.
+     */
+    CHECK(translating_count > 0, "no block was re-created for translation");
+    CHECK(recreated_count < 10 * XL8_THRESHOLD, "translations were not reused");
+    CHECK(stored_count > 0, "no stored translation was used");
+    if (!drmgr_unregister_bb_insertion_event(event_insertion) ||
+        !drmgr_unregister_restore_state_ex_event(event_restore_state))
+        CHECK(false, "drmgr unregistration failed");
+    dr_fprintf(STDERR, "all done\n");
+    drmgr_exit();
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    drmgr_init();
+    if (!drmgr_set_translation_reuse_threshold(XL8_THRESHOLD) ||
+        !drmgr_register_bb_instrumentation_event(NULL, event_insertion, NULL) ||
+        !drmgr_register_restore_state_ex_event(event_restore_state))
+        CHECK(false, "drmgr registration failed");
+    drmgr_register_exit_event(event_exit);
+}
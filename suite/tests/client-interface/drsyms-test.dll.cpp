@@ -39,6 +39,10 @@
 
 #include <limits.h>
 #include <string.h>
+#ifdef LINUX
+#    include <dirent.h>
+#    include <sys/stat.h>
+#endif
 
 /* DR's build system usually disables warnings we're not interested in, but the
  * flags don't seem to make it to the compiler for this file, maybe because
@@ -560,6 +564,377 @@ test_line_iteration(const module_data_t *dll_data)
         dr_fprintf(STDERR, "found tools.h\n");
 }
 
+#ifdef UNIX
+/* Upper bound on the line table addresses compared by test_line_index(). */
+#    define MAX_LINE_ADDRS 512
+
+typedef struct _line_addrs_t {
+    size_t addrs[MAX_LINE_ADDRS];
+    size_t count;
+} line_addrs_t;
+
+/* The outcome of one address lookup. */
+typedef struct _lookup_result_t {
+    drsym_error_t r;
+    char name[MAX_FUNC_LEN];
+    char file[MAXIMUM_PATH];
+    uint64 line;
+    size_t line_offs;
+} lookup_result_t;
+
+static bool
+collect_line_addrs_cb(drsym_line_info_t *info, void *data)
+{
+    line_addrs_t *addrs = (line_addrs_t *)data;
+    if (info->line_addr == 0)
+        return true;
+    /* Both the start of the row and an address inside it. */
+    addrs->addrs[addrs->count++] = info->line_addr;
+    addrs->addrs[addrs->count++] = info->line_addr + 1;
+    return addrs->count + 2 <= MAX_LINE_ADDRS;
+}
+
+static void
+init_lookup_info(drsym_info_t *info, lookup_result_t *res)
+{
+    info->struct_size = sizeof(*info);
+    info->name = res->name;
+    info->name_size = BUFFER_SIZE_ELEMENTS(res->name);
+    info->file = res->file;
+    info->file_size = BUFFER_SIZE_ELEMENTS(res->file);
+}
+
+static void
+record_lookup_result(lookup_result_t *res, const drsym_info_t *info, drsym_error_t r)
+{
+    res->r = r;
+    res->line = info->line;
+    res->line_offs = info->line_offs;
+    if (info->file_available_size == 0)
+        res->file[0] = '\0';
+}
+
+static void
+lookup_line_addrs(const char *dll_path, const line_addrs_t *addrs, uint flags,
+                  lookup_result_t *results)
+{
+    size_t i;
+    for (i = 0; i < addrs->count; i++) {
+        drsym_info_t info;
+        drsym_error_t r;
+        init_lookup_info(&info, &results[i]);
+        r = drsym_lookup_address(dll_path, addrs->addrs[i], &info, flags);
+        record_lookup_result(&results[i], &info, r);
+    }
+}
+
+static bool
+lookup_results_match(const lookup_result_t *a, const lookup_result_t *b, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (a[i].r != b[i].r)
+            return false;
+        if (a[i].r != DRSYM_SUCCESS && a[i].r != DRSYM_ERROR_LINE_NOT_AVAILABLE)
+            continue;
+        if (strcmp(a[i].name, b[i].name) != 0)
+            return false;
+        if (a[i].r == DRSYM_SUCCESS &&
+            (strcmp(a[i].file, b[i].file) != 0 || a[i].line != b[i].line ||
+             a[i].line_offs != b[i].line_offs))
+            return false;
+    }
+    return true;
+}
+
+/* Checks that lookups answered by the DRSYM_LINE_INDEX table match those
+ * answered by searching the DWARF line programs.
+ */
+static void
+test_line_index(const char *dll_path)
+{
+    line_addrs_t *addrs = (line_addrs_t *)dr_global_alloc(sizeof(*addrs));
+    lookup_result_t *dwarf, *index;
+    drsym_error_t r;
+
+    /* Start from a freshly loaded module, without a line index. */
+    drsym_free_resources(dll_path);
+    addrs->count = 0;
+    r = drsym_enumerate_lines(dll_path, collect_line_addrs_cb, addrs);
+    ASSERT(r == DRSYM_SUCCESS && addrs->count > 0);
+    dwarf = (lookup_result_t *)dr_global_alloc(addrs->count * sizeof(*dwarf));
+    index = (lookup_result_t *)dr_global_alloc(addrs->count * sizeof(*index));
+
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS, dwarf);
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS | DRSYM_LINE_INDEX, index);
+    if (lookup_results_match(dwarf, index, addrs->count))
+        dr_fprintf(STDERR, "line index matches DWARF\n");
+    else
+        dr_fprintf(STDERR, "line index mismatch\n");
+
+    dr_global_free(index, addrs->count * sizeof(*index));
+    dr_global_free(dwarf, addrs->count * sizeof(*dwarf));
+    dr_global_free(addrs, sizeof(*addrs));
+}
+
+/* Checks that drsym_lookup_addresses() matches drsym_lookup_address() on the
+ * line table addresses of the appdll and the exe, queried out of order and
+ * interleaved, with and without DRSYM_LINE_INDEX.
+ */
+static void
+test_lookup_addresses(const char *dll_path)
+{
+    static const uint flags[] = { DRSYM_DEFAULT_FLAGS,
+                                  DRSYM_DEFAULT_FLAGS | DRSYM_LINE_INDEX };
+    module_data_t *exe = dr_get_main_module();
+    const char *paths[2] = { dll_path, exe->full_path };
+    line_addrs_t *addrs[2];
+    lookup_result_t *single[2], *batch;
+    drsym_lookup_t *lookups;
+    drsym_info_t *infos;
+    size_t total = 0, i, k;
+    int m, f;
+    bool match = true;
+    drsym_error_t r;
+
+    for (m = 0; m < 2; m++) {
+        addrs[m] = (line_addrs_t *)dr_global_alloc(sizeof(*addrs[m]));
+        addrs[m]->count = 0;
+        r = drsym_enumerate_lines(paths[m], collect_line_addrs_cb, addrs[m]);
+        ASSERT(r == DRSYM_SUCCESS && addrs[m]->count > 0);
+        single[m] =
+            (lookup_result_t *)dr_global_alloc(addrs[m]->count * sizeof(*single[m]));
+        total += addrs[m]->count;
+    }
+    batch = (lookup_result_t *)dr_global_alloc(total * sizeof(*batch));
+    lookups = (drsym_lookup_t *)dr_global_alloc(total * sizeof(*lookups));
+    infos = (drsym_info_t *)dr_global_alloc(total * sizeof(*infos));
+
+    for (f = 0; f < (int)BUFFER_SIZE_ELEMENTS(flags); f++) {
+        /* Each module's addresses in reverse order, alternating modules. */
+        for (m = 0; m < 2; m++)
+            drsym_free_resources(paths[m]);
+        for (i = 0, k = 0; k < total; i++) {
+            for (m = 0; m < 2; m++) {
+                if (i >= addrs[m]->count)
+                    continue;
+                lookups[k].modpath = paths[m];
+                lookups[k].modoffs = addrs[m]->addrs[addrs[m]->count - 1 - i];
+                init_lookup_info(&infos[k], &batch[k]);
+                lookups[k].info = &infos[k];
+                k++;
+            }
+        }
+        r = drsym_lookup_addresses(lookups, total, flags[f]);
+        ASSERT(r == DRSYM_SUCCESS);
+
+        for (m = 0; m < 2; m++) {
+            drsym_free_resources(paths[m]);
+            lookup_line_addrs(paths[m], addrs[m], flags[f], single[m]);
+        }
+        for (i = 0, k = 0; k < total; i++) {
+            for (m = 0; m < 2; m++) {
+                if (i >= addrs[m]->count)
+                    continue;
+                record_lookup_result(&batch[k], &infos[k], lookups[k].result);
+                if (!lookup_results_match(&single[m][addrs[m]->count - 1 - i], &batch[k],
+                                          1))
+                    match = false;
+                k++;
+            }
+        }
+    }
+    if (match)
+        dr_fprintf(STDERR, "batch lookups match\n");
+    else
+        dr_fprintf(STDERR, "batch lookup mismatch\n");
+
+    dr_global_free(infos, total * sizeof(*infos));
+    dr_global_free(lookups, total * sizeof(*lookups));
+    dr_global_free(batch, total * sizeof(*batch));
+    for (m = 0; m < 2; m++) {
+        dr_global_free(single[m], addrs[m]->count * sizeof(*single[m]));
+        dr_global_free(addrs[m], sizeof(*addrs[m]));
+    }
+    dr_free_module_data(exe);
+}
+#endif
+
+#ifdef LINUX
+/* Finds the cache file in dir other than skip. */
+static bool
+find_cache_file(const char *dir, const char *skip, char *path, size_t path_size)
+{
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    bool found = false;
+    ASSERT(d != NULL);
+    while ((ent = readdir(d)) != NULL) {
+        const char *suffix = strstr(ent->d_name, ".drsymcache");
+        if (suffix == NULL || suffix[strlen(".drsymcache")] != '\0')
+            continue;
+        dr_snprintf(path, path_size, "%s/%s", dir, ent->d_name);
+        path[path_size - 1] = '\0';
+        if (skip == NULL || strcmp(path, skip) != 0) {
+            found = true;
+            break;
+        }
+    }
+    closedir(d);
+    return found;
+}
+
+static byte *
+read_whole_file(const char *path, size_t *size DR_PARAM_OUT)
+{
+    file_t f = dr_open_file(path, DR_FILE_READ);
+    uint64 file_size;
+    byte *buf;
+    ASSERT(f != INVALID_FILE);
+    if (!dr_file_size(f, &file_size))
+        ASSERT(false);
+    *size = (size_t)file_size;
+    buf = (byte *)dr_global_alloc(*size);
+    if (dr_read_file(f, buf, *size) != (ssize_t)*size)
+        ASSERT(false);
+    dr_close_file(f);
+    return buf;
+}
+
+static void
+write_whole_file(const char *path, const byte *buf, size_t size)
+{
+    file_t f = dr_open_file(path, DR_FILE_WRITE_OVERWRITE);
+    ASSERT(f != INVALID_FILE);
+    if (dr_write_file(f, buf, size) != (ssize_t)size)
+        ASSERT(false);
+    dr_close_file(f);
+}
+
+/* A rewritten cache file is renamed into place, so it gets a new inode. */
+static ino_t
+file_inode(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        ASSERT(false);
+    return st.st_ino;
+}
+
+/* Returns whether the file at path holds exactly buf. */
+static bool
+file_matches(const char *path, const byte *buf, size_t size)
+{
+    size_t cur_size;
+    byte *cur = read_whole_file(path, &cur_size);
+    bool match = cur_size == size && memcmp(cur, buf, size) == 0;
+    dr_global_free(cur, cur_size);
+    return match;
+}
+
+/* Checks that lookups answered from drsym_set_cache_dir()'s cache file match
+ * those answered from the module, and that a corrupt file or one written for
+ * another module is rejected and rewritten.
+ */
+static void
+test_cache(const char *dll_path)
+{
+    line_addrs_t *addrs = (line_addrs_t *)dr_global_alloc(sizeof(*addrs));
+    lookup_result_t *expect, *got;
+    module_data_t *exe = dr_get_main_module();
+    char dir[MAXIMUM_PATH], cache_path[MAXIMUM_PATH], other_path[MAXIMUM_PATH];
+    byte *orig, *buf;
+    size_t orig_size, size, exe_offs;
+    ino_t inode;
+    char *slash;
+    drsym_error_t r;
+
+    drsym_free_resources(dll_path);
+    addrs->count = 0;
+    r = drsym_enumerate_lines(dll_path, collect_line_addrs_cb, addrs);
+    ASSERT(r == DRSYM_SUCCESS && addrs->count > 0);
+    expect = (lookup_result_t *)dr_global_alloc(addrs->count * sizeof(*expect));
+    got = (lookup_result_t *)dr_global_alloc(addrs->count * sizeof(*got));
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS, expect);
+
+    dr_snprintf(dir, BUFFER_SIZE_ELEMENTS(dir), "%s", dll_path);
+    NULL_TERMINATE_BUFFER(dir);
+    slash = strrchr(dir, '/');
+    ASSERT(slash != NULL);
+    dr_snprintf(slash, BUFFER_SIZE_ELEMENTS(dir) - (slash - dir), "/drsyms-cache.%d",
+                dr_get_process_id());
+    NULL_TERMINATE_BUFFER(dir);
+    if (!dr_create_dir(dir))
+        ASSERT(false);
+    r = drsym_set_cache_dir(dir);
+    ASSERT(r == DRSYM_SUCCESS);
+
+    /* The first query writes the file and the next load maps it. */
+    drsym_free_resources(dll_path);
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS, got);
+    ASSERT(lookup_results_match(expect, got, addrs->count));
+    if (!find_cache_file(dir, NULL, cache_path, BUFFER_SIZE_ELEMENTS(cache_path)))
+        ASSERT(false);
+    orig = read_whole_file(cache_path, &orig_size);
+    inode = file_inode(cache_path);
+    drsym_free_resources(dll_path);
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS, got);
+    if (lookup_results_match(expect, got, addrs->count) &&
+        file_inode(cache_path) == inode)
+        dr_fprintf(STDERR, "cache lookups match\n");
+    else
+        dr_fprintf(STDERR, "cache lookups mismatch\n");
+
+    /* A corrupt file is rewritten, with the same contents as before. */
+    buf = (byte *)dr_global_alloc(orig_size);
+    memcpy(buf, orig, orig_size);
+    buf[orig_size / 2] ^= 0xff;
+    write_whole_file(cache_path, buf, orig_size);
+    dr_global_free(buf, orig_size);
+    drsym_free_resources(dll_path);
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS, got);
+    if (lookup_results_match(expect, got, addrs->count) &&
+        file_matches(cache_path, orig, orig_size))
+        dr_fprintf(STDERR, "corrupt cache rewritten\n");
+    else
+        dr_fprintf(STDERR, "corrupt cache used\n");
+
+    /* So is a valid file for a different module.  The exe was queried before
+     * the cache was enabled, so we reload it to have it write its file.
+     */
+    drsym_free_resources(exe->full_path);
+    r = drsym_lookup_symbol(exe->full_path, "main", &exe_offs, DRSYM_DEFAULT_FLAGS);
+    ASSERT(r == DRSYM_SUCCESS);
+    if (!find_cache_file(dir, cache_path, other_path, BUFFER_SIZE_ELEMENTS(other_path)))
+        ASSERT(false);
+    buf = read_whole_file(other_path, &size);
+    write_whole_file(cache_path, buf, size);
+    dr_global_free(buf, size);
+    drsym_free_resources(dll_path);
+    lookup_line_addrs(dll_path, addrs, DRSYM_DEFAULT_FLAGS, got);
+    if (lookup_results_match(expect, got, addrs->count) &&
+        file_matches(cache_path, orig, orig_size))
+        dr_fprintf(STDERR, "stale cache rewritten\n");
+    else
+        dr_fprintf(STDERR, "stale cache used\n");
+
+    r = drsym_set_cache_dir(NULL);
+    ASSERT(r == DRSYM_SUCCESS);
+    drsym_free_resources(dll_path);
+    drsym_free_resources(exe->full_path);
+    dr_delete_file(cache_path);
+    dr_delete_file(other_path);
+    if (!dr_delete_dir(dir))
+        ASSERT(false);
+
+    dr_free_module_data(exe);
+    dr_global_free(orig, orig_size);
+    dr_global_free(got, addrs->count * sizeof(*got));
+    dr_global_free(expect, addrs->count * sizeof(*expect));
+    dr_global_free(addrs, sizeof(*addrs));
+}
+#endif
+
 /* Lookup symbols in the appdll and wrap them. */
 static void
 lookup_dll_syms(void *dc, const module_data_t *dll_data, bool loaded)
@@ -631,6 +1006,13 @@ lookup_dll_syms(void *dc, const module_data_t *dll_data, bool loaded)
     check_enumerate_dll_syms(dll_path);
 
     test_line_iteration(dll_data);
+#ifdef UNIX
+    test_line_index(dll_path);
+    test_lookup_addresses(dll_path);
+#endif
+#ifdef LINUX
+    test_cache(dll_path);
+#endif
 
     drsym_free_resources(dll_path);
 }